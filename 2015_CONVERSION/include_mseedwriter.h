@@ -0,0 +1,98 @@
+/*
+ *   mseedwriter.h
+ *
+ *   miniSEED putaway routines, so events can be archived as miniSEED
+ *   straight from the TRACE_BUF samples rather than through SUDS, GSE
+ *   and step3_gse2mseed.
+ *
+ *   MSEEDWR_XXX mirror SUDSWR_XXX: init once, then next_ev, next for
+ *   each channel, and end_ev for each event, and close at the end; the
+ *   MSEEDPA_XXX calls do the same through one writer hidden in
+ *   mseedputaway.c. Each event goes in
+ *
+ *      OutDir/yyyymmdd_hhmmss_subnet_evid.mseed
+ *
+ *   named as the SUDS .dmx would be (or as the caller says, with
+ *   MSEEDWR_next_ev_file). Each channel is written as a run
+ *   of SEED 2.4 data records (RecLen bytes, 512 or 4096 say; quality
+ *   'D', a blockette 1000, data from byte 64, big-endian) in the
+ *   encoding OutputFormat names:
+ *
+ *      "steim2"   Steim2 compression (the default)
+ *      "int32"    32-bit integers
+ *
+ *   Station, channel and network are the TRACE_BUF's, cut to 5, 3 and 2
+ *   characters, and the location code is blank. Short and long samples
+ *   are written as they are; float samples are cut to integers,
+ *   clipped to the 32-bit range. A gap or overlap of more than
+ *   GapThresh samples starts a new record with its own start time
+ *   (nothing is filled in), and so does a difference too big for
+ *   Steim2 to hold.
+ *
+ *   A channel is encoded a buffer-load at a time as its packets come
+ *   in, so its length is not limited. The differences are taken and
+ *   sorted by width with SudsSteimDiff (sudsconvert.h), which is
+ *   vectorized; the packing then only looks at the width classes.
+ */
+
+#ifndef MSEEDWRITER_H
+#define MSEEDWRITER_H
+
+#include <stdint.h>
+#include <ws_clientII.h>
+#include <sudsio.h>
+
+#define MSEED_MAXTXT     150
+#define MSEED_STEIM2     11            /* blockette 1000 encoding formats */
+#define MSEED_INT32      3
+#define MSEED_RUNLEN     65536         /* samples buffered per channel */
+#define MSEED_OUTRECS    64            /* records gathered per write */
+
+typedef struct _MSEED_WRITER
+{
+  SUDS_OUT Out;                        /* miniSEED file for the current event */
+  int     IoMode;                      /* SUDS_IO_XXX for new files */
+  char    FileName[4*MSEED_MAXTXT];    /* name of the current file */
+  int     RecLen;                      /* bytes in a record */
+  int     RecExp;                      /* ... as a power of 2 */
+  int     Encoding;                    /* MSEED_STEIM2 or MSEED_INT32 */
+  long    Seq;                         /* sequence number of the last record */
+
+  /* the run of samples being encoded */
+  int32_t *Samples;                    /* MSEED_RUNLEN samples */
+  int32_t *Diff;                       /* and their differences */
+  unsigned char *Class;                /* ... and width classes */
+  long    nRun;                        /* samples in the buffers */
+  int     InRun;                       /* a run is under way */
+  int32_t Last;                        /* its last sample so far */
+  double  RunT0;                       /* time of its first sample */
+  long    RunDone;                     /* samples of it already written */
+  double  Rate;
+  char    Sta[6], Chan[4], Net[3];
+
+  unsigned char *OutBuf;               /* MSEED_OUTRECS records */
+  int     nOut;                        /* records in OutBuf */
+} MSEED_WRITER;
+
+int MSEEDWR_init (MSEED_WRITER *mw, int RecLen, char *OutDir,
+                  char *OutputFormat, int debug);
+int MSEEDWR_set_io (MSEED_WRITER *mw, int IoMode);
+int MSEEDWR_next_ev (MSEED_WRITER *mw, char *EventID, TRACE_REQ *ptrReq,
+                     int nReq, char *OutDir, char *EventDate, char *EventTime,
+                     char *EventSubnet, int debug);
+int MSEEDWR_next_ev_file (MSEED_WRITER *mw, const char *FileName, int debug);
+int MSEEDWR_next (MSEED_WRITER *mw, TRACE_REQ *getThis, double GapThresh,
+                  int debug);
+int MSEEDWR_end_ev (MSEED_WRITER *mw, int debug);
+int MSEEDWR_close (MSEED_WRITER *mw, int debug);
+
+/* The same through the default writer */
+int MSEEDPA_init (int RecLen, char *OutDir, char *OutputFormat, int debug);
+int MSEEDPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq,
+                     char *OutDir, char *EventDate, char *EventTime,
+                     char *EventSubnet, int debug);
+int MSEEDPA_next (TRACE_REQ *getThis, double GapThresh, int debug);
+int MSEEDPA_end_ev (int debug);
+int MSEEDPA_close (int debug);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ *   sudsarchive.h
+ *
+ *   Bulk conversion of a PC-SUDS archive, in place of running
+ *   sort_suds_data.pl, demux.pl, irig.pl and suds2gse.pl over the tree
+ *   one after another.
+ *
+ *   SudsArchiveRun walks InDir once for .WVM files (any case) and for
+ *   each one
+ *
+ *      - demultiplexes it (sudsdemux.h) into OutDir/<same dir>/<name>.dmx,
+ *        correcting its times from the IRIG channel if one is named
+ *        (sudsirig.h), and
+ *      - if MseedDir is set, writes the same channels as miniSEED to
+ *        MseedDir/<same dir>/<name>.mseed (mseedwriter.h).
+ *
+ *   Files are done on a pool of nThreads threads, each with its own
+ *   writers. Each output is written under a .part name, synced to
+ *   disk and renamed when complete, the rename synced too, and then
+ *   the file is recorded in the journal, an append-only text file
+ *   synced after every record. A file already in the journal with the
+ *   same size and modification time is skipped, so a run that was
+ *   interrupted (or killed) picks up where it stopped, and a file that
+ *   changed since is done again. Every ReportSec seconds, and at the
+ *   end, the files and bytes done so far and their rates are logged.
+ *
+ *   The input of the files a few places ahead in the queue is asked
+ *   for (posix_fadvise) while the current ones are converted, so the
+ *   reading of one file overlaps the de-interleaving and writing of
+ *   the ones before it.
+ */
+
+#ifndef SUDSARCHIVE_H
+#define SUDSARCHIVE_H
+
+#define SUDS_ARCHIVE_JOURNAL  "sudsarchive.jnl"   /* in OutDir by default */
+
+typedef struct
+{
+  const char *InDir;                   /* archive to walk for .WVM files */
+  const char *OutDir;                  /* .dmx tree */
+  const char *MseedDir;                /* miniSEED tree; NULL for none */
+  int         MseedRecLen;             /* record length; 0 for 4096 */
+  const char *OutputFormat;            /* .dmx byte order: "intel" or "sparc" */
+  const char *Journal;                 /* NULL for OutDir/SUDS_ARCHIVE_JOURNAL */
+  int         nThreads;
+  int         ReportSec;               /* 0 for a report only at the end */
+  const char *IrigSta;                 /* time code channel; NULL for none */
+  const char *IrigChan;
+  int         IrigCode;                /* SUDS_IRIG_B or SUDS_IRIG_E */
+  int         debug;
+} SUDS_ARCHIVE_PARAMS;
+
+typedef struct
+{
+  long        nFiles;                  /* .WVM files found */
+  long        nSkipped;                /* ... already in the journal */
+  long        nDone;                   /* ... converted this run */
+  long        nFailed;
+  double      Bytes;                   /* input bytes converted this run */
+  double      Seconds;                 /* wall clock time of the run */
+} SUDS_ARCHIVE_STATS;
+
+/* Convert the archive; EW_FAILURE if it couldn't be started or any *
+ * file failed. st (may be NULL) says how it went.                   */
+int SudsArchiveRun (const SUDS_ARCHIVE_PARAMS *ap, SUDS_ARCHIVE_STATS *st);
+
+#endif
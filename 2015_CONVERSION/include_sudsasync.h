@@ -0,0 +1,73 @@
+/*
+ *   sudsasync.h
+ *
+ *   Write-behind service for SUDS event files.
+ *
+ *   The putaway routines hand each piece of output to the service, which
+ *   copies it into its queue and returns; background I/O threads do the
+ *   open, writes, fsync and close. Closing a file returns at once, and
+ *   the DONE callback (called on an I/O thread) reports later whether
+ *   everything for that file made it to disk. Each file is owned by one
+ *   I/O thread, so its writes happen in the order they were queued;
+ *   different files go to different threads.
+ *
+ *   Where the kernel has io_uring, each I/O thread keeps a run of queued
+ *   writes in flight at once through its own ring; otherwise, or if the
+ *   ring can't be set up, it uses pwrite.
+ *
+ *   Durability policy:
+ *     SUDS_SYNC_NONE   close without fsync; the OS writes back when it likes
+ *     SUDS_SYNC_EVENT  fdatasync each file before reporting it done
+ *     SUDS_SYNC_GROUP  keep closed files open and fdatasync them together
+ *                      every GroupMs milliseconds (sooner if 256 are
+ *                      waiting), then report them done
+ *
+ *   The queue holds at most MaxQueued bytes; a producer that gets that far
+ *   ahead of the disk waits for room rather than growing memory without
+ *   bound.
+ */
+
+#ifndef SUDSASYNC_H
+#define SUDSASYNC_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define SUDS_SYNC_NONE    0
+#define SUDS_SYNC_EVENT   1
+#define SUDS_SYNC_GROUP   2
+
+typedef struct _SUDS_ASYNC SUDS_ASYNC;
+typedef struct _SUDS_AFILE SUDS_AFILE;
+
+/* Called once per file, on an I/O thread, when it has been closed (and *
+ * synced, per the policy); status is EW_SUCCESS or EW_FAILURE           */
+typedef void (*SUDS_ASYNC_DONE) (void *arg, const char *path, int status);
+
+/* Start the service with nThreads I/O threads */
+SUDS_ASYNC *SudsAsyncStart (int nThreads, int Sync, int GroupMs,
+                            long MaxQueued);
+
+/* Finish everything queued, then stop the I/O threads and free the service */
+void SudsAsyncStop (SUDS_ASYNC *as);
+
+/* Is io_uring in use? */
+int SudsAsyncUring (SUDS_ASYNC *as);
+
+/* Queue the creation of path; NULL only if out of memory */
+SUDS_AFILE *SudsAsyncOpen (SUDS_ASYNC *as, const char *path);
+
+/* Queue a write of the n pieces in iov at offset off */
+int SudsAsyncWrite (SUDS_AFILE *af, const struct iovec *iov, int n, off_t off);
+
+/* Queue a rewrite of bytes already queued; ordered after all earlier writes */
+int SudsAsyncPatch (SUDS_AFILE *af, const void *buf, size_t len, off_t off);
+
+/* Queue cutting the file back to off bytes */
+int SudsAsyncTruncate (SUDS_AFILE *af, off_t off);
+
+/* Queue the close; done (may be NULL) is called when it has happened. *
+ * af must not be used after this.                                     */
+int SudsAsyncClose (SUDS_AFILE *af, SUDS_ASYNC_DONE done, void *arg);
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ *   sudsbufpool.h
+ *
+ *   Sample buffers for the PC-SUDS putaway routines, shared by any
+ *   number of writers and threads.
+ *
+ *   Buffers come in size classes, powers of two from SUDS_BUF_MIN up,
+ *   and one that is given back is kept for the next call wanting that
+ *   class, so the same few buffers serve every channel of every event.
+ *   A writer asks for about what the channel needs and grows it as it
+ *   goes, so the memory in hand is what is being worked on now, not a
+ *   worst case fixed up front.
+ *
+ *   With Huge set, buffers of SUDS_BUF_HUGE (2 MB) or more are mapped on
+ *   hugepages: explicit ones (MAP_HUGETLB) if any are reserved, else
+ *   2 MB aligned and marked for transparent hugepages, so a long trace
+ *   takes a few TLB entries instead of hundreds.
+ *
+ *   Cap, if not 0, bounds the bytes in the pool, given out or kept.
+ *   A call that would go past it first drops kept buffers, then waits
+ *   for other threads to give theirs back; that wait is the
+ *   backpressure on the callers. If nothing given out can come back
+ *   soon - every holder is itself waiting for memory or stalled (see
+ *   SudsBufStall) - the call goes over the cap rather than wait
+ *   forever, and the overdraft is counted. Only a single buffer bigger
+ *   than Cap is refused.
+ */
+
+#ifndef SUDSBUFPOOL_H
+#define SUDSBUFPOOL_H
+
+#include <stddef.h>
+
+#define SUDS_BUF_MIN     65536         /* smallest size class, bytes */
+#define SUDS_BUF_HUGE    2097152       /* hugepage size */
+
+typedef struct _SUDS_BUFPOOL SUDS_BUFPOOL;
+
+typedef struct
+{
+  size_t  InUse;                       /* bytes given out */
+  size_t  Kept;                        /* bytes given back and kept */
+  size_t  Peak;                        /* most of both at once */
+  long    Gets;                        /* buffers given out, grown or not */
+  long    Reused;                      /* ... that were kept ones */
+  long    Waits;                       /* calls that waited for memory */
+  long    Overdrafts;                  /* calls that went over the cap */
+  long    Huge;                        /* buffers mapped on hugepages */
+} SUDS_BUFSTATS;
+
+/* A new, empty pool; Cap 0 for no cap */
+SUDS_BUFPOOL *SudsBufPoolCreate (size_t Cap, int Huge);
+
+/* The pool's cap, 0 for none */
+size_t SudsBufPoolCap (SUDS_BUFPOOL *bp);
+
+/* A buffer of at least want bytes; its real size goes in *size. NULL *
+ * if want is over the cap, or out of memory.                          */
+void *SudsBufGet (SUDS_BUFPOOL *bp, size_t want, size_t *size);
+
+/* Trade buf (*size bytes) for one of at least want bytes holding its *
+ * first keep bytes. On failure buf is still the caller's and NULL is *
+ * returned.                                                           */
+void *SudsBufGrow (SUDS_BUFPOOL *bp, void *buf, size_t keep, size_t want,
+                   size_t *size);
+
+/* Give back a buffer from SudsBufGet or SudsBufGrow; buf may be NULL */
+void SudsBufPut (SUDS_BUFPOOL *bp, void *buf, size_t size);
+
+/* The calling thread, holding held bytes, is about to wait (stalled *
+ * 1) on something other than memory, or is done waiting (0)         */
+void SudsBufStall (SUDS_BUFPOOL *bp, size_t held, int stalled);
+
+void SudsBufPoolStats (SUDS_BUFPOOL *bp, SUDS_BUFSTATS *st);
+
+/* Free the pool and every kept buffer; all must have been given back */
+void SudsBufPoolDestroy (SUDS_BUFPOOL *bp);
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ *   sudscatalog.h
+ *
+ *   Catalog of every trace the SUDS putaway routines write, kept in
+ *   columns on disk and memory-mapped, so daily counts and station
+ *   uptime come from the catalog in a moment rather than from hours of
+ *   rescanning the archive.
+ *
+ *   Hand a SUDS_CATALOG to SUDSWR_set_catalog and each trace written
+ *   (each DESCRIPTRACE: one per channel, or one per segment when
+ *   segmenting) adds a row of
+ *
+ *      id          trace id, NET.STA.--.CHAN as in the daily CSVs
+ *      begintime   epoch seconds, before any IRIG time correction
+ *      rate        samples per second
+ *      nsamp       samples
+ *      mindata     least and greatest sample
+ *      maxdata
+ *      gaps        gaps filled within the trace
+ *      clipped     clipped samples
+ *      file        a 64-bit hash of the event file's name
+ *      quality     0, 0.5 or 1 from the QC engine (sudsqc.h), if the
+ *      snr         writer has one; -1 if not
+ *
+ *   The catalog is a directory holding a small header file and one
+ *   file per column, each a plain array in the machine's byte order,
+ *   grown by doubling. A row is copied into the columns first and only
+ *   then counted in the header, so a reader never sees half of one.
+ *   Like the other engines it belongs to the caller and may be shared
+ *   by any number of writers in one process; only one process may
+ *   have it open for writing, but any number may read it.
+ *
+ *   SudsCatalogByDay and SudsCatalogUptime sum the rows up by UTC day
+ *   or over a span of time, for the catalog as a whole, each station or
+ *   each trace id. A trace is counted on the day it begins. Uptime is
+ *   the part of the span covered by at least one trace, so overlapping
+ *   traces of the same station are only counted once. SudsCatalogCols
+ *   gives the columns themselves to anything else that wants to scan
+ *   them.
+ */
+
+#ifndef SUDSCATALOG_H
+#define SUDSCATALOG_H
+
+#include <stdint.h>
+
+#define SUDS_CAT_IDLEN    32
+
+#define SUDS_CAT_ALL      0            /* SudsCatalogByDay, SudsCatalogUptime: */
+#define SUDS_CAT_STA      1            /* ... group by NET.STA */
+#define SUDS_CAT_ID       2            /* ... group by trace id */
+
+typedef struct _SUDS_CATALOG SUDS_CATALOG;
+
+typedef struct
+{
+  char      id[SUDS_CAT_IDLEN];
+  double    begintime;
+  double    rate;
+  int64_t   nsamp;
+  int32_t   mindata;
+  int32_t   maxdata;
+  int32_t   gaps;
+  int64_t   clipped;
+  uint64_t  file;
+  float     quality;
+  float     snr;
+} SUDS_CATROW;
+
+/* The columns, for scanning directly; each has nrows entries */
+typedef struct
+{
+  long            nrows;
+  const char     *id;                  /* nrows * SUDS_CAT_IDLEN */
+  const double   *begintime;
+  const double   *rate;
+  const int64_t  *nsamp;
+  const int32_t  *mindata;
+  const int32_t  *maxdata;
+  const int32_t  *gaps;
+  const int64_t  *clipped;
+  const uint64_t *file;
+  const float    *quality;
+  const float    *snr;
+} SUDS_CATCOLS;
+
+/* One day of one group */
+typedef struct
+{
+  long      yyyymmdd;
+  char      id[SUDS_CAT_IDLEN];        /* NET.STA or trace id; "" for all */
+  long      traces;
+  long      files;                     /* different event files */
+  int64_t   samples;
+  double    seconds;                   /* of samples */
+  long      gaps;
+  int64_t   clipped;
+  int32_t   mindata;
+  int32_t   maxdata;
+  long      checked;                   /* traces with a quality */
+  long      bad;                       /* ... of 0 */
+  double    quality;                   /* ... their mean; -1 if none */
+} SUDS_CATDAY;
+
+/* One group's share of a span of time */
+typedef struct
+{
+  char      id[SUDS_CAT_IDLEN];
+  long      traces;                    /* that overlap the span */
+  double    seconds;                   /* of the span covered by them */
+  double    fraction;                  /* ... as a part of the span */
+} SUDS_CATUPTIME;
+
+/* Open the catalog in Dir, making it if need be when Write is set; NULL *
+ * on failure                                                            */
+SUDS_CATALOG *SudsCatalogOpen (const char *Dir, int Write);
+
+/* Append a row */
+int SudsCatalogAdd (SUDS_CATALOG *cat, const SUDS_CATROW *row);
+
+/* The 64-bit hash of a file name used for the file column */
+uint64_t SudsCatalogFileKey (const char *FileName);
+
+/* The rows so far; a reader sees the rows there were when it opened */
+long SudsCatalogRows (SUDS_CATALOG *cat);
+
+/* The columns as mapped now. A writer's move when the catalog grows, *
+ * so in the writing process they are only good until the next row.   */
+int SudsCatalogCols (SUDS_CATALOG *cat, SUDS_CATCOLS *cols);
+
+/* Sum up the rows by day and By (SUDS_CAT_XXX) into a malloced array, *
+ * sorted by day and then id                                           */
+int SudsCatalogByDay (SUDS_CATALOG *cat, int By, SUDS_CATDAY **day, long *n);
+
+/* How much of t0 to t1 each group (By) has traces for, into a malloced *
+ * array sorted by id; groups with no traces in the span are left out    */
+int SudsCatalogUptime (SUDS_CATALOG *cat, int By, double t0, double t1,
+                       SUDS_CATUPTIME **up, long *n);
+
+/* Flush and close the catalog; cat may be NULL */
+int SudsCatalogClose (SUDS_CATALOG *cat);
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ *   sudsconvert.h
+ *
+ *   Sample conversion kernels for sudsputaway.c.
+ *
+ *   Each kernel copies one TRACE_BUF payload into the SUDS output
+ *   buffer, clipping to the output type and swapping to the output
+ *   byte order in the same pass, and folds the (native order) sample
+ *   values into the running statistics for the trace (sudsstats.h).
+ *
+ *   SudsDeinterleave splits multiplexed samples (sudsdemux.h) into one
+ *   array per channel, and SudsSteimDiff takes the differences the
+ *   Steim2 encoder (mseedwriter.h) packs.
+ *
+ *   Samples have explicit widths: a SUDS long sample is 32 bits, as it
+ *   is in files written by 32-bit builds, even where long is 64.
+ *
+ *   SudsConvertInit picks SSE2 or AVX2 versions of the kernels when
+ *   the CPU supports them; until it is called the portable scalar
+ *   versions are used.
+ */
+
+#ifndef SUDSCONVERT_H
+#define SUDSCONVERT_H
+
+#include <stdint.h>
+#include <sudsstats.h>
+
+/* Select the fastest kernels this CPU can run */
+void SudsConvertInit (void);
+
+/* Name of the kernel set selected by SudsConvertInit, for logging */
+const char *SudsConvertName (void);
+
+/* i2 TRACE_BUF samples -> 16-bit SUDS samples; with out NULL, only the *
+ * statistics are taken, for samples that can be written as they are    */
+extern void (*SudsConvShort) (const int16_t *in, int16_t *out, long n,
+                              int swap, SUDS_STATS *st);
+
+/* i4 TRACE_BUF samples -> 32-bit SUDS (long) samples */
+extern void (*SudsConvLong) (const int32_t *in, int32_t *out, long n,
+                             int swap, SUDS_STATS *st);
+
+/* f4 TRACE_BUF samples -> 32-bit SUDS samples, clipped to INT32_MIN..    *
+ * INT32_MAX; a NaN becomes 0                                             */
+extern void (*SudsConvFloat) (const float *in, int32_t *out, long n, int swap,
+                              SUDS_STATS *st);
+
+/* Multiplexed short samples -> one array per channel: sample c of scan *
+ * i (the short at byte 2 * (i * nch + c) of mux) goes to out[c][i];    *
+ * mux need not be aligned, and byte order is left alone                */
+extern void (*SudsDeinterleave) (const char *mux, long nscan, int nch,
+                                 short *const *out);
+
+/* d[i] = x[i] - x[i-1] (modulo 2^32), with x[-1] = prev, and cls[i] the *
+ * Steim2 width class of d[i]: 0..6 for 4, 5, 6, 8, 10, 15 or 30 bits, 7   *
+ * if it fits none of them. Returns the largest class.                     */
+extern int (*SudsSteimDiff) (const int32_t *x, long n, int32_t prev,
+                             int32_t *d, unsigned char *cls);
+
+/* Fill n output samples with a constant (used for gap filling) */
+void SudsFillShort (int16_t *out, long n, int16_t value, int swap);
+void SudsFillLong (int32_t *out, long n, int32_t value, int swap);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ *   sudsdemux.h
+ *
+ *   Demultiplexing of PC-SUDS .WVM files into .dmx files, in place of
+ *   running demux.exe once per file.
+ *
+ *   A .WVM file holds the STATIONCOMPs of the digitizer's channels
+ *   and then MUXDATA blocks, each numsamps scans of numchans
+ *   interleaved short samples. The file is mapped (sudsreader.h), each
+ *   block is de-interleaved (SudsDeinterleave, sudsconvert.h) straight
+ *   into one TRACE_BUF packet per channel, and the channels are written
+ *   through a SUDS_WRITER as STATIONCOMP / DESCRIPTRACE / samples, just
+ *   as SUDSPA_next writes them. Everything the writer does on the way
+ *   (statistics, triggers, IRIG, the index) is done for these too.
+ *
+ *   Column c of the blocks belongs to the STATIONCOMP whose channel
+ *   number is c, if the channel numbers (from 0 or from 1) number the
+ *   columns; otherwise to the c'th STATIONCOMP in the file. The
+ *   STATIONCOMPs are carried over to the .dmx as they were, bar the
+ *   data type and clip level. A column without one is named CHnnn.
+ *   Blocks are taken to follow each other in time; a gap between them
+ *   is filled as SUDSWR_next fills gaps. Other records in the .WVM are
+ *   not copied.
+ *
+ *   SudsDemuxFile is SudsDemuxLoad, which maps and de-interleaves a file
+ *   into one TRACE_REQ per channel, then SudsDemuxWrite; a caller with
+ *   other uses for the channels (a miniSEED copy, say) can call them
+ *   itself. If the writer has a trigger engine (and isn't segmenting),
+ *   SudsDemuxFile runs each block through it as it stands, all the
+ *   channels at once (SudsTrigFeedMux), and the writer is handed the
+ *   triggers instead of feeding the channels one at a time; a file
+ *   loaded with SudsDemuxLoad is fed by the writer as usual.
+ *
+ *   SudsDemuxFiles demultiplexes a list of files on a pool of threads,
+ *   one writer per thread. The packets for a file are built whole
+ *   before it is written, taking about as much memory as the file
+ *   itself; no file is started while that would take the files in
+ *   hand past MemBudget bytes (though a file bigger than the budget
+ *   is still done, on its own).
+ */
+
+#ifndef SUDSDEMUX_H
+#define SUDSDEMUX_H
+
+#include <stddef.h>
+#include <sudswriter.h>
+
+#define SUDS_DEMUX_BUFLEN   1048576    /* writer buffers for SudsDemuxFiles */
+
+/* A demultiplexed file: nch channels, each a TRACE_REQ whose packets *
+ * (native byte order) are in pkts                                     */
+typedef struct
+{
+  int               nch;
+  TRACE_REQ        *req;
+  SUDS_STATIONCOMP *sc;                /* the file's STATIONCOMPs, native order */
+  int               nsc;
+  char             *pkts;
+  size_t            size;              /* bytes in pkts */
+  SUDS_TRIGGERS    *tr;                /* each channel's triggers, if fed */
+} SUDS_DEMUXED;
+
+/* Demultiplex path into outpath through sw, which should be streaming *
+ * (SUDSWR_set_stream) unless its buffers hold a whole channel           */
+int SudsDemuxFile (SUDS_WRITER *sw, const char *path, const char *outpath,
+                   int debug);
+
+/* Map and de-interleave path into dm */
+int SudsDemuxLoad (const char *path, SUDS_DEMUXED *dm, int debug);
+
+/* Write dm's channels to outpath through sw (as for SudsDemuxFile) */
+int SudsDemuxWrite (SUDS_WRITER *sw, SUDS_DEMUXED *dm, const char *outpath,
+                    int debug);
+
+void SudsDemuxFree (SUDS_DEMUXED *dm);
+
+/* Name of the .dmx for path: its base name with the extension (if any) *
+ * changed to .dmx, in OutDir, or beside path if OutDir is NULL          */
+int SudsDemuxName (const char *path, const char *OutDir, char *out,
+                   size_t len);
+
+/* Demultiplex n files on nThreads threads, writing in OutputFormat     *
+ * ("intel" or "sparc"); MemBudget 0 for no limit. EW_FAILURE if any    *
+ * file failed.                                                          */
+int SudsDemuxFiles (char **paths, int n, const char *OutDir,
+                    const char *OutputFormat, int nThreads, size_t MemBudget,
+                    int debug);
+
+#endif
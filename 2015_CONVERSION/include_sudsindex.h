@@ -0,0 +1,89 @@
+/*
+ *   sudsindex.h
+ *
+ *   Channel index for SUDS event files.
+ *
+ *   With indexing turned on (SUDSWR_set_index), the putaway routines
+ *   note where each channel's STATIONCOMP, DESCRIPTRACE and samples went
+ *   and, at the end of the event, append one more tagged record:
+ *
+ *      SUDS tag (id_struct SUDS_CHANINDEX_ID)
+ *      SUDS_INDEXHEAD
+ *      num_chans SUDS_CHANINDEX entries      } the tag's len_data
+ *      SUDS_INDEXTRAILER                     }
+ *
+ *   Readers that don't know the record skip it like any other unknown
+ *   struct. Readers that do look at the trailer in the last bytes of
+ *   the file, which gives the distance back to the tag, and go straight
+ *   to the channel they want. Everything is in the byte order of the
+ *   rest of the file; the trailer's machine byte says which that is.
+ *   The head, each entry and the trailer take SUDS_INDEXHEAD_LEN,
+ *   SUDS_CHANINDEX_LEN and SUDS_INDEXTRAILER_LEN bytes, packed as
+ *   PC-SUDS packs its own structs (sudsswap.h), and file offsets in
+ *   them are 32 bits, like a SUDS long.
+ */
+
+#ifndef SUDSINDEX_H
+#define SUDSINDEX_H
+
+#include <stdint.h>
+#include <sudshead.h>
+#include <sudsio.h>
+#include <sudsreader.h>
+
+#define SUDS_CHANINDEX_ID   100        /* not used by PC-SUDS itself */
+#define SUDS_INDEX_MAGIC    "SIDX"
+
+#define SUDS_INDEXHEAD_LEN     8       /* bytes in the file */
+#define SUDS_CHANINDEX_LEN     40
+#define SUDS_INDEXTRAILER_LEN  12
+
+typedef struct
+{
+  char    magic[4];             /* SUDS_INDEX_MAGIC */
+  int32_t num_chans;
+} SUDS_INDEXHEAD;
+
+typedef struct
+{
+  SUDS_STATIDENT ci_name;       /* station, network, component */
+  int32_t sc_offset;            /* file offset of the STATIONCOMP tag */
+  int32_t dt_offset;            /* file offset of the DESCRIPTRACE tag */
+  int32_t data_offset;          /* file offset of the first sample */
+  double  begintime;
+  float   rate;
+  int32_t length;               /* number of samples */
+} SUDS_CHANINDEX;
+
+typedef struct
+{
+  int32_t back;                 /* bytes from the index tag to end of file */
+  char    machine;              /* byte order of back, as in SUDS_STRUCTTAG */
+  char    pad[3];
+  char    magic[4];             /* SUDS_INDEX_MAGIC */
+} SUDS_INDEXTRAILER;
+
+/* Entries gathered while an event is written */
+typedef struct
+{
+  SUDS_CHANINDEX *ent;
+  long    n;
+  long    max;
+} SUDS_INDEX;
+
+/* Writing: add an entry (native byte order), append the record to out */
+int SudsIndexAdd (SUDS_INDEX *ix, const SUDS_CHANINDEX *ent);
+int SudsIndexWrite (SUDS_INDEX *ix, SUDS_OUT *out, char machine);
+void SudsIndexReset (SUDS_INDEX *ix);
+void SudsIndexFree (SUDS_INDEX *ix);
+
+/* Reading: copy the file's index into a malloced array in native order; *
+ * SUDS_EOF if the file has none                                         */
+int SudsIndexLoad (SUDS_FILE *sf, SUDS_CHANINDEX **ent, long *n);
+
+/* Find one channel through the index and read it as SudsNextTrace would; *
+ * net may be NULL or "" to match any network, component 0 any component  */
+int SudsIndexFind (SUDS_FILE *sf, const char *sta, const char *net,
+                   char component, SUDS_TRACE *tr);
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ *   sudsio.h
+ *
+ *   Output file layer for the SUDS putaway routines.
+ *
+ *   SUDS_IO_STDIO writes through a buffered FILE*, as sudsputaway.c
+ *   always has. SUDS_IO_WRITEV writes each piece handed to SudsOutWritev
+ *   with a single pwritev, with no stdio copy in between.
+ *   SUDS_IO_DIRECT opens the file O_DIRECT and gathers output in an
+ *   aligned staging buffer, written a whole number of blocks at a time,
+ *   so bulk conversions don't fill the page cache with files nobody
+ *   will read back soon. If the file system refuses O_DIRECT,
+ *   SUDS_IO_DIRECT quietly becomes SUDS_IO_WRITEV.
+ *
+ *   Everything is appended at the end of the file, except that
+ *   SudsOutPatch may rewrite bytes already written and SudsOutTruncate
+ *   may cut the file back.
+ */
+
+#ifndef SUDSIO_H
+#define SUDSIO_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sudsasync.h>
+
+#define SUDS_IO_STDIO    0
+#define SUDS_IO_WRITEV   1
+#define SUDS_IO_DIRECT   2
+#define SUDS_IO_ASYNC    3
+
+#define SUDS_IO_ALIGN    4096            /* O_DIRECT block and buffer alignment */
+#define SUDS_IO_STAGE    (1024 * 1024)   /* O_DIRECT staging buffer size */
+
+typedef struct _SUDS_OUT
+{
+  int     Open;          /* is a file open? */
+  int     Mode;          /* SUDS_IO_XXX actually in use */
+  FILE   *fp;            /* SUDS_IO_STDIO */
+  int     fd;            /* SUDS_IO_WRITEV and SUDS_IO_DIRECT */
+  off_t   Offset;        /* end of file, for SUDS_IO_WRITEV and SUDS_IO_ASYNC */
+  char   *Stage;         /* SUDS_IO_DIRECT staging buffer */
+  long    StageUsed;     /* bytes in Stage */
+  off_t   StageOff;      /* file offset of Stage[0]; always block aligned */
+  char   *Scratch;       /* one aligned block for patching flushed data */
+  SUDS_AFILE *af;        /* SUDS_IO_ASYNC file */
+  SUDS_ASYNC_DONE Done;  /* SUDS_IO_ASYNC completion callback and its arg */
+  void   *DoneArg;
+} SUDS_OUT;
+
+/* Open path for writing with the given SUDS_IO_XXX mode */
+int SudsOutOpen (SUDS_OUT *out, const char *path, int Mode);
+
+/* Open path for SUDS_IO_ASYNC writing through the service as; done (may *
+ * be NULL) is called with arg once the file is closed                    */
+int SudsOutOpenAsync (SUDS_OUT *out, const char *path, SUDS_ASYNC *as,
+                      SUDS_ASYNC_DONE done, void *arg);
+
+/* Append the n pieces in iov */
+int SudsOutWritev (SUDS_OUT *out, const struct iovec *iov, int n);
+
+/* Append len bytes */
+int SudsOutWrite (SUDS_OUT *out, const void *buf, size_t len);
+
+/* Overwrite len bytes at off, which must already have been written */
+int SudsOutPatch (SUDS_OUT *out, const void *buf, size_t len, off_t off);
+
+/* Cut the file back to off bytes; later writes continue from there */
+int SudsOutTruncate (SUDS_OUT *out, off_t off);
+
+/* Current length of the file, i.e. where the next write will go */
+off_t SudsOutTell (SUDS_OUT *out);
+
+/* Is a file open? */
+int SudsOutIsOpen (SUDS_OUT *out);
+
+/* Flush anything staged and close the file */
+int SudsOutClose (SUDS_OUT *out);
+
+#endif
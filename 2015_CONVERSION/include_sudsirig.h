@@ -0,0 +1,95 @@
+/*
+ *   sudsirig.h
+ *
+ *   IRIG time code decoding for the PC-SUDS putaway routines, so that
+ *   clock correction is done as events are written rather than by
+ *   running IRIG.EXE over every file afterwards.
+ *
+ *   Hand a SUDS_IRIG to SUDSWR_set_irig and the samples of the channel
+ *   it names (the digitized time code) are decoded as SUDSWR_next
+ *   converts them. Each frame gives the day of year, hour, minute and
+ *   second at the leading edge of its reference marker; set against the
+ *   time the digitizer put on that edge, that is one measurement of the
+ *   clock's offset. At the end of the event the offsets are fitted with
+ *   a straight line (offset and drift), and SUDSWR_end_ev
+ *
+ *      - fills in time_correct and rate_correct in the DESCRIPTRACE of
+ *        every channel of the event, where
+ *
+ *            time_correct = offset + drift * (begintime - tref)
+ *            rate_correct = rate / (1 + drift) - rate
+ *
+ *        so begintime + time_correct is the true start of the trace and
+ *        rate + rate_correct the true sample rate, and
+ *      - appends a SUDS_TIMECORRECTION for the time code channel with
+ *        effective_time the (whole) second of the first frame,
+ *        time_correct the offset then, rate_correct the drift (seconds
+ *        per second), program 'i', and sync_code 'G' if the drift was
+ *        fitted or 'O' if only an offset could be had (one frame, or
+ *        frames too close together).
+ *
+ *   Nothing is changed if no frame could be decoded.
+ *
+ *   The code may be IRIG-B (a 100-bit frame every second, 10 ms bits)
+ *   or IRIG-E (the same frame every 10 seconds, 100 ms bits); the bits
+ *   are told apart by pulse width (0.2, 0.5 or 0.8 of a bit for 0, 1
+ *   and a position marker), so the channel needs at least
+ *   SUDS_IRIG_MINSPB samples a bit: IRIG-B wants 500 sps or more, while
+ *   IRIG-E can be read at 50. The code must be DC level shift (an
+ *   amplitude modulated code has to be demodulated before it is
+ *   digitized); the high and low levels are tracked as the signal
+ *   goes, so gain and offset don't matter. Frames with markers out of
+ *   place or fields out of range are dropped, and so are offsets more
+ *   than SUDS_IRIG_OUTLIER seconds from the median; the year is taken
+ *   to be the one that puts the frame nearest the digitizer's time.
+ */
+
+#ifndef SUDSIRIG_H
+#define SUDSIRIG_H
+
+#include <trace_buf.h>
+
+#define SUDS_IRIG_B        0           /* codes */
+#define SUDS_IRIG_E        1
+#define SUDS_IRIG_MINSPB   5           /* least samples per bit */
+#define SUDS_IRIG_OUTLIER  0.1         /* seconds from the median offset */
+
+typedef struct _SUDS_IRIG SUDS_IRIG;
+
+/* The fitted clock correction: true time = t + offset + drift * (t - tref) */
+typedef struct
+{
+  double  tref;                        /* digitizer time of the first frame */
+  double  offset;                      /* seconds, at tref */
+  double  drift;                       /* seconds per second */
+  double  rms;                         /* of the fit, seconds */
+  int     fitted;                      /* drift was fitted, not taken as 0 */
+  int     nframes;                     /* frames fitted */
+  int     nbad;                        /* frames dropped */
+} SUDS_IRIGFIT;
+
+/* A decoder for the time code on sta (chan: NULL or "" for any), in *
+ * code SUDS_IRIG_B or SUDS_IRIG_E; one per writer                   */
+SUDS_IRIG *SudsIrigCreate (const char *sta, const char *chan, int code);
+
+/* Whether a channel is the time code */
+int SudsIrigMatch (SUDS_IRIG *ir, const char *sta, const char *chan);
+
+/* Forget the frames of the last event */
+void SudsIrigReset (SUDS_IRIG *ir);
+
+/* Decode one packet (header and samples in native byte order; datatype *
+ * 's', 'l' or 'f' as in sudsputaway.c)                                  */
+int SudsIrigFeed (SUDS_IRIG *ir, const TRACE_HEADER *wf, const void *samples,
+                  char datatype);
+
+/* Fit the frames decoded since the last reset; EW_FAILURE if there are *
+ * none                                                                 */
+int SudsIrigFit (SUDS_IRIG *ir, SUDS_IRIGFIT *fit);
+
+/* Correction to add to digitizer time t */
+double SudsIrigCorrection (const SUDS_IRIGFIT *fit, double t);
+
+void SudsIrigDestroy (SUDS_IRIG *ir);
+
+#endif
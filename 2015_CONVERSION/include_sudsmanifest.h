@@ -0,0 +1,61 @@
+/*
+ *   sudsmanifest.h
+ *
+ *   Manifest of the SUDS event files written under an output tree, so
+ *   they can be counted and found by reading one file instead of
+ *   walking the tree and stat()ing every .dmx in it.
+ *
+ *   Hand a SUDS_MANIFEST to SUDSWR_set_manifest and SUDSWR_end_ev adds
+ *   a line for each file it closes:
+ *
+ *      evid begintime endtime nchans bytes path
+ *
+ *   evid is the event id given to SUDSWR_next_ev ("-" for a file named
+ *   by the caller), begintime and endtime the earliest start and latest
+ *   end of its traces (epoch seconds, before any IRIG time correction),
+ *   nchans the channels in it and bytes its length. path is last, so it
+ *   may hold spaces; a file under the manifest's own directory is given
+ *   relative to it, so the tree and its manifest can be moved together.
+ *
+ *   Lines are only ever appended, each with a single write() to a file
+ *   opened O_APPEND, so any number of writers, threads or processes may
+ *   share one manifest without their lines mixing. With Sync set each
+ *   line is also fdatasync()ed before SUDSWR_end_ev returns. A last line
+ *   cut short by a crash has no newline and is ignored when read back.
+ *   With write-behind output (SUDSWR_set_async) a file is recorded as
+ *   soon as its close is queued, before it is known to be written.
+ */
+
+#ifndef SUDSMANIFEST_H
+#define SUDSMANIFEST_H
+
+#define SUDS_MANIFEST_MAXPATH  600     /* as SUDS_WRITER's FileName */
+#define SUDS_MANIFEST_MAXID    32
+
+typedef struct _SUDS_MANIFEST SUDS_MANIFEST;
+
+typedef struct
+{
+  char    evid[SUDS_MANIFEST_MAXID];
+  double  begintime;
+  double  endtime;
+  long    nchans;
+  long    bytes;
+  char    path[SUDS_MANIFEST_MAXPATH];
+} SUDS_MANIFEST_ENT;
+
+/* Open path for appending, creating it if need be; NULL on failure */
+SUDS_MANIFEST *SudsManifestOpen (const char *path, int Sync);
+
+/* Append one file's line */
+int SudsManifestAdd (SUDS_MANIFEST *mf, const SUDS_MANIFEST_ENT *ent);
+
+/* Close the manifest; mf may be NULL */
+int SudsManifestClose (SUDS_MANIFEST *mf);
+
+/* Read every line of the manifest at path into a malloced array, in *
+ * the order written; no manifest is an empty one. Paths are as kept, *
+ * relative ones relative to the manifest's directory.                */
+int SudsManifestLoad (const char *path, SUDS_MANIFEST_ENT **ent, long *n);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ *   sudsmetrics.h
+ *
+ *   Counters and phase timers for the PC-SUDS putaway routines, so what
+ *   they did and where the time went can be seen without debug logging.
+ *
+ *   Hand a SUDS_METRICS to SUDSWR_set_metrics and, for every channel it
+ *   writes, the writer counts packets, samples, traces (and how many
+ *   went straight from the packets, see sudswriter.h), gaps (and the
+ *   largest), overlaps, clipped samples, truncated traces, unknown
+ *   components, failures and bytes written, and times the phases of
+ *   the work:
+ *
+ *      decode    putting packets in local byte order and checking them
+ *      detect    feeding the RSAM, trigger and IRIG engines
+ *      convert   byte swapping, clipping and statistics (one pass)
+ *      gapfill   filling gaps
+ *      header    building the SUDS structs
+ *      write     writing to the file
+ *
+ *   The counts and times are kept in a SUDS_CHANMETRICS belonging to
+ *   whichever thread is encoding the channel, and only added into the
+ *   SUDS_METRICS (under its lock) once the channel is written, so the
+ *   cost while encoding is a few clock reads per packet. The clock is
+ *   the CPU's time stamp counter where there is one (x86), scaled to
+ *   seconds against the system clock when the numbers are written.
+ *
+ *   The totals, overall and per station/channel/network, can be written
+ *   as a Prometheus text file (for node_exporter's textfile collector)
+ *   or as JSON, on demand with SudsMetricsWrite or by the writer at the
+ *   end of an event every ExportSec seconds. Files are written under a
+ *   temporary name and renamed, so a reader never sees half of one. The
+ *   engine belongs to the caller and may be shared by several writers.
+ */
+
+#ifndef SUDSMETRICS_H
+#define SUDSMETRICS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <trace_buf.h>
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#include <x86intrin.h>
+#define SUDS_METRICS_TSC
+#endif
+
+#define SUDS_PH_DECODE    0            /* phases */
+#define SUDS_PH_DETECT    1
+#define SUDS_PH_CONVERT   2
+#define SUDS_PH_GAPFILL   3
+#define SUDS_PH_HEADER    4
+#define SUDS_PH_WRITE     5
+#define SUDS_NPHASE       6
+
+#define SUDS_METRICS_PROM 0            /* SudsMetricsWrite formats */
+#define SUDS_METRICS_JSON 1
+
+typedef struct _SUDS_METRICS SUDS_METRICS;
+
+/* One channel's share, kept by the thread encoding it */
+typedef struct
+{
+  char      sta[TRACE_STA_LEN];
+  char      chan[TRACE_CHAN_LEN];
+  char      net[TRACE_NET_LEN];
+  int       on;                        /* counting at all */
+  uint64_t  last;                      /* clock at the last lap */
+  uint64_t  ticks[SUDS_NPHASE];
+  long      traces, packets, samples;
+  long      direct;                    /* traces written without a copy */
+  long      gaps, overlaps, clipped, truncated, badcomp, errors;
+  double    gap_max;                   /* seconds */
+  double    bytes;                     /* written to the file */
+} SUDS_CHANMETRICS;
+
+/* A new set of totals; PromFile and JsonFile (either may be NULL) are *
+ * written every ExportSec seconds by SudsMetricsEvent (0 for only by  *
+ * SudsMetricsDestroy)                                                  */
+SUDS_METRICS *SudsMetricsCreate (const char *PromFile, const char *JsonFile,
+                                 int ExportSec);
+
+/* Start counting a channel into cm; m may be NULL, for nothing */
+void SudsMetricsStart (SUDS_METRICS *m, SUDS_CHANMETRICS *cm,
+                       const char *sta, const char *chan, const char *net);
+
+/* Add cm into the totals and clear its counts */
+int SudsMetricsFlush (SUDS_METRICS *m, SUDS_CHANMETRICS *cm);
+
+/* Count an event, and write the files if they are due */
+int SudsMetricsEvent (SUDS_METRICS *m);
+
+/* Write the totals to path in format (SUDS_METRICS_XXX) */
+int SudsMetricsWrite (SUDS_METRICS *m, int format, const char *path);
+
+/* Write the files one last time and free the totals */
+int SudsMetricsDestroy (SUDS_METRICS *m);
+
+/* A cheap clock, in ticks of no fixed length */
+static inline uint64_t SudsMetricsClock (void)
+{
+#ifdef SUDS_METRICS_TSC
+  return __rdtsc ();
+#else
+  struct timespec  ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+/* Charge the time since the last lap to phase */
+static inline void SudsMetricsLap (SUDS_CHANMETRICS *cm, int phase)
+{
+  uint64_t  now;
+
+  if (cm->on)
+  {
+    now = SudsMetricsClock ();
+    cm->ticks[phase] += now - cm->last;
+    cm->last = now;
+  }
+}
+
+#endif
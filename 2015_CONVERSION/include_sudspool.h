@@ -0,0 +1,34 @@
+/*
+ *   sudspool.h
+ *
+ *   A small persistent thread pool for running a batch of independent
+ *   tasks, used by the SUDS putaway and conversion routines.
+ *
+ *   SudsPoolRun hands out task numbers 0..nTasks-1 to whichever worker
+ *   is free next (the calling thread works too) and returns once every
+ *   task has finished, so a slow task never holds up tasks queued
+ *   behind it on another worker. Tasks are claimed in increasing order.
+ */
+
+#ifndef SUDSPOOL_H
+#define SUDSPOOL_H
+
+typedef struct _SUDS_POOL SUDS_POOL;
+
+/* Task function: arg as passed to SudsPoolRun, the task number, and the *
+ * number (0..nThreads-1) of the worker running it                       */
+typedef void (*SUDS_POOL_TASK) (void *arg, int task, int worker);
+
+/* Start a pool of nThreads workers, counting the calling thread */
+SUDS_POOL *SudsPoolCreate (int nThreads);
+
+/* Number of workers, counting the calling thread */
+int SudsPoolThreads (SUDS_POOL *pool);
+
+/* Run tasks 0..nTasks-1 and wait for all of them */
+int SudsPoolRun (SUDS_POOL *pool, int nTasks, SUDS_POOL_TASK fn, void *arg);
+
+/* Stop the workers and free the pool */
+void SudsPoolDestroy (SUDS_POOL *pool);
+
+#endif
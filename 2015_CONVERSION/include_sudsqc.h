@@ -0,0 +1,133 @@
+/*
+ *   sudsqc.h
+ *
+ *   In-line trace quality control for the PC-SUDS putaway routines, in
+ *   place of running LIB/trace_quality_control.py over the files after
+ *   the fact.
+ *
+ *   Hand a SUDS_QC to SUDSWR_set_qc and every trace SUDSWR_next writes
+ *   is checked as its packets are converted, in the same pass:
+ *
+ *      runs        the longest run of zeros, of -1s, and of any one
+ *                  value (a stuck digitizer), found a vector of
+ *                  samples at a time
+ *      envelope    the peak of each whole second of samples, taken as
+ *                  half its peak-to-peak so the DC offset needn't be
+ *                  taken out first, and kept in a log-scale histogram
+ *                  (exact below 32, within about 1.5% above), from
+ *                  which the 95th and 5th percentiles are read
+ *      snr         the 95th percentile over the 5th, once the trace has
+ *                  more than MinSeconds seconds and the 95th is at
+ *                  least 1; -1 otherwise
+ *
+ *   and, as the script had it, the trace is bad (quality 0) if it has
+ *   no sample but 0, ZeroRun or more zeros in a row or Neg1Run or more
+ *   -1s in a row (12 and 8 by default), and, if StuckRun is set, that
+ *   many of any one value in a row; a good trace whose snr is no more
+ *   than SnrMin, or that has none, has quality 0.5, and otherwise 1.
+ *   Gap fill isn't data, so a gap ends a run rather than adding to one,
+ *   and a trace is only checked as far as it is written.
+ *
+ *   Each trace gets a SUDS_CHANQC after its samples (after the stats
+ *   and triggers records, if any):
+ *
+ *      SUDS tag (id_struct SUDS_CHANQC_ID, len_data 0)
+ *      SUDS_CHANQC
+ *
+ *   its quality and snr go in the catalog (sudscatalog.h), and
+ *   SUDSWR_end_ev puts a COMMENT at the end of the file summing up the
+ *   event's traces: how many, how many bad and why, and their mean
+ *   quality. Readers that don't know the record skip it like any other
+ *   unknown struct; SudsRecStruct (sudsreader.h) decodes it into the
+ *   struct. The record takes SUDS_CHANQC_LEN bytes in the file.
+ *
+ *   The engine only holds the settings, so it may be shared by any
+ *   number of writers once set up; each trace's state is the writer's.
+ */
+
+#ifndef SUDSQC_H
+#define SUDSQC_H
+
+#include <stdint.h>
+#include <trace_buf.h>
+#include <sudshead.h>
+
+#define SUDS_CHANQC_ID      102        /* not used by PC-SUDS itself */
+#define SUDS_CHANQC_LEN     52         /* bytes in the file */
+
+#define SUDS_QC_BLANK       0x01       /* SUDS_CHANQC flags: no sample but 0 */
+#define SUDS_QC_ZEROS       0x02       /* ... a run of ZeroRun zeros */
+#define SUDS_QC_NEG1        0x04       /* ... a run of Neg1Run -1s */
+#define SUDS_QC_STUCK       0x08       /* ... a run of StuckRun of one value */
+#define SUDS_QC_LOWSNR      0x10       /* snr no more than SnrMin */
+#define SUDS_QC_SHORT       0x20       /* too short or quiet for an snr */
+#define SUDS_QC_BAD         (SUDS_QC_BLANK | SUDS_QC_ZEROS | SUDS_QC_NEG1 \
+                             | SUDS_QC_STUCK)
+
+#define SUDS_QC_BINS        896        /* envelope histogram */
+
+typedef struct _SUDS_QC SUDS_QC;
+
+/* One trace being checked */
+typedef struct
+{
+  const SUDS_QC *qc;
+  long      persec;                    /* samples a second */
+  double    gap;                       /* seconds between packets that is a gap */
+  double    lastend;                   /* end of the last packet */
+  int64_t   nsamp;
+  int64_t   nonzero;
+  int32_t   cur;                       /* the run going on */
+  int64_t   curlen;
+  int64_t   zero_run, neg1_run, stuck_run;
+  long      secn;                      /* samples of the second going on */
+  int32_t   secmin, secmax;
+  int32_t   nsec;                      /* whole seconds in the histogram */
+  uint32_t  hist[SUDS_QC_BINS];
+} SUDS_QCTRACE;
+
+/* The QC record */
+typedef struct
+{
+  SUDS_STATIDENT qc_name;       /* station, network, component */
+  float   quality;              /* 1, 0.5 or 0 */
+  float   snr;                  /* -1 if not measured */
+  float   signal;               /* 95th percentile of the second peaks */
+  float   noise;                /* 5th percentile */
+  int32_t nseconds;             /* whole seconds in the envelope */
+  int32_t zero_run;             /* longest run of zeros */
+  int32_t neg1_run;             /* ... of -1s */
+  int32_t stuck_run;            /* ... of any one value */
+  int32_t numclip;              /* clipped samples, as in the DESCRIPTRACE */
+  int32_t flags;                /* SUDS_QC_XXX */
+} SUDS_CHANQC;
+
+/* A new engine: ZeroRun 12, Neg1Run 8, StuckRun 0 (off), MinSeconds 10, *
+ * SnrMin 1; picks the run kernels for this machine                      */
+SUDS_QC *SudsQcCreate (void);
+
+/* Runs that make a trace bad; 0 turns one off */
+int SudsQcSetRuns (SUDS_QC *qc, long ZeroRun, long Neg1Run, long StuckRun);
+
+/* snr only for traces of more than MinSeconds; quality halved at or *
+ * below SnrMin                                                      */
+int SudsQcSetSnr (SUDS_QC *qc, int MinSeconds, double SnrMin);
+
+/* Which run kernels are in use: "scalar" or "avx2" */
+const char *SudsQcName (void);
+
+void SudsQcDestroy (SUDS_QC *qc);
+
+/* Start a trace at rate samples a second; packets more than GapThresh *
+ * samples apart are a gap                                             */
+void SudsQcStart (const SUDS_QC *qc, SUDS_QCTRACE *qt, double rate,
+                  double GapThresh);
+
+/* Check one packet: wf (native order) and its samples, 's', 'l' or 'f' */
+void SudsQcFeed (SUDS_QCTRACE *qt, const TRACE_HEADER *wf,
+                 const void *samples, char datatype);
+
+/* Fill in a QC record (but for qc_name) for the finished trace */
+void SudsQcRecord (SUDS_QCTRACE *qt, int32_t numclip, SUDS_CHANQC *cq);
+
+#endif
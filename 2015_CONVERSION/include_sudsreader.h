@@ -0,0 +1,96 @@
+/*
+ *   sudsreader.h
+ *
+ *   Reader for PC-SUDS files (.dmx, .sud) of the kind sudsputaway.c
+ *   writes.
+ *
+ *   SudsFileOpen maps the whole file read-only; nothing is read or
+ *   converted until asked for. SudsNextRec walks the file one
+ *   SUDS_STRUCTTAG at a time, handing back pointers into the mapping.
+ *   SudsRecStruct decodes one struct into native byte order and
+ *   layout, so only the headers actually looked at are converted. Sample payloads
+ *   are never copied: a SUDS_SPAN points at them in the file and its
+ *   samples are put into native order as they are fetched.
+ *
+ *   Structs are read with the layout PC-SUDS gives them in the file
+ *   (sudsswap.h), whatever the layout sudshead.h gives them in memory;
+ *   a record whose len_struct doesn't match that is skipped by
+ *   SudsNextTrace and refused by SudsRecStruct.
+ */
+
+#ifndef SUDSREADER_H
+#define SUDSREADER_H
+
+#include <stddef.h>
+#include <sudshead.h>
+
+#define SUDS_EOF   1             /* SudsNextRec/SudsNextTrace: no more records */
+
+typedef struct _SUDS_FILE
+{
+  const char *Base;              /* the file's bytes */
+  size_t      Size;              /* and how many */
+  int         Mapped;            /* Base is mmapped (else malloced) */
+} SUDS_FILE;
+
+/* One tagged record, pointing into the file */
+typedef struct _SUDS_REC
+{
+  short       id;                /* id_struct: STATIONCOMP, DESCRIPTRACE, ... */
+  char        machine;           /* '6' for Intel byte order */
+  int         swap;              /* record's byte order isn't ours */
+  long        len_struct;        /* bytes in Struct */
+  long        len_data;          /* bytes in Data */
+  const char *Struct;            /* the struct, in file byte order */
+  const char *Data;              /* anything following it, e.g. samples */
+  size_t      Offset;            /* file offset of the tag */
+} SUDS_REC;
+
+/* Samples in the file, still in file byte order */
+typedef struct _SUDS_SPAN
+{
+  const char *Base;
+  long        n;                 /* number of samples */
+  int         Size;              /* bytes per sample: 2, 4 or sizeof(long) */
+  int         swap;
+} SUDS_SPAN;
+
+/* One channel: the STATIONCOMP (if there was one) and DESCRIPTRACE, *
+ * both in native byte order, and its samples                        */
+typedef struct _SUDS_TRACE
+{
+  int               have_sc;
+  SUDS_STATIONCOMP  sc;
+  SUDS_DESCRIPTRACE dt;
+  SUDS_SPAN         samples;
+  size_t            Offset;      /* file offset of the DESCRIPTRACE tag */
+} SUDS_TRACE;
+
+/* Map path for reading */
+int SudsFileOpen (SUDS_FILE *sf, const char *path);
+
+/* Unmap it */
+void SudsFileClose (SUDS_FILE *sf);
+
+/* Read the record at *pos and advance *pos past it; start with *pos = 0. *
+ * EW_SUCCESS, SUDS_EOF at the end, EW_FAILURE if the file is damaged    */
+int SudsNextRec (SUDS_FILE *sf, size_t *pos, SUDS_REC *rec);
+
+/* Decode the record's struct, which must be of type struct_type, into *
+ * out in native byte order                                            */
+int SudsRecStruct (const SUDS_REC *rec, void *out, int struct_type);
+
+/* Advance *pos past the next DESCRIPTRACE and its samples */
+int SudsNextTrace (SUDS_FILE *sf, size_t *pos, SUDS_TRACE *tr);
+
+/* Sample i of a span, in native order */
+long SudsSample (const SUDS_SPAN *sp, long i);
+
+/* Copy up to n samples from first on into out; returns how many */
+long SudsSamples (const SUDS_SPAN *sp, long first, long n, long *out);
+
+/* The effective time of the file: from the first TIMECORRECTION, or  *
+ * failing that the first STATIONCOMP. Only that one struct is read.  */
+int SudsEffectiveTime (SUDS_FILE *sf, long *effective);
+
+#endif
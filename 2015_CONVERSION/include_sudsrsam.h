@@ -0,0 +1,123 @@
+/*
+ *   sudsrsam.h
+ *
+ *   Incremental RSAM (Real-time Seismic Amplitude Measurement) for the
+ *   TRACE_BUF stream going through the PC-SUDS putaway routines.
+ *
+ *   Hand a SUDS_RSAM to SUDSWR_set_rsam and every packet SUDSWR_next
+ *   converts is also fed to it. For each configured station it keeps
+ *   the mean absolute amplitude (after taking out a slowly tracked DC
+ *   offset) over each second, and from those the 1-minute and 10-minute
+ *   averages; the work per sample is constant, and per second is one
+ *   ring update. Packets that overlap data already seen (snippets of
+ *   overlapping events) are only counted once.
+ *
+ *   Two alarm rules, "event" and "tremor", each look at one of the
+ *   averages every so many seconds and fire when at least min_stations
+ *   stations are at or over their own thresholds; a station with a
+ *   threshold of 0 is listed but doesn't vote. Each alarm is one line,
+ *   in the column layout of the RSAM alarm files the observatory kept:
+ *
+ *      event   DATEMLYT.THRESH<tab>MLYT.DATA<tab>...<tab>      (tab separated)
+ *      tremor  DATE,MLYT.THRESH,MLYT.DATA,...                  (comma separated)
+ *
+ *   with DATE like "03-Feb-1999 09:52:38" (UTC) and the stations in the
+ *   order they were added. Only the event header ends in a tab, and it
+ *   has none after DATE, just as in DATA/rsam_event_alarms.csv.
+ *
+ *   A second is only judged once every station has got past it, or, if
+ *   a station has stopped sending, once the others are MaxLag seconds
+ *   further on; data arriving for a second after that is still archived
+ *   but can no longer raise an alarm for it.
+ *
+ *   The archive holds one SUDS_RSAMREC per station per minute with data,
+ *   after a SUDS_RSAMHEAD and nchan SUDS_RSAMCHAN naming the stations,
+ *   all in the byte order given by the header's machine byte ('6' for
+ *   Intel, as in SUDS_STRUCTTAG). An existing archive is appended to
+ *   only if it names the same stations in the same order.
+ */
+
+#ifndef SUDSRSAM_H
+#define SUDSRSAM_H
+
+#include <trace_buf.h>
+
+#define RSAM_1S        0               /* averaging windows */
+#define RSAM_1MIN      1
+#define RSAM_10MIN     2
+#define RSAM_NWIN      3
+
+#define RSAM_EVENT     0               /* alarm rules */
+#define RSAM_TREMOR    1
+#define RSAM_NRULE     2
+
+#define RSAM_MAXLAG    300             /* most MaxLag may be, in seconds */
+#define RSAM_MAGIC     "RSAM"
+
+typedef struct _SUDS_RSAM SUDS_RSAM;
+
+/* Archive layout */
+typedef struct
+{
+  char    magic[4];                    /* RSAM_MAGIC */
+  char    machine;                     /* byte order, as in SUDS_STRUCTTAG */
+  char    version;                     /* 1 */
+  short   nchan;
+} SUDS_RSAMHEAD;
+
+typedef struct
+{
+  char    sta[8];
+  char    chan[12];                    /* empty if any channel of sta */
+  char    net[12];                     /* empty if any network */
+} SUDS_RSAMCHAN;
+
+typedef struct
+{
+  int     time;                        /* start of the minute, epoch seconds */
+  float   rsam;                        /* mean absolute amplitude, counts */
+  short   chan;                        /* station number in the header */
+  short   nsec;                        /* seconds of the minute with data */
+} SUDS_RSAMREC;
+
+/* A new engine with no stations; the event rule looks at the 1-minute *
+ * average every second and the tremor rule at the 10-minute average   *
+ * every 10 minutes, both needing two stations                         */
+SUDS_RSAM *SudsRsamCreate (void);
+
+/* Track sta (chan, net: NULL or "" for any), with its event and tremor *
+ * thresholds in counts. All stations must be added before the first    *
+ * packet.                                                               */
+int SudsRsamAddStation (SUDS_RSAM *rs, const char *sta, const char *chan,
+                        const char *net, double EventThresh,
+                        double TremorThresh);
+
+/* Change an alarm rule: which average it looks at, how often (seconds, *
+ * a divisor of 600 so it runs on the minute), how many stations must   *
+ * be over threshold, and how long to wait after an alarm               */
+int SudsRsamSetRule (SUDS_RSAM *rs, int rule, int window, int every,
+                     int MinStations, int Holdoff);
+
+/* How far (seconds) the other stations may get ahead of a silent one */
+int SudsRsamSetMaxLag (SUDS_RSAM *rs, int MaxLag);
+
+/* Start writing alarms and the archive; any path may be NULL */
+int SudsRsamOpen (SUDS_RSAM *rs, const char *EventFile,
+                  const char *TremorFile, const char *ArchiveFile);
+
+/* Station number of a channel, or -1 if it isn't tracked */
+int SudsRsamFind (SUDS_RSAM *rs, const char *sta, const char *chan,
+                  const char *net);
+
+/* Feed one packet (header and samples in native byte order; datatype 's', *
+ * 'l' or 'f' as in sudsputaway.c) for station number ch                    */
+int SudsRsamFeed (SUDS_RSAM *rs, int ch, const TRACE_HEADER *wf,
+                  const void *samples, char datatype);
+
+/* Current average of station ch over window, or -1 if there's no data */
+double SudsRsamValue (SUDS_RSAM *rs, int ch, int window);
+
+/* Judge what is left, close the files and free the engine */
+int SudsRsamDestroy (SUDS_RSAM *rs);
+
+#endif
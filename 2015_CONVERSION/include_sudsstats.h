@@ -0,0 +1,84 @@
+/*
+ *   sudsstats.h
+ *
+ *   Trace statistics for the PC-SUDS putaway routines.
+ *
+ *   The conversion kernels (sudsconvert.h) fold every sample they copy
+ *   into a SUDS_STATS as they go, so a trace is measured in the same
+ *   pass that converts it: min, max, sum, sum of squares, and how many
+ *   samples sat at or beyond the clip values. Gap fill isn't data and
+ *   is left out of all of those, except for avenoise, which is the mean
+ *   of the first SUDS_HEAD_SAMPLES samples of the trace as written.
+ *
+ *   The results go into the DESCRIPTRACE (mindata, maxdata, avenoise,
+ *   numclip) and, with SUDSWR_set_stats turned on, into a stats record
+ *   written after each trace's samples:
+ *
+ *      SUDS tag (id_struct SUDS_CHANSTATS_ID, len_data 0)
+ *      SUDS_CHANSTATS
+ *
+ *   Readers that don't know the record skip it like any other unknown
+ *   struct; SudsRecStruct (sudsreader.h) decodes it into the struct.
+ *
+ *   Samples are at most 32 bits, so min and max are too; counts and sums
+ *   are 64-bit so that no trace, however long, can overflow them, on any
+ *   width of long. The record has 32-bit fields and takes
+ *   SUDS_CHANSTATS_LEN bytes in the file, packed as PC-SUDS packs its
+ *   own structs (sudsswap.h); the padding in the struct is only there
+ *   in memory.
+ */
+
+#ifndef SUDSSTATS_H
+#define SUDSSTATS_H
+
+#include <stdint.h>
+#include <sudshead.h>
+
+#define SUDS_CHANSTATS_ID   101        /* not used by PC-SUDS itself */
+#define SUDS_CHANSTATS_LEN  64         /* bytes in the file */
+#define SUDS_HEAD_SAMPLES   200        /* samples averaged for avenoise */
+
+/* Running statistics for one trace */
+typedef struct
+{
+  int64_t    n;                 /* samples measured */
+  int32_t    min, max;
+  int32_t    cliplo, cliphi;    /* a sample <= cliplo or >= cliphi is clipped */
+  int64_t    nclip;
+  int64_t    sum;
+  double     sumsq;
+  int64_t    nhead;             /* samples (fill included) toward avenoise */
+  int64_t    headsum;
+} SUDS_STATS;
+
+/* The stats record */
+typedef struct
+{
+  SUDS_STATIDENT cs_name;       /* station, network, component */
+  int32_t length;               /* samples measured; gap fill isn't counted */
+  int32_t mindata;
+  int32_t maxdata;
+  int32_t numclip;              /* samples at or beyond the clip values */
+  int32_t clip_lo;
+  int32_t clip_hi;
+  char    pad[4];
+  double  mean;                 /* the DC offset */
+  double  rms;                  /* of the samples as recorded */
+  double  rms_ac;               /* with the DC offset taken out */
+  float   avenoise;             /* as in the DESCRIPTRACE */
+  char    pad2[4];
+} SUDS_CHANSTATS;
+
+/* Start a trace; samples <= cliplo or >= cliphi count as clipped */
+void SudsStatsInit (SUDS_STATS *st, int32_t cliplo, int32_t cliphi);
+
+/* Note n samples of gap fill */
+void SudsStatsFill (SUDS_STATS *st, long n, int32_t value);
+
+/* Mean of the first SUDS_HEAD_SAMPLES samples */
+float SudsStatsAvenoise (const SUDS_STATS *st);
+
+/* Fill in a stats record (but for cs_name) from the finished statistics */
+void SudsStatsRecord (const SUDS_STATS *st, SUDS_CHANSTATS *cs);
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ *   sudsswap.h
+ *
+ *   On-disk layout and byte order of the PC-SUDS structs, shared by the
+ *   putaway routines (sudsputaway.c), the reader (sudsreader.c) and the
+ *   channel index (sudsindex.c).
+ *
+ *   A struct in the file is a fixed-width record laid out as PC-SUDS
+ *   lays it out (SUDSFORM.H): packed to 2 bytes, longs 32 bits. That is
+ *   not how a compiler lays out the struct in memory, least of all
+ *   where long is 64 bits, so structs are never written or read with
+ *   memcpy. Each one is described once, as a table giving every field's
+ *   place in the struct and in the record (sudsswap.c); the same table
+ *   encodes it for writing, in either byte order, and decodes it when
+ *   read. A new struct type needs only a new table.
+ *
+ *   The host byte order is known at compile time from the compiler
+ *   (__BYTE_ORDER__), or failing that from _INTEL / _SPARC, so neither
+ *   has to be set by hand on Linux, x86-64 or aarch64. The byte order
+ *   of the files being written is parsed from "intel" / "sparc" once,
+ *   when the writer is set up.
+ */
+
+#ifndef SUDSSWAP_H
+#define SUDSSWAP_H
+
+#include <stddef.h>
+
+typedef enum
+{
+  SUDS_ORDER_INTEL = 0,          /* little-endian; SUDS_STRUCTTAG machine '6' */
+  SUDS_ORDER_SPARC = 1           /* big-endian; machine '1' */
+} SUDS_ORDER;
+
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SUDS_HOST_ORDER  SUDS_ORDER_INTEL
+#elif defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SUDS_HOST_ORDER  SUDS_ORDER_SPARC
+#elif defined (_INTEL)
+#define SUDS_HOST_ORDER  SUDS_ORDER_INTEL
+#elif defined (_SPARC)
+#define SUDS_HOST_ORDER  SUDS_ORDER_SPARC
+#else
+#error "sudsswap.h: can't tell the byte order; compile with _INTEL or _SPARC"
+#endif
+
+/* machine byte for a SUDS_STRUCTTAG, and the byte order it stands for */
+#define SUDS_MACHINE(order)  ((order) == SUDS_ORDER_INTEL ? '6' : '1')
+#define SUDS_MACHINE_ORDER(machine) \
+                             ((machine) == '6' ? SUDS_ORDER_INTEL : SUDS_ORDER_SPARC)
+
+/* Does data in this byte order, or tagged with this machine byte, need swapping? */
+#define SUDS_ORDER_SWAP(order)      ((order) != SUDS_HOST_ORDER)
+#define SUDS_MACHINE_SWAP(machine)  SUDS_ORDER_SWAP (SUDS_MACHINE_ORDER (machine))
+
+/* The byte order that swap, from our own, gives */
+#define SUDS_SWAP_ORDER(swap)  ((swap) ? (SUDS_ORDER) (1 - SUDS_HOST_ORDER) : SUDS_HOST_ORDER)
+
+/* Bytes each struct takes in the file */
+#define SUDS_STRUCTTAG_LEN        12
+#define SUDS_STATIONCOMP_LEN      76
+#define SUDS_MUXDATA_LEN          32
+#define SUDS_DESCRIPTRACE_LEN     64
+#define SUDS_COMMENT_LEN           8
+#define SUDS_TRIGGERS_LEN         32
+#define SUDS_DETECTOR_LEN         24
+#define SUDS_TIMECORRECTION_LEN   32
+
+/* Width of a SUDS long in the file: 32 bits, whatever sizeof (long) is */
+#define SUDS_LONG_WIDTH  4
+
+/* Kinds of field */
+#define SUDS_FIELD_BYTES  0          /* chars, copied as they are */
+#define SUDS_FIELD_INT    1          /* signed integer, any width in memory */
+#define SUDS_FIELD_REAL   2          /* float or double */
+
+/* One field of a struct, and where it goes in the record; a table *
+ * lists every field and ends with width 0                         */
+typedef struct
+{
+  unsigned short offset;         /* in the struct */
+  unsigned short size;           /* in the struct */
+  unsigned short disk;           /* offset in the record */
+  unsigned char  width;          /* bytes in the record */
+  unsigned char  kind;           /* SUDS_FIELD_XXX */
+} SUDS_FIELD;
+
+#define SUDS_FIELD_OF(type, field, disk, width, kind) \
+  { offsetof (type, field), sizeof (((type *) 0)->field), disk, width, kind }
+#define SUDS_FIELD_END  { 0, 0, 0, 0, 0 }
+
+/* The four fields of a SUDS_STATIDENT, 12 bytes in the record */
+#define SUDS_STATIDENT_OF(type, name, disk) \
+  SUDS_FIELD_OF (type, name.network, (disk), 4, SUDS_FIELD_BYTES), \
+  SUDS_FIELD_OF (type, name.st_name, (disk) + 4, 5, SUDS_FIELD_BYTES), \
+  SUDS_FIELD_OF (type, name.component, (disk) + 9, 1, SUDS_FIELD_BYTES), \
+  SUDS_FIELD_OF (type, name.inst_type, (disk) + 10, 2, SUDS_FIELD_INT)
+
+/* Parse "intel" or "sparc" */
+int SudsParseOrder (const char *OutputFormat, SUDS_ORDER *order);
+
+/* Write the fields of the struct at ptr into the record at out, in *
+ * our byte order or, if swap, the other                             */
+void SudsEncodeFields (char *out, const void *ptr, const SUDS_FIELD *fields,
+                       int swap);
+
+/* Fill in the struct at ptr from the first len bytes of a record; *
+ * fields that don't fit in len are left alone                      */
+void SudsDecodeFields (void *ptr, const char *in, size_t len,
+                       const SUDS_FIELD *fields, int swap);
+
+/* Check that the fields fill len bytes of record exactly, in order, *
+ * each as wide as its kind allows                                    */
+int SudsCheckFields (const SUDS_FIELD *fields, long len);
+
+/* SudsCheckFields for every struct type we know; EW_FAILURE, having *
+ * said which, if any table is wrong                                  */
+int SudsCheckLayout (void);
+
+/* Bytes a SUDS struct of type struct_type (STRUCTTAG, STATIONCOMP, *
+ * DESCRIPTRACE, ... from sudshead.h) takes in the file; 0 if it's  *
+ * not one we know                                                  */
+long SudsStructLen (int struct_type);
+
+/* Encode a struct of a known type into SudsStructLen bytes at out */
+int SudsEncodeStruct (char *out, int struct_type, const void *ptr, int swap);
+
+/* Decode a record of len bytes into a struct of a known type; len *
+ * must be the type's SudsStructLen                                 */
+int SudsDecodeStruct (void *ptr, int struct_type, const char *in, long len,
+                      int swap);
+
+/* Encode a SUDS_STRUCTTAG for the struct, with len_data bytes to *
+ * follow, then the struct: SUDS_STRUCTTAG_LEN + SudsStructLen    *
+ * bytes at out                                                   */
+int SudsEncodeRecord (char *out, int struct_type, const void *ptr,
+                      long len_data, int swap);
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ *   sudstrigger.h
+ *
+ *   In-line recursive STA/LTA triggering for the PC-SUDS putaway
+ *   routines, with a network coincidence trigger on top.
+ *
+ *   Hand a SUDS_TRIG to SUDSWR_set_trigger and every packet SUDSWR_next
+ *   converts is also run through a detector for its channel; channels
+ *   are taken on as they are first seen. For each sample
+ *
+ *      sta += (|x - dc| - sta) / (StaSec * rate)
+ *      lta += (|x - dc| - lta) / (LtaSec * rate)     (held while triggered)
+ *
+ *   where dc follows the signal's offset over LtaSec. A channel turns on
+ *   once sta >= OnRatio * lta, no sooner than LtaSec after its first
+ *   sample, and off again once sta < OffRatio * lta. Packets overlapping
+ *   data already seen (snippets of overlapping events) are only run
+ *   through once, so the detectors carry on across events.
+ *
+ *   The detector state is kept one array per quantity, with a slot per
+ *   channel, and the update runs across a row of channels at a time, so
+ *   multiplexed data (SudsTrigFeedMux) is detected a vector of channels
+ *   per step. SudsDemuxFile (sudsdemux.h) feeds the blocks of a .WVM
+ *   that way; each channel's triggers come out the same as fed a channel
+ *   at a time.
+ *
+ *   A channel that turned on during a trace gets a SUDS_TRIGGERS after
+ *   its samples (after the stats record, if any):
+ *
+ *      sta, lta          short and long term means of the samples (their
+ *                        DC level) at the first trigger
+ *      abs_sta, abs_lta  the averages the detector runs on, at the first
+ *                        trigger
+ *      trig_value        STA/LTA at the first trigger, times 100
+ *      num_triggers      times the channel turned on during the trace
+ *      trig_time         when it first turned on
+ *
+ *   (all clipped to fit a short), and SUDSWR_end_ev puts a SUDS_DETECTOR
+ *   at the end of a file with any triggers in it: dalgorithm 'r'
+ *   (recursive STA/LTA), net_node_id "stalta", and, if the network
+ *   trigger declared an event while the file was open, event_type 't'
+ *   and event_number the number of the last event declared; otherwise
+ *   event_type 'u' and event_number 0.
+ *
+ *   The network trigger declares an event when a channel turns on with
+ *   at least MinStations - 1 other channels having turned on within
+ *   Window seconds either side of it. Later triggers within Window of
+ *   the event's first and last ones are counted as part of it. Channels
+ *   may arrive in any order, so an event is declared when its
+ *   MinStations'th trigger comes in, which need not be the latest in
+ *   time.
+ */
+
+#ifndef SUDSTRIGGER_H
+#define SUDSTRIGGER_H
+
+#include <trace_buf.h>
+#include <sudshead.h>
+
+typedef struct _SUDS_TRIG SUDS_TRIG;
+
+/* A network event */
+typedef struct
+{
+  long    number;                      /* 1, 2, ... */
+  double  on_time;                     /* earliest channel trigger */
+  int     nsta;                        /* channels triggered so far */
+} SUDS_NETEVENT;
+
+/* Called as each network event is declared (under the engine's lock, *
+ * so it mustn't call back into the engine)                            */
+typedef void (*SUDS_TRIG_EVENT) (void *arg, const SUDS_NETEVENT *ev);
+
+/* A new engine with room for MaxChans channels; StaSec 1, LtaSec 30, *
+ * OnRatio 4, OffRatio 1.5; coincidence needs 3 channels within 10 s  */
+SUDS_TRIG *SudsTrigCreate (int MaxChans);
+
+/* Detector settings, for channels taken on from now on */
+int SudsTrigSetDetector (SUDS_TRIG *tg, double StaSec, double LtaSec,
+                         double OnRatio, double OffRatio);
+
+/* Network trigger: MinStations channels within Window seconds; done (may *
+ * be NULL) is called with arg for each event declared                    */
+int SudsTrigSetCoincidence (SUDS_TRIG *tg, int MinStations, double Window,
+                            SUDS_TRIG_EVENT done, void *arg);
+
+/* Channel number of sta.chan.net, taking it on if it is new (rate is its *
+ * sample rate); -1 if the engine is full                                 */
+int SudsTrigChannel (SUDS_TRIG *tg, const char *sta, const char *chan,
+                     const char *net, double rate);
+
+/* Run one packet (header and samples in native byte order; datatype 's', *
+ * 'l' or 'f' as in sudsputaway.c) through channel ch's detector; if tr   *
+ * isn't NULL, triggers are added to it (native byte order; zero it at    *
+ * the start of a trace, and the caller fills in tr_name)                 */
+int SudsTrigFeed (SUDS_TRIG *tg, int ch, const TRACE_HEADER *wf,
+                  const void *samples, char datatype, SUDS_TRIGGERS *tr);
+
+/* Run nscan multiplexed scans of short samples (as in a MUXDATA; need *
+ * not be aligned, byte-swapped if swap) of channels first..first+nch-1 *
+ * (taken on in that order, at one rate) through their detectors; scan  *
+ * i is at t0 + i / rate. tr, if not NULL, is nch accumulators as above. */
+int SudsTrigFeedMux (SUDS_TRIG *tg, int first, int nch, const char *mux,
+                     int swap, long nscan, double t0, SUDS_TRIGGERS *tr);
+
+/* Number of the last network event declared; 0 if none yet */
+long SudsTrigLastEvent (SUDS_TRIG *tg);
+
+/* Fill in a SUDS_DETECTOR for an event file; events_before is what     *
+ * SudsTrigLastEvent said when the file was opened                      */
+void SudsTrigDetector (SUDS_TRIG *tg, long events_before, SUDS_DETECTOR *de);
+
+void SudsTrigDestroy (SUDS_TRIG *tg);
+
+#endif
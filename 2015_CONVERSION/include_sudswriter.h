@@ -0,0 +1,253 @@
+/*
+ *   sudswriter.h
+ *
+ *   Reentrant interface to the PC-SUDS putaway routines.
+ *
+ *   The SUDSPA_XXX routines (prototyped in pa_other_head.h) write one
+ *   event at a time through a single writer hidden in sudsputaway.c.
+ *   The SUDSWR_XXX routines take the writer as their first argument, so
+ *   a program can keep one SUDS_WRITER per thread and write overlapping
+ *   events concurrently. A SUDS_WRITER must only be used by one thread
+ *   at a time.
+ *
+ *   SUDSWR_next_batch writes every channel of an event in one call,
+ *   encoding the channels on a pool of threads. The file it writes is
+ *   the same, byte for byte, as calling SUDSWR_next once per channel.
+ *
+ *   With streaming turned on (SUDSWR_set_stream), SUDSWR_next writes
+ *   each trace out a buffer-load at a time and then goes back to fill
+ *   in its DESCRIPTRACE, so OutBufferLen only sets the chunk size and
+ *   long traces are no longer cut short. The file must be seekable.
+ *   SUDSWR_next_batch always buffers whole traces.
+ *
+ *   SUDSWR_set_io picks how event files are written: through stdio (the
+ *   default), with one pwritev per channel, or O_DIRECT; see sudsio.h.
+ *   SUDSWR_set_async instead queues the writing on a write-behind
+ *   service shared by any number of writers (sudsasync.h). SUDSWR_end_ev
+ *   then returns as soon as the close is queued, and the callback given
+ *   to SUDSWR_set_async reports, for each file, whether it was written.
+ *
+ *   By default a gap longer than GapThresh samples is filled with zeros.
+ *   With SUDSWR_set_segment turned on, each run of packets between gaps
+ *   (or overlaps) is written as its own DESCRIPTRACE with its own
+ *   begintime instead, and a COMMENT after the channel sums up its gaps
+ *   and overlaps. Long dropouts then cost nothing in the file, and can
+ *   no longer get a whole channel thrown away as a "bogus gap".
+ *
+ *   With SUDSWR_set_index turned on, SUDSWR_end_ev appends a channel
+ *   index record to each file before closing it (see sudsindex.h). Its
+ *   offsets are 32 bits, so a file with a channel starting past 2 GB
+ *   gets no index, and no IRIG time correction, which needs it; that
+ *   is logged.
+ *
+ *   Each trace's min, max, avenoise and count of clipped samples are
+ *   taken as its samples are converted and go in its DESCRIPTRACE; with
+ *   SUDSWR_set_stats turned on, a stats record with its mean and RMS as
+ *   well follows the samples (see sudsstats.h). A sample is clipped if
+ *   it is at or beyond +/- the value given to SUDSWR_set_clip, or by
+ *   default if it is pinned at the limit of the output sample type.
+ *
+ *   An RSAM engine given to SUDSWR_set_rsam sees every packet of the
+ *   stations it tracks as it is converted (see sudsrsam.h). The engine
+ *   belongs to the caller and may be shared by several writers.
+ *
+ *   So does an STA/LTA trigger engine given to SUDSWR_set_trigger, which
+ *   runs every channel through a detector as it is converted; channels
+ *   that triggered get a SUDS_TRIGGERS after their samples, and a file
+ *   with any triggers in it gets a SUDS_DETECTOR at the end (see
+ *   sudstrigger.h). A caller that has run a channel through the engine
+ *   itself (SudsDemuxFile does, a block of channels at a time) points
+ *   TrigFed at its triggers before SUDSWR_next, and the writer just
+ *   writes them.
+ *
+ *   With an IRIG decoder given to SUDSWR_set_irig, the time code channel
+ *   is decoded as it is converted, and SUDSWR_end_ev corrects the times
+ *   of every channel of the event and appends a SUDS_TIMECORRECTION
+ *   (see sudsirig.h). Unlike the engines above, the decoder holds the
+ *   current event's frames, so each writer needs its own.
+ *
+ *   SUDSWR_next_ev_file starts an event in a file the caller names, and
+ *   SUDSWR_set_stations gives STATIONCOMPs (site, instrument, gain and
+ *   so on) for the channels to start from instead of zeros; the
+ *   demultiplexer (sudsdemux.h) uses both to carry a .WVM file's
+ *   stations over to its .dmx.
+ *
+ *   With a SUDS_METRICS given to SUDSWR_set_metrics, each channel's
+ *   packets, gaps, clipping, bytes and so on are counted, and the time
+ *   spent on it split by phase (see sudsmetrics.h). Like the RSAM and
+ *   trigger engines it belongs to the caller and may be shared.
+ *
+ *   Sample buffers come from a buffer pool (sudsbufpool.h): one for
+ *   each channel being encoded, sized to the channel and grown as it
+ *   needs, then kept for the next. By default each writer has a pool of
+ *   its own, and a trace is cut short at OutBufferLen bytes (counted at
+ *   4 bytes a sample) as it always was. A pool given to
+ *   SUDSWR_set_buffers may be shared by any number of writers; if it
+ *   has a cap, a trace may be as long as the cap, and a writer that
+ *   would take the pool over it waits for the others to give buffers
+ *   back instead. Either way a streamed trace still goes out in pieces
+ *   of OutBufferLen.
+ *
+ *   Unless files are written through stdio, a 16-bit trace already in
+ *   the output byte order, with no gap to fill and packets of a couple
+ *   of kilobytes or more, isn't copied at all: its statistics are taken
+ *   in place and its samples written straight from the caller's
+ *   packets, one piece of the channel's gather write per packet. The
+ *   buffer then only holds the list of pieces, and a streamed trace
+ *   isn't streamed. The file is the same either way.
+ *
+ *   SUDSWR_next_ev names each file yyyymmdd_hhmmss_subnet_evid.dmx and
+ *   by default puts it straight in OutDir. SUDSWR_set_layout can shard
+ *   the files instead, by event date (OutDir/yyyy/mm/dd/) or by a hash
+ *   of the name (OutDir/xx/, one of 256), making the directories as
+ *   they are needed, so no one directory grows without bound. With a
+ *   manifest given to SUDSWR_set_manifest, SUDSWR_end_ev records each
+ *   file's path, event, time span, channels and size in it (see
+ *   sudsmanifest.h), so the files can be counted and found without
+ *   walking the tree. Like the engines above, the manifest belongs to
+ *   the caller and may be shared.
+ *
+ *   So does a catalog given to SUDSWR_set_catalog, which gets a row for
+ *   every trace written, with its id, time, length, rate, extremes,
+ *   gaps and clipping, in memory-mapped columns that can be summed up
+ *   by day or for station uptime without reading the files (see
+ *   sudscatalog.h).
+ *
+ *   A QC engine given to SUDSWR_set_qc checks every trace as it is
+ *   converted, for blank data, long runs of 0, -1 or one stuck value,
+ *   and a signal-to-noise ratio from its per-second peaks, and gives it
+ *   a quality of 0, 0.5 or 1 as LIB/trace_quality_control.py did. Each
+ *   trace gets a QC record after its samples, its quality and snr go in
+ *   the catalog, and SUDSWR_end_ev puts a COMMENT summing them up at
+ *   the end of the file (see sudsqc.h). Like the RSAM and trigger
+ *   engines it belongs to the caller and may be shared.
+ */
+
+#ifndef SUDSWRITER_H
+#define SUDSWRITER_H
+
+#include <stdio.h>
+#include <ws_clientII.h>
+#include <sudsio.h>
+#include <sudsswap.h>
+#include <sudsindex.h>
+#include <sudsrsam.h>
+#include <sudstrigger.h>
+#include <sudsirig.h>
+#include <sudsmetrics.h>
+#include <sudsbufpool.h>
+#include <sudspool.h>
+#include <sudsmanifest.h>
+#include <sudscatalog.h>
+#include <sudsqc.h>
+
+#define SUDS_MAXTXT      150
+
+#define SUDS_LAYOUT_FLAT  0            /* SUDSWR_set_layout: OutDir/name */
+#define SUDS_LAYOUT_DATE  1            /* OutDir/yyyy/mm/dd/name */
+#define SUDS_LAYOUT_HASH  2            /* OutDir/xx/name */
+
+typedef struct _SUDS_WRITER
+{
+  SUDS_OUT Out;                        /* SUDS file for the current event */
+  int     IoMode;                      /* SUDS_IO_XXX for new files */
+  SUDS_BUFPOOL *Buffers;               /* sample buffers come from here */
+  SUDS_BUFPOOL *OwnBuffers;            /* ... unless replaced, the writer's own */
+  char    OutputFormat[SUDS_MAXTXT];   /* "intel" or "sparc" */
+  SUDS_ORDER Order;                    /* ... parsed */
+  int     Swap;                        /* output order isn't ours */
+  char    FileName[4*SUDS_MAXTXT];     /* name of the current SUDS file */
+  long    BufferLen;                   /* longest trace, or streamed piece, in bytes */
+  int     Stream;                      /* write traces a chunk at a time */
+  SUDS_ASYNC *Async;                   /* write-behind service for SUDS_IO_ASYNC */
+  SUDS_ASYNC_DONE AsyncDone;           /* called as each file is finished */
+  void   *AsyncArg;
+  int     Segment;                     /* split channels at gaps */
+  int     WriteIndex;                  /* append a channel index at end_ev */
+  SUDS_INDEX Index;                    /* channels written to the current file */
+  int     IndexFull;                   /* a channel was past its 32-bit offsets */
+  long    ClipValue;                   /* clip level; 0 for the sample type's limits */
+  int     WriteStats;                  /* write a stats record after each trace */
+  SUDS_RSAM *Rsam;                     /* fed every packet, if not NULL */
+  SUDS_TRIG *Trig;                     /* likewise */
+  const SUDS_TRIGGERS *TrigFed;        /* next channel's triggers, if already fed */
+  long    TrigEvents;                  /* its network events before this file */
+  int     nTriggered;                  /* channels in this file that triggered */
+  SUDS_IRIG *Irig;                     /* decodes the time code, if not NULL */
+  SUDS_STATIDENT IrigName;             /* the time code channel, once written */
+  const SUDS_STATIONCOMP *Stations;    /* STATIONCOMP templates, native order */
+  int     nStations;
+  SUDS_METRICS *Metrics;               /* counts and times, if not NULL */
+  int     Layout;                      /* SUDS_LAYOUT_XXX */
+  char    MadeDir[4*SUDS_MAXTXT];      /* last directory it made, if any */
+  SUDS_MANIFEST *Manifest;             /* files are recorded here, if not NULL */
+  SUDS_MANIFEST_ENT Entry;             /* ... the current one, as it grows */
+  SUDS_STATIDENT LastChan;             /* channel last written to the file */
+  SUDS_CATALOG *Catalog;               /* traces are added here, if not NULL */
+  uint64_t FileKey;                    /* ... with this for the current file */
+  SUDS_QC *Qc;                         /* checks every trace, if not NULL */
+  int     nChecked;                    /* traces in this file checked */
+  int     nBad;                        /* ... that were bad */
+  int     nLowSnr;                     /* ... or had a low snr */
+  double  QualitySum;
+  char    BadChans[SUDS_MAXTXT];       /* the bad ones, as far as they fit */
+
+  /* batch encoding, set up by the first SUDSWR_next_batch call */
+  SUDS_POOL *Pool;                     /* encoding threads */
+} SUDS_WRITER;
+
+int SUDSWR_init (SUDS_WRITER *sw, int OutBufferLen, char *OutDir,
+                 char *OutputFormat, int debug);
+int SUDSWR_next_ev (SUDS_WRITER *sw, char *EventID, TRACE_REQ *ptrReq,
+                    int nReq, char *OutDir, char *EventDate, char *EventTime,
+                    char *EventSubnet, int debug);
+int SUDSWR_next_ev_file (SUDS_WRITER *sw, const char *FileName, int debug);
+int SUDSWR_set_stream (SUDS_WRITER *sw, int Stream);
+int SUDSWR_set_io (SUDS_WRITER *sw, int IoMode);
+int SUDSWR_set_async (SUDS_WRITER *sw, SUDS_ASYNC *as, SUDS_ASYNC_DONE done,
+                      void *arg);
+int SUDSWR_set_segment (SUDS_WRITER *sw, int Segment);
+int SUDSWR_set_index (SUDS_WRITER *sw, int WriteIndex);
+int SUDSWR_set_clip (SUDS_WRITER *sw, long ClipValue);
+int SUDSWR_set_stats (SUDS_WRITER *sw, int WriteStats);
+int SUDSWR_set_rsam (SUDS_WRITER *sw, SUDS_RSAM *rs);
+int SUDSWR_set_trigger (SUDS_WRITER *sw, SUDS_TRIG *tg);
+int SUDSWR_set_irig (SUDS_WRITER *sw, SUDS_IRIG *ir);
+int SUDSWR_set_stations (SUDS_WRITER *sw, const SUDS_STATIONCOMP *sc, int n);
+int SUDSWR_set_metrics (SUDS_WRITER *sw, SUDS_METRICS *m);
+int SUDSWR_set_buffers (SUDS_WRITER *sw, SUDS_BUFPOOL *bp);
+int SUDSWR_set_layout (SUDS_WRITER *sw, int Layout);
+int SUDSWR_set_manifest (SUDS_WRITER *sw, SUDS_MANIFEST *mf);
+int SUDSWR_set_catalog (SUDS_WRITER *sw, SUDS_CATALOG *cat);
+int SUDSWR_set_qc (SUDS_WRITER *sw, SUDS_QC *qc);
+int SUDSWR_next (SUDS_WRITER *sw, TRACE_REQ *getThis, double GapThresh,
+                 long OutBufferLen, int debug);
+int SUDSWR_next_batch (SUDS_WRITER *sw, TRACE_REQ *ptrReq, int nReq,
+                       double GapThresh, long OutBufferLen, int nThreads,
+                       int debug);
+int SUDSWR_end_ev (SUDS_WRITER *sw, int debug);
+int SUDSWR_close (SUDS_WRITER *sw, int debug);
+
+/* Batch, streaming, write-behind, segmenting, index, stats and RSAM entry points for the *
+ * default writer behind SUDSPA_XXX; the SUDSPA_set_XXX calls must follow SUDSPA_init     */
+int SUDSPA_next_batch (TRACE_REQ *ptrReq, int nReq, double GapThresh,
+                       long OutBufferLen, int nThreads, int debug);
+int SUDSPA_set_stream (int Stream);
+int SUDSPA_set_io (int IoMode);
+int SUDSPA_set_async (SUDS_ASYNC *as, SUDS_ASYNC_DONE done, void *arg);
+int SUDSPA_set_segment (int Segment);
+int SUDSPA_set_index (int WriteIndex);
+int SUDSPA_set_clip (long ClipValue);
+int SUDSPA_set_stats (int WriteStats);
+int SUDSPA_set_rsam (SUDS_RSAM *rs);
+int SUDSPA_set_trigger (SUDS_TRIG *tg);
+int SUDSPA_set_irig (SUDS_IRIG *ir);
+int SUDSPA_set_stations (const SUDS_STATIONCOMP *sc, int n);
+int SUDSPA_set_metrics (SUDS_METRICS *m);
+int SUDSPA_set_buffers (SUDS_BUFPOOL *bp);
+int SUDSPA_set_layout (int Layout);
+int SUDSPA_set_manifest (SUDS_MANIFEST *mf);
+int SUDSPA_set_catalog (SUDS_CATALOG *cat);
+int SUDSPA_set_qc (SUDS_QC *qc);
+
+#endif
@@ -0,0 +1,90 @@
+/* sudsarchive.c
+
+        Convert a PC-SUDS archive in one pass: every .WVM under InDir is
+        demultiplexed (and time corrected) into OutDir, and copied to
+        miniSEED if -s is given. See sudsarchive.h for how it goes about
+        it. Run it again after an interruption and it carries on from
+        the journal.
+
+   usage: sudsarchive [-t threads] [-f intel|sparc] [-s mseeddir]
+                      [-r reclen] [-j journal] [-i sta:chan:B|E]
+                      [-p reportsec] [-v] InDir OutDir
+
+   Exits 0 when every file was converted, 1 if any failed, 2 on bad
+   arguments.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <earthworm.h>
+#include <sudsirig.h>
+#include <sudsarchive.h>
+
+static void Usage (const char *prog)
+{
+  fprintf (stderr, "usage: %s [-t threads] [-f intel|sparc] [-s mseeddir]\n"
+           "          [-r reclen] [-j journal] [-i sta:chan:B|E]\n"
+           "          [-p reportsec] [-v] InDir OutDir\n", prog);
+  exit (2);
+}
+
+int main (int argc, char **argv)
+{
+  SUDS_ARCHIVE_PARAMS  ap;
+  SUDS_ARCHIVE_STATS   st;
+  char   *sta, *chan, *code;
+  int     c;
+
+  memset (&ap, 0, sizeof (ap));
+  ap.OutputFormat = "intel";
+  ap.nThreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  ap.ReportSec = 60;
+
+  while ((c = getopt (argc, argv, "t:f:s:r:j:i:p:v")) != -1)
+  {
+    switch (c)
+    {
+      case 't': ap.nThreads = atoi (optarg);     break;
+      case 'f': ap.OutputFormat = optarg;        break;
+      case 's': ap.MseedDir = optarg;            break;
+      case 'r': ap.MseedRecLen = atoi (optarg);  break;
+      case 'j': ap.Journal = optarg;             break;
+      case 'p': ap.ReportSec = atoi (optarg);    break;
+      case 'v': ap.debug = 1;                    break;
+      case 'i':
+        sta = optarg;
+        if ((chan = strchr (sta, ':')) == NULL
+            || (code = strchr (chan + 1, ':')) == NULL)
+          Usage (argv[0]);
+        *chan++ = '\0';
+        *code++ = '\0';
+        if (strcmp (code, "B") == 0)
+          ap.IrigCode = SUDS_IRIG_B;
+        else if (strcmp (code, "E") == 0)
+          ap.IrigCode = SUDS_IRIG_E;
+        else
+          Usage (argv[0]);
+        ap.IrigSta = sta;
+        ap.IrigChan = chan;
+        break;
+      default:
+        Usage (argv[0]);
+    }
+  }
+  if (argc - optind != 2)
+    Usage (argv[0]);
+  ap.InDir = argv[optind];
+  ap.OutDir = argv[optind + 1];
+  if (ap.nThreads < 1)
+    ap.nThreads = 1;
+
+  logit_init ("sudsarchive", 0, 256, 1);
+
+  c = SudsArchiveRun (&ap, &st);
+  fprintf (stderr, "%ld files: %ld converted, %ld already done, %ld failed; "
+           "%.1f MB in %.0f s\n", st.nFiles, st.nDone, st.nSkipped,
+           st.nFailed, st.Bytes / 1048576.0, st.Seconds);
+  return (c == EW_SUCCESS) ? 0 : 1;
+}
@@ -0,0 +1,788 @@
+/* regress.c
+
+        Regression check of the SUDS putaway path: an event written in
+        Intel and in SPARC byte order is read back through sudsreader and
+        the two compared. Built without Earthworm from the stub headers,
+        like sudsbench; link the headers under their Earthworm names as
+        sudsbench.c says, then from 2015_CONVERSION:
+
+   cc -O2 -I/tmp/sb/stubs -I/tmp/sb/include -o sudsregress \
+      src_bench_sudsbench_regress.c src_bench_sudsbench_stubs.c \
+      src_libsrc_util_suds*.c src_libsrc_util_mseedputaway.c \
+      -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc -lpthread -lm
+
+   usage: sudsregress [-o outdir] [-d datadir] [-v]
+
+   The event is three made-up channels of 20 seconds at 100 sps: i2
+   and i4 random walks (the i4 one well outside a short) and an i2 one
+   with a run of zeros in it. They are written to outdir/intel.dmx and
+   outdir/sparc.dmx with the stats, QC and channel index records on,
+   and each file is checked for
+
+        layout   the field tables make the PC-SUDS sizes: a 12-byte
+                 tag, 76-byte STATIONCOMP, 64-byte DESCRIPTRACE and
+                 52-byte QC record
+        tags     each tag starts where the last record ended, names the
+                 file's byte order, and gives a known struct its PC-SUDS
+                 length; the last record ends the file
+        samples  each trace has the samples that went in
+        qc       each trace is followed by a QC record (id 102) naming
+                 it, and only the channel with the zeros is flagged
+        index    the channel index points at each trace's DESCRIPTRACE
+
+   and then the two files must decode to the same structs and samples.
+
+   A .WVM of eleven multiplexed channels in SPARC order, with bursts
+   on most of them, is then demultiplexed twice with a trigger engine
+   on the writer: by SudsDemuxFile, which runs the blocks through it a
+   scan of channels at a time, and by SudsDemuxLoad and SudsDemuxWrite,
+   which leave it to the writer a channel at a time. The two .dmx files
+   must have the same records, byte for byte, with TRIGGERS records in
+   them, and each must end in a DETECTOR. (The event number in that may
+   differ: the network trigger sees the channels' triggers in another
+   order, so it may group them into events differently.)
+
+   The RSAM engine is then fed the amplitudes of the first two alarms
+   in datadir/rsam_event_alarms.csv (../DATA by default), with the
+   same stations and thresholds, and the event alarm file it writes
+   must be the same, byte for byte, as that file's first three lines.
+
+   Each check prints ok or FAIL; the exit status is 1 if any failed.
+   With -v, what the putaway routines log is printed too.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <earthworm.h>
+#include <swap.h>
+#include <trace_buf.h>
+#include <ws_clientII.h>
+#include <sudswriter.h>
+#include <sudsreader.h>
+#include <sudsindex.h>
+#include <sudsqc.h>
+#include <sudsstats.h>
+#include <sudsswap.h>
+#include <sudsrsam.h>
+#include <sudsdemux.h>
+
+#define REG_NCH       3
+#define REG_RATE      100.0
+#define REG_PKTLEN    100                /* samples a packet */
+#define REG_NPKT      20
+#define REG_NSAMP     (REG_PKTLEN * REG_NPKT)
+#define REG_ZERO_AT   700                /* the run of zeros in channel 2 */
+#define REG_ZERO_LEN  50
+#define REG_BUFLEN    (2 * REG_NSAMP * (long) sizeof (int32_t))
+#define REG_GAPTHRESH 1.5
+#define REG_MAXREC    64
+
+#define TRIG_NCH      11                 /* a vector of channels and some over */
+#define TRIG_NBLK     3
+#define TRIG_NSCAN    1000               /* scans a block */
+#define TRIG_BUFLEN   (2 * TRIG_NBLK * TRIG_NSCAN * (long) sizeof (int32_t))
+
+#define RSAM_NSTA     6                  /* as in rsam_event_alarms.csv */
+#define RSAM_NROW     2                  /* alarms checked */
+#define RSAM_WARMUP   700                /* seconds before the first */
+
+extern int BenchVerbose;               /* print what is logged; stubs.c */
+
+static const char *Stations[REG_NCH] = { "RA01", "RA02", "RA03" };
+static const char *Types[REG_NCH]    = { "i2", "i4", "i2" };
+
+/* What one file decodes to */
+typedef struct
+{
+  SUDS_STATIONCOMP  sc[REG_NCH];
+  SUDS_DESCRIPTRACE dt[REG_NCH];
+  SUDS_CHANSTATS    cs[REG_NCH];
+  SUDS_CHANQC       cq[REG_NCH];
+  size_t            dt_at[REG_NCH];    /* file offset of the DESCRIPTRACE tag */
+  long             *samples[REG_NCH];
+  int               nch;
+} REG_FILE;
+
+/* The stations and event thresholds of the reference alarm file, and the *
+ * one-minute averages (0 for no data) and times of its first alarms      */
+static const char  *RsamSta[RSAM_NSTA] = { "MLYT", "MJHT", "MRYT", "MLGT",
+                                           "MWHZ", "MGHZ" };
+static const double RsamThresh[RSAM_NSTA] = { 150, 50, 0, 400, 50, 200 };
+static const int    RsamAmp[RSAM_NROW][RSAM_NSTA] = {
+  { 40, 141, 0, 116, 21, 207 },          /* 03-Feb-1999 09:52:38 */
+  { 30,  88, 0,  82, 21, 207 }           /* 03-Feb-1999 10:07:29 */
+};
+static const long   RsamTime[RSAM_NROW] = { 918035558L, 918036449L };
+
+/* Internal Function Prototypes */
+static int CheckLayout (void);
+static int WriteEvent (const char *, const char *, int32_t **);
+static void MakeChannel (TRACE_REQ *, int, int32_t *);
+static int ReadEvent (const char *, char, int32_t **, REG_FILE *);
+static int CheckTags (SUDS_FILE *, char);
+static int CheckTraces (SUDS_FILE *, int32_t **, REG_FILE *);
+static int CheckQc (SUDS_FILE *, REG_FILE *);
+static int CheckIndex (SUDS_FILE *, REG_FILE *);
+static int CompareFiles (REG_FILE *, REG_FILE *);
+static int CheckTrigger (const char *);
+static int DemuxTrig (const char *, const char *, const char *, int,
+                      long *);
+static int MakeWvm (const char *);
+static short TrigSample (int, long, unsigned int *);
+static int CountRecs (const char *, int);
+static int SameRecs (const char *, const char *, int);
+static int CheckRsam (const char *, const char *);
+static int RsamSecond (SUDS_RSAM *, int, long, int);
+static long ReadHead (const char *, char *, long, int);
+static void FreeFile (REG_FILE *);
+static int Report (const char *, const char *, int);
+
+int main (int argc, char **argv)
+{
+  REG_FILE  in, sp;
+  int32_t  *values[REG_NCH];
+  char      intel[256], sparc[256];
+  char     *outdir = "sudsregress.out", *datadir = "../DATA";
+  int       c, fail = 0;
+
+  while ((c = getopt (argc, argv, "o:d:v")) != -1)
+  {
+    switch (c)
+    {
+      case 'o': outdir = optarg;     break;
+      case 'd': datadir = optarg;    break;
+      case 'v': BenchVerbose = 1;    break;
+      default:
+        fprintf (stderr, "usage: %s [-o outdir] [-d datadir] [-v]\n",
+                 argv[0]);
+        return 2;
+    }
+  }
+  if (mkdir (outdir, 0755) != 0 && access (outdir, W_OK) != 0)
+  {
+    perror (outdir);
+    return 2;
+  }
+  snprintf (intel, sizeof (intel), "%s/intel.dmx", outdir);
+  snprintf (sparc, sizeof (sparc), "%s/sparc.dmx", outdir);
+  memset (&in, 0, sizeof (in));
+  memset (&sp, 0, sizeof (sp));
+  for (c = 0; c < REG_NCH; c++)
+    if ((values[c] = (int32_t *) malloc (REG_NSAMP * sizeof (int32_t))) == NULL)
+      return 2;
+
+  fail |= Report ("layout", "", CheckLayout ());
+  fail |= Report ("write", "intel", WriteEvent (intel, "intel", values));
+  fail |= Report ("write", "sparc", WriteEvent (sparc, "sparc", values));
+  if (!fail)
+  {
+    fail |= ReadEvent (intel, '6', values, &in);
+    fail |= ReadEvent (sparc, '1', values, &sp);
+    fail |= Report ("orders", "intel = sparc", CompareFiles (&in, &sp));
+  }
+  fail |= Report ("trigger", "mux = channel", CheckTrigger (outdir));
+  fail |= Report ("rsam", "event alarms", CheckRsam (outdir, datadir));
+
+  FreeFile (&in);
+  FreeFile (&sp);
+  for (c = 0; c < REG_NCH; c++)
+    free (values[c]);
+  printf ("%s\n", fail ? "FAILED" : "all ok");
+  return fail ? 1 : 0;
+}
+
+/* The tables make the sizes PC-SUDS readers expect */
+static int CheckLayout (void)
+{
+  if (SudsCheckLayout () != EW_SUCCESS
+      || SudsStructLen (STRUCTTAG) != SUDS_STRUCTTAG_LEN
+      || SudsStructLen (STRUCTTAG) != 12
+      || SudsStructLen (STATIONCOMP) != 76
+      || SudsStructLen (DESCRIPTRACE) != 64
+      || SudsStructLen (SUDS_CHANSTATS_ID) != SUDS_CHANSTATS_LEN
+      || SudsStructLen (SUDS_CHANQC_ID) != 52)
+    return EW_FAILURE;
+  return EW_SUCCESS;
+}
+
+
+/*
+ *  Writing
+ */
+
+/* Write the event to path in format; values gets each channel's samples */
+static int WriteEvent (const char *path, const char *format, int32_t **values)
+{
+  SUDS_WRITER  sw;
+  SUDS_QC     *qc;
+  TRACE_REQ    req[REG_NCH];
+  char         dir[256];
+  int          c, ret = EW_SUCCESS;
+
+  memset (req, 0, sizeof (req));
+  for (c = 0; c < REG_NCH; c++)
+    MakeChannel (&req[c], c, values[c]);
+
+  snprintf (dir, sizeof (dir), "%s", path);
+  *strrchr (dir, '/') = '\0';
+  if ((qc = SudsQcCreate ()) == NULL
+      || SUDSWR_init (&sw, (int) REG_BUFLEN, dir, (char *) format, 0)
+         != EW_SUCCESS)
+  {
+    SudsQcDestroy (qc);
+    for (c = 0; c < REG_NCH; c++)
+      free (req[c].pBuf);
+    return EW_FAILURE;
+  }
+  if (SUDSWR_set_stats (&sw, 1) != EW_SUCCESS
+      || SUDSWR_set_index (&sw, 1) != EW_SUCCESS
+      || SUDSWR_set_qc (&sw, qc) != EW_SUCCESS
+      || SUDSWR_next_ev_file (&sw, path, 0) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  for (c = 0; c < REG_NCH && ret == EW_SUCCESS; c++)
+    if (SUDSWR_next (&sw, &req[c], REG_GAPTHRESH, REG_BUFLEN, 0) != EW_SUCCESS)
+      ret = EW_FAILURE;
+  if (ret == EW_SUCCESS && SUDSWR_end_ev (&sw, 0) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  if (SUDSWR_close (&sw, 0) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  SudsQcDestroy (qc);
+  for (c = 0; c < REG_NCH; c++)
+    free (req[c].pBuf);
+  return ret;
+}
+
+/* Channel c's packets, contiguous, in local order; its samples in values */
+static void MakeChannel (TRACE_REQ *r, int c, int32_t *values)
+{
+  TRACE_HEADER *wf;
+  unsigned int  seed = 4242u + c;
+  long    value = 0, step = (Types[c][1] == '4') ? 4000 : 100;
+  double  t = 946684800.0;             /* 2000-01-01 */
+  char   *p;
+  int     size = (Types[c][1] == '4') ? (int) sizeof (int32_t) : 2;
+  int     k, j, i = 0;
+  short   s;
+
+  r->pBuf = p = (char *) malloc (REG_NPKT * (sizeof (TRACE_HEADER)
+                                             + REG_PKTLEN * size));
+  if (p == NULL)
+    return;
+  strcpy (r->sta, Stations[c]);
+  strcpy (r->chan, "SHZ");
+  strcpy (r->net, "RG");
+  for (k = 0; k < REG_NPKT; k++)
+  {
+    wf = (TRACE_HEADER *) p;
+    memset (wf, 0, sizeof (TRACE_HEADER));
+    wf->pinno = c;
+    wf->nsamp = REG_PKTLEN;
+    wf->starttime = t;
+    wf->endtime = t + (REG_PKTLEN - 1) / REG_RATE;
+    wf->samprate = REG_RATE;
+    strcpy (wf->sta, r->sta);
+    strcpy (wf->chan, r->chan);
+    strcpy (wf->net, r->net);
+    strcpy (wf->datatype, Types[c]);
+    p += sizeof (TRACE_HEADER);
+    for (j = 0; j < REG_PKTLEN; j++, i++, p += size)
+    {
+      seed = seed * 1103515245u + 12345u;
+      value += (long) ((seed >> 16) % (2 * step + 1)) - step;
+      if (value > 30 * step || value < -30 * step)
+        value /= 2;
+      values[i] = (c == 2 && i >= REG_ZERO_AT && i < REG_ZERO_AT + REG_ZERO_LEN)
+                  ? 0 : (int32_t) value;
+      if (size == 2)
+      {
+        s = (short) values[i];
+        memcpy (p, &s, sizeof (s));
+      }
+      else
+        memcpy (p, &values[i], sizeof (int32_t));
+    }
+    t += REG_PKTLEN / REG_RATE;
+  }
+  r->actLen = (long) (p - r->pBuf);
+  r->bufLen = r->actLen;
+  r->samprate = REG_RATE;
+}
+
+
+/*
+ *  Reading back
+ */
+
+/* Read path, which should be in machine's byte order, into rf */
+static int ReadEvent (const char *path, char machine, int32_t **values,
+                      REG_FILE *rf)
+{
+  SUDS_FILE  sf;
+  const char *name = (machine == '6') ? "intel" : "sparc";
+  int        fail = 0;
+
+  if (SudsFileOpen (&sf, path) != EW_SUCCESS)
+    return Report ("open", name, EW_FAILURE);
+  fail |= Report ("tags", name, CheckTags (&sf, machine));
+  fail |= Report ("samples", name, CheckTraces (&sf, values, rf));
+  fail |= Report ("qc", name, CheckQc (&sf, rf));
+  fail |= Report ("index", name, CheckIndex (&sf, rf));
+  SudsFileClose (&sf);
+  return fail;
+}
+
+/* Every record is where the last one ended and in machine's order */
+static int CheckTags (SUDS_FILE *sf, char machine)
+{
+  SUDS_REC  rec;
+  size_t    pos = 0, next = 0;
+  long      len;
+  int       r, n = 0;
+
+  while ((r = SudsNextRec (sf, &pos, &rec)) == EW_SUCCESS)
+  {
+    len = SudsStructLen (rec.id);
+    if (rec.Offset != next || rec.machine != machine
+        || (len > 0 && rec.len_struct != len))
+    {
+      fprintf (stderr, "tag %d at %lu: machine %c, %ld bytes; expected at %lu\n",
+               rec.id, (unsigned long) rec.Offset, rec.machine,
+               rec.len_struct, (unsigned long) next);
+      return EW_FAILURE;
+    }
+    next = rec.Offset + SUDS_STRUCTTAG_LEN + rec.len_struct + rec.len_data;
+    n++;
+  }
+  return (r == SUDS_EOF && next == sf->Size && n > 0) ? EW_SUCCESS : EW_FAILURE;
+}
+
+/* Each trace is a channel in order, with the samples that went in */
+static int CheckTraces (SUDS_FILE *sf, int32_t **values, REG_FILE *rf)
+{
+  SUDS_TRACE  tr;
+  size_t      pos = 0;
+  long        i;
+  int         c;
+
+  for (c = 0; SudsNextTrace (sf, &pos, &tr) == EW_SUCCESS; c++)
+  {
+    if (c == REG_NCH || !tr.have_sc
+        || strncmp (tr.dt.dt_name.st_name, Stations[c], 4) != 0
+        || tr.dt.length != REG_NSAMP || tr.samples.n != REG_NSAMP
+        || tr.dt.rate != (float) REG_RATE
+        || tr.dt.datatype != ((Types[c][1] == '4') ? 'l' : 's'))
+      return EW_FAILURE;
+    if ((rf->samples[c] = (long *) malloc (REG_NSAMP * sizeof (long))) == NULL
+        || SudsSamples (&tr.samples, 0, REG_NSAMP, rf->samples[c]) != REG_NSAMP)
+      return EW_FAILURE;
+    for (i = 0; i < REG_NSAMP; i++)
+      if (rf->samples[c][i] != values[c][i])
+      {
+        fprintf (stderr, "%s sample %ld is %ld, not %ld\n", Stations[c], i,
+                 rf->samples[c][i], (long) values[c][i]);
+        return EW_FAILURE;
+      }
+    rf->sc[c] = tr.sc;
+    rf->dt[c] = tr.dt;
+    rf->dt_at[c] = tr.Offset;
+    rf->nch = c + 1;
+  }
+  return (rf->nch == REG_NCH) ? EW_SUCCESS : EW_FAILURE;
+}
+
+/* Each trace's stats and QC records follow it and name it; only the *
+ * channel with the zeros is bad                                     */
+static int CheckQc (SUDS_FILE *sf, REG_FILE *rf)
+{
+  SUDS_REC  rec;
+  size_t    pos = 0;
+  int       c = -1, nqc = 0, bad;
+
+  while (SudsNextRec (sf, &pos, &rec) == EW_SUCCESS)
+  {
+    if (rec.id == DESCRIPTRACE)
+      c++;
+    else if (rec.id == SUDS_CHANSTATS_ID && c >= 0 && c < REG_NCH)
+    {
+      if (SudsRecStruct (&rec, &rf->cs[c], SUDS_CHANSTATS_ID) != EW_SUCCESS
+          || memcmp (&rf->cs[c].cs_name, &rf->dt[c].dt_name,
+                     sizeof (SUDS_STATIDENT)) != 0
+          || rf->cs[c].mindata != rf->dt[c].mindata
+          || rf->cs[c].maxdata != rf->dt[c].maxdata)
+        return EW_FAILURE;
+    }
+    else if (rec.id == SUDS_CHANQC_ID && c >= 0 && c < REG_NCH)
+    {
+      if (SudsRecStruct (&rec, &rf->cq[c], SUDS_CHANQC_ID) != EW_SUCCESS
+          || memcmp (&rf->cq[c].qc_name, &rf->dt[c].dt_name,
+                     sizeof (SUDS_STATIDENT)) != 0
+          || rf->cq[c].numclip != rf->dt[c].numclip)
+        return EW_FAILURE;
+      bad = (rf->cq[c].flags & SUDS_QC_ZEROS) != 0;
+      if (bad != (c == 2) || rf->cq[c].zero_run < (c == 2 ? REG_ZERO_LEN : 0)
+          || (bad && rf->cq[c].quality != 0.0f))
+      {
+        fprintf (stderr, "%s: QC flags %x, zero run %d, quality %.1f\n",
+                 Stations[c], rf->cq[c].flags, rf->cq[c].zero_run,
+                 rf->cq[c].quality);
+        return EW_FAILURE;
+      }
+      nqc++;
+    }
+  }
+  return (nqc == REG_NCH) ? EW_SUCCESS : EW_FAILURE;
+}
+
+/* The index has every trace, at its DESCRIPTRACE */
+static int CheckIndex (SUDS_FILE *sf, REG_FILE *rf)
+{
+  SUDS_CHANINDEX *ent = NULL;
+  long            n = 0;
+  int             c, ret = EW_SUCCESS;
+
+  if (SudsIndexLoad (sf, &ent, &n) != EW_SUCCESS || n != REG_NCH)
+    ret = EW_FAILURE;
+  for (c = 0; c < n && ret == EW_SUCCESS; c++)
+    if ((size_t) ent[c].dt_offset != rf->dt_at[c]
+        || ent[c].length != rf->dt[c].length
+        || memcmp (&ent[c].ci_name, &rf->dt[c].dt_name,
+                   sizeof (SUDS_STATIDENT)) != 0)
+      ret = EW_FAILURE;
+  free (ent);
+  return ret;
+}
+
+/* The same structs and samples whichever the byte order */
+static int CompareFiles (REG_FILE *a, REG_FILE *b)
+{
+  int  c;
+
+  if (a->nch != b->nch)
+    return EW_FAILURE;
+  for (c = 0; c < a->nch; c++)
+    if (memcmp (&a->sc[c], &b->sc[c], sizeof (SUDS_STATIONCOMP)) != 0
+        || memcmp (&a->dt[c], &b->dt[c], sizeof (SUDS_DESCRIPTRACE)) != 0
+        || memcmp (&a->cs[c], &b->cs[c], sizeof (SUDS_CHANSTATS)) != 0
+        || memcmp (&a->cq[c], &b->cq[c], sizeof (SUDS_CHANQC)) != 0
+        || memcmp (a->samples[c], b->samples[c], REG_NSAMP * sizeof (long)) != 0)
+      return EW_FAILURE;
+  return EW_SUCCESS;
+}
+
+
+
+/*
+ *  Triggering multiplexed data
+ */
+
+/* The triggers are the same fed a scan of channels at a time as fed *
+ * a channel at a time                                               */
+static int CheckTrigger (const char *outdir)
+{
+  char  wvm[256], mux[256], chan[256];
+  long  ev_mux, ev_chan;
+  int   ntrig;
+
+  snprintf (wvm, sizeof (wvm), "%s/trigger.wvm", outdir);
+  snprintf (mux, sizeof (mux), "%s/trigmux.dmx", outdir);
+  snprintf (chan, sizeof (chan), "%s/trigchan.dmx", outdir);
+  if (MakeWvm (wvm) != EW_SUCCESS
+      || DemuxTrig (outdir, wvm, mux, 1, &ev_mux) != EW_SUCCESS
+      || DemuxTrig (outdir, wvm, chan, 0, &ev_chan) != EW_SUCCESS)
+    return EW_FAILURE;
+
+  ntrig = CountRecs (mux, TRIGGERS);
+  if (ntrig < TRIG_NCH / 2 || ev_mux < 1 || ev_chan < 1
+      || CountRecs (mux, DETECTOR) != 1 || CountRecs (chan, DETECTOR) != 1)
+  {
+    fprintf (stderr, "%s: %d channels triggered, %ld events (%ld a channel "
+             "at a time)\n", mux, ntrig, ev_mux, ev_chan);
+    return EW_FAILURE;
+  }
+  if (SameRecs (mux, chan, DETECTOR) != EW_SUCCESS)
+  {
+    fprintf (stderr, "%s and %s differ\n", mux, chan);
+    return EW_FAILURE;
+  }
+  return EW_SUCCESS;
+}
+
+/* Demultiplex wvm to out with a trigger engine on the writer, by      *
+ * SudsDemuxFile if mux, else by SudsDemuxLoad and SudsDemuxWrite; the *
+ * engine's network events in nev                                      */
+static int DemuxTrig (const char *outdir, const char *wvm, const char *out,
+                      int mux, long *nev)
+{
+  SUDS_WRITER   sw;
+  SUDS_DEMUXED  dm;
+  SUDS_TRIG    *tg;
+  int           ret;
+
+  *nev = 0;
+  if ((tg = SudsTrigCreate (TRIG_NCH)) == NULL)
+    return EW_FAILURE;
+  if (SudsTrigSetDetector (tg, 0.5, 5.0, 4.0, 1.5) != EW_SUCCESS
+      || SUDSWR_init (&sw, (int) TRIG_BUFLEN, (char *) outdir, "intel", 0) != EW_SUCCESS)
+  {
+    SudsTrigDestroy (tg);
+    return EW_FAILURE;
+  }
+  ret = SUDSWR_set_trigger (&sw, tg);
+  if (ret == EW_SUCCESS && mux)
+    ret = SudsDemuxFile (&sw, wvm, out, 0);
+  else if (ret == EW_SUCCESS)
+  {
+    ret = SudsDemuxLoad (wvm, &dm, 0);
+    if (ret == EW_SUCCESS)
+      ret = SudsDemuxWrite (&sw, &dm, out, 0);
+    SudsDemuxFree (&dm);
+  }
+  if (SUDSWR_close (&sw, 0) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  *nev = SudsTrigLastEvent (tg);
+  SudsTrigDestroy (tg);
+  return ret;
+}
+
+/* A .WVM in SPARC order: a STATIONCOMP for each channel, then       *
+ * TRIG_NBLK MUXDATA blocks of TRIG_NSCAN scans at REG_RATE, in a    *
+ * row                                                               */
+static int MakeWvm (const char *path)
+{
+  SUDS_STATIONCOMP  sc;
+  SUDS_MUXDATA      md;
+  FILE             *fp;
+  char              rec[SUDS_STRUCTTAG_LEN + SUDS_STATIONCOMP_LEN];
+  short             scan[TRIG_NCH];
+  unsigned int      seed = 4242u;
+  int               swap = SUDS_ORDER_SWAP (SUDS_ORDER_SPARC);
+  int               c, b, ret = EW_SUCCESS;
+  long              i;
+
+  if ((fp = fopen (path, "wb")) == NULL)
+  {
+    perror (path);
+    return EW_FAILURE;
+  }
+  for (c = 0; c < TRIG_NCH && ret == EW_SUCCESS; c++)
+  {
+    memset (&sc, 0, sizeof (sc));
+    snprintf (sc.sc_name.st_name, sizeof (sc.sc_name.st_name), "TG%02d", c);
+    strcpy (sc.sc_name.network, "RG");
+    sc.sc_name.component = 'z';
+    sc.channel = (short) (c + 1);
+    if (SudsEncodeRecord (rec, STATIONCOMP, &sc, 0, swap) != EW_SUCCESS
+        || fwrite (rec, SUDS_STRUCTTAG_LEN + SUDS_STATIONCOMP_LEN, 1, fp) != 1)
+      ret = EW_FAILURE;
+  }
+  for (b = 0; b < TRIG_NBLK && ret == EW_SUCCESS; b++)
+  {
+    memset (&md, 0, sizeof (md));
+    strcpy (md.netname, "RG");
+    md.begintime = 946684800.0 + b * TRIG_NSCAN / REG_RATE;
+    md.numchans = TRIG_NCH;
+    md.dig_rate = (float) REG_RATE;
+    md.typedata = 's';
+    md.numsamps = TRIG_NSCAN;
+    if (SudsEncodeRecord (rec, MUXDATA, &md,
+                          TRIG_NSCAN * TRIG_NCH * (long) sizeof (short), swap)
+        != EW_SUCCESS
+        || fwrite (rec, SUDS_STRUCTTAG_LEN + SUDS_MUXDATA_LEN, 1, fp) != 1)
+      ret = EW_FAILURE;
+    for (i = 0; i < TRIG_NSCAN && ret == EW_SUCCESS; i++)
+    {
+      for (c = 0; c < TRIG_NCH; c++)
+      {
+        scan[c] = TrigSample (c, b * TRIG_NSCAN + i, &seed);
+        if (swap)
+          SwapShort (&scan[c]);
+      }
+      if (fwrite (scan, sizeof (scan), 1, fp) != 1)
+        ret = EW_FAILURE;
+    }
+  }
+  if (fclose (fp) != 0)
+    ret = EW_FAILURE;
+  return ret;
+}
+
+/* Sample i of channel c: noise, with two seconds of a burst from 12 s  *
+ * on (a little later on each channel; every fourth channel has none)   *
+ * and another from 23 s on every channel                               */
+static short TrigSample (int c, long i, unsigned int *seed)
+{
+  long  x, b1 = 1200 + 30 * c, b2 = 2300 + 10 * c;
+
+  *seed = *seed * 1103515245u + 12345u;
+  x = (long) ((*seed >> 16) % 201) - 100;
+  if ((c % 4 != 3 && i >= b1 && i < b1 + 200) || (i >= b2 && i < b2 + 200))
+    x += (i % 2) ? -3000 : 3000;
+  return (short) x;
+}
+
+/* Records of type id in path, or -1 if it can't be read */
+static int CountRecs (const char *path, int id)
+{
+  SUDS_FILE  sf;
+  SUDS_REC   rec;
+  size_t     pos = 0;
+  int        r, n = 0;
+
+  if (SudsFileOpen (&sf, path) != EW_SUCCESS)
+    return -1;
+  while ((r = SudsNextRec (&sf, &pos, &rec)) == EW_SUCCESS)
+    if (rec.id == id)
+      n++;
+  SudsFileClose (&sf);
+  return (r == SUDS_EOF) ? n : -1;
+}
+
+/* The two files have the same records, bar the contents of those of *
+ * type skip                                                          */
+static int SameRecs (const char *a, const char *b, int skip)
+{
+  SUDS_FILE  fa, fb;
+  SUDS_REC   ra, rb;
+  size_t     pa = 0, pb = 0;
+  int        r, s, ret = EW_SUCCESS;
+
+  if (SudsFileOpen (&fa, a) != EW_SUCCESS)
+    return EW_FAILURE;
+  if (SudsFileOpen (&fb, b) != EW_SUCCESS)
+  {
+    SudsFileClose (&fa);
+    return EW_FAILURE;
+  }
+  while ((r = SudsNextRec (&fa, &pa, &ra)) == EW_SUCCESS
+         && (s = SudsNextRec (&fb, &pb, &rb)) == EW_SUCCESS)
+  {
+    if (ra.id != rb.id || ra.len_struct != rb.len_struct
+        || ra.len_data != rb.len_data
+        || (ra.id != skip
+            && (memcmp (ra.Struct, rb.Struct, ra.len_struct) != 0
+                || memcmp (ra.Data, rb.Data, ra.len_data) != 0)))
+    {
+      fprintf (stderr, "record %d at %lu differs\n", ra.id,
+               (unsigned long) ra.Offset);
+      ret = EW_FAILURE;
+      break;
+    }
+  }
+  if (ret == EW_SUCCESS
+      && (r != SUDS_EOF || SudsNextRec (&fb, &pb, &rb) != SUDS_EOF))
+    ret = EW_FAILURE;
+  SudsFileClose (&fa);
+  SudsFileClose (&fb);
+  return ret;
+}
+
+
+/*
+ *  RSAM alarms
+ */
+
+/* The engine's event alarms for the reference amplitudes match the *
+ * reference file's header and first alarms                          */
+static int CheckRsam (const char *outdir, const char *datadir)
+{
+  SUDS_RSAM  *rs;
+  char        out[256], ref[256], got[4096], want[4096];
+  long        ngot, nwant;
+  int         i, r, ret = EW_SUCCESS;
+
+  snprintf (out, sizeof (out), "%s/rsam_event_alarms.csv", outdir);
+  snprintf (ref, sizeof (ref), "%s/rsam_event_alarms.csv", datadir);
+  remove (out);
+  if ((rs = SudsRsamCreate ()) == NULL)
+    return EW_FAILURE;
+  for (i = 0; i < RSAM_NSTA && ret == EW_SUCCESS; i++)
+    ret = SudsRsamAddStation (rs, RsamSta[i], NULL, NULL, RsamThresh[i], 0.0);
+  if (ret == EW_SUCCESS)
+    ret = SudsRsamOpen (rs, out, NULL, NULL);
+
+  /* A quiet second long before, so every station has data when the *
+   * first alarm's second is judged; then each alarm's second and    *
+   * the next, which is what gets it judged                          */
+  for (i = 0; i < RSAM_NSTA && ret == EW_SUCCESS; i++)
+    if (RsamAmp[0][i] > 0)
+      ret = RsamSecond (rs, i, RsamTime[0] - RSAM_WARMUP, 1);
+  for (r = 0; r < RSAM_NROW && ret == EW_SUCCESS; r++)
+  {
+    for (i = 0; i < RSAM_NSTA && ret == EW_SUCCESS; i++)
+      if (RsamAmp[r][i] > 0)
+        ret = RsamSecond (rs, i, RsamTime[r] - 1, RsamAmp[r][i]);
+    for (i = 0; i < RSAM_NSTA && ret == EW_SUCCESS; i++)
+      if (RsamAmp[r][i] > 0)
+        ret = RsamSecond (rs, i, RsamTime[r], RsamAmp[r][i]);
+  }
+  if (SudsRsamDestroy (rs) != EW_SUCCESS || ret != EW_SUCCESS)
+    return EW_FAILURE;
+
+  ngot = ReadHead (out, got, sizeof (got), 1 + RSAM_NROW + 1);
+  nwant = ReadHead (ref, want, sizeof (want), 1 + RSAM_NROW);
+  if (ngot < 0 || nwant < 0 || ngot != nwant || memcmp (got, want, ngot) != 0)
+  {
+    fprintf (stderr, "%s isn't the first %d lines of %s\n", out,
+             1 + RSAM_NROW, ref);
+    return EW_FAILURE;
+  }
+  return EW_SUCCESS;
+}
+
+/* One second of station i from t: a 100 sps square wave of +-amp, *
+ * whose mean absolute amplitude is amp whatever the DC tracked     */
+static int RsamSecond (SUDS_RSAM *rs, int i, long t, int amp)
+{
+  TRACE_HEADER  wf;
+  short         x[(int) REG_RATE];
+  int           j;
+
+  memset (&wf, 0, sizeof (wf));
+  wf.nsamp = (int) REG_RATE;
+  wf.samprate = REG_RATE;
+  wf.starttime = (double) t;
+  wf.endtime = t + (wf.nsamp - 1) / REG_RATE;
+  strcpy (wf.sta, RsamSta[i]);
+  strcpy (wf.datatype, "i2");
+  for (j = 0; j < wf.nsamp; j++)
+    x[j] = (short) ((j % 2) ? -amp : amp);
+  return SudsRsamFeed (rs, i, &wf, x, 's');
+}
+
+/* Up to the first nline lines of path into buf; their length, or -1 */
+static long ReadHead (const char *path, char *buf, long size, int nline)
+{
+  FILE  *fp;
+  long   n = 0;
+  int    c;
+
+  if ((fp = fopen (path, "r")) == NULL)
+  {
+    perror (path);
+    return -1;
+  }
+  while (nline > 0 && n < size && (c = getc (fp)) != EOF)
+    if ((buf[n++] = (char) c) == '\n')
+      nline--;
+  fclose (fp);
+  return n;
+}
+
+static void FreeFile (REG_FILE *rf)
+{
+  int  c;
+
+  for (c = 0; c < REG_NCH; c++)
+    free (rf->samples[c]);
+  memset (rf, 0, sizeof (REG_FILE));
+}
+
+/* Print a check's result; 1 if it failed */
+static int Report (const char *check, const char *what, int ret)
+{
+  printf ("%-8s %-14s %s\n", check, what, (ret == EW_SUCCESS) ? "ok" : "FAIL");
+  return ret != EW_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/* stubs.c
+
+        Stand-ins for the Earthworm library calls the SUDS putaway
+        routines make, so sudsbench links without an Earthworm
+        installation; see sudsbench.c.
+
+   logit formats its message, as Earthworm's does, but prints it only
+   if BenchVerbose is set (sudsbench -v), so that a run with gaps isn't
+   timing the terminal. malloc, calloc and realloc are counted
+   through the linker's --wrap.
+*/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <earthworm.h>
+#include <swap.h>
+#include <time_ew.h>
+
+/* 4-byte integer samples are 4 bytes, as in Earthworm's trace_buf.h */
+#define I4_SIZE  4
+
+unsigned long BenchAllocs;             /* malloc, calloc and realloc calls */
+int           BenchVerbose;
+
+void *__real_malloc (size_t size);
+void *__real_calloc (size_t n, size_t size);
+void *__real_realloc (void *p, size_t size);
+
+void *__wrap_malloc (size_t size)
+{
+  __sync_fetch_and_add (&BenchAllocs, 1);
+  return __real_malloc (size);
+}
+
+void *__wrap_calloc (size_t n, size_t size)
+{
+  __sync_fetch_and_add (&BenchAllocs, 1);
+  return __real_calloc (n, size);
+}
+
+void *__wrap_realloc (void *p, size_t size)
+{
+  __sync_fetch_and_add (&BenchAllocs, 1);
+  return __real_realloc (p, size);
+}
+
+void logit (const char *flag, const char *format, ...)
+{
+  char     msg[1024];
+  va_list  ap;
+
+  va_start (ap, format);
+  vsnprintf (msg, sizeof (msg), format, ap);
+  va_end (ap);
+  if (BenchVerbose)
+    fprintf (stderr, "%s", msg);
+}
+
+void logit_init (const char *prog, short mid, int bufSize, int logflag)
+{
+}
+
+int CreateDir (char *dirName)
+{
+  if (mkdir (dirName, 0755) != 0 && errno != EEXIST)
+    return EW_FAILURE;
+  return EW_SUCCESS;
+}
+
+void sleep_ew (unsigned milliseconds)
+{
+  usleep (milliseconds * 1000);
+}
+
+struct tm *gmtime_ew (const time_t *epochsec, struct tm *res)
+{
+  return gmtime_r (epochsec, res);
+}
+
+static void Reverse (void *data, size_t n)
+{
+  unsigned char *b = (unsigned char *) data;
+  unsigned char  t;
+  size_t         i;
+
+  for (i = 0; i < n / 2; i++)
+  {
+    t = b[i];
+    b[i] = b[n - 1 - i];
+    b[n - 1 - i] = t;
+  }
+}
+
+void SwapShort (short *data)   { Reverse (data, 2); }
+void SwapInt (int *data)       { Reverse (data, 4); }
+void SwapInt32 (int *data)     { Reverse (data, 4); }
+void SwapLong (long *data)     { Reverse (data, 4); }
+void SwapFloat (float *data)   { Reverse (data, 4); }
+void SwapDouble (double *data) { Reverse (data, 8); }
+
+int WaveMsgMakeLocal (TRACE_HEADER *wvmsg)
+{
+  static const int  one = 1;
+  char    local = *(const char *) &one ? 'i' : 's';
+  char    order;
+  size_t  size;
+  char   *p;
+  int     i;
+
+  switch (wvmsg->datatype[0])
+  {
+    case 'i': case 's': order = wvmsg->datatype[0];                    break;
+    case 'f': order = 'i';                                             break;
+    case 't': order = 's';                                             break;
+    default:  return -1;
+  }
+  if (wvmsg->datatype[1] == '2' && wvmsg->datatype[0] != 'f'
+      && wvmsg->datatype[0] != 't')
+    size = 2;
+  else if (wvmsg->datatype[1] == '4')
+    size = (wvmsg->datatype[0] == 'f' || wvmsg->datatype[0] == 't')
+           ? 4 : I4_SIZE;
+  else
+    return -1;
+  if (order == local)
+    return 0;
+
+  SwapInt (&wvmsg->pinno);
+  SwapInt (&wvmsg->nsamp);
+  SwapDouble (&wvmsg->starttime);
+  SwapDouble (&wvmsg->endtime);
+  SwapDouble (&wvmsg->samprate);
+  p = (char *) (wvmsg + 1);
+  for (i = 0; i < wvmsg->nsamp; i++, p += size)
+    Reverse (p, size);
+  if (wvmsg->datatype[0] == 'i' || wvmsg->datatype[0] == 's')
+    wvmsg->datatype[0] = local;
+  else
+    wvmsg->datatype[0] = (local == 'i') ? 'f' : 't';
+  return 0;
+}
@@ -0,0 +1,27 @@
+/*
+ *   earthworm.h (sudsbench stub)
+ *
+ *   Just what the SUDS putaway routines use of the real earthworm.h, so
+ *   that sudsbench builds without an Earthworm installation.
+ */
+
+#ifndef EARTHWORM_H
+#define EARTHWORM_H
+
+#define EW_SUCCESS    0
+#define EW_FAILURE   -1
+#define EW_WARNING    2
+
+/* let the compiler check logit's arguments against its format */
+#ifdef __GNUC__
+#define EW_PRINTF_FORMAT(f, a)  __attribute__ ((format (printf, f, a)))
+#else
+#define EW_PRINTF_FORMAT(f, a)
+#endif
+
+void logit (const char *flag, const char *format, ...) EW_PRINTF_FORMAT (2, 3);
+void logit_init (const char *prog, short mid, int bufSize, int logflag);
+int CreateDir (char *dirName);
+void sleep_ew (unsigned milliseconds);
+
+#endif
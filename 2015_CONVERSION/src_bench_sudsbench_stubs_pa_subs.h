@@ -0,0 +1,10 @@
+/*
+ *   pa_subs.h (sudsbench stub)
+ */
+
+#ifndef PA_SUBS_H
+#define PA_SUBS_H
+
+#define EVENTID_SIZE  50
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ *   putaway.h (sudsbench stub)
+ *
+ *   The SUDS entries of Earthworm's putaway.h.
+ */
+
+#ifndef PUTAWAY_H
+#define PUTAWAY_H
+
+#include <ws_clientII.h>
+
+int SUDSPA_init (int OutBufferLen, char *OutDir, char *OutputFormat,
+                 int debug);
+int SUDSPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq, char *OutDir,
+                    char *EventDate, char *EventTime, char *EventSubnet,
+                    int debug);
+int SUDSPA_next (TRACE_REQ *getThis, double GapThresh, long OutBufferLen,
+                 int debug);
+int SUDSPA_end_ev (int debug);
+int SUDSPA_close (int debug);
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ *   sudshead.h (sudsbench stub)
+ *
+ *   The PC-SUDS structures the putaway routines write, as in
+ *   Earthworm's sudshead.h, but with every long an int32_t and the
+ *   padding a compiler would put in spelled out, so that a struct is
+ *   the same on any machine. That is only their layout in memory; in
+ *   the file they are packed as PC-SUDS packs them (sudsswap.h).
+ */
+
+#ifndef SUDSHEAD_H
+#define SUDSHEAD_H
+
+#include <stdint.h>
+
+#define STATIDENT        1             /* structure ids */
+#define STRUCTTAG        2
+#define TERMINATOR       3
+#define STATIONCOMP      5
+#define MUXDATA          6
+#define DESCRIPTRACE     7
+#define COMMENT         20
+#define TRIGGERS        25
+#define DETECTOR        28
+#define TIMECORRECTION  30
+
+typedef struct
+{
+  char    network[4];
+  char    st_name[5];
+  char    component;
+  short   inst_type;
+} SUDS_STATIDENT;
+
+typedef struct
+{
+  char    sync;
+  char    machine;
+  short   id_struct;
+  int32_t len_struct;
+  int32_t len_data;
+} SUDS_STRUCTTAG;
+
+typedef struct
+{
+  SUDS_STATIDENT sc_name;
+  short   azim;
+  short   incid;
+  double  st_lat;
+  double  st_long;
+  float   elev;
+  char    enclosure;
+  char    annotation;
+  char    recorder;
+  char    rockclass;
+  short   rocktype;
+  char    sitecondition;
+  char    sensor_type;
+  char    data_type;
+  char    data_units;
+  char    polarity;
+  char    st_status;
+  float   max_gain;
+  float   clip_value;
+  float   con_mvolts;
+  short   channel;
+  short   atod_gain;
+  int32_t effective;
+  float   clock_correct;
+  float   station_delay;
+  char    pad[4];
+} SUDS_STATIONCOMP;
+
+typedef struct
+{
+  SUDS_STATIDENT dt_name;
+  char    pad[4];
+  double  begintime;
+  short   localtime;
+  char    datatype;
+  char    descriptor;
+  short   digi_by;
+  short   processed;
+  int32_t length;
+  float   rate;
+  float   mindata;
+  float   maxdata;
+  float   avenoise;
+  int32_t numclip;
+  double  time_correct;
+  float   rate_correct;
+  char    pad2[4];
+} SUDS_DESCRIPTRACE;
+
+typedef struct
+{
+  char    netname[4];
+  char    pad[4];
+  double  begintime;
+  short   loctime;
+  short   numchans;
+  float   dig_rate;
+  char    typedata;
+  char    descript;
+  short   spareG;
+  int32_t numsamps;
+  int32_t blocksize;
+  char    pad2[4];
+} SUDS_MUXDATA;
+
+typedef struct
+{
+  SUDS_STATIDENT tr_name;
+  short   sta;
+  short   lta;
+  short   abs_sta;
+  short   abs_lta;
+  short   trig_value;
+  short   num_triggers;
+  double  trig_time;
+} SUDS_TRIGGERS;
+
+typedef struct
+{
+  char    dalgorithm;
+  char    event_type;
+  char    net_node_id[10];
+  float   versionnum;
+  int32_t event_number;
+  int32_t spareL;
+} SUDS_DETECTOR;
+
+typedef struct
+{
+  SUDS_STATIDENT tm_name;
+  char    pad[4];
+  double  time_correct;
+  float   rate_correct;
+  char    sync_code;
+  char    program;
+  char    pad2[2];
+  int32_t effective_time;
+  short   spareM;
+  char    pad3[2];
+} SUDS_TIMECORRECTION;
+
+typedef struct
+{
+  short   refer;
+  short   item;
+  short   length;
+  short   unused;
+} SUDS_COMMENT;
+
+/* No padding but what is spelled out above (these fail to compile if not) */
+typedef char SUDS_TAG_SIZE_CHECK[(sizeof (SUDS_STRUCTTAG) == 12) ? 1 : -1];
+typedef char SUDS_DT_SIZE_CHECK[(sizeof (SUDS_DESCRIPTRACE) == 72) ? 1 : -1];
+typedef char SUDS_TC_SIZE_CHECK[(sizeof (SUDS_TIMECORRECTION) == 40) ? 1 : -1];
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ *   swap.h (sudsbench stub)
+ *
+ *   Byte swapping as in Earthworm's swap.h. SwapLong swaps the first
+ *   four bytes of its argument, as Earthworm's does.
+ */
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <trace_buf.h>
+
+void SwapShort (short *data);
+void SwapInt (int *data);
+void SwapInt32 (int *data);
+void SwapLong (long *data);
+void SwapFloat (float *data);
+void SwapDouble (double *data);
+
+/* Put a TRACE_BUF (header and samples) into local byte order; -1 for *
+ * an unknown datatype                                                 */
+int WaveMsgMakeLocal (TRACE_HEADER *wvmsg);
+
+#endif
@@ -0,0 +1,12 @@
+/*
+ *   time_ew.h (sudsbench stub)
+ */
+
+#ifndef TIME_EW_H
+#define TIME_EW_H
+
+#include <time.h>
+
+struct tm *gmtime_ew (const time_t *epochsec, struct tm *res);
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ *   trace_buf.h (sudsbench stub)
+ *
+ *   The TRACE_BUF header as in Earthworm's trace_buf.h.
+ */
+
+#ifndef TRACE_BUF_H
+#define TRACE_BUF_H
+
+#define TRACE_STA_LEN   7
+#define TRACE_NET_LEN   9
+#define TRACE_CHAN_LEN  9
+
+typedef struct
+{
+  int     pinno;                       /* pin number */
+  int     nsamp;                       /* samples in this packet */
+  double  starttime;                   /* time of first sample, epoch seconds */
+  double  endtime;                     /* time of last sample */
+  double  samprate;                    /* samples a second */
+  char    sta[TRACE_STA_LEN];
+  char    net[TRACE_NET_LEN];
+  char    chan[TRACE_CHAN_LEN];
+  char    datatype[3];                 /* i2, i4, s2, s4, f4, t4 */
+  char    quality[2];
+  char    pad[2];
+} TRACE_HEADER;
+
+#endif
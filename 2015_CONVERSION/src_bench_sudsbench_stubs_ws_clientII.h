@@ -0,0 +1,33 @@
+/*
+ *   ws_clientII.h (sudsbench stub)
+ *
+ *   The TRACE_REQ snippet request as in Earthworm's ws_clientII.h.
+ */
+
+#ifndef WS_CLIENTII_H
+#define WS_CLIENTII_H
+
+#include <trace_buf.h>
+
+typedef struct
+{
+  char          sta[TRACE_STA_LEN];
+  char          chan[TRACE_CHAN_LEN];
+  char          net[TRACE_NET_LEN];
+  long          pinno;
+  double        reqStarttime;
+  double        reqEndtime;
+  int           partial;
+  char         *pBuf;                  /* TRACE_BUF packets, one after another */
+  unsigned long bufLen;
+  long          timeout;
+  long          fill;
+  char          retFlag;
+  double        waitSec;
+  double        actStarttime;
+  double        actEndtime;
+  long          actLen;                /* bytes of packets in pBuf */
+  double        samprate;
+} TRACE_REQ;
+
+#endif
@@ -0,0 +1,629 @@
+/* sudsbench.c
+
+        Microbenchmark of the SUDS putaway path (SUDSPA_next_ev, one
+        SUDSPA_next per channel, SUDSPA_end_ev), built without Earthworm
+        from the stub headers. The sources include the headers by their
+        Earthworm names, so link them under those names first; from
+        2015_CONVERSION:
+
+   mkdir -p /tmp/sb/stubs /tmp/sb/include
+   for h in src_bench_sudsbench_stubs_*.h; do
+      ln -sf "$PWD/$h" /tmp/sb/stubs/${h#src_bench_sudsbench_stubs_}; done
+   for h in include_*.h; do
+      ln -sf "$PWD/$h" /tmp/sb/include/${h#include_}; done
+   cc -O2 -I/tmp/sb/stubs -I/tmp/sb/include -o sudsbench \
+      src_bench_sudsbench_sudsbench.c src_bench_sudsbench_stubs.c \
+      src_libsrc_util_suds*.c src_libsrc_util_mseedputaway.c \
+      -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc -lpthread -lm
+
+   usage: sudsbench [-d types] [-f formats] [-p patterns] [-c channels]
+                    [-e events] [-s seconds] [-r rate] [-n packet]
+                    [-o outdir] [-m metrics] [-t threads] [-b capMB] [-H]
+                    [-w io] [-a cpu] [-v]
+
+   Each mode is a datatype (i2 i4 f4 s2 s4 t4: the s and t types are
+   big-endian, so they are swapped on the way in on an Intel host), an
+   output format (intel sparc), a gap pattern and a channel count; all
+   the combinations of the comma-separated lists given are run. The
+   snippets are made up once per mode, the same every run: each
+   channel is seconds*rate samples of a random walk from a fixed seed,
+   in TRACE_BUF packets of the given length, and the pattern is
+
+        contig   every packet follows on from the last
+        gap      every 10th packet starts 5 samples late
+        overlap  every 10th packet starts half a packet early
+
+   For each mode there is an event to warm up, then events timings,
+   each the mean of as many events as take 20 ms or more. Every event
+   is written over the same .dmx in outdir (put it on tmpfs for numbers
+   that don't depend on the disk). The packets are copied back into
+   the snippet buffers, untimed, before each event, since
+   WaveMsgMakeLocal swaps them in place. Messages the putaway routines
+   log are formatted but only printed with -v. Reported per mode, from
+   the median timing:
+
+        Msamp/s      samples a second, in millions
+        MB/s         TRACE_BUF bytes a second (headers and samples)
+        allocs/ev    malloc, calloc and realloc calls per event
+        syscalls/ev  read and write system calls per event (Linux
+                     /proc/self/io syscr + syscw; - if not available)
+        spread       interquartile range of the timings / median, in %
+
+   A spread over a few percent means the numbers are noisy; run more
+   events, pin the benchmark to an idle CPU (-a, Linux only), or use a
+   quieter machine.
+
+   With -m, the writer keeps metrics (sudsmetrics.h) as it goes, which
+   shows what they cost, and they are written at the end to
+   metrics.prom and metrics.json.
+
+   With -t, each event's channels go through SUDSPA_next_batch on that
+   many threads instead of one SUDSPA_next each. With -b or -H, the
+   writer takes its sample buffers from a pool of the bench's own
+   (sudsbufpool.h), capped at capMB megabytes and with big buffers on
+   hugepages if -H; a line after each mode then says how much the pool
+   held at most and how often it waited or went over the cap.
+
+   -w picks how the .dmx is written (sudsio.h): stdio (the default),
+   writev or direct.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <earthworm.h>
+#include <trace_buf.h>
+#include <ws_clientII.h>
+#include <putaway.h>
+#include <sudswriter.h>
+
+#define BENCH_GAPTHRESH   1.5
+#define BENCH_EVERY       10           /* packets between gaps or overlaps */
+#define BENCH_GAPLEN      5            /* samples */
+#define BENCH_MAXLIST     32
+#define BENCH_MINSEC      0.02         /* least time taken for one timing */
+#define BENCH_I4_SIZE     sizeof (int32_t)   /* as the putaway routines take i4 */
+
+extern unsigned long BenchAllocs;      /* counted in stubs.c */
+extern int BenchVerbose;               /* print what is logged */
+
+enum { CONTIG, GAP, OVERLAP };
+static const char *Patterns[] = { "contig", "gap", "overlap" };
+
+/* One mode's snippets */
+typedef struct
+{
+  int        nch;
+  TRACE_REQ *req;
+  char     **pristine;                 /* each channel's packets as made */
+  long       bytes;                    /* packet bytes, all channels */
+  long       nsamp;                    /* samples, all channels */
+  long       maxch;                    /* most samples a channel writes */
+} BENCH_SET;
+
+typedef struct
+{
+  char   *types[BENCH_MAXLIST], *formats[BENCH_MAXLIST], *patterns[BENCH_MAXLIST];
+  int     ntypes, nformats, npatterns;
+  int     channels[BENCH_MAXLIST];
+  int     nchannels;
+  int     events;
+  double  seconds, rate;
+  int     pktlen;
+  char   *outdir;
+  SUDS_METRICS *metrics;                /* NULL for none */
+  int     threads;                      /* SUDSPA_next_batch; 0 for SUDSPA_next */
+  double  capmb;                        /* buffer pool cap; 0 for none */
+  int     huge;                         /* buffer pool on hugepages */
+  int     pool;                         /* use a buffer pool of our own */
+  int     io;                           /* SUDS_IO_XXX */
+} BENCH_ARGS;
+
+/* Internal Function Prototypes */
+static int RunMode (BENCH_ARGS *, const char *, const char *, int, int);
+static int OneEvent (BENCH_SET *, BENCH_ARGS *, long, double *,
+                     unsigned long *, long *);
+static int MakeSet (BENCH_SET *, BENCH_ARGS *, const char *, int, int);
+static void FreeSet (BENCH_SET *);
+static void PutSample (char *, const char *, long);
+static void Reverse (void *, size_t);
+static void PacketOrder (TRACE_HEADER *, int);
+static int SampleSize (const char *);
+static long Syscalls (void);
+static double Now (void);
+static int CompareDouble (const void *, const void *);
+static int Split (char *, char **);
+static int IoMode (const char *);
+static void Usage (const char *);
+
+int main (int argc, char **argv)
+{
+  BENCH_ARGS  ba;
+  char       *list[BENCH_MAXLIST];
+  char        types[] = "i2,i4,f4,s2,s4,t4", formats[] = "intel,sparc";
+  char        patterns[] = "contig,gap,overlap", channels[] = "1,16,256";
+  char       *chanlist = channels;
+  char       *mprefix = NULL;
+  char        prom[256], json[256];
+  int         t, f, p, c, i, n, cpu = -1, ret = 0;
+
+  memset (&ba, 0, sizeof (ba));
+  ba.ntypes = Split (types, ba.types);
+  ba.nformats = Split (formats, ba.formats);
+  ba.npatterns = Split (patterns, ba.patterns);
+  ba.events = 20;
+  ba.seconds = 60.0;
+  ba.rate = 100.0;
+  ba.pktlen = 100;
+  ba.outdir = "sudsbench.out";
+
+  while ((c = getopt (argc, argv, "d:f:p:c:e:s:r:n:o:m:t:b:Hw:a:v")) != -1)
+  {
+    switch (c)
+    {
+      case 'd': ba.ntypes = Split (optarg, ba.types);         break;
+      case 'f': ba.nformats = Split (optarg, ba.formats);     break;
+      case 'p': ba.npatterns = Split (optarg, ba.patterns);   break;
+      case 'c': chanlist = optarg;                            break;
+      case 'e': ba.events = atoi (optarg);                    break;
+      case 's': ba.seconds = atof (optarg);                   break;
+      case 'r': ba.rate = atof (optarg);                      break;
+      case 'n': ba.pktlen = atoi (optarg);                    break;
+      case 'o': ba.outdir = optarg;                           break;
+      case 'm': mprefix = optarg;                             break;
+      case 't': ba.threads = atoi (optarg);                   break;
+      case 'b': ba.capmb = atof (optarg); ba.pool = 1;        break;
+      case 'H': ba.huge = 1; ba.pool = 1;                     break;
+      case 'w': ba.io = IoMode (optarg);                      break;
+      case 'v': BenchVerbose = 1;                             break;
+      case 'a': cpu = atoi (optarg);                          break;
+      default:  Usage (argv[0]);
+    }
+  }
+  n = Split (chanlist, list);
+  for (i = 0; i < n; i++)
+    if ((ba.channels[ba.nchannels++] = atoi (list[i])) < 1)
+      Usage (argv[0]);
+  if (optind != argc || ba.io < 0 || ba.events < 1 || ba.pktlen < 2
+      || ba.rate <= 0.0 || ba.seconds * ba.rate < ba.pktlen)
+    Usage (argv[0]);
+  for (t = 0; t < ba.ntypes; t++)
+    if (SampleSize (ba.types[t]) == 0)
+      Usage (argv[0]);
+  for (p = 0; p < ba.npatterns; p++)
+  {
+    for (i = 0; i < 3 && strcmp (ba.patterns[p], Patterns[i]) != 0; i++)
+      ;
+    if (i == 3)
+      Usage (argv[0]);
+  }
+
+  if (cpu >= 0)
+  {
+#ifdef __linux__
+    cpu_set_t  set;
+
+    CPU_ZERO (&set);
+    CPU_SET (cpu, &set);
+    if (sched_setaffinity (0, sizeof (set), &set) != 0)
+      perror ("sudsbench: sched_setaffinity");
+#else
+    fprintf (stderr, "sudsbench: -a is only for Linux\n");
+#endif
+  }
+
+  if (mprefix != NULL)
+  {
+    snprintf (prom, sizeof (prom), "%s.prom", mprefix);
+    snprintf (json, sizeof (json), "%s.json", mprefix);
+    if ((ba.metrics = SudsMetricsCreate (prom, json, 0)) == NULL)
+      return 1;
+  }
+
+  printf ("%-4s %-6s %-8s %4s %10s %9s %10s %12s %7s\n", "type", "format",
+          "pattern", "nch", "Msamp/s", "MB/s", "allocs/ev", "syscalls/ev",
+          "spread");
+  for (t = 0; t < ba.ntypes; t++)
+    for (f = 0; f < ba.nformats; f++)
+      for (p = 0; p < ba.npatterns; p++)
+        for (c = 0; c < ba.nchannels; c++)
+        {
+          for (i = 0; strcmp (ba.patterns[p], Patterns[i]) != 0; i++)
+            ;
+          if (RunMode (&ba, ba.types[t], ba.formats[f], i, ba.channels[c])
+              != EW_SUCCESS)
+            ret = 1;
+        }
+  if (SudsMetricsDestroy (ba.metrics) != EW_SUCCESS)
+    ret = 1;
+  return ret;
+}
+
+/* Time one mode and print its line */
+static int RunMode (BENCH_ARGS *ba, const char *type, const char *format,
+                    int pattern, int nch)
+{
+  BENCH_SET      set;
+  SUDS_BUFPOOL  *pool = NULL;
+  SUDS_BUFSTATS  bs;
+  double        *sec, dt, med;
+  unsigned long  allocs = 0;
+  long           sys = 0, buflen;
+  int            ev, r, reps, ret;
+
+  if (MakeSet (&set, ba, type, pattern, nch) != EW_SUCCESS)
+    return EW_FAILURE;
+  sec = (double *) malloc (ba->events * sizeof (double));
+  buflen = 2 * set.maxch * (long) sizeof (int32_t);
+  if (ba->pool)
+    pool = SudsBufPoolCreate ((size_t) (ba->capmb * 1048576.0), ba->huge);
+  if (sec == NULL || (ba->pool && pool == NULL)
+      || SUDSPA_init ((int) buflen, ba->outdir, (char *) format, 0)
+         != EW_SUCCESS
+      || SUDSPA_set_io (ba->io) != EW_SUCCESS
+      || SUDSPA_set_metrics (ba->metrics) != EW_SUCCESS
+      || SUDSPA_set_buffers (pool) != EW_SUCCESS)
+  {
+    fprintf (stderr, "sudsbench: can't set up %s %s\n", type, format);
+    free (sec);
+    SudsBufPoolDestroy (pool);
+    FreeSet (&set);
+    return EW_FAILURE;
+  }
+
+  /* The warm-up event says how many events make up one timing, so *
+   * that a timing is never so short the clock's jitter shows       */
+  ret = OneEvent (&set, ba, buflen, &dt, &allocs, &sys);
+  reps = (dt < BENCH_MINSEC) ? (int) (BENCH_MINSEC / (dt + 1e-9)) + 1 : 1;
+  for (ev = 0; ev < ba->events && ret == EW_SUCCESS; ev++)
+  {
+    sec[ev] = 0.0;
+    for (r = 0; r < reps && ret == EW_SUCCESS; r++)
+    {
+      ret = OneEvent (&set, ba, buflen, &dt, &allocs, &sys);
+      sec[ev] += dt;
+    }
+    sec[ev] /= reps;
+  }
+  SUDSPA_close (0);
+
+  if (ret != EW_SUCCESS)
+    fprintf (stderr, "sudsbench: %s %s %s %d failed\n", type, format,
+             Patterns[pattern], nch);
+  else
+  {
+    qsort (sec, ba->events, sizeof (double), CompareDouble);
+    med = sec[ba->events / 2];
+    printf ("%-4s %-6s %-8s %4d %10.2f %9.1f %10lu ", type, format,
+            Patterns[pattern], nch, set.nsamp / med * 1e-6,
+            set.bytes / med / 1048576.0, allocs);
+    if (sys < 0)
+      printf ("%12s", "-");
+    else
+      printf ("%12ld", sys);
+    printf (" %6.1f%%\n", 100.0 * (sec[(3 * ba->events) / 4]
+                                    - sec[ba->events / 4]) / med);
+    if (pool != NULL)
+    {
+      SudsBufPoolStats (pool, &bs);
+      printf ("     buffers: %.1f MB at most, %ld of %ld reused, %ld waits, "
+              "%ld over the cap, %ld on hugepages\n", bs.Peak / 1048576.0,
+              bs.Reused, bs.Gets, bs.Waits, bs.Overdrafts, bs.Huge);
+    }
+    fflush (stdout);
+  }
+  SudsBufPoolDestroy (pool);
+  free (sec);
+  FreeSet (&set);
+  return ret;
+}
+
+/* Write one event of set's channels; its time, allocations and system *
+ * calls (-1 if they can't be counted)                                  */
+static int OneEvent (BENCH_SET *set, BENCH_ARGS *ba, long buflen,
+                     double *sec, unsigned long *allocs, long *sys)
+{
+  static long  cal = -1;
+  unsigned long  a0;
+  long    s0;
+  double  t0;
+  int     c, ret = EW_SUCCESS;
+
+  /* what reading the counter costs */
+  if (cal < 0 && (s0 = Syscalls ()) >= 0)
+    cal = Syscalls () - s0;
+
+  for (c = 0; c < set->nch; c++)
+    memcpy (set->req[c].pBuf, set->pristine[c], set->req[c].actLen);
+
+  a0 = BenchAllocs;
+  s0 = Syscalls ();
+  t0 = Now ();
+  if (SUDSPA_next_ev ("1", set->req, set->nch, ba->outdir, "20000101",
+                      "000000", "BENCH", 0) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  if (ba->threads > 0)
+  {
+    if (ret == EW_SUCCESS
+        && SUDSPA_next_batch (set->req, set->nch, BENCH_GAPTHRESH, buflen,
+                              ba->threads, 0) != EW_SUCCESS)
+      ret = EW_FAILURE;
+  }
+  else
+    for (c = 0; c < set->nch && ret == EW_SUCCESS; c++)
+      if (SUDSPA_next (&set->req[c], BENCH_GAPTHRESH, buflen, 0) != EW_SUCCESS)
+        ret = EW_FAILURE;
+  if (SUDSPA_end_ev (0) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  *sec = Now () - t0;
+  *sys = (s0 < 0) ? -1 : Syscalls () - s0 - cal;
+  *allocs = BenchAllocs - a0;
+  return ret;
+}
+
+
+/*
+ *  Synthetic snippets
+ */
+
+/* Make nch channels of type's packets with the given gap pattern */
+static int MakeSet (BENCH_SET *set, BENCH_ARGS *ba, const char *type,
+                    int pattern, int nch)
+{
+  TRACE_HEADER *wf;
+  TRACE_REQ    *r;
+  long    nsamp = (long) (ba->seconds * ba->rate);
+  long    npkt = (nsamp + ba->pktlen - 1) / ba->pktlen;
+  long    k, j, n, done, fill;
+  int     size = SampleSize (type);
+  int     c;
+  double  t;
+  char   *p;
+  unsigned int  seed;
+  long    value;
+
+  memset (set, 0, sizeof (BENCH_SET));
+  set->nch = nch;
+  set->req = (TRACE_REQ *) calloc (nch, sizeof (TRACE_REQ));
+  set->pristine = (char **) calloc (nch, sizeof (char *));
+  if (set->req == NULL || set->pristine == NULL)
+    return EW_FAILURE;
+
+  for (c = 0; c < nch; c++)
+  {
+    r = &set->req[c];
+    if ((r->pBuf = (char *) malloc (npkt * (sizeof (TRACE_HEADER)
+                                            + ba->pktlen * size))) == NULL
+        || (set->pristine[c] = (char *) malloc (npkt * (sizeof (TRACE_HEADER)
+                                            + ba->pktlen * size))) == NULL)
+    {
+      FreeSet (set);
+      return EW_FAILURE;
+    }
+    sprintf (r->sta, "B%03d", c % 1000);
+    strcpy (r->chan, "SHZ");
+    strcpy (r->net, "MV");
+
+    seed = 12345u + c;
+    value = 0;
+    t = 946684800.0;                   /* 2000-01-01 */
+    fill = 0;
+    p = set->pristine[c];
+    for (k = 0, done = 0; done < nsamp; k++, done += n)
+    {
+      n = (nsamp - done < ba->pktlen) ? nsamp - done : ba->pktlen;
+      if (k > 0 && k % BENCH_EVERY == 0)
+      {
+        if (pattern == GAP)
+        {
+          t += BENCH_GAPLEN / ba->rate;
+          fill += BENCH_GAPLEN;
+        }
+        else if (pattern == OVERLAP)
+          t -= (ba->pktlen / 2) / ba->rate;
+      }
+      wf = (TRACE_HEADER *) p;
+      memset (wf, 0, sizeof (TRACE_HEADER));
+      wf->pinno = c;
+      wf->nsamp = (int) n;
+      wf->starttime = t;
+      wf->endtime = t + (n - 1) / ba->rate;
+      wf->samprate = ba->rate;
+      strcpy (wf->sta, r->sta);
+      strcpy (wf->chan, r->chan);
+      strcpy (wf->net, r->net);
+      strcpy (wf->datatype, type);
+      p += sizeof (TRACE_HEADER);
+      for (j = 0; j < n; j++, p += size)
+      {
+        /* a random walk that stays well inside a short */
+        seed = seed * 1103515245u + 12345u;
+        value += (long) ((seed >> 16) & 0xff) - 128;
+        if (value > 30000 || value < -30000)
+          value /= 2;
+        PutSample (p, type, value);
+      }
+      PacketOrder (wf, size);
+      t += n / ba->rate;
+    }
+    r->actLen = (long) (p - set->pristine[c]);
+    r->bufLen = r->actLen;
+    r->samprate = ba->rate;
+    set->bytes += r->actLen;
+    set->nsamp += nsamp;
+    if (nsamp + fill > set->maxch)
+      set->maxch = nsamp + fill;
+  }
+  return EW_SUCCESS;
+}
+
+static void FreeSet (BENCH_SET *set)
+{
+  int  c;
+
+  for (c = 0; c < set->nch; c++)
+  {
+    if (set->req != NULL)
+      free (set->req[c].pBuf);
+    if (set->pristine != NULL)
+      free (set->pristine[c]);
+  }
+  free (set->req);
+  free (set->pristine);
+  memset (set, 0, sizeof (BENCH_SET));
+}
+
+/* Bytes a sample of type takes in a packet; 0 for an unknown type */
+static int SampleSize (const char *type)
+{
+  if (strlen (type) != 2)
+    return 0;
+  if ((type[0] == 'i' || type[0] == 's') && type[1] == '2')
+    return 2;
+  if ((type[0] == 'i' || type[0] == 's') && type[1] == '4')
+    return (int) BENCH_I4_SIZE;
+  if ((type[0] == 'f' || type[0] == 't') && type[1] == '4')
+    return 4;
+  return 0;
+}
+
+/* Store value at p as a local-order sample of type */
+static void PutSample (char *p, const char *type, long value)
+{
+  short    s;
+  int32_t  i;
+  float    f;
+
+  if (type[0] == 'f' || type[0] == 't')
+  {
+    f = (float) value + 0.25f;
+    memcpy (p, &f, sizeof (f));
+  }
+  else if (type[1] == '2')
+  {
+    s = (short) value;
+    memcpy (p, &s, sizeof (s));
+  }
+  else
+  {
+    i = (int32_t) value;
+    memcpy (p, &i, sizeof (i));
+  }
+}
+
+static void Reverse (void *data, size_t n)
+{
+  unsigned char *b = (unsigned char *) data;
+  unsigned char  t;
+  size_t         i;
+
+  for (i = 0; i < n / 2; i++)
+  {
+    t = b[i];
+    b[i] = b[n - 1 - i];
+    b[n - 1 - i] = t;
+  }
+}
+
+/* Swap a packet made in local order if its type is the other order */
+static void PacketOrder (TRACE_HEADER *wf, int size)
+{
+  static const int  one = 1;
+  int     little = *(const char *) &one;
+  char   *p = (char *) (wf + 1);
+  int     j;
+
+  if (little == (wf->datatype[0] == 'i' || wf->datatype[0] == 'f'))
+    return;
+  for (j = 0; j < wf->nsamp; j++, p += size)
+    Reverse (p, size);
+  Reverse (&wf->pinno, sizeof (wf->pinno));
+  Reverse (&wf->nsamp, sizeof (wf->nsamp));
+  Reverse (&wf->starttime, sizeof (double));
+  Reverse (&wf->endtime, sizeof (double));
+  Reverse (&wf->samprate, sizeof (double));
+}
+
+
+/*
+ *  Counters
+ */
+
+/* Read and write system calls so far; -1 if they can't be had */
+static long Syscalls (void)
+{
+  char    buf[512];
+  char   *p;
+  long    n, r = -1, w = -1;
+  int     fd;
+
+  if ((fd = open ("/proc/self/io", O_RDONLY)) < 0)
+    return -1;
+  n = read (fd, buf, sizeof (buf) - 1);
+  close (fd);
+  if (n <= 0)
+    return -1;
+  buf[n] = '\0';
+  if ((p = strstr (buf, "syscr:")) != NULL)
+    r = atol (p + 6);
+  if ((p = strstr (buf, "syscw:")) != NULL)
+    w = atol (p + 6);
+  return (r < 0 || w < 0) ? -1 : r + w;
+}
+
+static double Now (void)
+{
+  struct timespec  ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int CompareDouble (const void *a, const void *b)
+{
+  double  da = *(const double *) a, db = *(const double *) b;
+
+  return (da < db) ? -1 : (da > db);
+}
+
+/* Split a comma-separated list in place */
+static int Split (char *s, char **list)
+{
+  int  n = 0;
+
+  for (s = strtok (s, ","); s != NULL && n < BENCH_MAXLIST;
+       s = strtok (NULL, ","))
+    list[n++] = s;
+  return n;
+}
+
+/* SUDS_IO_XXX for name; -1 if it isn't one */
+static int IoMode (const char *name)
+{
+  if (strcmp (name, "stdio") == 0)
+    return SUDS_IO_STDIO;
+  if (strcmp (name, "writev") == 0)
+    return SUDS_IO_WRITEV;
+  if (strcmp (name, "direct") == 0)
+    return SUDS_IO_DIRECT;
+  return -1;
+}
+
+static void Usage (const char *prog)
+{
+  fprintf (stderr, "usage: %s [-d i2,i4,f4,s2,s4,t4] [-f intel,sparc]\n"
+           "          [-p contig,gap,overlap] [-c 1,16,256] [-e events]\n"
+           "          [-s seconds] [-r rate] [-n packet] [-o outdir]\n"
+           "          [-m metrics] [-t threads] [-b capMB] [-H]\n"
+           "          [-w stdio,writev,direct] [-a cpu] [-v]\n",
+           prog);
+  exit (2);
+}
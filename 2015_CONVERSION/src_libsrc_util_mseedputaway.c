@@ -0,0 +1,638 @@
+/* mseedputaway.c
+
+        Routines for writing trace data as miniSEED; see mseedwriter.h
+
+   The samples of a channel are widened to 32 bits into the run buffer
+   a packet at a time, and SudsSteimDiff takes their differences and
+   width classes as they go in. Whenever the buffer fills, as many full
+   records are packed out of it as it holds and the rest is moved down;
+   at a gap, and at the end of the channel, the rest is packed too.
+
+   A Steim2 data word holds 7 4-bit, 6 5-bit, 5 6-bit, 4 8-bit, 3 10-bit,
+   2 15-bit or 1 30-bit difference; each word takes the first of these
+   that the next differences all fit, which is just a look at the
+   largest of their classes. The first difference in a record is never
+   used by the reader (it starts from X0), so it is written as it is if
+   it fits and as 0 if not; a later one that fits no word ends the
+   record early, and the next record starts at it.
+
+   Records are gathered MSEED_OUTRECS at a time and written with one
+   SudsOutWrite (sudsio.h).
+*/
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <earthworm.h>
+#include <time_ew.h>
+#include <trace_buf.h>
+#include <swap.h>
+#include <ws_clientII.h>
+#include <pa_subs.h>
+#include <sudsconvert.h>
+#include <sudsio.h>
+#include <mseedwriter.h>
+
+#define MSEED_HDR        64            /* header and blockette 1000, padded */
+#define MSEED_FRAME      64            /* bytes in a Steim frame */
+#define MSEED_MAXNSAMP   65535         /* nsamples is 16 bits */
+
+/* Writer behind the MSEEDPA_XXX entry points */
+static  MSEED_WRITER MseedDefault;
+
+/* The Steim2 data word layouts, from the most differences a word down */
+static const struct
+{
+  int   n;                             /* differences in the word */
+  int   bits;                          /* ... each this wide */
+  int   cls;                           /* largest width class that fits */
+  int   ctrl;                          /* control nibble */
+  int   dnib;                          /* top two bits; -1 for none */
+} Steim2Word[] =
+{
+  { 7, 4, 0, 3, 2 },
+  { 6, 5, 1, 3, 1 },
+  { 5, 6, 2, 3, 0 },
+  { 4, 8, 3, 1, -1 },
+  { 3, 10, 4, 2, 3 },
+  { 2, 15, 5, 2, 2 },
+  { 1, 30, 6, 2, 1 }
+};
+#define STEIM2_NWORD  (int) (sizeof (Steim2Word) / sizeof (Steim2Word[0]))
+
+/* Internal Function Prototypes */
+static int OpenEvent (MSEED_WRITER *, const char *, int);
+static int EncodeRun (MSEED_WRITER *, int, int);
+static long PackSteim2 (MSEED_WRITER *, long, long, unsigned char *);
+static long PackInt32 (MSEED_WRITER *, long, long, unsigned char *);
+static void PackHeader (MSEED_WRITER *, unsigned char *, double, long);
+static void RateFactor (double, short *, short *);
+static int FlushRecords (MSEED_WRITER *);
+static void Put16 (unsigned char *, unsigned int);
+static void Put32 (unsigned char *, uint32_t);
+
+/************************************************************************
+* Initialization function: check the record length and encoding, and   *
+* make sure the output directory exists.                                *
+*************************************************************************/
+int MSEEDWR_init (MSEED_WRITER *mw, int RecLen, char *OutDir,
+                  char *OutputFormat, int debug)
+{
+  int  exp;
+
+  if (mw == NULL)
+  {
+    logit ("e", "MSEEDWR_init: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+  memset (mw, 0, sizeof (MSEED_WRITER));
+
+  for (exp = 8; exp <= 16 && (1 << exp) != RecLen; exp++)
+    ;
+  if (exp > 16)
+  {
+    logit ("e", "MSEEDWR_init: record length %d isn't a power of 2 from "
+           "256 to 65536\n", RecLen);
+    return EW_FAILURE;
+  }
+  mw->RecLen = RecLen;
+  mw->RecExp = exp;
+
+  if (OutputFormat == NULL || OutputFormat[0] == '\0'
+      || strcmp (OutputFormat, "steim2") == 0)
+    mw->Encoding = MSEED_STEIM2;
+  else if (strcmp (OutputFormat, "int32") == 0)
+    mw->Encoding = MSEED_INT32;
+  else
+  {
+    logit ("e", "MSEEDWR_init: OutputFormat must be steim2 or int32, not %s\n",
+           OutputFormat);
+    return EW_FAILURE;
+  }
+
+  if ((mw->Samples = (int32_t *) malloc (MSEED_RUNLEN * sizeof (int32_t)))
+      == NULL
+      || (mw->Diff = (int32_t *) malloc (MSEED_RUNLEN * sizeof (int32_t)))
+      == NULL
+      || (mw->Class = (unsigned char *) malloc (MSEED_RUNLEN)) == NULL
+      || (mw->OutBuf = (unsigned char *) malloc (MSEED_OUTRECS * RecLen))
+      == NULL)
+  {
+    logit ("et", "MSEEDWR_init: couldn't malloc buffers\n");
+    MSEEDWR_close (mw, debug);
+    return EW_FAILURE;
+  }
+
+  /* Make sure that the top level output directory exists */
+  if (CreateDir (OutDir) != EW_SUCCESS)
+  {
+    logit ("e", "MSEEDWR_init: Call to CreateDir failed\n");
+    MSEEDWR_close (mw, debug);
+    return EW_FAILURE;
+  }
+
+  SudsConvertInit ();
+  if (debug == 1)
+    logit ("", "MSEEDWR_init: %d byte %s records, %s differencing\n",
+           RecLen, (mw->Encoding == MSEED_STEIM2) ? "steim2" : "int32",
+           SudsConvertName ());
+  return EW_SUCCESS;
+}
+
+/* Choose how event files are written (SUDS_IO_XXX in sudsio.h, but *
+ * not SUDS_IO_ASYNC); takes effect from the next event              */
+int MSEEDWR_set_io (MSEED_WRITER *mw, int IoMode)
+{
+  if (mw == NULL || IoMode < SUDS_IO_STDIO || IoMode > SUDS_IO_DIRECT)
+    return EW_FAILURE;
+  mw->IoMode = IoMode;
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* Event initializer: open the event's file, named as the SUDS file     *
+* would be (see SUDSWR_next_ev)                                         *
+*************************************************************************/
+int MSEEDWR_next_ev (MSEED_WRITER *mw, char *EventID, TRACE_REQ *ptrReq,
+                     int nReq, char *OutDir, char *EventDate, char *EventTime,
+                     char *EventSubnet, int debug)
+{
+  char    tmpEventID[EVENTID_SIZE + 3];
+  char    hhmmss[7];
+
+  if (mw == NULL || mw->Samples == NULL)
+  {
+    logit ("e", "MSEEDWR_next_ev: writer not initialized.\n");
+    return EW_FAILURE;
+  }
+
+  if (strlen (EventID) < 3)
+    sprintf (tmpEventID, "000%s", EventID);
+  else
+    sprintf (tmpEventID, "%s", EventID);
+  strncpy (hhmmss, EventTime, 6);
+  hhmmss[6] = '\0';
+  sprintf (mw->FileName, "%s/%s_%s_%s_%s.mseed", OutDir, EventDate, hhmmss,
+           (EventSubnet[0] != '\0') ? EventSubnet : ptrReq->net,
+           &tmpEventID[strlen (tmpEventID) - 3]);
+  return OpenEvent (mw, "MSEEDWR_next_ev", debug);
+}
+
+/* Start an event in the file FileName, named by the caller */
+int MSEEDWR_next_ev_file (MSEED_WRITER *mw, const char *FileName, int debug)
+{
+  if (mw == NULL || mw->Samples == NULL)
+  {
+    logit ("e", "MSEEDWR_next_ev_file: writer not initialized.\n");
+    return EW_FAILURE;
+  }
+  if (FileName == NULL || strlen (FileName) >= sizeof (mw->FileName))
+  {
+    logit ("e", "MSEEDWR_next_ev_file: bad file name.\n");
+    return EW_FAILURE;
+  }
+  strcpy (mw->FileName, FileName);
+  return OpenEvent (mw, "MSEEDWR_next_ev_file", debug);
+}
+
+/* Open mw->FileName and start counting records again */
+static int OpenEvent (MSEED_WRITER *mw, const char *caller, int debug)
+{
+  if (debug == 1)
+    logit ("t", "Opening miniSEED file %s\n", mw->FileName);
+  if (SudsOutOpen (&mw->Out, mw->FileName, mw->IoMode) != EW_SUCCESS)
+  {
+    logit ("e", "%s: unable to open file %s: %s\n", caller,
+           mw->FileName, strerror (errno));
+    return EW_FAILURE;
+  }
+  mw->Seq = 0;
+  mw->nOut = 0;
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* Write one channel (all the TRACE_BUFs of one TRACE_REQ) as records   *
+*************************************************************************/
+int MSEEDWR_next (MSEED_WRITER *mw, TRACE_REQ *getThis, double GapThresh,
+                  int debug)
+{
+  TRACE_HEADER *wf;
+  char   *msg_p;
+  char    datatype;
+  long    nsamp, i, j, k, room;
+  double  endtime = 0.0;
+  int32_t *x;
+  float   f;
+
+  if (mw == NULL || getThis == NULL || (msg_p = getThis->pBuf) == NULL)
+  {
+    logit ("e", "MSEEDWR_next: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+  mw->InRun = 0;
+  mw->nRun = 0;
+
+  while (msg_p < getThis->pBuf + getThis->actLen)
+  {
+    wf = (TRACE_HEADER *) msg_p;
+    if (WaveMsgMakeLocal (wf) < 0)
+    {
+      logit ("e", "MSEEDWR_next: unknown trace data type: %s\n",
+             wf->datatype);
+      return EW_FAILURE;
+    }
+    msg_p += sizeof (TRACE_HEADER);
+    nsamp = wf->nsamp;
+    datatype = 'n';
+    if (wf->datatype[0] == 's' || wf->datatype[0] == 'i')
+    {
+      if (wf->datatype[1] == '2') datatype = 's';
+      else if (wf->datatype[1] == '4') datatype = 'l';
+    }
+    else if (wf->datatype[0] == 't' || wf->datatype[0] == 'f')
+    {
+      if (wf->datatype[1] == '4') datatype = 'f';
+    }
+    if (datatype == 'n' || wf->samprate < 0.01)
+    {
+      logit ("et", "MSEEDWR_next: can't write <%s.%s.%s>: datatype %s, "
+             "rate %f\n", wf->sta, wf->chan, wf->net, wf->datatype,
+             wf->samprate);
+      return EW_FAILURE;
+    }
+
+    /* A gap, an overlap or a new rate ends the run */
+    if (mw->InRun && (wf->samprate != mw->Rate
+        || fabs (wf->starttime - endtime - 1.0 / mw->Rate)
+           > GapThresh / mw->Rate))
+    {
+      if (debug == 1)
+        logit ("", "MSEEDWR_next: break in %s.%s.%s at %f\n", wf->sta,
+               wf->chan, wf->net, wf->starttime);
+      if (EncodeRun (mw, 1, debug) != EW_SUCCESS)
+        return EW_FAILURE;
+    }
+    if (!mw->InRun)
+    {
+      mw->InRun = 1;
+      mw->RunT0 = wf->starttime;
+      mw->RunDone = 0;
+      mw->Rate = wf->samprate;
+      strncpy (mw->Sta, wf->sta, 5);
+      mw->Sta[5] = '\0';
+      strncpy (mw->Chan, wf->chan, 3);
+      mw->Chan[3] = '\0';
+      strncpy (mw->Net, wf->net, 2);
+      mw->Net[2] = '\0';
+    }
+
+    /* Widen the packet into the run buffer, a buffer-load at a time */
+    for (i = 0; i < nsamp; i += k)
+    {
+      if ((room = MSEED_RUNLEN - mw->nRun) == 0)
+      {
+        if (EncodeRun (mw, 0, debug) != EW_SUCCESS)
+          return EW_FAILURE;
+        room = MSEED_RUNLEN - mw->nRun;
+      }
+      k = (nsamp - i < room) ? nsamp - i : room;
+      x = mw->Samples + mw->nRun;
+      switch (datatype)
+      {
+      case 's':
+        for (j = 0; j < k; j++)
+          x[j] = ((short *) msg_p)[i + j];
+        break;
+      case 'l':
+        memcpy (x, (int32_t *) msg_p + i, k * sizeof (int32_t));
+        break;
+      case 'f':
+        for (j = 0; j < k; j++)
+        {
+          f = ((float *) msg_p)[i + j];
+          if (f != f)                  /* NaN, as SudsConvFloat has it */
+            x[j] = 0;
+          else if (f < (float) INT32_MIN)
+            x[j] = INT32_MIN;
+          else if (f >= (float) INT32_MAX)
+            x[j] = INT32_MAX;
+          else
+            x[j] = (int32_t) f;
+        }
+        break;
+      }
+      SudsSteimDiff (x, k, (mw->nRun > 0 || mw->RunDone > 0) ? mw->Last : x[0],
+                     mw->Diff + mw->nRun, mw->Class + mw->nRun);
+      mw->nRun += k;
+      mw->Last = x[k - 1];
+    }
+    msg_p += nsamp * ((datatype == 's') ? sizeof (short) : 4);
+    endtime = wf->starttime + (nsamp - 1) / wf->samprate;
+  }
+
+  if (mw->InRun && EncodeRun (mw, 1, debug) != EW_SUCCESS)
+    return EW_FAILURE;
+  mw->InRun = 0;
+  return FlushRecords (mw);
+}
+
+/* Pack records out of the run buffer: all of it if final, otherwise *
+ * only whole records, moving what is left to the front               */
+static int EncodeRun (MSEED_WRITER *mw, int final, int debug)
+{
+  unsigned char *rec;
+  long    pos = 0, n, packed, most;
+
+  /* the most a record can hold */
+  if (mw->Encoding == MSEED_STEIM2)
+    most = 7 * ((mw->RecLen - MSEED_HDR) / MSEED_FRAME * 15 - 2);
+  else
+    most = (mw->RecLen - MSEED_HDR) / 4;
+  if (most > MSEED_MAXNSAMP)
+    most = MSEED_MAXNSAMP;
+
+  while (pos < mw->nRun)
+  {
+    n = mw->nRun - pos;
+    if (!final && n < most && pos > 0)
+      break;
+    if (n > most)
+      n = most;
+    if (mw->nOut == MSEED_OUTRECS && FlushRecords (mw) != EW_SUCCESS)
+      return EW_FAILURE;
+    rec = mw->OutBuf + (long) mw->nOut * mw->RecLen;
+    memset (rec, 0, mw->RecLen);
+    if (mw->Encoding == MSEED_STEIM2)
+      packed = PackSteim2 (mw, pos, n, rec);
+    else
+      packed = PackInt32 (mw, pos, n, rec);
+    PackHeader (mw, rec, mw->RunT0 + (mw->RunDone + pos) / mw->Rate, packed);
+    mw->nOut++;
+    pos += packed;
+  }
+  if (debug == 1)
+    logit ("", "MSEEDWR_next: %ld samples of %s.%s.%s packed\n", pos,
+           mw->Sta, mw->Chan, mw->Net);
+
+  mw->RunDone += pos;
+  mw->nRun -= pos;
+  if (mw->nRun > 0)
+  {
+    memmove (mw->Samples, mw->Samples + pos, mw->nRun * sizeof (int32_t));
+    memmove (mw->Diff, mw->Diff + pos, mw->nRun * sizeof (int32_t));
+    memmove (mw->Class, mw->Class + pos, mw->nRun);
+  }
+  if (final)
+    mw->InRun = 0;
+  return EW_SUCCESS;
+}
+
+/* Steim2-encode up to n samples from pos on into rec's frames; returns *
+ * how many went in                                                     */
+static long PackSteim2 (MSEED_WRITER *mw, long pos, long n, unsigned char *rec)
+{
+  const int32_t       *x = mw->Samples + pos;
+  const int32_t       *d = mw->Diff + pos;
+  const unsigned char *cls = mw->Class + pos;
+  unsigned char *frame;
+  uint32_t       ctrl, word, v;
+  long           i = 0;
+  int            nframes, f, w, m, j, top, c, stop = 0;
+
+  nframes = (mw->RecLen - MSEED_HDR) / MSEED_FRAME;
+  for (f = 0; f < nframes && i < n && !stop; f++)
+  {
+    frame = rec + MSEED_HDR + f * MSEED_FRAME;
+    ctrl = 0;
+    for (w = (f == 0) ? 3 : 1; w < 16 && i < n; w++)
+    {
+      /* the most differences that all fit one word */
+      for (m = 0; m < STEIM2_NWORD; m++)
+      {
+        if (Steim2Word[m].n > n - i)
+          continue;
+        for (top = 0, j = 0; j < Steim2Word[m].n; j++)
+        {
+          c = (i + j == 0) ? 0 : cls[i + j];
+          if (c > top)
+            top = c;
+        }
+        if (top <= Steim2Word[m].cls)
+          break;
+      }
+      if (m == STEIM2_NWORD)
+      {
+        stop = 1;                       /* too big for any word */
+        break;
+      }
+
+      word = (Steim2Word[m].dnib >= 0) ? (uint32_t) Steim2Word[m].dnib << 30 : 0;
+      for (j = 0; j < Steim2Word[m].n; j++)
+      {
+        v = (uint32_t) ((i + j == 0 && cls[0] > 6) ? 0 : d[i + j]);
+        v &= (1u << Steim2Word[m].bits) - 1;
+        word |= v << (Steim2Word[m].bits * (Steim2Word[m].n - 1 - j));
+      }
+      Put32 (frame + 4 * w, word);
+      ctrl |= (uint32_t) Steim2Word[m].ctrl << (30 - 2 * w);
+      i += Steim2Word[m].n;
+    }
+    Put32 (frame, ctrl);
+  }
+  Put32 (rec + MSEED_HDR + 4, (uint32_t) x[0]);           /* X0 */
+  Put32 (rec + MSEED_HDR + 8, (uint32_t) x[i - 1]);       /* Xn */
+  return i;
+}
+
+/* Up to n samples from pos on as big-endian 32-bit integers */
+static long PackInt32 (MSEED_WRITER *mw, long pos, long n, unsigned char *rec)
+{
+  long  i;
+
+  for (i = 0; i < n; i++)
+    Put32 (rec + MSEED_HDR + 4 * i, (uint32_t) mw->Samples[pos + i]);
+  return n;
+}
+
+/* Fixed header and blockette 1000 of a record of nsamp samples from t */
+static void PackHeader (MSEED_WRITER *mw, unsigned char *rec, double t,
+                        long nsamp)
+{
+  struct tm  tm;
+  time_t     tt;
+  double     ticks;
+  long       frac;
+  short      fact, mult;
+  char       seq[24];
+
+  /* BTIME is to 0.0001 s */
+  ticks = floor (t * 10000.0 + 0.5);
+  tt = (time_t) floor (ticks / 10000.0);
+  frac = (long) (ticks - (double) tt * 10000.0);
+  gmtime_ew (&tt, &tm);
+
+  if (++mw->Seq > 999999)
+    mw->Seq = 1;
+  sprintf (seq, "%06ld", mw->Seq);
+  memcpy (rec, seq, 6);
+  rec[6] = 'D';
+  rec[7] = ' ';
+  memset (rec + 8, ' ', 12);
+  memcpy (rec + 8, mw->Sta, strlen (mw->Sta));
+  memcpy (rec + 15, mw->Chan, strlen (mw->Chan));
+  memcpy (rec + 18, mw->Net, strlen (mw->Net));
+  Put16 (rec + 20, tm.tm_year + 1900);
+  Put16 (rec + 22, tm.tm_yday + 1);
+  rec[24] = (unsigned char) tm.tm_hour;
+  rec[25] = (unsigned char) tm.tm_min;
+  rec[26] = (unsigned char) tm.tm_sec;
+  rec[27] = 0;
+  Put16 (rec + 28, (unsigned int) frac);
+  Put16 (rec + 30, (unsigned int) nsamp);
+  RateFactor (mw->Rate, &fact, &mult);
+  Put16 (rec + 32, (unsigned short) fact);
+  Put16 (rec + 34, (unsigned short) mult);
+  rec[39] = 1;                                  /* blockettes */
+  Put16 (rec + 44, MSEED_HDR);                  /* beginning of data */
+  Put16 (rec + 46, 48);                         /* first blockette */
+
+  /* blockette 1000 */
+  Put16 (rec + 48, 1000);
+  rec[52] = (unsigned char) mw->Encoding;
+  rec[53] = 1;                                  /* big-endian */
+  rec[54] = (unsigned char) mw->RecExp;
+}
+
+/* SEED sample rate factor and multiplier for rate */
+static void RateFactor (double rate, short *fact, short *mult)
+{
+  double  scale;
+  int     k;
+
+  if (rate >= 1.0 && rate <= 32767.0 && fabs (rate - floor (rate + 0.5)) < 1e-6)
+  {
+    *fact = (short) floor (rate + 0.5);
+    *mult = 1;
+    return;
+  }
+  if (rate < 1.0 && 1.0 / rate <= 32767.0
+      && fabs (1.0 / rate - floor (1.0 / rate + 0.5)) < 1e-6)
+  {
+    *fact = (short) -floor (1.0 / rate + 0.5);
+    *mult = 1;
+    return;
+  }
+  /* rate = fact / -mult, with as many decimals as fit */
+  for (k = 4, scale = 10000.0; k > 0 && rate * scale > 32767.0; k--)
+    scale /= 10.0;
+  *fact = (short) floor (rate * scale + 0.5);
+  *mult = (short) -scale;
+}
+
+/* Write out the records gathered in OutBuf */
+static int FlushRecords (MSEED_WRITER *mw)
+{
+  if (mw->nOut == 0)
+    return EW_SUCCESS;
+  if (SudsOutWrite (&mw->Out, mw->OutBuf, (size_t) mw->nOut * mw->RecLen)
+      != EW_SUCCESS)
+  {
+    logit ("et", "MSEEDWR_next: error writing %s: %s\n", mw->FileName,
+           strerror (errno));
+    mw->nOut = 0;
+    return EW_FAILURE;
+  }
+  mw->nOut = 0;
+  return EW_SUCCESS;
+}
+
+static void Put16 (unsigned char *p, unsigned int v)
+{
+  p[0] = (unsigned char) (v >> 8);
+  p[1] = (unsigned char) v;
+}
+
+static void Put32 (unsigned char *p, uint32_t v)
+{
+  p[0] = (unsigned char) (v >> 24);
+  p[1] = (unsigned char) (v >> 16);
+  p[2] = (unsigned char) (v >> 8);
+  p[3] = (unsigned char) v;
+}
+
+/************************************************************************
+* End of event: write out what is left and close the file              *
+*************************************************************************/
+int MSEEDWR_end_ev (MSEED_WRITER *mw, int debug)
+{
+  int  ret;
+
+  if (mw == NULL)
+    return EW_FAILURE;
+  ret = FlushRecords (mw);
+  if (SudsOutIsOpen (&mw->Out) && SudsOutClose (&mw->Out) != EW_SUCCESS)
+  {
+    logit ("e", "MSEEDWR_end_ev: error closing %s\n", mw->FileName);
+    ret = EW_FAILURE;
+  }
+  if (debug == 1)
+    logit ("t", "Closed miniSEED file %s: %ld records\n", mw->FileName,
+           mw->Seq);
+  return ret;
+}
+
+int MSEEDWR_close (MSEED_WRITER *mw, int debug)
+{
+  if (mw == NULL)
+    return EW_SUCCESS;
+  if (SudsOutIsOpen (&mw->Out))
+    MSEEDWR_end_ev (mw, debug);
+  free (mw->Samples);
+  free (mw->Diff);
+  free (mw->Class);
+  free (mw->OutBuf);
+  mw->Samples = NULL;
+  mw->Diff = NULL;
+  mw->Class = NULL;
+  mw->OutBuf = NULL;
+  return EW_SUCCESS;
+}
+
+
+/*
+ *  MSEEDPA_XXX entry points: the same through the default writer
+ */
+
+int MSEEDPA_init (int RecLen, char *OutDir, char *OutputFormat, int debug)
+{
+  return MSEEDWR_init (&MseedDefault, RecLen, OutDir, OutputFormat, debug);
+}
+
+int MSEEDPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq,
+                     char *OutDir, char *EventDate, char *EventTime,
+                     char *EventSubnet, int debug)
+{
+  return MSEEDWR_next_ev (&MseedDefault, EventID, ptrReq, nReq, OutDir,
+                          EventDate, EventTime, EventSubnet, debug);
+}
+
+int MSEEDPA_next (TRACE_REQ *getThis, double GapThresh, int debug)
+{
+  return MSEEDWR_next (&MseedDefault, getThis, GapThresh, debug);
+}
+
+int MSEEDPA_end_ev (int debug)
+{
+  return MSEEDWR_end_ev (&MseedDefault, debug);
+}
+
+int MSEEDPA_close (int debug)
+{
+  return MSEEDWR_close (&MseedDefault, debug);
+}
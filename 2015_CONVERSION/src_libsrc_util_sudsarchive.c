@@ -0,0 +1,588 @@
+/* sudsarchive.c
+
+        Bulk, resumable conversion of a PC-SUDS archive; see sudsarchive.h
+
+   The tree is walked once and the .WVM files sorted by path; the ones
+   the journal already has are dropped, and the rest are handed to a
+   SUDS_POOL, which gives each worker the next file as soon as it is
+   free, so a few big files never hold up the small ones behind them.
+   Each worker keeps its own SUDS_WRITER (streaming), MSEED_WRITER and
+   IRIG decoder from one file to the next.
+
+   Each output is written as name.part, fsync()ed, renamed into place,
+   and then its directory fsync()ed, so the rename itself is on disk.
+   Only after all of a file's outputs are is its journal line written.
+   The journal is one line per file converted, "size mtime path", taken
+   relative to InDir. Lines are only appended, each with a single
+   write() and then fdatasync(), so after a crash every file the
+   journal holds has its outputs whole and in place; the one being
+   written may be lost, and a last line cut short has no newline and
+   is ignored.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <earthworm.h>
+#include <sudsdemux.h>
+#include <sudsirig.h>
+#include <sudspool.h>
+#include <sudswriter.h>
+#include <mseedwriter.h>
+#include <sudsarchive.h>
+
+#define ARCH_MAXPATH     (4*SUDS_MAXTXT)
+#define ARCH_GAPTHRESH   1.5           /* samples, for the miniSEED copy */
+
+/* One input file, by its path under InDir */
+typedef struct
+{
+  char   *rel;
+  long    size;
+  long    mtime;
+} ARCH_FILE;
+
+typedef struct
+{
+  ARCH_FILE *f;
+  long       n, max;
+} ARCH_LIST;
+
+/* One worker's writers */
+typedef struct
+{
+  SUDS_WRITER   sw;
+  MSEED_WRITER  mw;
+  SUDS_IRIG    *ir;
+} ARCH_WORKER;
+
+/* One SudsArchiveRun call */
+typedef struct
+{
+  const SUDS_ARCHIVE_PARAMS *ap;
+  ARCH_FILE          *todo;
+  long                nTodo;
+  ARCH_WORKER        *w;
+  int                 nWorkers;
+  int                 jfd;             /* journal, open for appending */
+  SUDS_ARCHIVE_STATS *st;
+  double              t0;              /* start of the run */
+  double              LastReport;
+  pthread_mutex_t     mutex;           /* journal and stats */
+} ARCH_RUN;
+
+/* Internal Function Prototypes */
+static int Walk (const char *, const char *, ARCH_LIST *);
+static int IsWvm (const char *);
+static int AddFile (ARCH_LIST *, const char *, long, long);
+static void FreeList (ARCH_LIST *);
+static int CompareFile (const void *, const void *);
+static int ReadJournal (const char *, ARCH_LIST *);
+static int InJournal (ARCH_LIST *, ARCH_FILE *);
+static int OutName (const char *, const char *, const char *, char *);
+static int MakeDirs (const char *);
+static int SyncRename (const char *, const char *);
+static void Prefetch (ARCH_RUN *, long);
+static void ArchiveTask (void *, int, int);
+static int ConvertFile (ARCH_RUN *, ARCH_WORKER *, ARCH_FILE *);
+static void FileDone (ARCH_RUN *, ARCH_FILE *, int);
+static void Report (ARCH_RUN *, const char *);
+static double Now (void);
+
+/************************************************************************
+* SudsArchiveRun: convert every .WVM under InDir not already done       *
+*************************************************************************/
+int SudsArchiveRun (const SUDS_ARCHIVE_PARAMS *ap, SUDS_ARCHIVE_STATS *st)
+{
+  ARCH_RUN            run;
+  ARCH_LIST           all, done;
+  SUDS_ARCHIVE_STATS  mine;
+  SUDS_POOL          *pool = NULL;
+  char                journal[ARCH_MAXPATH];
+  long                i;
+  int                 w, ret = EW_FAILURE;
+
+  if (ap == NULL || ap->InDir == NULL || ap->OutDir == NULL
+      || ap->OutputFormat == NULL)
+  {
+    logit ("e", "SudsArchiveRun: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+  if (st == NULL)
+    st = &mine;
+  memset (st, 0, sizeof (SUDS_ARCHIVE_STATS));
+  memset (&run, 0, sizeof (run));
+  memset (&all, 0, sizeof (all));
+  memset (&done, 0, sizeof (done));
+  run.ap = ap;
+  run.st = st;
+  run.jfd = -1;
+  run.t0 = run.LastReport = Now ();
+  pthread_mutex_init (&run.mutex, NULL);
+
+  /* What there is, and what is still to do */
+  if (Walk (ap->InDir, "", &all) != EW_SUCCESS)
+    goto done;
+  qsort (all.f, all.n, sizeof (ARCH_FILE), CompareFile);
+  st->nFiles = all.n;
+
+  if (ap->Journal != NULL)
+    strcpy (journal, ap->Journal);
+  else if (OutName (ap->OutDir, "", SUDS_ARCHIVE_JOURNAL, journal)
+           != EW_SUCCESS)
+    goto done;
+  if (MakeDirs (journal) != EW_SUCCESS
+      || ReadJournal (journal, &done) != EW_SUCCESS)
+    goto done;
+  if ((run.todo = (ARCH_FILE *) malloc ((all.n + 1) * sizeof (ARCH_FILE)))
+      == NULL)
+  {
+    logit ("e", "SudsArchiveRun: out of memory\n");
+    goto done;
+  }
+  for (i = 0; i < all.n; i++)
+    if (InJournal (&done, &all.f[i]))
+      st->nSkipped++;
+    else
+      run.todo[run.nTodo++] = all.f[i];
+  logit ("t", "SudsArchiveRun: %ld .WVM files under %s, %ld already done\n",
+         st->nFiles, ap->InDir, st->nSkipped);
+  if (run.nTodo == 0)
+  {
+    ret = EW_SUCCESS;
+    goto done;
+  }
+
+  if ((run.jfd = open (journal, O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0)
+  {
+    logit ("e", "SudsArchiveRun: can't open journal %s: %s\n", journal,
+           strerror (errno));
+    goto done;
+  }
+
+  /* One set of writers per worker */
+  if ((pool = SudsPoolCreate (ap->nThreads < 1 ? 1 : ap->nThreads)) == NULL)
+  {
+    logit ("e", "SudsArchiveRun: couldn't start threads\n");
+    goto done;
+  }
+  run.nWorkers = SudsPoolThreads (pool);
+  if ((run.w = (ARCH_WORKER *) calloc (run.nWorkers, sizeof (ARCH_WORKER)))
+      == NULL)
+  {
+    logit ("e", "SudsArchiveRun: out of memory\n");
+    goto done;
+  }
+  for (w = 0; w < run.nWorkers; w++)
+  {
+    if (SUDSWR_init (&run.w[w].sw, SUDS_DEMUX_BUFLEN, (char *) ap->OutDir,
+                     (char *) ap->OutputFormat, ap->debug) != EW_SUCCESS)
+      goto done;
+    SUDSWR_set_stream (&run.w[w].sw, 1);
+    if (ap->IrigSta != NULL)
+    {
+      if ((run.w[w].ir = SudsIrigCreate (ap->IrigSta, ap->IrigChan,
+                                         ap->IrigCode)) == NULL)
+        goto done;
+      SUDSWR_set_irig (&run.w[w].sw, run.w[w].ir);
+    }
+    if (ap->MseedDir != NULL
+        && MSEEDWR_init (&run.w[w].mw,
+                         (ap->MseedRecLen > 0) ? ap->MseedRecLen : 4096,
+                         (char *) ap->MseedDir, "steim2", ap->debug)
+           != EW_SUCCESS)
+      goto done;
+  }
+
+  /* Get the first files coming before the workers want them */
+  for (i = 0; i < run.nWorkers; i++)
+    Prefetch (&run, i);
+  SudsPoolRun (pool, (int) run.nTodo, ArchiveTask, &run);
+  ret = (st->nFailed > 0) ? EW_FAILURE : EW_SUCCESS;
+
+done:
+  st->Seconds = Now () - run.t0;
+  if (run.nTodo > 0)
+    Report (&run, "done");
+  if (run.w != NULL)
+  {
+    for (w = 0; w < run.nWorkers; w++)
+    {
+      SUDSWR_close (&run.w[w].sw, ap->debug);
+      MSEEDWR_close (&run.w[w].mw, ap->debug);
+      SudsIrigDestroy (run.w[w].ir);
+    }
+    free (run.w);
+  }
+  SudsPoolDestroy (pool);
+  if (run.jfd >= 0)
+    close (run.jfd);
+  free (run.todo);
+  FreeList (&done);
+  FreeList (&all);
+  pthread_mutex_destroy (&run.mutex);
+  return ret;
+}
+
+/* Pool task: todo file i on worker's writers */
+static void ArchiveTask (void *arg, int i, int worker)
+{
+  ARCH_RUN  *run = (ARCH_RUN *) arg;
+
+  /* workers claim files in order, so this is about when it's wanted */
+  Prefetch (run, i + run->nWorkers);
+  FileDone (run, &run->todo[i],
+            ConvertFile (run, &run->w[worker], &run->todo[i]));
+}
+
+/* Demultiplex one file, and copy it to miniSEED if asked */
+static int ConvertFile (ARCH_RUN *run, ARCH_WORKER *w, ARCH_FILE *f)
+{
+  const SUDS_ARCHIVE_PARAMS *ap = run->ap;
+  SUDS_DEMUXED  dm;
+  char    in[ARCH_MAXPATH], out[ARCH_MAXPATH], part[ARCH_MAXPATH + 8];
+  int     c, ret = EW_SUCCESS;
+
+  if (OutName (ap->InDir, f->rel, NULL, in) != EW_SUCCESS
+      || OutName (ap->OutDir, f->rel, ".dmx", out) != EW_SUCCESS)
+    return EW_FAILURE;
+  if (ap->debug == 1)
+    logit ("t", "SudsArchiveRun: %s -> %s\n", in, out);
+  if (SudsDemuxLoad (in, &dm, ap->debug) != EW_SUCCESS)
+    return EW_FAILURE;
+
+  sprintf (part, "%s.part", out);
+  if (MakeDirs (out) != EW_SUCCESS
+      || SudsDemuxWrite (&w->sw, &dm, part, ap->debug) != EW_SUCCESS
+      || SyncRename (part, out) != EW_SUCCESS)
+  {
+    logit ("e", "SudsArchiveRun: %s not written\n", out);
+    ret = EW_FAILURE;
+  }
+
+  if (ret == EW_SUCCESS && ap->MseedDir != NULL)
+  {
+    if (OutName (ap->MseedDir, f->rel, ".mseed", out) != EW_SUCCESS)
+      ret = EW_FAILURE;
+    else
+    {
+      sprintf (part, "%s.part", out);
+      if (MakeDirs (out) != EW_SUCCESS
+          || MSEEDWR_next_ev_file (&w->mw, part, ap->debug) != EW_SUCCESS)
+        ret = EW_FAILURE;
+      else
+      {
+        for (c = 0; c < dm.nch; c++)
+          if (MSEEDWR_next (&w->mw, &dm.req[c], ARCH_GAPTHRESH, ap->debug)
+              != EW_SUCCESS)
+            ret = EW_FAILURE;
+        if (MSEEDWR_end_ev (&w->mw, ap->debug) != EW_SUCCESS
+            || ret != EW_SUCCESS || SyncRename (part, out) != EW_SUCCESS)
+          ret = EW_FAILURE;
+      }
+      if (ret != EW_SUCCESS)
+        logit ("e", "SudsArchiveRun: %s not written\n", out);
+    }
+  }
+  SudsDemuxFree (&dm);
+  return ret;
+}
+
+/* Record how a file went: in the journal if it was converted */
+static void FileDone (ARCH_RUN *run, ARCH_FILE *f, int ret)
+{
+  char    line[ARCH_MAXPATH + 64];
+  int     len;
+
+  pthread_mutex_lock (&run->mutex);
+  if (ret == EW_SUCCESS)
+  {
+    len = sprintf (line, "%ld %ld %s\n", f->size, f->mtime, f->rel);
+    if (write (run->jfd, line, len) != len || fdatasync (run->jfd) != 0)
+      logit ("e", "SudsArchiveRun: error writing journal: %s\n",
+             strerror (errno));
+    run->st->nDone++;
+    run->st->Bytes += f->size;
+  }
+  else
+    run->st->nFailed++;
+  if (run->ap->ReportSec > 0
+      && Now () - run->LastReport >= run->ap->ReportSec)
+  {
+    run->LastReport = Now ();
+    run->st->Seconds = run->LastReport - run->t0;
+    Report (run, "so far");
+  }
+  pthread_mutex_unlock (&run->mutex);
+}
+
+/* Log progress and rates */
+static void Report (ARCH_RUN *run, const char *when)
+{
+  SUDS_ARCHIVE_STATS *st = run->st;
+  double  sec = (st->Seconds > 0.0) ? st->Seconds : 1e-9;
+
+  logit ("t", "SudsArchiveRun: %s %ld of %ld files (%ld failed) in %.0f s: "
+         "%.2f files/s, %.2f MB/s\n", when, st->nDone, run->nTodo,
+         st->nFailed, st->Seconds, st->nDone / sec,
+         st->Bytes / sec / 1048576.0);
+}
+
+/* Ask for todo file i to be read in */
+static void Prefetch (ARCH_RUN *run, long i)
+{
+#if defined (POSIX_FADV_WILLNEED)
+  char  path[ARCH_MAXPATH];
+  int   fd;
+
+  if (i >= run->nTodo
+      || OutName (run->ap->InDir, run->todo[i].rel, NULL, path) != EW_SUCCESS
+      || (fd = open (path, O_RDONLY)) < 0)
+    return;
+  posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+  close (fd);
+#endif
+}
+
+/* dir/rel, with rel's extension changed to ext if ext isn't NULL */
+static int OutName (const char *dir, const char *rel, const char *ext,
+                    char *out)
+{
+  const char  *base, *dot;
+  size_t       stem;
+
+  stem = strlen (rel);
+  if (ext != NULL)
+  {
+    base = strrchr (rel, '/');
+    base = (base != NULL) ? base + 1 : rel;
+    if ((dot = strrchr (base, '.')) != NULL && dot != base)
+      stem = dot - rel;
+  }
+  if (strlen (dir) + 1 + stem + ((ext != NULL) ? strlen (ext) : 0)
+      >= ARCH_MAXPATH)
+  {
+    logit ("e", "SudsArchiveRun: path too long for %s\n", rel);
+    return EW_FAILURE;
+  }
+  sprintf (out, "%s/%.*s%s", dir, (int) stem, rel, (ext != NULL) ? ext : "");
+  return EW_SUCCESS;
+}
+
+/* Make every directory leading up to path's last / */
+static int MakeDirs (const char *path)
+{
+  char   dir[ARCH_MAXPATH];
+  char  *p;
+
+  strcpy (dir, path);
+  for (p = dir + 1; (p = strchr (p, '/')) != NULL; p++)
+  {
+    *p = '\0';
+    if (mkdir (dir, 0755) != 0 && errno != EEXIST)
+    {
+      logit ("e", "SudsArchiveRun: can't make %s: %s\n", dir,
+             strerror (errno));
+      return EW_FAILURE;
+    }
+    *p = '/';
+  }
+  return EW_SUCCESS;
+}
+
+/* Put part on disk, rename it to out, and put the rename on disk */
+static int SyncRename (const char *part, const char *out)
+{
+  char   dir[ARCH_MAXPATH];
+  char  *p;
+  int    fd, ret = EW_SUCCESS;
+
+  if ((fd = open (part, O_RDONLY)) < 0 || fsync (fd) != 0)
+    ret = EW_FAILURE;
+  if (fd >= 0 && close (fd) != 0)
+    ret = EW_FAILURE;
+  if (ret == EW_SUCCESS && rename (part, out) != 0)
+    ret = EW_FAILURE;
+  if (ret == EW_SUCCESS)
+  {
+    strcpy (dir, out);
+    if ((p = strrchr (dir, '/')) == NULL)
+      strcpy (dir, ".");
+    else if (p == dir)
+      p[1] = '\0';
+    else
+      *p = '\0';
+    if ((fd = open (dir, O_RDONLY)) < 0 || fsync (fd) != 0)
+      ret = EW_FAILURE;
+    if (fd >= 0)
+      close (fd);
+  }
+  if (ret != EW_SUCCESS)
+    logit ("e", "SudsArchiveRun: can't put %s on disk: %s\n", out,
+           strerror (errno));
+  return ret;
+}
+
+
+/*
+ *  The archive and the journal
+ */
+
+/* Add every .WVM under root/rel to list */
+static int Walk (const char *root, const char *rel, ARCH_LIST *list)
+{
+  DIR            *d;
+  struct dirent  *de;
+  struct stat     sb;
+  char            path[ARCH_MAXPATH], sub[ARCH_MAXPATH];
+  int             ret = EW_SUCCESS;
+
+  if (strlen (root) + strlen (rel) + 2 >= ARCH_MAXPATH)
+    return EW_FAILURE;
+  strcpy (path, root);
+  if (rel[0] != '\0')
+    strcat (strcat (path, "/"), rel);
+  if ((d = opendir (path)) == NULL)
+  {
+    logit ("e", "SudsArchiveRun: can't read %s: %s\n", path,
+           strerror (errno));
+    return EW_FAILURE;
+  }
+  while (ret == EW_SUCCESS && (de = readdir (d)) != NULL)
+  {
+    if (strcmp (de->d_name, ".") == 0 || strcmp (de->d_name, "..") == 0)
+      continue;
+    if (strlen (rel) + strlen (de->d_name) + 2 >= ARCH_MAXPATH
+        || strlen (path) + strlen (de->d_name) + 2 >= ARCH_MAXPATH)
+    {
+      logit ("e", "SudsArchiveRun: path too long under %s\n", path);
+      continue;
+    }
+    strcpy (sub, rel);
+    if (rel[0] != '\0')
+      strcat (sub, "/");
+    strcat (sub, de->d_name);
+    strcat (strcat (path, "/"), de->d_name);
+    if (stat (path, &sb) == 0)
+    {
+      if (S_ISDIR (sb.st_mode))
+        ret = Walk (root, sub, list);
+      else if (S_ISREG (sb.st_mode) && IsWvm (de->d_name))
+        ret = AddFile (list, sub, (long) sb.st_size, (long) sb.st_mtime);
+    }
+    path[strlen (path) - strlen (de->d_name) - 1] = '\0';
+  }
+  closedir (d);
+  return ret;
+}
+
+static int IsWvm (const char *name)
+{
+  const char  *dot = strrchr (name, '.');
+
+  return dot != NULL && (dot[1] == 'W' || dot[1] == 'w')
+    && (dot[2] == 'V' || dot[2] == 'v') && (dot[3] == 'M' || dot[3] == 'm')
+    && dot[4] == '\0';
+}
+
+static int AddFile (ARCH_LIST *list, const char *rel, long size, long mtime)
+{
+  ARCH_FILE  *more;
+
+  if (list->n == list->max)
+  {
+    list->max = (list->max == 0) ? 1024 : 2 * list->max;
+    if ((more = (ARCH_FILE *) realloc (list->f, list->max * sizeof (ARCH_FILE)))
+        == NULL)
+    {
+      logit ("e", "SudsArchiveRun: out of memory\n");
+      return EW_FAILURE;
+    }
+    list->f = more;
+  }
+  if ((list->f[list->n].rel = strdup (rel)) == NULL)
+  {
+    logit ("e", "SudsArchiveRun: out of memory\n");
+    return EW_FAILURE;
+  }
+  list->f[list->n].size = size;
+  list->f[list->n].mtime = mtime;
+  list->n++;
+  return EW_SUCCESS;
+}
+
+static void FreeList (ARCH_LIST *list)
+{
+  long  i;
+
+  for (i = 0; i < list->n; i++)
+    free (list->f[i].rel);
+  free (list->f);
+  memset (list, 0, sizeof (ARCH_LIST));
+}
+
+/* By path, then size, then time */
+static int CompareFile (const void *a, const void *b)
+{
+  const ARCH_FILE  *fa = (const ARCH_FILE *) a;
+  const ARCH_FILE  *fb = (const ARCH_FILE *) b;
+  int  c;
+
+  if ((c = strcmp (fa->rel, fb->rel)) != 0)
+    return c;
+  if (fa->size != fb->size)
+    return (fa->size < fb->size) ? -1 : 1;
+  if (fa->mtime != fb->mtime)
+    return (fa->mtime < fb->mtime) ? -1 : 1;
+  return 0;
+}
+
+/* Load the files the journal says are done, sorted; no journal is fine */
+static int ReadJournal (const char *path, ARCH_LIST *done)
+{
+  FILE   *fp;
+  char    line[ARCH_MAXPATH + 64];
+  char   *nl;
+  long    size, mtime;
+  int     n;
+
+  if ((fp = fopen (path, "r")) == NULL)
+    return (errno == ENOENT) ? EW_SUCCESS : EW_FAILURE;
+  while (fgets (line, sizeof (line), fp) != NULL)
+  {
+    if ((nl = strchr (line, '\n')) == NULL)
+      continue;                         /* cut short by a crash */
+    *nl = '\0';
+    if (sscanf (line, "%ld %ld %n", &size, &mtime, &n) == 2 && line[n] != '\0'
+        && AddFile (done, line + n, size, mtime) != EW_SUCCESS)
+    {
+      fclose (fp);
+      return EW_FAILURE;
+    }
+  }
+  fclose (fp);
+  qsort (done->f, done->n, sizeof (ARCH_FILE), CompareFile);
+  return EW_SUCCESS;
+}
+
+static int InJournal (ARCH_LIST *done, ARCH_FILE *f)
+{
+  return done->n > 0
+    && bsearch (f, done->f, done->n, sizeof (ARCH_FILE), CompareFile) != NULL;
+}
+
+static double Now (void)
+{
+  struct timespec  ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
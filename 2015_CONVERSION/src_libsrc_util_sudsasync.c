@@ -0,0 +1,758 @@
+/* sudsasync.c
+
+        Write-behind service for SUDS event files
+
+   Producers queue jobs (open, write, patch, truncate, close) for a file;
+   each file is given to one I/O thread when it is opened, and that
+   thread runs its jobs in order. Write jobs carry their own copy of the
+   bytes, so the caller's buffers are free again as soon as the job is
+   queued.
+
+   An I/O thread takes its whole queue at once. Runs of consecutive
+   writes are submitted to the thread's io_uring together and waited for
+   together; a patch starts a new run, since it overwrites bytes an
+   earlier write in the same run may not have reached yet. Without
+   io_uring the writes are done one by one with pwrite.
+
+   io_uring is driven through the raw system calls, so no liburing is
+   needed; if the headers are missing the service is built with the
+   pwrite path only, and if io_uring_setup fails at run time (old
+   kernel, seccomp) the pwrite path is used instead.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <earthworm.h>
+#include <sudsasync.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SUDS_HAVE_URING
+#endif
+#endif
+
+#ifdef SUDS_HAVE_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#define URING_DEPTH   64            /* writes in flight per I/O thread */
+#define GROUP_FILES   256           /* closed files held open for one group sync */
+
+#define AJ_OPEN       0
+#define AJ_WRITE      1
+#define AJ_PATCH      2
+#define AJ_TRUNCATE   3
+#define AJ_CLOSE      4
+
+typedef struct _AJOB
+{
+  int            op;            /* AJ_XXX */
+  SUDS_AFILE    *af;
+  off_t          off;
+  size_t         len;           /* bytes in data */
+  struct iovec   iov;           /* data, for the ring */
+  SUDS_ASYNC_DONE done;         /* AJ_CLOSE */
+  void          *arg;
+  struct _AJOB  *next;
+  char           data[1];       /* AJ_WRITE and AJ_PATCH bytes follow */
+} AJOB;
+
+#ifdef SUDS_HAVE_URING
+typedef struct
+{
+  int                   fd;
+  unsigned             *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned             *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe  *sqes;
+  struct io_uring_cqe  *cqes;
+  void                 *sq_ring, *cq_ring;
+  size_t                sq_size, cq_size, sqes_size;
+} URING;
+#endif
+
+typedef struct
+{
+  SUDS_ASYNC      *as;
+  pthread_t        tid;
+  pthread_mutex_t  mutex;
+  pthread_cond_t   wake;
+  AJOB            *head, *tail;   /* queued jobs */
+  SUDS_AFILE      *group;         /* closed files waiting for the group sync */
+  struct timespec  groupStart;    /* when the first of them was closed */
+  int              nGroup;        /* how many of them there are */
+  int              quit;
+  int              haveRing;
+#ifdef SUDS_HAVE_URING
+  URING            ring;
+#endif
+} AWORKER;
+
+struct _SUDS_AFILE
+{
+  SUDS_ASYNC      *as;
+  AWORKER         *w;
+  int              fd;
+  int              status;        /* EW_FAILURE once anything has gone wrong */
+  SUDS_ASYNC_DONE  done;
+  void            *arg;
+  SUDS_AFILE      *nextGroup;
+  char             path[1];
+};
+
+struct _SUDS_ASYNC
+{
+  int              nWorkers;
+  AWORKER         *w;
+  int              Sync;          /* SUDS_SYNC_XXX */
+  int              GroupMs;
+  long             MaxQueued;
+  long             Queued;        /* bytes of write data in all the queues */
+  pthread_mutex_t  qmutex;
+  pthread_cond_t   qroom;
+  unsigned         nextWorker;
+  int              Uring;
+};
+
+/* Internal Function Prototypes */
+static void *IoThread (void *);
+static void RunJobs (AWORKER *, AJOB *);
+static void RunWrites (AWORKER *, AJOB **, int);
+static void FinishFile (SUDS_AFILE *);
+static void GroupSync (AWORKER *);
+static void GroupDue (AWORKER *, struct timespec *);
+static int Enqueue (SUDS_AFILE *, AJOB *);
+static AJOB *NewJob (SUDS_AFILE *, int, size_t);
+static int JobLost (SUDS_AFILE *);
+static int PwriteAll (int, const char *, size_t, off_t);
+#ifdef SUDS_HAVE_URING
+static int UringSetup (URING *, unsigned);
+static int UringReap (URING *, AJOB **, char *);
+static void UringClose (URING *);
+#endif
+
+/************************************************************************
+* SudsAsyncStart: start nThreads I/O threads                            *
+*************************************************************************/
+SUDS_ASYNC *SudsAsyncStart (int nThreads, int Sync, int GroupMs, long MaxQueued)
+{
+  SUDS_ASYNC  *as;
+  int          i;
+
+  if (nThreads < 1)
+    nThreads = 1;
+  if ((as = (SUDS_ASYNC *) calloc (1, sizeof (SUDS_ASYNC))) == NULL
+      || (as->w = (AWORKER *) calloc (nThreads, sizeof (AWORKER))) == NULL)
+  {
+    logit ("e", "SudsAsyncStart: couldn't malloc service\n");
+    free (as);
+    return NULL;
+  }
+  as->Sync = Sync;
+  as->GroupMs = (GroupMs > 0) ? GroupMs : 1000;
+  as->MaxQueued = MaxQueued;
+  pthread_mutex_init (&as->qmutex, NULL);
+  pthread_cond_init (&as->qroom, NULL);
+
+  as->Uring = 1;
+  for (i = 0; i < nThreads; i++)
+  {
+    AWORKER *w = &as->w[i];
+
+    w->as = as;
+    pthread_mutex_init (&w->mutex, NULL);
+    pthread_cond_init (&w->wake, NULL);
+#ifdef SUDS_HAVE_URING
+    w->haveRing = (UringSetup (&w->ring, URING_DEPTH) == EW_SUCCESS);
+#endif
+    if (!w->haveRing)
+      as->Uring = 0;
+    if (pthread_create (&w->tid, NULL, IoThread, w) != 0)
+    {
+      logit ("e", "SudsAsyncStart: couldn't start I/O thread %d\n", i);
+#ifdef SUDS_HAVE_URING
+      if (w->haveRing)
+        UringClose (&w->ring);
+#endif
+      break;
+    }
+    as->nWorkers++;
+  }
+  if (as->nWorkers == 0)
+  {
+    free (as->w);
+    free (as);
+    return NULL;
+  }
+  return as;
+}
+
+int SudsAsyncUring (SUDS_ASYNC *as)
+{
+  return as->Uring;
+}
+
+/************************************************************************
+* SudsAsyncStop: let the I/O threads finish their queues, then stop     *
+*************************************************************************/
+void SudsAsyncStop (SUDS_ASYNC *as)
+{
+  int  i;
+
+  if (as == NULL)
+    return;
+  for (i = 0; i < as->nWorkers; i++)
+  {
+    pthread_mutex_lock (&as->w[i].mutex);
+    as->w[i].quit = 1;
+    pthread_cond_signal (&as->w[i].wake);
+    pthread_mutex_unlock (&as->w[i].mutex);
+  }
+  for (i = 0; i < as->nWorkers; i++)
+  {
+    pthread_join (as->w[i].tid, NULL);
+#ifdef SUDS_HAVE_URING
+    if (as->w[i].haveRing)
+      UringClose (&as->w[i].ring);
+#endif
+    pthread_mutex_destroy (&as->w[i].mutex);
+    pthread_cond_destroy (&as->w[i].wake);
+  }
+  pthread_mutex_destroy (&as->qmutex);
+  pthread_cond_destroy (&as->qroom);
+  free (as->w);
+  free (as);
+}
+
+/************************************************************************
+* SudsAsyncOpen .. SudsAsyncClose: queue jobs for one file              *
+*************************************************************************/
+SUDS_AFILE *SudsAsyncOpen (SUDS_ASYNC *as, const char *path)
+{
+  SUDS_AFILE  *af;
+  AJOB        *job;
+
+  if ((af = (SUDS_AFILE *) calloc (1, sizeof (SUDS_AFILE) + strlen (path))) == NULL)
+    return NULL;
+  strcpy (af->path, path);
+  af->as = as;
+  af->fd = -1;
+  af->status = EW_SUCCESS;
+  af->w = &as->w[__sync_fetch_and_add (&as->nextWorker, 1) % as->nWorkers];
+
+  if ((job = NewJob (af, AJ_OPEN, 0)) == NULL)
+  {
+    free (af);
+    return NULL;
+  }
+  Enqueue (af, job);
+  return af;
+}
+
+int SudsAsyncWrite (SUDS_AFILE *af, const struct iovec *iov, int n, off_t off)
+{
+  AJOB    *job;
+  size_t   len = 0;
+  int      i;
+
+  for (i = 0; i < n; i++)
+    len += iov[i].iov_len;
+  if ((job = NewJob (af, AJ_WRITE, len)) == NULL)
+    return JobLost (af);
+  for (i = 0, len = 0; i < n; i++)
+  {
+    memcpy (job->data + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  job->off = off;
+  return Enqueue (af, job);
+}
+
+int SudsAsyncPatch (SUDS_AFILE *af, const void *buf, size_t len, off_t off)
+{
+  AJOB  *job;
+
+  if ((job = NewJob (af, AJ_PATCH, len)) == NULL)
+    return JobLost (af);
+  memcpy (job->data, buf, len);
+  job->off = off;
+  return Enqueue (af, job);
+}
+
+int SudsAsyncTruncate (SUDS_AFILE *af, off_t off)
+{
+  AJOB  *job;
+
+  if ((job = NewJob (af, AJ_TRUNCATE, 0)) == NULL)
+    return JobLost (af);
+  job->off = off;
+  return Enqueue (af, job);
+}
+
+int SudsAsyncClose (SUDS_AFILE *af, SUDS_ASYNC_DONE done, void *arg)
+{
+  AJOB  *job;
+
+  /* the close has to happen whatever, so wait for memory if need be */
+  while ((job = NewJob (af, AJ_CLOSE, 0)) == NULL)
+    sleep_ew (10);
+  job->done = done;
+  job->arg = arg;
+  return Enqueue (af, job);
+}
+
+
+static AJOB *NewJob (SUDS_AFILE *af, int op, size_t len)
+{
+  AJOB  *job;
+
+  if ((job = (AJOB *) malloc (sizeof (AJOB) + len)) == NULL)
+  {
+    logit ("e", "SudsAsync: couldn't malloc %lu byte job for %s\n",
+           (unsigned long) len, af->path);
+    return NULL;
+  }
+  memset (job, 0, sizeof (AJOB));
+  job->op = op;
+  job->af = af;
+  job->len = len;
+  job->iov.iov_base = job->data;
+  job->iov.iov_len = len;
+  return job;
+}
+
+/* A write, patch or truncate that couldn't be queued leaves the file *
+ * wrong, so the close must say so as well                           */
+static int JobLost (SUDS_AFILE *af)
+{
+  pthread_mutex_lock (&af->w->mutex);
+  af->status = EW_FAILURE;
+  pthread_mutex_unlock (&af->w->mutex);
+  return EW_FAILURE;
+}
+
+/* Add a job to the file's I/O thread queue, first waiting for room if the *
+ * queues already hold MaxQueued bytes                                     */
+static int Enqueue (SUDS_AFILE *af, AJOB *job)
+{
+  SUDS_ASYNC  *as = af->as;
+  AWORKER     *w = af->w;
+
+  if (job->len > 0)
+  {
+    pthread_mutex_lock (&as->qmutex);
+    while (as->MaxQueued > 0 && as->Queued > 0
+           && as->Queued + (long) job->len > as->MaxQueued)
+      pthread_cond_wait (&as->qroom, &as->qmutex);
+    as->Queued += job->len;
+    pthread_mutex_unlock (&as->qmutex);
+  }
+
+  pthread_mutex_lock (&w->mutex);
+  if (w->tail != NULL)
+    w->tail->next = job;
+  else
+    w->head = job;
+  w->tail = job;
+  pthread_cond_signal (&w->wake);
+  pthread_mutex_unlock (&w->mutex);
+  return EW_SUCCESS;
+}
+
+
+/* I/O thread: run queued jobs until told to quit with nothing left */
+static void *IoThread (void *arg)
+{
+  AWORKER         *w = (AWORKER *) arg;
+  AJOB            *jobs;
+  struct timespec  due, now;
+
+  pthread_mutex_lock (&w->mutex);
+  for (;;)
+  {
+    while (w->head == NULL && !w->quit)
+    {
+      if (w->group == NULL)
+      {
+        pthread_cond_wait (&w->wake, &w->mutex);
+        continue;
+      }
+      GroupDue (w, &due);
+      if (pthread_cond_timedwait (&w->wake, &w->mutex, &due) == ETIMEDOUT)
+      {
+        pthread_mutex_unlock (&w->mutex);
+        GroupSync (w);
+        pthread_mutex_lock (&w->mutex);
+      }
+    }
+    if (w->head == NULL)
+      break;
+    jobs = w->head;
+    w->head = w->tail = NULL;
+    pthread_mutex_unlock (&w->mutex);
+    RunJobs (w, jobs);
+
+    /* A steady stream of jobs never lets the wait above time out, so *
+     * the group is also checked here, after every pass               */
+    if (w->group != NULL)
+    {
+      if (w->nGroup >= GROUP_FILES)
+        GroupSync (w);
+      else
+      {
+        clock_gettime (CLOCK_REALTIME, &now);
+        GroupDue (w, &due);
+        if (now.tv_sec > due.tv_sec
+            || (now.tv_sec == due.tv_sec && now.tv_nsec >= due.tv_nsec))
+          GroupSync (w);
+      }
+    }
+    pthread_mutex_lock (&w->mutex);
+  }
+  pthread_mutex_unlock (&w->mutex);
+  GroupSync (w);
+  return NULL;
+}
+
+/* Run a list of jobs in order, gathering consecutive writes into runs */
+static void RunJobs (AWORKER *w, AJOB *jobs)
+{
+  SUDS_ASYNC  *as = w->as;
+  AJOB        *run[URING_DEPTH];
+  AJOB        *job, *next;
+  SUDS_AFILE  *af;
+  long         freed = 0;
+  int          nrun = 0;
+
+  for (job = jobs; job != NULL; job = job->next)
+  {
+    af = job->af;
+    if (job->op == AJ_WRITE || job->op == AJ_PATCH)
+    {
+      if (nrun == URING_DEPTH || (job->op == AJ_PATCH && nrun > 0))
+      {
+        RunWrites (w, run, nrun);
+        nrun = 0;
+      }
+      if (af->fd >= 0)
+        run[nrun++] = job;
+      continue;
+    }
+
+    if (nrun > 0)
+    {
+      RunWrites (w, run, nrun);
+      nrun = 0;
+    }
+    switch (job->op)
+    {
+    case AJ_OPEN:
+      if ((af->fd = open (af->path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+      {
+        logit ("e", "SudsAsync: unable to open %s: %s\n", af->path, strerror (errno));
+        af->status = EW_FAILURE;
+      }
+      break;
+
+    case AJ_TRUNCATE:
+      if (af->fd >= 0 && ftruncate (af->fd, job->off) != 0)
+      {
+        logit ("e", "SudsAsync: unable to truncate %s: %s\n", af->path, strerror (errno));
+        af->status = EW_FAILURE;
+      }
+      break;
+
+    case AJ_CLOSE:
+      af->done = job->done;
+      af->arg = job->arg;
+      if (af->fd >= 0 && as->Sync == SUDS_SYNC_GROUP)
+      {
+        /* keep it open until the next group sync */
+        if (w->group == NULL)
+          clock_gettime (CLOCK_REALTIME, &w->groupStart);
+        af->nextGroup = w->group;
+        w->group = af;
+        w->nGroup++;
+        break;
+      }
+      if (af->fd >= 0 && as->Sync == SUDS_SYNC_EVENT && fdatasync (af->fd) != 0)
+      {
+        logit ("e", "SudsAsync: unable to sync %s: %s\n", af->path, strerror (errno));
+        af->status = EW_FAILURE;
+      }
+      FinishFile (af);
+      break;
+    }
+  }
+  if (nrun > 0)
+    RunWrites (w, run, nrun);
+
+  for (job = jobs; job != NULL; job = next)
+  {
+    next = job->next;
+    freed += job->len;
+    free (job);
+  }
+  if (freed > 0)
+  {
+    pthread_mutex_lock (&as->qmutex);
+    as->Queued -= freed;
+    pthread_cond_broadcast (&as->qroom);
+    pthread_mutex_unlock (&as->qmutex);
+  }
+}
+
+/* Write a run of jobs that don't overlap each other: all at once through *
+ * the ring if there is one, otherwise one after another                  */
+static void RunWrites (AWORKER *w, AJOB **run, int n)
+{
+  AJOB  *job;
+  int    i;
+
+#ifdef SUDS_HAVE_URING
+  if (w->haveRing)
+  {
+    URING                 *r = &w->ring;
+    struct io_uring_sqe   *sqe;
+    char                   done[URING_DEPTH];
+    unsigned               tail, first;
+    int                    submitted, got, ret, err;
+
+    first = tail = *r->sq_tail;
+    for (i = 0; i < n; i++)
+    {
+      unsigned idx = tail & *r->sq_mask;
+
+      sqe = &r->sqes[idx];
+      memset (sqe, 0, sizeof (*sqe));
+      sqe->opcode = IORING_OP_WRITEV;
+      sqe->fd = run[i]->af->fd;
+      sqe->addr = (unsigned long) &run[i]->iov;
+      sqe->len = 1;
+      sqe->off = run[i]->off;
+      sqe->user_data = i;
+      r->sq_array[idx] = idx;
+      done[i] = 0;
+      tail++;
+    }
+    __atomic_store_n (r->sq_tail, tail, __ATOMIC_RELEASE);
+
+    for (submitted = 0, got = 0; got < n; )
+    {
+      ret = (int) syscall (__NR_io_uring_enter, r->fd, n - submitted, n - got,
+                           IORING_ENTER_GETEVENTS, NULL, 0);
+      if (ret < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+      submitted += ret;
+      got += UringReap (r, run, done);
+    }
+    if (got == n)
+      return;
+
+    /* The ring has failed us; don't trust it again. Writes the kernel *
+     * has already taken still point into the jobs, so wait for every  *
+     * one of them to complete before the ring goes and the rest are   *
+     * written with pwrite.                                            */
+    err = errno;
+    got += UringReap (r, run, done);
+    while (got < (int) (__atomic_load_n (r->sq_head, __ATOMIC_ACQUIRE) - first))
+    {
+      ret = (int) syscall (__NR_io_uring_enter, r->fd, 0, 1,
+                           IORING_ENTER_GETEVENTS, NULL, 0);
+      if (ret < 0 && errno != EINTR)
+      {
+        struct timespec  nap = { 0, 1000000L };
+
+        nanosleep (&nap, NULL);
+      }
+      got += UringReap (r, run, done);
+    }
+    logit ("e", "SudsAsync: io_uring_enter failed (%s); using pwrite\n", strerror (err));
+    UringClose (r);
+    w->haveRing = 0;
+    for (i = 0; i < n; i++)
+      if (!done[i]
+          && PwriteAll (run[i]->af->fd, run[i]->data, run[i]->len, run[i]->off) != EW_SUCCESS)
+        run[i]->af->status = EW_FAILURE;
+    return;
+  }
+#endif
+
+  for (i = 0; i < n; i++)
+  {
+    job = run[i];
+    if (PwriteAll (job->af->fd, job->data, job->len, job->off) != EW_SUCCESS)
+    {
+      logit ("e", "SudsAsync: write to %s failed: %s\n", job->af->path, strerror (errno));
+      job->af->status = EW_FAILURE;
+    }
+  }
+}
+
+/* Sync and finish every file waiting for the group sync */
+static void GroupSync (AWORKER *w)
+{
+  SUDS_AFILE  *af, *next;
+
+  for (af = w->group; af != NULL; af = af->nextGroup)
+    if (fdatasync (af->fd) != 0)
+    {
+      logit ("e", "SudsAsync: unable to sync %s: %s\n", af->path, strerror (errno));
+      af->status = EW_FAILURE;
+    }
+  for (af = w->group; af != NULL; af = next)
+  {
+    next = af->nextGroup;
+    FinishFile (af);
+  }
+  w->group = NULL;
+  w->nGroup = 0;
+}
+
+/* When the files waiting for the group sync must be synced by */
+static void GroupDue (AWORKER *w, struct timespec *due)
+{
+  *due = w->groupStart;
+  due->tv_sec += w->as->GroupMs / 1000;
+  due->tv_nsec += (long) (w->as->GroupMs % 1000) * 1000000L;
+  if (due->tv_nsec >= 1000000000L)
+  {
+    due->tv_sec++;
+    due->tv_nsec -= 1000000000L;
+  }
+}
+
+/* Close the file, report how it went and forget it */
+static void FinishFile (SUDS_AFILE *af)
+{
+  if (af->fd >= 0 && close (af->fd) != 0)
+  {
+    logit ("e", "SudsAsync: unable to close %s: %s\n", af->path, strerror (errno));
+    af->status = EW_FAILURE;
+  }
+  if (af->done != NULL)
+    af->done (af->arg, af->path, af->status);
+  free (af);
+}
+
+static int PwriteAll (int fd, const char *buf, size_t len, off_t off)
+{
+  ssize_t  done;
+
+  while (len > 0)
+  {
+    if ((done = pwrite (fd, buf, len, off)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return EW_FAILURE;
+    }
+    buf += done;
+    off += done;
+    len -= done;
+  }
+  return EW_SUCCESS;
+}
+
+#ifdef SUDS_HAVE_URING
+/* Set up a ring and map its queues */
+static int UringSetup (URING *r, unsigned entries)
+{
+  struct io_uring_params  p;
+  char                   *sq, *cq;
+
+  memset (r, 0, sizeof (URING));
+  memset (&p, 0, sizeof (p));
+  if ((r->fd = (int) syscall (__NR_io_uring_setup, entries, &p)) < 0)
+    return EW_FAILURE;
+
+  r->sq_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+  r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+  r->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+
+  r->sq_ring = mmap (NULL, r->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  r->cq_ring = mmap (NULL, r->cq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+  r->sqes = (struct io_uring_sqe *) mmap (NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (r->sq_ring == MAP_FAILED || r->cq_ring == MAP_FAILED || r->sqes == MAP_FAILED)
+  {
+    UringClose (r);
+    return EW_FAILURE;
+  }
+
+  sq = (char *) r->sq_ring;
+  cq = (char *) r->cq_ring;
+  r->sq_head = (unsigned *) (sq + p.sq_off.head);
+  r->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+  r->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+  r->sq_array = (unsigned *) (sq + p.sq_off.array);
+  r->cq_head = (unsigned *) (cq + p.cq_off.head);
+  r->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+  r->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+  return EW_SUCCESS;
+}
+
+/* Take every completion the ring has ready, finish its job and mark it *
+ * done; return how many there were                                    */
+static int UringReap (URING *r, AJOB **run, char *done)
+{
+  struct io_uring_cqe  *cqe;
+  AJOB                 *job;
+  unsigned              head;
+  int                   got = 0;
+
+  head = *r->cq_head;
+  while (head != __atomic_load_n (r->cq_tail, __ATOMIC_ACQUIRE))
+  {
+    cqe = &r->cqes[head & *r->cq_mask];
+    job = run[cqe->user_data];
+    done[cqe->user_data] = 1;
+    if (cqe->res < 0)
+    {
+      logit ("e", "SudsAsync: write to %s failed: %s\n",
+             job->af->path, strerror (-cqe->res));
+      job->af->status = EW_FAILURE;
+    }
+    else if ((size_t) cqe->res < job->len
+             && PwriteAll (job->af->fd, job->data + cqe->res,
+                           job->len - cqe->res, job->off + cqe->res) != EW_SUCCESS)
+    {
+      job->af->status = EW_FAILURE;
+    }
+    head++;
+    got++;
+  }
+  __atomic_store_n (r->cq_head, head, __ATOMIC_RELEASE);
+  return got;
+}
+
+static void UringClose (URING *r)
+{
+  if (r->sq_ring != NULL && r->sq_ring != MAP_FAILED)
+    munmap (r->sq_ring, r->sq_size);
+  if (r->cq_ring != NULL && r->cq_ring != MAP_FAILED)
+    munmap (r->cq_ring, r->cq_size);
+  if (r->sqes != NULL && (void *) r->sqes != MAP_FAILED)
+    munmap (r->sqes, r->sqes_size);
+  close (r->fd);
+  memset (r, 0, sizeof (URING));
+  r->fd = -1;
+}
+#endif
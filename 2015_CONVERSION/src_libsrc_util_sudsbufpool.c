@@ -0,0 +1,374 @@
+/* sudsbufpool.c
+
+        Shared sample buffers for the SUDS putaway routines; see
+        sudsbufpool.h
+
+   Kept buffers sit on one list per size class, linked through their
+   first word. The bookkeeping (and any waiting) is done under the
+   pool's mutex, the allocating and copying outside it. Whether a
+   buffer is mapped or malloc'd follows from its size, so the two kinds
+   never need telling apart any other way. Waiting for memory is done
+   the way SudsDemuxFiles waits on its budget: on a condition that is
+   broadcast whenever bytes come back, and never while there is
+   nobody to give any back.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <earthworm.h>
+#include <sudsbufpool.h>
+
+#define NCLASS   40                    /* SUDS_BUF_MIN << 39 is plenty */
+
+struct _SUDS_BUFPOOL
+{
+  size_t           Cap;                /* 0 for none */
+  int              Huge;               /* map big buffers on hugepages */
+  volatile int     NoHugetlb;          /* MAP_HUGETLB failed; THP only */
+  pthread_mutex_t  mutex;
+  pthread_cond_t   freed;              /* bytes given back, or a holder stalled */
+  void            *kept[NCLASS];       /* given back, by class */
+  size_t           stuck;              /* bytes held by threads that are waiting */
+  SUDS_BUFSTATS    st;
+};
+
+/* Internal Function Prototypes */
+static size_t ClassSize (SUDS_BUFPOOL *, size_t);
+static int ClassOf (size_t);
+static int Mapped (SUDS_BUFPOOL *, size_t);
+static void *Take (SUDS_BUFPOOL *, size_t, size_t);
+static void DropKept (SUDS_BUFPOOL *, size_t);
+static void *Alloc (SUDS_BUFPOOL *, size_t);
+static void Free (SUDS_BUFPOOL *, void *, size_t);
+static void *MapHuge (SUDS_BUFPOOL *, size_t);
+
+/************************************************************************
+* SudsBufPoolCreate: a new pool, holding nothing yet                    *
+*************************************************************************/
+SUDS_BUFPOOL *SudsBufPoolCreate (size_t Cap, int Huge)
+{
+  SUDS_BUFPOOL *bp;
+
+  if ((bp = (SUDS_BUFPOOL *) calloc (1, sizeof (SUDS_BUFPOOL))) == NULL)
+  {
+    logit ("e", "SudsBufPoolCreate: out of memory\n");
+    return NULL;
+  }
+  bp->Cap = Cap;
+  bp->Huge = Huge;
+  pthread_mutex_init (&bp->mutex, NULL);
+  pthread_cond_init (&bp->freed, NULL);
+  return bp;
+}
+
+size_t SudsBufPoolCap (SUDS_BUFPOOL *bp)
+{
+  return (bp == NULL) ? 0 : bp->Cap;
+}
+
+/************************************************************************
+* SudsBufGet: a buffer of at least want bytes, waiting for room under   *
+*       the cap if it has to                                            *
+*************************************************************************/
+void *SudsBufGet (SUDS_BUFPOOL *bp, size_t want, size_t *size)
+{
+  void   *p;
+
+  if (bp == NULL || size == NULL || (bp->Cap > 0 && want > bp->Cap))
+    return NULL;
+  *size = ClassSize (bp, want);
+  if ((p = Take (bp, *size, 0)) == NULL
+      && (p = Alloc (bp, *size)) == NULL)
+  {
+    logit ("e", "SudsBufGet: couldn't allocate %lu bytes\n",
+           (unsigned long) *size);
+    pthread_mutex_lock (&bp->mutex);
+    bp->st.InUse -= *size;
+    pthread_cond_broadcast (&bp->freed);
+    pthread_mutex_unlock (&bp->mutex);
+  }
+  return p;
+}
+
+/************************************************************************
+* SudsBufGrow: move the first keep bytes of buf into a bigger buffer    *
+*       and give buf back. The caller holds buf while it waits for      *
+*       room, which SudsBufGet's callers don't.                         *
+*************************************************************************/
+void *SudsBufGrow (SUDS_BUFPOOL *bp, void *buf, size_t keep, size_t want,
+                   size_t *size)
+{
+  size_t  nsize;
+  void   *p;
+
+  if (buf == NULL)
+    return SudsBufGet (bp, want, size);
+  if (bp == NULL || size == NULL || (bp->Cap > 0 && want > bp->Cap))
+    return NULL;
+  if (want <= *size)
+    return buf;
+  nsize = ClassSize (bp, want);
+  if ((p = Take (bp, nsize, *size)) == NULL
+      && (p = Alloc (bp, nsize)) == NULL)
+  {
+    logit ("e", "SudsBufGrow: couldn't allocate %lu bytes\n",
+           (unsigned long) nsize);
+    pthread_mutex_lock (&bp->mutex);
+    bp->st.InUse -= nsize;
+    pthread_cond_broadcast (&bp->freed);
+    pthread_mutex_unlock (&bp->mutex);
+    return NULL;
+  }
+  memcpy (p, buf, (keep < *size) ? keep : *size);
+  SudsBufPut (bp, buf, *size);
+  *size = nsize;
+  return p;
+}
+
+/************************************************************************
+* SudsBufPut: keep buf for the next caller wanting its class, unless    *
+*       it is an odd size or the pool is over its cap                   *
+*************************************************************************/
+void SudsBufPut (SUDS_BUFPOOL *bp, void *buf, size_t size)
+{
+  int  c;
+
+  if (bp == NULL || buf == NULL)
+    return;
+  pthread_mutex_lock (&bp->mutex);
+  bp->st.InUse -= size;
+  if ((c = ClassOf (size)) >= 0
+      && (bp->Cap == 0 || bp->st.InUse + bp->st.Kept + size <= bp->Cap))
+  {
+    *(void **) buf = bp->kept[c];
+    bp->kept[c] = buf;
+    bp->st.Kept += size;
+    buf = NULL;
+  }
+  pthread_cond_broadcast (&bp->freed);
+  pthread_mutex_unlock (&bp->mutex);
+  if (buf != NULL)
+    Free (bp, buf, size);
+}
+
+/************************************************************************
+* SudsBufStall: a thread holding held bytes is going to wait on         *
+*       something else (a batch writer waiting its turn, say) and       *
+*       can't give them back until then; so nobody waits on it          *
+*************************************************************************/
+void SudsBufStall (SUDS_BUFPOOL *bp, size_t held, int stalled)
+{
+  if (bp == NULL || held == 0)
+    return;
+  pthread_mutex_lock (&bp->mutex);
+  if (stalled)
+  {
+    bp->stuck += held;
+    pthread_cond_broadcast (&bp->freed);
+  }
+  else
+    bp->stuck -= held;
+  pthread_mutex_unlock (&bp->mutex);
+}
+
+void SudsBufPoolStats (SUDS_BUFPOOL *bp, SUDS_BUFSTATS *st)
+{
+  if (bp == NULL)
+  {
+    memset (st, 0, sizeof (SUDS_BUFSTATS));
+    return;
+  }
+  pthread_mutex_lock (&bp->mutex);
+  *st = bp->st;
+  pthread_mutex_unlock (&bp->mutex);
+}
+
+/************************************************************************
+* SudsBufPoolDestroy: free the kept buffers and the pool                *
+*************************************************************************/
+void SudsBufPoolDestroy (SUDS_BUFPOOL *bp)
+{
+  void  *p;
+  int    c;
+
+  if (bp == NULL)
+    return;
+  if (bp->st.InUse > 0)
+    logit ("e", "SudsBufPoolDestroy: %lu bytes never given back\n",
+           (unsigned long) bp->st.InUse);
+  for (c = 0; c < NCLASS; c++)
+    while ((p = bp->kept[c]) != NULL)
+    {
+      bp->kept[c] = *(void **) p;
+      Free (bp, p, (size_t) SUDS_BUF_MIN << c);
+    }
+  pthread_cond_destroy (&bp->freed);
+  pthread_mutex_destroy (&bp->mutex);
+  free (bp);
+}
+
+/* The size to give someone wanting want bytes: the class it falls in, *
+ * or, where that would be over the cap, just what was asked for       */
+static size_t ClassSize (SUDS_BUFPOOL *bp, size_t want)
+{
+  size_t  size = SUDS_BUF_MIN;
+  size_t  huge;
+
+  while (size < want && size <= SIZE_MAX / 2)
+    size <<= 1;
+  if (size < want || (bp->Cap > 0 && size > bp->Cap))
+  {
+    size = want;
+    huge = (want + SUDS_BUF_HUGE - 1) / SUDS_BUF_HUGE * SUDS_BUF_HUGE;
+    if (bp->Huge && want >= SUDS_BUF_HUGE && (bp->Cap == 0 || huge <= bp->Cap))
+      size = huge;
+  }
+  return size;
+}
+
+/* The class of a buffer size, -1 for an odd one */
+static int ClassOf (size_t size)
+{
+  int  c;
+
+  for (c = 0; c < NCLASS; c++)
+    if (size == (size_t) SUDS_BUF_MIN << c)
+      return c;
+  return -1;
+}
+
+static int Mapped (SUDS_BUFPOOL *bp, size_t size)
+{
+  return bp->Huge && size >= SUDS_BUF_HUGE && size % SUDS_BUF_HUGE == 0;
+}
+
+/* Count size bytes as given out, making room under the cap first, and *
+ * hand back a kept buffer of that size if there is one; NULL means    *
+ * the caller must allocate it. held is what the caller holds while    *
+ * it waits.                                                           */
+static void *Take (SUDS_BUFPOOL *bp, size_t size, size_t held)
+{
+  void   *p = NULL;
+  int     c = ClassOf (size);
+  int     waited = 0;
+
+  pthread_mutex_lock (&bp->mutex);
+  bp->st.Gets++;
+  if (c >= 0 && (p = bp->kept[c]) != NULL)
+  {
+    bp->kept[c] = *(void **) p;
+    bp->st.Kept -= size;
+    bp->st.Reused++;
+  }
+  else if (bp->Cap > 0)
+  {
+    bp->stuck += held;
+    while (bp->st.InUse + bp->st.Kept + size > bp->Cap)
+    {
+      if (bp->st.Kept > 0)
+      {
+        DropKept (bp, bp->st.InUse + bp->st.Kept + size - bp->Cap);
+        continue;
+      }
+      /* everything given out is held by someone waiting too */
+      if (bp->st.InUse <= bp->stuck)
+      {
+        bp->st.Overdrafts++;
+        break;
+      }
+      if (!waited)
+      {
+        bp->st.Waits++;
+        waited = 1;
+        if (held > 0)
+          pthread_cond_broadcast (&bp->freed);
+      }
+      pthread_cond_wait (&bp->freed, &bp->mutex);
+    }
+    bp->stuck -= held;
+  }
+  bp->st.InUse += size;
+  if (bp->st.Peak < bp->st.InUse + bp->st.Kept)
+    bp->st.Peak = bp->st.InUse + bp->st.Kept;
+  pthread_mutex_unlock (&bp->mutex);
+  return p;
+}
+
+/* Free kept buffers, biggest first, until excess bytes are gone or *
+ * none are left; called with the mutex held                         */
+static void DropKept (SUDS_BUFPOOL *bp, size_t excess)
+{
+  size_t  size;
+  void   *p;
+  int     c;
+
+  for (c = NCLASS - 1; c >= 0 && bp->st.Kept > 0; c--)
+  {
+    size = (size_t) SUDS_BUF_MIN << c;
+    while ((p = bp->kept[c]) != NULL)
+    {
+      bp->kept[c] = *(void **) p;
+      bp->st.Kept -= size;
+      Free (bp, p, size);
+      if (size >= excess)
+        return;
+      excess -= size;
+    }
+  }
+}
+
+static void *Alloc (SUDS_BUFPOOL *bp, size_t size)
+{
+  if (Mapped (bp, size))
+    return MapHuge (bp, size);
+  return malloc (size);
+}
+
+static void Free (SUDS_BUFPOOL *bp, void *p, size_t size)
+{
+  if (Mapped (bp, size))
+    munmap (p, size);
+  else
+    free (p);
+}
+
+/* size bytes on hugepages: reserved ones if there are any, else 2 MB *
+ * aligned so the kernel can back them with transparent ones          */
+static void *MapHuge (SUDS_BUFPOOL *bp, size_t size)
+{
+  char    *p;
+  size_t   lead;
+
+#ifdef MAP_HUGETLB
+  if (!bp->NoHugetlb)
+  {
+    p = (char *) mmap (NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != (char *) MAP_FAILED)
+    {
+      __sync_fetch_and_add (&bp->st.Huge, 1);
+      return p;
+    }
+    bp->NoHugetlb = 1;                 /* none reserved; stop asking */
+  }
+#endif
+  p = (char *) mmap (NULL, size + SUDS_BUF_HUGE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == (char *) MAP_FAILED)
+    return NULL;
+  lead = (SUDS_BUF_HUGE - (uintptr_t) p % SUDS_BUF_HUGE) % SUDS_BUF_HUGE;
+  if (lead > 0)
+    munmap (p, lead);
+  munmap (p + lead + size, SUDS_BUF_HUGE - lead);
+  p += lead;
+#ifdef MADV_HUGEPAGE
+  if (madvise (p, size, MADV_HUGEPAGE) == 0)
+    __sync_fetch_and_add (&bp->st.Huge, 1);
+#endif
+  return p;
+}
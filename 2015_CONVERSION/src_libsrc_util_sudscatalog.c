@@ -0,0 +1,693 @@
+/* sudscatalog.c
+
+        Columnar, memory-mapped catalog of SUDS traces; see sudscatalog.h
+
+   Dir/catalog.hdr holds a CAT_HEAD, mapped shared so readers see the
+   row count move; Dir/<column>.col is each column. All the column
+   files are kept the same number of rows long and mapped whole; when
+   they are full they are all lengthened to twice that and mapped
+   again. The writer holds an flock on the header for as long as it
+   has the catalog open.
+
+   The day rollup finds each row's group in a hash table and sums it
+   there, in one pass over the columns in place; only the groups are
+   sorted. The uptime rollup sorts the spans that fall in its time, by
+   group and beginning, and merges each group's.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <earthworm.h>
+#include <sudscatalog.h>
+
+#define CAT_MAGIC      "SCAT"
+#define CAT_VERSION    2
+#define CAT_ORDER      0x01020304      /* as the writing machine stores it */
+#define CAT_MIN_ROWS   4096            /* rows the columns start with */
+#define CAT_MAXPATH    1024
+
+typedef struct
+{
+  char     magic[4];                   /* CAT_MAGIC */
+  int32_t  version;
+  int32_t  order;                      /* CAT_ORDER */
+  int32_t  ncols;
+  int64_t  nrows;                      /* rows complete in every column */
+} CAT_HEAD;
+
+/* The columns, in SUDS_CATROW order */
+typedef struct
+{
+  const char *name;                    /* <name>.col */
+  size_t      width;                   /* bytes an entry */
+  size_t      off;                     /* in SUDS_CATROW */
+} CAT_COLDESC;
+
+static const CAT_COLDESC Col[] =
+{
+  { "id",        SUDS_CAT_IDLEN,     offsetof (SUDS_CATROW, id) },
+  { "begintime", sizeof (double),    offsetof (SUDS_CATROW, begintime) },
+  { "rate",      sizeof (double),    offsetof (SUDS_CATROW, rate) },
+  { "nsamp",     sizeof (int64_t),   offsetof (SUDS_CATROW, nsamp) },
+  { "mindata",   sizeof (int32_t),   offsetof (SUDS_CATROW, mindata) },
+  { "maxdata",   sizeof (int32_t),   offsetof (SUDS_CATROW, maxdata) },
+  { "gaps",      sizeof (int32_t),   offsetof (SUDS_CATROW, gaps) },
+  { "clipped",   sizeof (int64_t),   offsetof (SUDS_CATROW, clipped) },
+  { "file",      sizeof (uint64_t),  offsetof (SUDS_CATROW, file) },
+  { "quality",   sizeof (float),     offsetof (SUDS_CATROW, quality) },
+  { "snr",       sizeof (float),     offsetof (SUDS_CATROW, snr) },
+};
+#define NCOL  ((int) (sizeof (Col) / sizeof (Col[0])))
+
+struct _SUDS_CATALOG
+{
+  int              Write;
+  char             Dir[CAT_MAXPATH];
+  int              hfd;                /* header file */
+  CAT_HEAD        *head;
+  int              fd[NCOL];           /* column files */
+  char            *col[NCOL];          /* ... mapped */
+  long             cap;                /* rows mapped */
+  long             nrows;              /* rows added, or there at opening */
+  pthread_mutex_t  mutex;              /* adding and remapping */
+};
+
+/* The groups of a day rollup, found by an open-addressed hash on day *
+ * and name, and the files each has been seen with, likewise           */
+typedef struct
+{
+  long         g;                      /* group, or -1 for an empty slot */
+  uint64_t     file;
+} CAT_FSLOT;
+
+typedef struct
+{
+  SUDS_CATDAY *d;                      /* the groups */
+  int32_t     *day;                    /* ... their days since 1970 */
+  long         n, max;
+  long        *slot;                   /* group + 1, or 0 */
+  long         size;                   /* a power of two */
+  CAT_FSLOT   *fslot;
+  long         nf, fsize;
+} CAT_GROUPS;
+
+/* A trace's part of an uptime span */
+typedef struct
+{
+  const char  *key;                    /* group name, in the id column */
+  int          klen;
+  double       b, e;
+} CAT_KEY;
+
+static int OpenCols (SUDS_CATALOG *);
+static int MapCols (SUDS_CATALOG *, long);
+static void Cols (SUDS_CATALOG *, SUDS_CATCOLS *);
+static int KeyLen (const char *, int);
+static int KeyCmp (const CAT_KEY *, const CAT_KEY *);
+static long FindGroup (CAT_GROUPS *, int32_t, const char *, int);
+static int AddFile (CAT_GROUPS *, long, uint64_t);
+static int CompareCatDay (const void *, const void *);
+static int CompareSpan (const void *, const void *);
+static long YearMonthDay (int32_t);
+
+SUDS_CATALOG *SudsCatalogOpen (const char *Dir, int Write)
+{
+  SUDS_CATALOG  *cat;
+  char           path[CAT_MAXPATH + 32];
+  struct stat    sb;
+  int            i;
+
+  if (Dir == NULL || strlen (Dir) >= CAT_MAXPATH)
+  {
+    logit ("e", "SudsCatalogOpen: bad catalog directory\n");
+    return NULL;
+  }
+  if ((cat = (SUDS_CATALOG *) calloc (1, sizeof (SUDS_CATALOG))) == NULL)
+  {
+    logit ("e", "SudsCatalogOpen: couldn't malloc catalog\n");
+    return NULL;
+  }
+  cat->Write = Write;
+  strcpy (cat->Dir, Dir);
+  cat->hfd = -1;
+  for (i = 0; i < NCOL; i++)
+    cat->fd[i] = -1;
+  pthread_mutex_init (&cat->mutex, NULL);
+
+  if (Write && mkdir (Dir, 0755) != 0 && errno != EEXIST)
+  {
+    logit ("e", "SudsCatalogOpen: can't make %s: %s\n", Dir, strerror (errno));
+    goto fail;
+  }
+  sprintf (path, "%s/catalog.hdr", Dir);
+  if ((cat->hfd = open (path, Write ? O_RDWR | O_CREAT : O_RDONLY, 0644)) < 0
+      || fstat (cat->hfd, &sb) != 0)
+  {
+    logit ("e", "SudsCatalogOpen: can't open %s: %s\n", path, strerror (errno));
+    goto fail;
+  }
+  if (Write && flock (cat->hfd, LOCK_EX | LOCK_NB) != 0)
+  {
+    logit ("e", "SudsCatalogOpen: %s is open for writing elsewhere\n", Dir);
+    goto fail;
+  }
+  if (Write && sb.st_size == 0
+      && ftruncate (cat->hfd, sizeof (CAT_HEAD)) != 0)
+  {
+    logit ("e", "SudsCatalogOpen: can't write %s: %s\n", path, strerror (errno));
+    goto fail;
+  }
+  if ((sb.st_size != 0 && sb.st_size != sizeof (CAT_HEAD))
+      || (!Write && sb.st_size == 0))
+  {
+    logit ("e", "SudsCatalogOpen: %s isn't a catalog header\n", path);
+    goto fail;
+  }
+  if ((cat->head = (CAT_HEAD *) mmap (NULL, sizeof (CAT_HEAD),
+                                      Write ? PROT_READ | PROT_WRITE : PROT_READ,
+                                      MAP_SHARED, cat->hfd, 0)) == MAP_FAILED)
+  {
+    cat->head = NULL;
+    logit ("e", "SudsCatalogOpen: can't map %s: %s\n", path, strerror (errno));
+    goto fail;
+  }
+  if (sb.st_size == 0)
+  {
+    cat->head->version = CAT_VERSION;
+    cat->head->order = CAT_ORDER;
+    cat->head->ncols = NCOL;
+    cat->head->nrows = 0;
+    memcpy (cat->head->magic, CAT_MAGIC, 4);
+  }
+  if (memcmp (cat->head->magic, CAT_MAGIC, 4) != 0
+      || cat->head->version != CAT_VERSION || cat->head->order != CAT_ORDER
+      || cat->head->ncols != NCOL)
+  {
+    logit ("e", "SudsCatalogOpen: %s is not a version %d catalog in this "
+           "machine's byte order\n", Dir, CAT_VERSION);
+    goto fail;
+  }
+  cat->nrows = (long) __atomic_load_n (&cat->head->nrows, __ATOMIC_ACQUIRE);
+  if (OpenCols (cat) != EW_SUCCESS)
+    goto fail;
+  return cat;
+
+fail:
+  SudsCatalogClose (cat);
+  return NULL;
+}
+
+/* Open and map the column files, as many rows as all of them hold */
+static int OpenCols (SUDS_CATALOG *cat)
+{
+  char         path[CAT_MAXPATH + 32];
+  struct stat  sb;
+  long         cap = -1;
+  int          i;
+
+  for (i = 0; i < NCOL; i++)
+  {
+    sprintf (path, "%s/%s.col", cat->Dir, Col[i].name);
+    if ((cat->fd[i] = open (path, cat->Write ? O_RDWR | O_CREAT : O_RDONLY,
+                            0644)) < 0
+        || fstat (cat->fd[i], &sb) != 0)
+    {
+      logit ("e", "SudsCatalogOpen: can't open %s: %s\n", path,
+             strerror (errno));
+      return EW_FAILURE;
+    }
+    if (cap < 0 || sb.st_size / (off_t) Col[i].width < cap)
+      cap = (long) (sb.st_size / (off_t) Col[i].width);
+  }
+  if (cat->nrows > cap)
+  {
+    if (cat->Write)
+    {
+      logit ("e", "SudsCatalogOpen: columns of %s are short\n", cat->Dir);
+      return EW_FAILURE;
+    }
+    cat->nrows = cap;                  /* caught mid-growth */
+  }
+  return MapCols (cat, cap);
+}
+
+/* Map every column cap rows long, lengthening the files first if *
+ * writing                                                         */
+static int MapCols (SUDS_CATALOG *cat, long cap)
+{
+  char  *p;
+  int    i;
+
+  for (i = 0; i < NCOL; i++)
+  {
+    if (cat->Write && ftruncate (cat->fd[i], (off_t) cap * Col[i].width) != 0)
+    {
+      logit ("e", "SudsCatalogAdd: can't grow %s/%s.col: %s\n", cat->Dir,
+             Col[i].name, strerror (errno));
+      return EW_FAILURE;
+    }
+    p = NULL;
+    if (cap > 0
+        && (p = (char *) mmap (NULL, cap * Col[i].width,
+                               cat->Write ? PROT_READ | PROT_WRITE : PROT_READ,
+                               MAP_SHARED, cat->fd[i], 0)) == MAP_FAILED)
+    {
+      logit ("e", "SudsCatalogOpen: can't map %s/%s.col: %s\n", cat->Dir,
+             Col[i].name, strerror (errno));
+      return EW_FAILURE;
+    }
+    if (cat->col[i] != NULL)
+      munmap (cat->col[i], cat->cap * Col[i].width);
+    cat->col[i] = p;
+  }
+  cat->cap = cap;
+  return EW_SUCCESS;
+}
+
+int SudsCatalogAdd (SUDS_CATALOG *cat, const SUDS_CATROW *row)
+{
+  int  i;
+
+  if (cat == NULL || !cat->Write)
+    return EW_FAILURE;
+  pthread_mutex_lock (&cat->mutex);
+  if (cat->nrows == cat->cap
+      && MapCols (cat, (cat->cap > 0) ? 2 * cat->cap : CAT_MIN_ROWS)
+         != EW_SUCCESS)
+  {
+    pthread_mutex_unlock (&cat->mutex);
+    return EW_FAILURE;
+  }
+  for (i = 0; i < NCOL; i++)
+    memcpy (cat->col[i] + cat->nrows * Col[i].width,
+            (const char *) row + Col[i].off, Col[i].width);
+  cat->nrows++;
+  __atomic_store_n (&cat->head->nrows, (int64_t) cat->nrows, __ATOMIC_RELEASE);
+  pthread_mutex_unlock (&cat->mutex);
+  return EW_SUCCESS;
+}
+
+/* FNV-1a */
+uint64_t SudsCatalogFileKey (const char *FileName)
+{
+  uint64_t  h = 14695981039346656037ULL;
+
+  for (; *FileName != '\0'; FileName++)
+    h = (h ^ (unsigned char) *FileName) * 1099511628211ULL;
+  return h;
+}
+
+long SudsCatalogRows (SUDS_CATALOG *cat)
+{
+  return (cat != NULL) ? cat->nrows : 0;
+}
+
+/* The columns as they are mapped now; a writer's move when it next grows */
+int SudsCatalogCols (SUDS_CATALOG *cat, SUDS_CATCOLS *cols)
+{
+  if (cat == NULL)
+    return EW_FAILURE;
+  pthread_mutex_lock (&cat->mutex);
+  Cols (cat, cols);
+  pthread_mutex_unlock (&cat->mutex);
+  return EW_SUCCESS;
+}
+
+static void Cols (SUDS_CATALOG *cat, SUDS_CATCOLS *cols)
+{
+  cols->nrows = cat->nrows;
+  cols->id = cat->col[0];
+  cols->begintime = (const double *) cat->col[1];
+  cols->rate = (const double *) cat->col[2];
+  cols->nsamp = (const int64_t *) cat->col[3];
+  cols->mindata = (const int32_t *) cat->col[4];
+  cols->maxdata = (const int32_t *) cat->col[5];
+  cols->gaps = (const int32_t *) cat->col[6];
+  cols->clipped = (const int64_t *) cat->col[7];
+  cols->file = (const uint64_t *) cat->col[8];
+  cols->quality = (const float *) cat->col[9];
+  cols->snr = (const float *) cat->col[10];
+}
+
+/* The rollups hold the lock throughout, since they read the columns in *
+ * place and a writer adding a row may move them                         */
+int SudsCatalogByDay (SUDS_CATALOG *cat, int By, SUDS_CATDAY **day, long *n)
+{
+  SUDS_CATCOLS  c;
+  CAT_GROUPS    gr;
+  SUDS_CATDAY  *d;
+  const char   *key;
+  uint64_t      pf = 0;
+  long          i, g, pg = -1;
+  int           klen, nf, ret = EW_FAILURE;
+
+  *day = NULL;
+  *n = 0;
+  if (cat == NULL)
+    return EW_FAILURE;
+  memset (&gr, 0, sizeof (gr));
+  pthread_mutex_lock (&cat->mutex);
+  Cols (cat, &c);
+  for (i = 0; i < c.nrows; i++)
+  {
+    key = c.id + i * SUDS_CAT_IDLEN;
+    klen = KeyLen (key, By);
+    if ((g = FindGroup (&gr, (int32_t) floor (c.begintime[i] / 86400.0),
+                        key, klen)) < 0)
+      goto done;
+    d = &gr.d[g];
+    if (d->traces == 0)
+    {
+      d->mindata = c.mindata[i];
+      d->maxdata = c.maxdata[i];
+    }
+
+    /* a file's channels mostly come one after another */
+    if (g != pg || c.file[i] != pf)
+    {
+      if ((nf = AddFile (&gr, g, c.file[i])) < 0)
+        goto done;
+      d->files += nf;
+      pg = g;
+      pf = c.file[i];
+    }
+    d->traces++;
+    d->samples += c.nsamp[i];
+    if (c.rate[i] > 0.0)
+      d->seconds += c.nsamp[i] / c.rate[i];
+    d->gaps += c.gaps[i];
+    d->clipped += c.clipped[i];
+    if (d->mindata > c.mindata[i])
+      d->mindata = c.mindata[i];
+    if (d->maxdata < c.maxdata[i])
+      d->maxdata = c.maxdata[i];
+    if (c.quality[i] >= 0.0f)
+    {
+      d->checked++;
+      d->bad += (c.quality[i] == 0.0f);
+      d->quality += c.quality[i];
+    }
+  }
+  for (g = 0; g < gr.n; g++)
+    gr.d[g].quality = (gr.d[g].checked > 0)
+                      ? gr.d[g].quality / gr.d[g].checked : -1.0;
+  ret = EW_SUCCESS;
+
+done:
+  pthread_mutex_unlock (&cat->mutex);
+  free (gr.day);
+  free (gr.slot);
+  free (gr.fslot);
+  if (ret != EW_SUCCESS)
+  {
+    logit ("e", "SudsCatalogByDay: couldn't malloc rollup\n");
+    free (gr.d);
+    return EW_FAILURE;
+  }
+  qsort (gr.d, gr.n, sizeof (SUDS_CATDAY), CompareCatDay);
+  *day = gr.d;
+  *n = gr.n;
+  return EW_SUCCESS;
+}
+
+/* The group for day and key, added if it is new; -1 if out of memory */
+static long FindGroup (CAT_GROUPS *gr, int32_t day, const char *key, int klen)
+{
+  SUDS_CATDAY  *d;
+  int32_t      *dy;
+  uint64_t      h = 14695981039346656037ULL ^ (uint32_t) day;
+  long          s = 0, g, i;
+  int           k;
+
+  for (k = 0; k < klen; k++)
+    h = (h ^ (unsigned char) key[k]) * 1099511628211ULL;
+  if (gr->size > 0)
+    for (s = (long) (h & (gr->size - 1)); (g = gr->slot[s] - 1) >= 0;
+         s = (s + 1) & (gr->size - 1))
+      if (gr->day[g] == day && memcmp (gr->d[g].id, key, klen) == 0
+          && gr->d[g].id[klen] == '\0')
+        return g;
+
+  /* new: make room, in the table at no more than half full */
+  if (gr->n == gr->max)
+  {
+    gr->max = (gr->max > 0) ? 2 * gr->max : 1024;
+    if ((d = (SUDS_CATDAY *) realloc (gr->d, gr->max * sizeof (SUDS_CATDAY))) == NULL)
+      return -1;
+    gr->d = d;
+    if ((dy = (int32_t *) realloc (gr->day, gr->max * sizeof (int32_t))) == NULL)
+      return -1;
+    gr->day = dy;
+  }
+  if (2 * (gr->n + 1) > gr->size)
+  {
+    free (gr->slot);
+    gr->size = (gr->size > 0) ? 2 * gr->size : 2048;
+    if ((gr->slot = (long *) calloc (gr->size, sizeof (long))) == NULL)
+      return -1;
+    for (i = 0; i < gr->n; i++)
+    {
+      h = 14695981039346656037ULL ^ (uint32_t) gr->day[i];
+      for (k = 0; gr->d[i].id[k] != '\0'; k++)
+        h = (h ^ (unsigned char) gr->d[i].id[k]) * 1099511628211ULL;
+      for (s = (long) (h & (gr->size - 1)); gr->slot[s] != 0;
+           s = (s + 1) & (gr->size - 1))
+        ;
+      gr->slot[s] = i + 1;
+    }
+    return FindGroup (gr, day, key, klen);
+  }
+  g = gr->n++;
+  memset (&gr->d[g], 0, sizeof (SUDS_CATDAY));
+  memcpy (gr->d[g].id, key, klen);
+  gr->d[g].yyyymmdd = YearMonthDay (day);
+  gr->day[g] = day;
+  gr->slot[s] = g + 1;
+  return g;
+}
+
+/* Note that group g has file; 1 if it hadn't yet, 0 if it had, -1 if *
+ * out of memory                                                       */
+static int AddFile (CAT_GROUPS *gr, long g, uint64_t file)
+{
+  CAT_FSLOT  *old, *fs;
+  uint64_t    h;
+  long        s, i, osize;
+
+  if (2 * (gr->nf + 1) > gr->fsize)
+  {
+    old = gr->fslot;
+    osize = gr->fsize;
+    gr->fsize = (osize > 0) ? 2 * osize : 4096;
+    if ((gr->fslot = (CAT_FSLOT *) malloc (gr->fsize * sizeof (CAT_FSLOT))) == NULL)
+    {
+      gr->fslot = old;
+      gr->fsize = osize;
+      return -1;
+    }
+    for (s = 0; s < gr->fsize; s++)
+      gr->fslot[s].g = -1;
+    for (i = 0; i < osize; i++)
+      if (old[i].g >= 0)
+      {
+        h = (old[i].file ^ (uint64_t) old[i].g) * 0x9E3779B97F4A7C15ULL;
+        for (s = (long) (h >> 32) & (gr->fsize - 1); gr->fslot[s].g >= 0;
+             s = (s + 1) & (gr->fsize - 1))
+          ;
+        gr->fslot[s] = old[i];
+      }
+    free (old);
+  }
+  h = (file ^ (uint64_t) g) * 0x9E3779B97F4A7C15ULL;
+  for (s = (long) (h >> 32) & (gr->fsize - 1); (fs = &gr->fslot[s])->g >= 0;
+       s = (s + 1) & (gr->fsize - 1))
+    if (fs->g == g && fs->file == file)
+      return 0;
+  fs->g = g;
+  fs->file = file;
+  gr->nf++;
+  return 1;
+}
+
+int SudsCatalogUptime (SUDS_CATALOG *cat, int By, double t0, double t1,
+                       SUDS_CATUPTIME **up, long *n)
+{
+  SUDS_CATCOLS    c;
+  CAT_KEY        *k = NULL;
+  SUDS_CATUPTIME *u = NULL;
+  double          b, e, end = 0.0;
+  long            i, nk, g, ng;
+
+  *up = NULL;
+  *n = 0;
+  if (cat == NULL || t1 <= t0)
+    return EW_FAILURE;
+  pthread_mutex_lock (&cat->mutex);
+  Cols (cat, &c);
+  if (c.nrows == 0)
+    goto done;
+  if ((k = (CAT_KEY *) malloc (c.nrows * sizeof (CAT_KEY))) == NULL)
+    goto nomem;
+
+  /* the traces that overlap the span, cut down to it */
+  for (nk = 0, i = 0; i < c.nrows; i++)
+  {
+    if (c.rate[i] <= 0.0)
+      continue;
+    b = c.begintime[i];
+    e = b + c.nsamp[i] / c.rate[i];
+    if (e <= t0 || b >= t1)
+      continue;
+    k[nk].key = c.id + i * SUDS_CAT_IDLEN;
+    k[nk].klen = KeyLen (k[nk].key, By);
+    k[nk].b = (b > t0) ? b : t0;
+    k[nk].e = (e < t1) ? e : t1;
+    nk++;
+  }
+  if (nk == 0)
+    goto done;
+  qsort (k, nk, sizeof (CAT_KEY), CompareSpan);
+
+  for (ng = 1, i = 1; i < nk; i++)
+    if (KeyCmp (&k[i], &k[i-1]) != 0)
+      ng++;
+  if ((u = (SUDS_CATUPTIME *) calloc (ng, sizeof (SUDS_CATUPTIME))) == NULL)
+    goto nomem;
+
+  /* spans are in order of beginning within each group, so each covers *
+   * only what it reaches beyond the furthest end so far                */
+  for (g = -1, i = 0; i < nk; i++)
+  {
+    if (i == 0 || KeyCmp (&k[i], &k[i-1]) != 0)
+    {
+      g++;
+      memcpy (u[g].id, k[i].key, k[i].klen);
+      end = t0;
+    }
+    u[g].traces++;
+    if (k[i].e > end)
+    {
+      u[g].seconds += k[i].e - ((k[i].b > end) ? k[i].b : end);
+      end = k[i].e;
+    }
+  }
+  for (g = 0; g < ng; g++)
+    u[g].fraction = u[g].seconds / (t1 - t0);
+  *up = u;
+  *n = ng;
+
+done:
+  pthread_mutex_unlock (&cat->mutex);
+  free (k);
+  return EW_SUCCESS;
+
+nomem:
+  pthread_mutex_unlock (&cat->mutex);
+  logit ("e", "SudsCatalogUptime: couldn't malloc rollup\n");
+  free (k);
+  return EW_FAILURE;
+}
+
+int SudsCatalogClose (SUDS_CATALOG *cat)
+{
+  int  i, ret = EW_SUCCESS;
+
+  if (cat == NULL)
+    return EW_SUCCESS;
+  for (i = 0; i < NCOL; i++)
+  {
+    if (cat->col[i] != NULL)
+    {
+      if (cat->Write && msync (cat->col[i], cat->cap * Col[i].width, MS_SYNC) != 0)
+        ret = EW_FAILURE;
+      munmap (cat->col[i], cat->cap * Col[i].width);
+    }
+    if (cat->fd[i] >= 0)
+      close (cat->fd[i]);
+  }
+  if (cat->head != NULL)
+  {
+    if (cat->Write && msync (cat->head, sizeof (CAT_HEAD), MS_SYNC) != 0)
+      ret = EW_FAILURE;
+    munmap (cat->head, sizeof (CAT_HEAD));
+  }
+  if (cat->hfd >= 0)
+    close (cat->hfd);                  /* and with it the flock */
+  pthread_mutex_destroy (&cat->mutex);
+  free (cat);
+  return ret;
+}
+
+/* How much of the trace id id names the group: all of it, its NET.STA, *
+ * or none                                                              */
+static int KeyLen (const char *id, int By)
+{
+  const char  *dot;
+  int          len;
+
+  for (len = 0; len < SUDS_CAT_IDLEN - 1 && id[len] != '\0'; len++)
+    ;
+  if (By == SUDS_CAT_ALL)
+    return 0;
+  if (By == SUDS_CAT_STA && (dot = memchr (id, '.', len)) != NULL
+      && (dot = memchr (dot + 1, '.', len - (dot + 1 - id))) != NULL)
+    return (int) (dot - id);
+  return len;
+}
+
+static int KeyCmp (const CAT_KEY *a, const CAT_KEY *b)
+{
+  int  c;
+
+  c = memcmp (a->key, b->key, (a->klen < b->klen) ? a->klen : b->klen);
+  if (c != 0)
+    return c;
+  return a->klen - b->klen;
+}
+
+/* By day, then id */
+static int CompareCatDay (const void *pa, const void *pb)
+{
+  const SUDS_CATDAY  *a = (const SUDS_CATDAY *) pa;
+  const SUDS_CATDAY  *b = (const SUDS_CATDAY *) pb;
+
+  if (a->yyyymmdd != b->yyyymmdd)
+    return (a->yyyymmdd < b->yyyymmdd) ? -1 : 1;
+  return strcmp (a->id, b->id);
+}
+
+/* By group, then beginning */
+static int CompareSpan (const void *pa, const void *pb)
+{
+  const CAT_KEY  *a = (const CAT_KEY *) pa;
+  const CAT_KEY  *b = (const CAT_KEY *) pb;
+  int             c;
+
+  if ((c = KeyCmp (a, b)) != 0)
+    return c;
+  if (a->b != b->b)
+    return (a->b < b->b) ? -1 : 1;
+  return 0;
+}
+
+/* Days since 1970 as yyyymmdd, UTC */
+static long YearMonthDay (int32_t day)
+{
+  time_t     t = (time_t) day * 86400;
+  struct tm  tm;
+
+  gmtime_r (&t, &tm);
+  return (tm.tm_year + 1900) * 10000L + (tm.tm_mon + 1) * 100L + tm.tm_mday;
+}
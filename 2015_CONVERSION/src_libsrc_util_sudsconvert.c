@@ -0,0 +1,807 @@
+/* sudsconvert.c
+
+        Sample conversion kernels for sudsputaway.c
+
+   SUDSPA_next used to make three passes over every trace: one to widen
+   the TRACE_BUF samples into a long buffer, one to narrow them back to
+   shorts, and one to byte-swap the result, and then went back over the
+   start of the trace for avenoise. The kernels here do the
+   widen/clip/swap in one pass and take the trace statistics
+   (sudsstats.h) as they go.
+
+   The vector kernels keep min/max, the sum (in 64-bit lanes, so it is
+   exact), the sum of squares and the clip count in registers and fold
+   them into the SUDS_STATS once per call. The first SUDS_HEAD_SAMPLES
+   samples of a trace go through the scalar kernel, which also adds
+   them up for avenoise.
+
+   The SSE2 and AVX2 versions are compiled with per-function target
+   attributes, so this file needs no special compiler flags; which set
+   is used is decided at run time by SudsConvertInit.
+
+   Samples are int16_t and int32_t whatever the width of the C types:
+   an i4 TRACE_BUF sample and a SUDS long sample are both 4 bytes, even
+   where long is 8.
+*/
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <earthworm.h>
+#include <swap.h>
+#include <sudsstats.h>
+#include <sudsconvert.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SUDS_CONV_X86
+#include <immintrin.h>
+#endif
+
+/* Internal Function Prototypes */
+static void ConvShortScalar (const int16_t *, int16_t *, long, int,
+                             SUDS_STATS *);
+static void ConvLongScalar (const int32_t *, int32_t *, long, int,
+                            SUDS_STATS *);
+static void ConvFloatScalar (const float *, int32_t *, long, int, SUDS_STATS *);
+static void DeinterleaveScalar (const char *, long, int, short *const *);
+static int SteimDiffScalar (const int32_t *, long, int32_t, int32_t *,
+                            unsigned char *);
+
+void (*SudsConvShort) (const int16_t *, int16_t *, long, int, SUDS_STATS *) =
+  ConvShortScalar;
+void (*SudsConvLong) (const int32_t *, int32_t *, long, int, SUDS_STATS *) =
+  ConvLongScalar;
+void (*SudsConvFloat) (const float *, int32_t *, long, int, SUDS_STATS *) =
+  ConvFloatScalar;
+void (*SudsDeinterleave) (const char *, long, int, short *const *) =
+  DeinterleaveScalar;
+int (*SudsSteimDiff) (const int32_t *, long, int32_t, int32_t *,
+                      unsigned char *) = SteimDiffScalar;
+
+static const char *ConvName = "scalar";
+
+
+/*
+ *  Scalar kernels; also used for the head and tail of each vector loop
+ */
+
+/* Fold one (native order) sample into the running statistics */
+#define STATS_ADD(st, x) \
+  do { \
+    if ((x) > (st)->max) \
+      (st)->max = (x); \
+    if ((x) < (st)->min) \
+      (st)->min = (x); \
+    if ((x) >= (st)->cliphi || (x) <= (st)->cliplo) \
+      (st)->nclip++; \
+    (st)->sum += (x); \
+    (st)->sumsq += (double) (x) * (double) (x); \
+    if ((st)->nhead < SUDS_HEAD_SAMPLES) \
+    { \
+      (st)->headsum += (x); \
+      (st)->nhead++; \
+    } \
+  } while (0)
+
+static void ConvShortScalar (const int16_t *in, int16_t *out, long n,
+                             int swap, SUDS_STATS *st)
+{
+  long  j;
+
+  if (out == NULL)
+  {
+    for (j = 0; j < n; j++)
+      STATS_ADD (st, (int32_t) in[j]);
+    st->n += n;
+    return;
+  }
+  for (j = 0; j < n; j++)
+  {
+    out[j] = in[j];
+    STATS_ADD (st, (int32_t) in[j]);
+    if (swap)
+      SwapShort (&out[j]);
+  }
+  st->n += n;
+}
+
+static void ConvLongScalar (const int32_t *in, int32_t *out, long n,
+                            int swap, SUDS_STATS *st)
+{
+  long  j;
+
+  for (j = 0; j < n; j++)
+  {
+    out[j] = in[j];
+    STATS_ADD (st, in[j]);
+    if (swap)
+      SwapInt32 (&out[j]);
+  }
+  st->n += n;
+}
+
+static void ConvFloatScalar (const float *in, int32_t *out, long n, int swap,
+                             SUDS_STATS *st)
+{
+  long  j;
+
+  /* CLIP the data to 32-bit int; a NaN is 0 */
+  for (j = 0; j < n; j++)
+  {
+    if (in[j] != in[j])
+      out[j] = 0;
+    else if (in[j] < (float) INT32_MIN)
+      out[j] = INT32_MIN;
+    else if (in[j] >= (float) INT32_MAX)
+      out[j] = INT32_MAX;
+    else
+      out[j] = (int32_t) in[j];
+    STATS_ADD (st, out[j]);
+    if (swap)
+      SwapInt32 (&out[j]);
+  }
+  st->n += n;
+}
+
+void SudsFillShort (int16_t *out, long n, int16_t value, int swap)
+{
+  long  j;
+
+  if (swap)
+    SwapShort (&value);
+  for (j = 0; j < n; j++)
+    out[j] = value;
+}
+
+void SudsFillLong (int32_t *out, long n, int32_t value, int swap)
+{
+  long  j;
+
+  if (swap)
+    SwapInt32 (&value);
+  for (j = 0; j < n; j++)
+    out[j] = value;
+}
+
+/* Channels from..nch-1 of scans from..nscan-1 (the part the vector *
+ * kernel leaves), one scan at a time; mux need not be aligned, so   *
+ * each sample is copied out of it                                   */
+static void DeinterleaveRange (const char *mux, long nscan, int nch,
+                               short *const *out, long first, int from)
+{
+  const char  *p;
+  long         i;
+  int          c;
+
+  for (i = first; i < nscan; i++)
+  {
+    p = mux + i * nch * sizeof (short);
+    for (c = from; c < nch; c++)
+      memcpy (&out[c][i], p + c * sizeof (short), sizeof (short));
+  }
+}
+
+static void DeinterleaveScalar (const char *mux, long nscan, int nch,
+                                short *const *out)
+{
+  DeinterleaveRange (mux, nscan, nch, out, 0, 0);
+}
+
+/* Steim2 width class of a difference, from a = d ^ (d >> 31): how many *
+ * of the field widths 4, 5, 6, 8, 10, 15 and 30 bits it doesn't fit   */
+#define STEIM_CLASS(a) \
+  (((a) >= 8) + ((a) >= 16) + ((a) >= 32) + ((a) >= 128) + ((a) >= 512) \
+   + ((a) >= 16384) + ((a) >= (1ul << 29)))
+
+static int SteimDiffScalar (const int32_t *x, long n, int32_t prev,
+                            int32_t *d, unsigned char *cls)
+{
+  unsigned long  a;
+  int32_t        v;
+  long           i;
+  int            c, top = 0;
+
+  for (i = 0; i < n; i++)
+  {
+    /* modulo 2^32, as the decoder adds them back up */
+    v = (int32_t) ((uint32_t) x[i] - (uint32_t) prev);
+    prev = x[i];
+    a = (uint32_t) (v ^ (v >> 31));
+    c = STEIM_CLASS (a);
+    d[i] = v;
+    cls[i] = (unsigned char) c;
+    if (c > top)
+      top = c;
+  }
+  return top;
+}
+
+
+#ifdef SUDS_CONV_X86
+
+/* Samples at the start of this call still wanted for avenoise */
+static long HeadLeft (const SUDS_STATS *st, long n)
+{
+  long  k = SUDS_HEAD_SAMPLES - st->nhead;
+
+  if (k < 0)
+    k = 0;
+  return (k < n) ? k : n;
+}
+
+/* Clip thresholds for a vector compare: one step inside the clip values, *
+ * so "x > hi" means x >= cliphi; limited to the range of the lanes       */
+static int32_t ClipInside (int64_t clip, int step, int32_t lo, int32_t hi)
+{
+  clip += step;
+  if (clip < lo)
+    return lo;
+  if (clip > hi)
+    return hi;
+  return (int32_t) clip;
+}
+
+/* Fold vector partial results into the statistics */
+static void ReduceStats (SUDS_STATS *st, const int *lo, const int *hi, int nlanes,
+                         const int64_t *sum, const double *sumsq, int nsum,
+                         long nclip, long n)
+{
+  int  k;
+
+  for (k = 0; k < nlanes; k++)
+  {
+    if (lo[k] < st->min)
+      st->min = lo[k];
+    if (hi[k] > st->max)
+      st->max = hi[k];
+  }
+  for (k = 0; k < nsum; k++)
+  {
+    st->sum += sum[k];
+    st->sumsq += sumsq[k];
+  }
+  st->nclip += nclip;
+  st->n += n;
+}
+
+
+/*
+ *  SSE2 kernels
+ */
+
+/* SSE2 has no 32-bit min/max; build them from compare and select */
+__attribute__((target("sse2")))
+static __m128i Min32Sse2 (__m128i a, __m128i b)
+{
+  __m128i gt = _mm_cmpgt_epi32 (a, b);
+  return _mm_or_si128 (_mm_and_si128 (gt, b), _mm_andnot_si128 (gt, a));
+}
+
+__attribute__((target("sse2")))
+static __m128i Max32Sse2 (__m128i a, __m128i b)
+{
+  __m128i gt = _mm_cmpgt_epi32 (a, b);
+  return _mm_or_si128 (_mm_and_si128 (gt, a), _mm_andnot_si128 (gt, b));
+}
+
+__attribute__((target("sse2")))
+static __m128i Swap32Sse2 (__m128i v)
+{
+  v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+  return _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (v, 0xB1), 0xB1);
+}
+
+__attribute__((target("sse2")))
+static void ConvShortSse2 (const int16_t *in, int16_t *out, long n, int swap,
+                           SUDS_STATS *st)
+{
+  long       j = HeadLeft (st, n);
+  long       nclip = 0;
+  int16_t    tmps[8];
+  int        lo32[8], hi32[8];
+  int64_t    sum[2], sq[2];
+  double     sqd[2];
+  int        k, m;
+  __m128i    lo = _mm_set1_epi16 (SHRT_MAX);
+  __m128i    hi = _mm_set1_epi16 (SHRT_MIN);
+  __m128i    ones = _mm_set1_epi16 (1);
+  __m128i    zero = _mm_setzero_si128 ();
+  __m128i    vsum = zero, vsq = zero;
+  __m128i    clo = _mm_set1_epi16 (ClipInside (st->cliplo, 1, SHRT_MIN, SHRT_MAX));
+  __m128i    chi = _mm_set1_epi16 (ClipInside (st->cliphi, -1, SHRT_MIN, SHRT_MAX));
+  long       j0;
+
+  ConvShortScalar (in, out, j, swap, st);
+  for (j0 = j; j + 8 <= n; j += 8)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (in + j));
+    __m128i s, q;
+
+    lo = _mm_min_epi16 (lo, v);
+    hi = _mm_max_epi16 (hi, v);
+    /* pairwise sums and squares; the squares are unsigned 32-bit */
+    s = _mm_madd_epi16 (v, ones);
+    q = _mm_madd_epi16 (v, v);
+    vsum = _mm_add_epi64 (vsum, _mm_unpacklo_epi32 (s, _mm_srai_epi32 (s, 31)));
+    vsum = _mm_add_epi64 (vsum, _mm_unpackhi_epi32 (s, _mm_srai_epi32 (s, 31)));
+    vsq = _mm_add_epi64 (vsq, _mm_unpacklo_epi32 (q, zero));
+    vsq = _mm_add_epi64 (vsq, _mm_unpackhi_epi32 (q, zero));
+    m = _mm_movemask_epi8 (_mm_or_si128 (_mm_cmpgt_epi16 (v, chi),
+                                         _mm_cmpgt_epi16 (clo, v)));
+    if (m != 0)
+      nclip += __builtin_popcount (m) / 2;
+    if (out == NULL)
+      continue;
+    if (swap)
+      v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+    _mm_storeu_si128 ((__m128i *) (out + j), v);
+  }
+  if (j > j0)
+  {
+    _mm_storeu_si128 ((__m128i *) tmps, lo);
+    for (k = 0; k < 8; k++)
+      lo32[k] = tmps[k];
+    _mm_storeu_si128 ((__m128i *) tmps, hi);
+    for (k = 0; k < 8; k++)
+      hi32[k] = tmps[k];
+    _mm_storeu_si128 ((__m128i *) sum, vsum);
+    _mm_storeu_si128 ((__m128i *) sq, vsq);
+    sqd[0] = (double) sq[0];
+    sqd[1] = (double) sq[1];
+    ReduceStats (st, lo32, hi32, 8, sum, sqd, 2, nclip, j - j0);
+  }
+  ConvShortScalar (in + j, (out != NULL) ? out + j : NULL, n - j, swap, st);
+}
+
+/* Vector statistics for 32-bit samples */
+typedef struct
+{
+  __m128i  lo, hi;
+  __m128i  sum;                 /* two 64-bit lanes */
+  __m128d  sumsq;
+  __m128i  clo, chi;
+  long     nclip;
+} ACC32_SSE2;
+
+__attribute__((target("sse2")))
+static void Acc32InitSse2 (ACC32_SSE2 *acc, const SUDS_STATS *st)
+{
+  acc->lo = _mm_set1_epi32 (INT32_MAX);
+  acc->hi = _mm_set1_epi32 (INT32_MIN);
+  acc->sum = _mm_setzero_si128 ();
+  acc->sumsq = _mm_setzero_pd ();
+  acc->clo = _mm_set1_epi32 (ClipInside (st->cliplo, 1, INT32_MIN, INT32_MAX));
+  acc->chi = _mm_set1_epi32 (ClipInside (st->cliphi, -1, INT32_MIN, INT32_MAX));
+  acc->nclip = 0;
+}
+
+__attribute__((target("sse2")))
+static void Acc32AddSse2 (ACC32_SSE2 *acc, __m128i v)
+{
+  __m128i  sign = _mm_srai_epi32 (v, 31);
+  __m128d  d0 = _mm_cvtepi32_pd (v);
+  __m128d  d1 = _mm_cvtepi32_pd (_mm_srli_si128 (v, 8));
+  int      m;
+
+  acc->lo = Min32Sse2 (acc->lo, v);
+  acc->hi = Max32Sse2 (acc->hi, v);
+  acc->sum = _mm_add_epi64 (acc->sum, _mm_unpacklo_epi32 (v, sign));
+  acc->sum = _mm_add_epi64 (acc->sum, _mm_unpackhi_epi32 (v, sign));
+  acc->sumsq = _mm_add_pd (acc->sumsq, _mm_mul_pd (d0, d0));
+  acc->sumsq = _mm_add_pd (acc->sumsq, _mm_mul_pd (d1, d1));
+  m = _mm_movemask_ps (_mm_castsi128_ps (
+        _mm_or_si128 (_mm_cmpgt_epi32 (v, acc->chi),
+                      _mm_cmpgt_epi32 (acc->clo, v))));
+  if (m != 0)
+    acc->nclip += __builtin_popcount (m);
+}
+
+__attribute__((target("sse2")))
+static void Acc32ReduceSse2 (ACC32_SSE2 *acc, SUDS_STATS *st, long n)
+{
+  int        lo[4], hi[4];
+  int64_t    sum[2];
+  double     sq[2];
+
+  _mm_storeu_si128 ((__m128i *) lo, acc->lo);
+  _mm_storeu_si128 ((__m128i *) hi, acc->hi);
+  _mm_storeu_si128 ((__m128i *) sum, acc->sum);
+  _mm_storeu_pd (sq, acc->sumsq);
+  ReduceStats (st, lo, hi, 4, sum, sq, 2, acc->nclip, n);
+}
+
+__attribute__((target("sse2")))
+static void ConvLongSse2 (const int32_t *in, int32_t *out, long n, int swap,
+                          SUDS_STATS *st)
+{
+  long        j = HeadLeft (st, n);
+  long        j0;
+  ACC32_SSE2  acc;
+
+  ConvLongScalar (in, out, j, swap, st);
+  Acc32InitSse2 (&acc, st);
+  for (j0 = j; j + 4 <= n; j += 4)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (in + j));
+    Acc32AddSse2 (&acc, v);
+    if (swap)
+      v = Swap32Sse2 (v);
+    _mm_storeu_si128 ((__m128i *) (out + j), v);
+  }
+  if (j > j0)
+    Acc32ReduceSse2 (&acc, st, j - j0);
+  ConvLongScalar (in + j, out + j, n - j, swap, st);
+}
+
+__attribute__((target("sse2")))
+static void ConvFloatSse2 (const float *in, int32_t *out, long n, int swap,
+                           SUDS_STATS *st)
+{
+  long        j = HeadLeft (st, n);
+  long        j0;
+  ACC32_SSE2  acc;
+  __m128      top = _mm_set1_ps (2147483648.0f);
+  __m128i     imax = _mm_set1_epi32 (INT32_MAX);
+
+  ConvFloatScalar (in, out, j, swap, st);
+  Acc32InitSse2 (&acc, st);
+  /* cvttps gives INT_MIN for anything out of range, which is already *
+   * the right answer below the range; patch in INT_MAX above it, and *
+   * 0 for a NaN (the only value not ordered with itself)             */
+  for (j0 = j; j + 4 <= n; j += 4)
+  {
+    __m128   f = _mm_loadu_ps (in + j);
+    __m128i  over = _mm_castps_si128 (_mm_cmpge_ps (f, top));
+    __m128i  num = _mm_castps_si128 (_mm_cmpord_ps (f, f));
+    __m128i  v = _mm_cvttps_epi32 (f);
+    v = _mm_or_si128 (_mm_and_si128 (over, imax), _mm_andnot_si128 (over, v));
+    v = _mm_and_si128 (v, num);
+    Acc32AddSse2 (&acc, v);
+    if (swap)
+      v = Swap32Sse2 (v);
+    _mm_storeu_si128 ((__m128i *) (out + j), v);
+  }
+  if (j > j0)
+    Acc32ReduceSse2 (&acc, st, j - j0);
+  ConvFloatScalar (in + j, out + j, n - j, swap, st);
+}
+
+
+/*
+ *  AVX2 kernels
+ */
+
+__attribute__((target("avx2")))
+static void ConvShortAvx2 (const int16_t *in, int16_t *out, long n, int swap,
+                           SUDS_STATS *st)
+{
+  long       j = HeadLeft (st, n);
+  long       nclip = 0;
+  int16_t    tmps[16];
+  int        lo32[16], hi32[16];
+  int64_t    sum[4], sq[4];
+  double     sqd[4];
+  int        k;
+  unsigned   m;
+  __m256i    lo = _mm256_set1_epi16 (SHRT_MAX);
+  __m256i    hi = _mm256_set1_epi16 (SHRT_MIN);
+  __m256i    ones = _mm256_set1_epi16 (1);
+  __m256i    zero = _mm256_setzero_si256 ();
+  __m256i    vsum = zero, vsq = zero;
+  __m256i    clo = _mm256_set1_epi16 (ClipInside (st->cliplo, 1, SHRT_MIN, SHRT_MAX));
+  __m256i    chi = _mm256_set1_epi16 (ClipInside (st->cliphi, -1, SHRT_MIN, SHRT_MAX));
+  __m256i    shuf = _mm256_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10,
+                                      13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6,
+                                      9, 8, 11, 10, 13, 12, 15, 14);
+  long       j0;
+
+  ConvShortScalar (in, out, j, swap, st);
+  for (j0 = j; j + 16 <= n; j += 16)
+  {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *) (in + j));
+    __m256i s, q;
+
+    lo = _mm256_min_epi16 (lo, v);
+    hi = _mm256_max_epi16 (hi, v);
+    /* pairwise sums and squares; the squares are unsigned 32-bit */
+    s = _mm256_madd_epi16 (v, ones);
+    q = _mm256_madd_epi16 (v, v);
+    vsum = _mm256_add_epi64 (vsum, _mm256_unpacklo_epi32 (s, _mm256_srai_epi32 (s, 31)));
+    vsum = _mm256_add_epi64 (vsum, _mm256_unpackhi_epi32 (s, _mm256_srai_epi32 (s, 31)));
+    vsq = _mm256_add_epi64 (vsq, _mm256_unpacklo_epi32 (q, zero));
+    vsq = _mm256_add_epi64 (vsq, _mm256_unpackhi_epi32 (q, zero));
+    m = (unsigned) _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_cmpgt_epi16 (v, chi),
+                                                          _mm256_cmpgt_epi16 (clo, v)));
+    if (m != 0)
+      nclip += __builtin_popcount (m) / 2;
+    if (out == NULL)
+      continue;
+    if (swap)
+      v = _mm256_shuffle_epi8 (v, shuf);
+    _mm256_storeu_si256 ((__m256i *) (out + j), v);
+  }
+  if (j > j0)
+  {
+    _mm256_storeu_si256 ((__m256i *) tmps, lo);
+    for (k = 0; k < 16; k++)
+      lo32[k] = tmps[k];
+    _mm256_storeu_si256 ((__m256i *) tmps, hi);
+    for (k = 0; k < 16; k++)
+      hi32[k] = tmps[k];
+    _mm256_storeu_si256 ((__m256i *) sum, vsum);
+    _mm256_storeu_si256 ((__m256i *) sq, vsq);
+    for (k = 0; k < 4; k++)
+      sqd[k] = (double) sq[k];
+    ReduceStats (st, lo32, hi32, 16, sum, sqd, 4, nclip, j - j0);
+  }
+  ConvShortScalar (in + j, (out != NULL) ? out + j : NULL, n - j, swap, st);
+}
+
+/* Vector statistics for 32-bit samples */
+typedef struct
+{
+  __m256i  lo, hi;
+  __m256i  sum;                 /* four 64-bit lanes */
+  __m256d  sumsq;
+  __m256i  clo, chi;
+  long     nclip;
+} ACC32_AVX2;
+
+__attribute__((target("avx2")))
+static void Acc32InitAvx2 (ACC32_AVX2 *acc, const SUDS_STATS *st)
+{
+  acc->lo = _mm256_set1_epi32 (INT32_MAX);
+  acc->hi = _mm256_set1_epi32 (INT32_MIN);
+  acc->sum = _mm256_setzero_si256 ();
+  acc->sumsq = _mm256_setzero_pd ();
+  acc->clo = _mm256_set1_epi32 (ClipInside (st->cliplo, 1, INT32_MIN, INT32_MAX));
+  acc->chi = _mm256_set1_epi32 (ClipInside (st->cliphi, -1, INT32_MIN, INT32_MAX));
+  acc->nclip = 0;
+}
+
+__attribute__((target("avx2")))
+static void Acc32AddAvx2 (ACC32_AVX2 *acc, __m256i v)
+{
+  __m128i  v0 = _mm256_castsi256_si128 (v);
+  __m128i  v1 = _mm256_extracti128_si256 (v, 1);
+  __m256d  d0 = _mm256_cvtepi32_pd (v0);
+  __m256d  d1 = _mm256_cvtepi32_pd (v1);
+  int      m;
+
+  acc->lo = _mm256_min_epi32 (acc->lo, v);
+  acc->hi = _mm256_max_epi32 (acc->hi, v);
+  acc->sum = _mm256_add_epi64 (acc->sum, _mm256_cvtepi32_epi64 (v0));
+  acc->sum = _mm256_add_epi64 (acc->sum, _mm256_cvtepi32_epi64 (v1));
+  acc->sumsq = _mm256_add_pd (acc->sumsq, _mm256_mul_pd (d0, d0));
+  acc->sumsq = _mm256_add_pd (acc->sumsq, _mm256_mul_pd (d1, d1));
+  m = _mm256_movemask_ps (_mm256_castsi256_ps (
+        _mm256_or_si256 (_mm256_cmpgt_epi32 (v, acc->chi),
+                         _mm256_cmpgt_epi32 (acc->clo, v))));
+  if (m != 0)
+    acc->nclip += __builtin_popcount (m);
+}
+
+__attribute__((target("avx2")))
+static void Acc32ReduceAvx2 (ACC32_AVX2 *acc, SUDS_STATS *st, long n)
+{
+  int        lo[8], hi[8];
+  int64_t    sum[4];
+  double     sq[4];
+
+  _mm256_storeu_si256 ((__m256i *) lo, acc->lo);
+  _mm256_storeu_si256 ((__m256i *) hi, acc->hi);
+  _mm256_storeu_si256 ((__m256i *) sum, acc->sum);
+  _mm256_storeu_pd (sq, acc->sumsq);
+  ReduceStats (st, lo, hi, 8, sum, sq, 4, acc->nclip, n);
+}
+
+__attribute__((target("avx2")))
+static void ConvLongAvx2 (const int32_t *in, int32_t *out, long n, int swap,
+                          SUDS_STATS *st)
+{
+  long        j = HeadLeft (st, n);
+  long        j0;
+  ACC32_AVX2  acc;
+  __m256i     shuf = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8,
+                                       15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4,
+                                       11, 10, 9, 8, 15, 14, 13, 12);
+
+  ConvLongScalar (in, out, j, swap, st);
+  Acc32InitAvx2 (&acc, st);
+  for (j0 = j; j + 8 <= n; j += 8)
+  {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *) (in + j));
+    Acc32AddAvx2 (&acc, v);
+    if (swap)
+      v = _mm256_shuffle_epi8 (v, shuf);
+    _mm256_storeu_si256 ((__m256i *) (out + j), v);
+  }
+  if (j > j0)
+    Acc32ReduceAvx2 (&acc, st, j - j0);
+  ConvLongScalar (in + j, out + j, n - j, swap, st);
+}
+
+__attribute__((target("avx2")))
+static void ConvFloatAvx2 (const float *in, int32_t *out, long n, int swap,
+                           SUDS_STATS *st)
+{
+  long        j = HeadLeft (st, n);
+  long        j0;
+  ACC32_AVX2  acc;
+  __m256      top = _mm256_set1_ps (2147483648.0f);
+  __m256i     imax = _mm256_set1_epi32 (INT32_MAX);
+  __m256i     shuf = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8,
+                                       15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4,
+                                       11, 10, 9, 8, 15, 14, 13, 12);
+
+  ConvFloatScalar (in, out, j, swap, st);
+  Acc32InitAvx2 (&acc, st);
+  for (j0 = j; j + 8 <= n; j += 8)
+  {
+    __m256   f = _mm256_loadu_ps (in + j);
+    __m256i  over = _mm256_castps_si256 (_mm256_cmp_ps (f, top, _CMP_GE_OQ));
+    __m256i  num = _mm256_castps_si256 (_mm256_cmp_ps (f, f, _CMP_ORD_Q));
+    __m256i  v = _mm256_cvttps_epi32 (f);
+    v = _mm256_and_si256 (_mm256_blendv_epi8 (v, imax, over), num);
+    Acc32AddAvx2 (&acc, v);
+    if (swap)
+      v = _mm256_shuffle_epi8 (v, shuf);
+    _mm256_storeu_si256 ((__m256i *) (out + j), v);
+  }
+  if (j > j0)
+    Acc32ReduceAvx2 (&acc, st, j - j0);
+  ConvFloatScalar (in + j, out + j, n - j, swap, st);
+}
+
+/* De-interleave eight channels at a time: load eight scans of them as *
+ * the rows of an 8x8 block of shorts, transpose it with unpacks, and  *
+ * store the columns, eight samples of one channel each                */
+__attribute__((target("sse2")))
+static void DeinterleaveSse2 (const char *mux, long nscan, int nch,
+                              short *const *out)
+{
+  const char   *p;
+  size_t        row = nch * sizeof (short);
+  long          i;
+  int           c, k;
+  __m128i       r0, r1, r2, r3, r4, r5, r6, r7;
+  __m128i       t0, t1, t2, t3, t4, t5, t6, t7;
+
+  for (c = 0; c + 8 <= nch; c += 8)
+  {
+    for (i = 0; i + 8 <= nscan; i += 8)
+    {
+      p = mux + i * row + c * sizeof (short);
+      r0 = _mm_loadu_si128 ((const __m128i *) p);
+      r1 = _mm_loadu_si128 ((const __m128i *) (p + row));
+      r2 = _mm_loadu_si128 ((const __m128i *) (p + 2 * row));
+      r3 = _mm_loadu_si128 ((const __m128i *) (p + 3 * row));
+      r4 = _mm_loadu_si128 ((const __m128i *) (p + 4 * row));
+      r5 = _mm_loadu_si128 ((const __m128i *) (p + 5 * row));
+      r6 = _mm_loadu_si128 ((const __m128i *) (p + 6 * row));
+      r7 = _mm_loadu_si128 ((const __m128i *) (p + 7 * row));
+
+      /* pairs of rows, then fours, then all eight */
+      t0 = _mm_unpacklo_epi16 (r0, r1);
+      t1 = _mm_unpackhi_epi16 (r0, r1);
+      t2 = _mm_unpacklo_epi16 (r2, r3);
+      t3 = _mm_unpackhi_epi16 (r2, r3);
+      t4 = _mm_unpacklo_epi16 (r4, r5);
+      t5 = _mm_unpackhi_epi16 (r4, r5);
+      t6 = _mm_unpacklo_epi16 (r6, r7);
+      t7 = _mm_unpackhi_epi16 (r6, r7);
+      r0 = _mm_unpacklo_epi32 (t0, t2);
+      r1 = _mm_unpackhi_epi32 (t0, t2);
+      r2 = _mm_unpacklo_epi32 (t1, t3);
+      r3 = _mm_unpackhi_epi32 (t1, t3);
+      r4 = _mm_unpacklo_epi32 (t4, t6);
+      r5 = _mm_unpackhi_epi32 (t4, t6);
+      r6 = _mm_unpacklo_epi32 (t5, t7);
+      r7 = _mm_unpackhi_epi32 (t5, t7);
+
+      _mm_storeu_si128 ((__m128i *) (out[c] + i), _mm_unpacklo_epi64 (r0, r4));
+      _mm_storeu_si128 ((__m128i *) (out[c + 1] + i), _mm_unpackhi_epi64 (r0, r4));
+      _mm_storeu_si128 ((__m128i *) (out[c + 2] + i), _mm_unpacklo_epi64 (r1, r5));
+      _mm_storeu_si128 ((__m128i *) (out[c + 3] + i), _mm_unpackhi_epi64 (r1, r5));
+      _mm_storeu_si128 ((__m128i *) (out[c + 4] + i), _mm_unpacklo_epi64 (r2, r6));
+      _mm_storeu_si128 ((__m128i *) (out[c + 5] + i), _mm_unpackhi_epi64 (r2, r6));
+      _mm_storeu_si128 ((__m128i *) (out[c + 6] + i), _mm_unpacklo_epi64 (r3, r7));
+      _mm_storeu_si128 ((__m128i *) (out[c + 7] + i), _mm_unpackhi_epi64 (r3, r7));
+    }
+    /* the last few scans of these eight channels */
+    for (; i < nscan; i++)
+    {
+      p = mux + i * row + c * sizeof (short);
+      for (k = 0; k < 8; k++)
+        memcpy (&out[c + k][i], p + k * sizeof (short), sizeof (short));
+    }
+  }
+  DeinterleaveRange (mux, nscan, nch, out, 0, c);
+}
+
+/* Steim2 differences and their width classes four at a time: the  *
+ * class is minus the sum of the compare masks against each limit    */
+__attribute__((target("sse2")))
+static int SteimDiffSse2 (const int32_t *x, long n, int32_t prev,
+                          int32_t *d, unsigned char *cls)
+{
+  const __m128i  zero = _mm_setzero_si128 ();
+  __m128i        v, a, c, top = _mm_setzero_si128 ();
+  int            lanes[4], most, k, cs;
+  long           i;
+
+  if (n < 5)
+    return SteimDiffScalar (x, n, prev, d, cls);
+  most = SteimDiffScalar (x, 1, prev, d, cls);
+  for (i = 1; i + 4 <= n; i += 4)
+  {
+    v = _mm_sub_epi32 (_mm_loadu_si128 ((const __m128i *) (x + i)),
+                       _mm_loadu_si128 ((const __m128i *) (x + i - 1)));
+    _mm_storeu_si128 ((__m128i *) (d + i), v);
+    a = _mm_xor_si128 (v, _mm_srai_epi32 (v, 31));
+    c = _mm_cmpgt_epi32 (a, _mm_set1_epi32 (7));
+    c = _mm_add_epi32 (c, _mm_cmpgt_epi32 (a, _mm_set1_epi32 (15)));
+    c = _mm_add_epi32 (c, _mm_cmpgt_epi32 (a, _mm_set1_epi32 (31)));
+    c = _mm_add_epi32 (c, _mm_cmpgt_epi32 (a, _mm_set1_epi32 (127)));
+    c = _mm_add_epi32 (c, _mm_cmpgt_epi32 (a, _mm_set1_epi32 (511)));
+    c = _mm_add_epi32 (c, _mm_cmpgt_epi32 (a, _mm_set1_epi32 (16383)));
+    c = _mm_add_epi32 (c, _mm_cmpgt_epi32 (a, _mm_set1_epi32 ((1 << 29) - 1)));
+    c = _mm_sub_epi32 (zero, c);
+    top = _mm_max_epi16 (top, c);       /* 0..7, so the high halves are 0 */
+    c = _mm_packs_epi32 (c, c);
+    cs = _mm_cvtsi128_si32 (_mm_packus_epi16 (c, c));
+    memcpy (cls + i, &cs, 4);
+  }
+  _mm_storeu_si128 ((__m128i *) lanes, top);
+  for (k = 0; k < 4; k++)
+    if (lanes[k] > most)
+      most = lanes[k];
+  k = SteimDiffScalar (x + i, n - i, x[i - 1], d + i, cls + i);
+  return (k > most) ? k : most;
+}
+
+#endif /* SUDS_CONV_X86 */
+
+
+/************************************************************************
+* SudsConvertInit: point the conversion kernels at the best versions    *
+*       this CPU supports. Safe to call more than once.                 *
+*************************************************************************/
+void SudsConvertInit (void)
+{
+#ifdef SUDS_CONV_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    SudsConvShort = ConvShortAvx2;
+    SudsDeinterleave = DeinterleaveSse2;
+    SudsSteimDiff = SteimDiffSse2;
+    SudsConvLong = ConvLongAvx2;
+    SudsConvFloat = ConvFloatAvx2;
+    ConvName = "avx2";
+    return;
+  }
+  if (__builtin_cpu_supports ("sse2"))
+  {
+    SudsConvShort = ConvShortSse2;
+    SudsDeinterleave = DeinterleaveSse2;
+    SudsSteimDiff = SteimDiffSse2;
+    SudsConvLong = ConvLongSse2;
+    SudsConvFloat = ConvFloatSse2;
+    ConvName = "sse2";
+    return;
+  }
+#endif
+  SudsConvShort = ConvShortScalar;
+  SudsConvLong = ConvLongScalar;
+  SudsConvFloat = ConvFloatScalar;
+  SudsDeinterleave = DeinterleaveScalar;
+  SudsSteimDiff = SteimDiffScalar;
+  ConvName = "scalar";
+}
+
+const char *SudsConvertName (void)
+{
+  return ConvName;
+}
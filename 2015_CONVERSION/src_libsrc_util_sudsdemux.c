@@ -0,0 +1,621 @@
+/* sudsdemux.c
+
+        Demultiplexing of .WVM files; see sudsdemux.h
+
+   One pass over the mapped file finds the STATIONCOMPs and the MUXDATA
+   blocks; nothing is copied. Then one allocation holds every channel's
+   packets, laid out channel after channel just as a TRACE_REQ from
+   the wave server would hold them, and each block is de-interleaved
+   into its slot in every channel at once. SudsDemuxFiles runs files on
+   a SUDS_POOL; the memory budget is a count of the bytes allocated so
+   far, under a mutex, with a condition to wait on for it to drop.
+*/
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <earthworm.h>
+#include <swap.h>
+#include <trace_buf.h>
+#include <ws_clientII.h>
+#include <sudshead.h>
+#include <sudsconvert.h>
+#include <sudsreader.h>
+#include <sudsswap.h>
+#include <sudspool.h>
+#include <sudswriter.h>
+#include <sudsdemux.h>
+
+#define DEMUX_GAPTHRESH  1.5           /* samples; as wave2disk uses */
+
+#if SUDS_HOST_ORDER == SUDS_ORDER_INTEL
+#define NATIVE_SHORT     "i2"
+#else
+#define NATIVE_SHORT     "s2"
+#endif
+
+/* One MUXDATA block, in the file */
+typedef struct
+{
+  const char   *mux;                 /* may be unaligned */
+  long          nscan;
+  double        t0;
+  int           swap;
+} DEMUX_BLOCK;
+
+/* Memory in hand across the files of one SudsDemuxFiles call */
+typedef struct
+{
+  size_t           budget;             /* 0 for no limit */
+  size_t           inflight;
+  pthread_mutex_t  mutex;
+  pthread_cond_t   freed;
+} DEMUX_BUDGET;
+
+/* One SudsDemuxFiles call */
+typedef struct
+{
+  char           **paths;
+  const char      *OutDir;
+  SUDS_WRITER     *sw;                 /* one per worker */
+  DEMUX_BUDGET     budget;
+  int              debug;
+  int              nFailed;
+} DEMUX_JOB;
+
+static int DemuxFile (SUDS_WRITER *, const char *, const char *,
+                      DEMUX_BUDGET *, int);
+static int LoadFile (const char *, SUDS_DEMUXED *, SUDS_TRIG *,
+                     DEMUX_BUDGET *, int);
+static int MapColumns (const SUDS_STATIONCOMP *, int, int, int *);
+static void Reserve (DEMUX_BUDGET *, size_t);
+static void Release (DEMUX_BUDGET *, size_t);
+static void DemuxTask (void *, int, int);
+
+/************************************************************************
+* SudsDemuxFile: demultiplex one file                                   *
+*************************************************************************/
+int SudsDemuxFile (SUDS_WRITER *sw, const char *path, const char *outpath,
+                   int debug)
+{
+  return DemuxFile (sw, path, outpath, NULL, debug);
+}
+
+static int DemuxFile (SUDS_WRITER *sw, const char *path, const char *outpath,
+                      DEMUX_BUDGET *budget, int debug)
+{
+  SUDS_DEMUXED  dm;
+  int           ret;
+
+  if (sw == NULL || path == NULL || outpath == NULL)
+  {
+    logit ("e", "SudsDemuxFile: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+  /* a segmenting writer wants triggers per segment, so feeds its own */
+  if (LoadFile (path, &dm, sw->Segment ? NULL : sw->Trig, budget, debug)
+      != EW_SUCCESS)
+    return EW_FAILURE;
+  ret = SudsDemuxWrite (sw, &dm, outpath, debug);
+  SudsDemuxFree (&dm);
+  Release (budget, dm.size);
+  return ret;
+}
+
+/************************************************************************
+* SudsDemuxLoad: de-interleave a file into per-channel packets          *
+*************************************************************************/
+int SudsDemuxLoad (const char *path, SUDS_DEMUXED *dm, int debug)
+{
+  return LoadFile (path, dm, NULL, NULL, debug);
+}
+
+/* As SudsDemuxLoad; with tg, each block is also run through tg's *
+ * detectors, all channels at once, into dm->tr                     */
+static int LoadFile (const char *path, SUDS_DEMUXED *dm, SUDS_TRIG *tg,
+                     DEMUX_BUDGET *budget, int debug)
+{
+  SUDS_FILE         sf;
+  SUDS_REC          rec;
+  SUDS_MUXDATA      md;
+  SUDS_STATIONCOMP *sc = NULL, *more;
+  DEMUX_BLOCK      *blk = NULL, *mblk;
+  TRACE_HEADER     *wf;
+  TRACE_REQ        *req;
+  short           **samp = NULL;
+  char             *pkts = NULL, *p;
+  int              *col = NULL;
+  int               nsc = 0, maxsc = 0, nblk = 0, maxblk = 0;
+  int               nch = 0, c, b, ret, first = -1;
+  long              nscan = 0, i;
+  size_t            pos = 0, need = 0, chan_size;
+  double            rate = 0.0;
+  char              netname[5];
+
+  memset (dm, 0, sizeof (SUDS_DEMUXED));
+  if (path == NULL)
+  {
+    logit ("e", "SudsDemuxLoad: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+  if (SudsFileOpen (&sf, path) != EW_SUCCESS)
+    return EW_FAILURE;
+  memset (netname, 0, sizeof (netname));
+
+  /* Find the stations and the blocks */
+  while ((ret = SudsNextRec (&sf, &pos, &rec)) == EW_SUCCESS)
+  {
+    if (rec.id == STATIONCOMP)
+    {
+      if (nsc == maxsc)
+      {
+        maxsc = (maxsc == 0) ? 32 : 2 * maxsc;
+        if ((more = (SUDS_STATIONCOMP *) realloc (sc, maxsc * sizeof (*sc)))
+            == NULL)
+        {
+          logit ("e", "SudsDemuxLoad: out of memory\n");
+          goto fail;
+        }
+        sc = more;
+      }
+      if (SudsRecStruct (&rec, &sc[nsc], STATIONCOMP)
+          == EW_SUCCESS)
+        nsc++;
+    }
+    else if (rec.id == MUXDATA)
+    {
+      if (SudsRecStruct (&rec, &md, MUXDATA) != EW_SUCCESS)
+        goto fail;
+      if (md.typedata != 's' && md.typedata != 'q')
+      {
+        logit ("e", "SudsDemuxLoad: %s: can't demultiplex %c samples\n",
+               path, md.typedata);
+        goto fail;
+      }
+      if (md.numchans <= 0 || md.dig_rate <= 0.0
+          || (nblk > 0 && (md.numchans != nch || md.dig_rate != rate)))
+      {
+        logit ("e", "SudsDemuxLoad: %s: bad MUXDATA at %lu\n", path,
+               (unsigned long) rec.Offset);
+        goto fail;
+      }
+      nch = md.numchans;
+      rate = md.dig_rate;
+      if (nblk == 0)
+        memcpy (netname, md.netname, sizeof (md.netname));
+      if (md.numsamps <= 0
+          || md.numsamps > rec.len_data / (long) (nch * sizeof (short)))
+      {
+        logit ("e", "SudsDemuxLoad: %s: MUXDATA at %lu is short of samples\n",
+               path, (unsigned long) rec.Offset);
+        goto fail;
+      }
+      if (nblk == maxblk)
+      {
+        maxblk = (maxblk == 0) ? 64 : 2 * maxblk;
+        if ((mblk = (DEMUX_BLOCK *) realloc (blk, maxblk * sizeof (*blk)))
+            == NULL)
+        {
+          logit ("e", "SudsDemuxLoad: out of memory\n");
+          goto fail;
+        }
+        blk = mblk;
+      }
+      blk[nblk].mux = rec.Data;
+      blk[nblk].nscan = md.numsamps;
+      blk[nblk].t0 = md.begintime;
+      blk[nblk].swap = rec.swap;
+      nscan += md.numsamps;
+      nblk++;
+    }
+  }
+  if (ret != SUDS_EOF)
+  {
+    logit ("e", "SudsDemuxLoad: %s is damaged\n", path);
+    goto fail;
+  }
+  if (nblk == 0)
+  {
+    logit ("e", "SudsDemuxLoad: no MUXDATA in %s\n", path);
+    goto fail;
+  }
+  if (debug == 1)
+    logit ("", "SudsDemuxLoad: %s: %d channels, %d blocks, %ld scans\n",
+           path, nch, nblk, nscan);
+
+  /* Which station each column is */
+  if ((col = (int *) malloc (nch * sizeof (int))) == NULL
+      || (samp = (short **) malloc (nch * sizeof (short *))) == NULL)
+  {
+    logit ("e", "SudsDemuxLoad: out of memory\n");
+    goto fail;
+  }
+  MapColumns (sc, nsc, nch, col);
+
+  /* Every channel's packets in one piece: channel c is chan_size bytes *
+   * from c * chan_size on                                               */
+  chan_size = nblk * sizeof (TRACE_HEADER) + nscan * sizeof (short);
+  need = nch * chan_size;
+  Reserve (budget, need);
+  if ((pkts = (char *) malloc (need)) == NULL)
+  {
+    logit ("e", "SudsDemuxLoad: out of memory for %s\n", path);
+    goto fail;
+  }
+
+  for (c = 0; c < nch; c++)
+  {
+    wf = (TRACE_HEADER *) (pkts + c * chan_size);
+    memset (wf, 0, sizeof (TRACE_HEADER));
+    if (col[c] >= 0)
+    {
+      memcpy (wf->sta, sc[col[c]].sc_name.st_name,
+              sizeof (sc[col[c]].sc_name.st_name));
+      memcpy (wf->net, sc[col[c]].sc_name.network,
+              sizeof (sc[col[c]].sc_name.network));
+      wf->chan[0] = sc[col[c]].sc_name.component;
+    }
+    else
+    {
+      sprintf (wf->sta, "CH%03d", c % 1000);
+      strcpy (wf->net, netname);
+      wf->chan[0] = 'V';
+    }
+    wf->pinno = c;
+    wf->samprate = rate;
+    strcpy (wf->datatype, NATIVE_SHORT);
+  }
+
+  /* Take the channels on in the trigger engine, in column order, so *
+   * that the blocks can be fed to it as they are                      */
+  if (tg != NULL)
+  {
+    if ((dm->tr = (SUDS_TRIGGERS *) calloc (nch, sizeof (SUDS_TRIGGERS)))
+        == NULL)
+    {
+      logit ("e", "SudsDemuxLoad: out of memory\n");
+      goto fail;
+    }
+    for (c = 0; c < nch; c++)
+    {
+      wf = (TRACE_HEADER *) (pkts + c * chan_size);
+      ret = SudsTrigChannel (tg, wf->sta, wf->chan, wf->net, rate);
+      if (c == 0)
+        first = ret;
+      if (ret < 0 || ret != first + c)
+        break;
+    }
+    if (c < nch)
+    {
+      logit ("e", "SudsDemuxLoad: %s: channels not together in the trigger "
+             "engine; feeding them one at a time\n", path);
+      free (dm->tr);
+      dm->tr = NULL;
+    }
+  }
+
+  /* De-interleave each block into the next packet of every channel */
+  for (b = 0, pos = 0; b < nblk; b++)
+  {
+    if (dm->tr != NULL)
+      SudsTrigFeedMux (tg, first, nch, blk[b].mux, blk[b].swap, blk[b].nscan,
+                       blk[b].t0, dm->tr);
+    for (c = 0; c < nch; c++)
+    {
+      p = pkts + c * chan_size + pos;
+      if (b > 0)
+        memcpy (p, pkts + c * chan_size, sizeof (TRACE_HEADER));
+      wf = (TRACE_HEADER *) p;
+      wf->nsamp = (int) blk[b].nscan;
+      wf->starttime = blk[b].t0;
+      wf->endtime = blk[b].t0 + (blk[b].nscan - 1) / rate;
+      samp[c] = (short *) (p + sizeof (TRACE_HEADER));
+    }
+    SudsDeinterleave (blk[b].mux, blk[b].nscan, nch, samp);
+    if (blk[b].swap)
+      for (c = 0; c < nch; c++)
+        for (i = 0; i < blk[b].nscan; i++)
+          SwapShort (&samp[c][i]);
+    pos += sizeof (TRACE_HEADER) + blk[b].nscan * sizeof (short);
+  }
+
+  /* One TRACE_REQ per channel, as a wave server would hand it back */
+  if ((dm->req = (TRACE_REQ *) calloc (nch, sizeof (TRACE_REQ))) == NULL)
+  {
+    logit ("e", "SudsDemuxLoad: out of memory\n");
+    goto fail;
+  }
+  for (c = 0; c < nch; c++)
+  {
+    wf = (TRACE_HEADER *) (pkts + c * chan_size);
+    req = &dm->req[c];
+    strcpy (req->sta, wf->sta);
+    strcpy (req->chan, wf->chan);
+    strcpy (req->net, wf->net);
+    req->pinno = c;
+    req->pBuf = (char *) wf;
+    req->bufLen = chan_size;
+    req->actLen = (long) chan_size;
+    req->samprate = rate;
+    req->reqStarttime = req->actStarttime = blk[0].t0;
+    req->reqEndtime = req->actEndtime =
+      blk[nblk - 1].t0 + (blk[nblk - 1].nscan - 1) / rate;
+  }
+  dm->nch = nch;
+  dm->sc = sc;
+  dm->nsc = nsc;
+  dm->pkts = pkts;
+  dm->size = need;
+
+  free (samp);
+  free (col);
+  free (blk);
+  SudsFileClose (&sf);
+  return EW_SUCCESS;
+
+fail:
+  free (dm->tr);
+  free (dm->req);
+  free (pkts);
+  Release (budget, need);
+  free (samp);
+  free (col);
+  free (blk);
+  free (sc);
+  SudsFileClose (&sf);
+  memset (dm, 0, sizeof (SUDS_DEMUXED));
+  return EW_FAILURE;
+}
+
+/************************************************************************
+* SudsDemuxWrite: write loaded channels to outpath through sw, with    *
+*       the file's own STATIONCOMPs                                     *
+*************************************************************************/
+int SudsDemuxWrite (SUDS_WRITER *sw, SUDS_DEMUXED *dm, const char *outpath,
+                    int debug)
+{
+  const SUDS_STATIONCOMP *OldStations;
+  int     nOldStations;
+  int     c, ret, nFailed = 0;
+
+  if (sw == NULL || dm == NULL || dm->req == NULL || outpath == NULL)
+  {
+    logit ("e", "SudsDemuxWrite: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+  OldStations = sw->Stations;
+  nOldStations = sw->nStations;
+  SUDSWR_set_stations (sw, dm->sc, dm->nsc);
+  if (SUDSWR_next_ev_file (sw, outpath, debug) != EW_SUCCESS)
+  {
+    SUDSWR_set_stations (sw, OldStations, nOldStations);
+    return EW_FAILURE;
+  }
+  for (c = 0; c < dm->nch; c++)
+  {
+    if (dm->tr != NULL && sw->Trig != NULL && !sw->Segment)
+      sw->TrigFed = &dm->tr[c];
+    ret = SUDSWR_next (sw, &dm->req[c], DEMUX_GAPTHRESH, sw->BufferLen, debug);
+    sw->TrigFed = NULL;
+    if (ret != EW_SUCCESS)
+    {
+      logit ("e", "SudsDemuxWrite: %s: channel %d (%s.%s) not written\n",
+             outpath, c, dm->req[c].sta, dm->req[c].chan);
+      nFailed++;
+    }
+  }
+  if (SUDSWR_end_ev (sw, debug) != EW_SUCCESS)
+    nFailed++;
+  SUDSWR_set_stations (sw, OldStations, nOldStations);
+  return (nFailed > 0) ? EW_FAILURE : EW_SUCCESS;
+}
+
+/* Free what SudsDemuxLoad allocated */
+void SudsDemuxFree (SUDS_DEMUXED *dm)
+{
+  if (dm == NULL)
+    return;
+  free (dm->req);
+  free (dm->pkts);
+  free (dm->sc);
+  free (dm->tr);
+  dm->req = NULL;
+  dm->tr = NULL;
+  dm->pkts = NULL;
+  dm->sc = NULL;
+  dm->nch = 0;
+  dm->nsc = 0;
+}
+
+/* col[c] is the STATIONCOMP for column c, or -1 if none. The channel *
+ * numbers are used if they number the columns, from 0 if any of them *
+ * is 0 and otherwise from 1                                            */
+static int MapColumns (const SUDS_STATIONCOMP *sc, int nsc, int nch, int *col)
+{
+  int   base = 1, c, k;
+
+  for (k = 0; k < nsc; k++)
+    if (sc[k].channel == 0)
+      base = 0;
+  for (c = 0; c < nch; c++)
+    col[c] = -1;
+  for (k = 0; k < nsc; k++)
+  {
+    c = sc[k].channel - base;
+    if (c < 0 || c >= nch || col[c] >= 0)
+      break;
+    col[c] = k;
+  }
+  if (nsc > 0 && k == nsc)
+    return EW_SUCCESS;
+
+  /* no; go by the order they come in */
+  for (c = 0; c < nch; c++)
+    col[c] = (c < nsc) ? c : -1;
+  return EW_SUCCESS;
+}
+
+/* Wait until need more bytes fit in the budget, then take them */
+static void Reserve (DEMUX_BUDGET *bu, size_t need)
+{
+  if (bu == NULL)
+    return;
+  pthread_mutex_lock (&bu->mutex);
+  while (bu->budget > 0 && bu->inflight > 0
+         && bu->inflight + need > bu->budget)
+    pthread_cond_wait (&bu->freed, &bu->mutex);
+  bu->inflight += need;
+  pthread_mutex_unlock (&bu->mutex);
+}
+
+static void Release (DEMUX_BUDGET *bu, size_t need)
+{
+  if (bu == NULL || need == 0)
+    return;
+  pthread_mutex_lock (&bu->mutex);
+  bu->inflight -= need;
+  pthread_cond_broadcast (&bu->freed);
+  pthread_mutex_unlock (&bu->mutex);
+}
+
+/************************************************************************
+* SudsDemuxName: the .dmx file name for a .WVM                          *
+*************************************************************************/
+int SudsDemuxName (const char *path, const char *OutDir, char *out,
+                   size_t len)
+{
+  const char  *base, *dot;
+  size_t       dirlen, stem;
+
+  if ((base = strrchr (path, '/')) != NULL)
+    base++;
+  else
+    base = path;
+  if ((dot = strrchr (base, '.')) != NULL && dot != base)
+    stem = dot - base;
+  else
+    stem = strlen (base);
+
+  if (OutDir != NULL)
+  {
+    if (strlen (OutDir) + 1 + stem + 5 > len)
+      return EW_FAILURE;
+    sprintf (out, "%s/%.*s.dmx", OutDir, (int) stem, base);
+  }
+  else
+  {
+    dirlen = base - path;
+    if (dirlen + stem + 5 > len)
+      return EW_FAILURE;
+    sprintf (out, "%.*s%.*s.dmx", (int) dirlen, path, (int) stem, base);
+  }
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsDemuxFiles: demultiplex many files at once                        *
+*************************************************************************/
+int SudsDemuxFiles (char **paths, int n, const char *OutDir,
+                    const char *OutputFormat, int nThreads, size_t MemBudget,
+                    int debug)
+{
+  DEMUX_JOB   job;
+  SUDS_POOL  *pool;
+  char        dir[4*SUDS_MAXTXT];
+  char        format[SUDS_MAXTXT];
+  int         nWorkers, w, ret = EW_SUCCESS;
+
+  if (paths == NULL || n < 0 || OutputFormat == NULL
+      || strlen (OutputFormat) >= sizeof (format)
+      || (OutDir != NULL && strlen (OutDir) >= sizeof (dir)))
+  {
+    logit ("e", "SudsDemuxFiles: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+  if (n == 0)
+    return EW_SUCCESS;
+  if ((pool = SudsPoolCreate (nThreads < 1 ? 1 : nThreads)) == NULL)
+  {
+    logit ("e", "SudsDemuxFiles: couldn't start threads\n");
+    return EW_FAILURE;
+  }
+  nWorkers = SudsPoolThreads (pool);
+
+  memset (&job, 0, sizeof (job));
+  job.paths = paths;
+  job.OutDir = OutDir;
+  job.debug = debug;
+  job.budget.budget = MemBudget;
+  pthread_mutex_init (&job.budget.mutex, NULL);
+  pthread_cond_init (&job.budget.freed, NULL);
+
+  /* One streaming writer per worker */
+  strcpy (dir, (OutDir != NULL) ? OutDir : ".");
+  strcpy (format, OutputFormat);
+  if ((job.sw = (SUDS_WRITER *) calloc (nWorkers, sizeof (SUDS_WRITER)))
+      == NULL)
+  {
+    logit ("e", "SudsDemuxFiles: out of memory\n");
+    ret = EW_FAILURE;
+    goto done;
+  }
+  for (w = 0; w < nWorkers; w++)
+  {
+    if (SUDSWR_init (&job.sw[w], SUDS_DEMUX_BUFLEN, dir, format, debug)
+        != EW_SUCCESS)
+    {
+      ret = EW_FAILURE;
+      goto done;
+    }
+    SUDSWR_set_stream (&job.sw[w], 1);
+  }
+
+  SudsPoolRun (pool, n, DemuxTask, &job);
+  if (job.nFailed > 0)
+  {
+    logit ("e", "SudsDemuxFiles: %d of %d files failed\n", job.nFailed, n);
+    ret = EW_FAILURE;
+  }
+
+done:
+  if (job.sw != NULL)
+  {
+    for (w = 0; w < nWorkers; w++)
+      SUDSWR_close (&job.sw[w], debug);
+    free (job.sw);
+  }
+  SudsPoolDestroy (pool);
+  pthread_cond_destroy (&job.budget.freed);
+  pthread_mutex_destroy (&job.budget.mutex);
+  return ret;
+}
+
+/* Pool task: file i, on worker's writer */
+static void DemuxTask (void *arg, int i, int worker)
+{
+  DEMUX_JOB  *job = (DEMUX_JOB *) arg;
+  char        outpath[4*SUDS_MAXTXT];
+  int         ret;
+
+  if (SudsDemuxName (job->paths[i], job->OutDir, outpath, sizeof (outpath))
+      != EW_SUCCESS)
+  {
+    logit ("e", "SudsDemuxFiles: name too long for %s\n", job->paths[i]);
+    ret = EW_FAILURE;
+  }
+  else
+  {
+    if (job->debug == 1)
+      logit ("t", "SudsDemuxFiles: %s -> %s\n", job->paths[i], outpath);
+    ret = DemuxFile (&job->sw[worker], job->paths[i], outpath, &job->budget,
+                     job->debug);
+  }
+  if (ret != EW_SUCCESS)
+  {
+    pthread_mutex_lock (&job->budget.mutex);
+    job->nFailed++;
+    pthread_mutex_unlock (&job->budget.mutex);
+  }
+}
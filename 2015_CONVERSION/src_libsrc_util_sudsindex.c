@@ -0,0 +1,235 @@
+/* sudsindex.c
+
+        Channel index record for SUDS event files
+
+   The writer side collects one SUDS_CHANINDEX per channel as the
+   channels are written and appends them as a single tagged record at
+   the end of the event; the reader side finds that record from the
+   trailer at the end of the file. See sudsindex.h for the layout.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <earthworm.h>
+#include <sudshead.h>
+#include <sudsio.h>
+#include <sudsreader.h>
+#include <sudsswap.h>
+#include <sudsindex.h>
+
+/* Layout of the index structs in the file, for SudsEncodeFields */
+static const SUDS_FIELD HeadFields[] = {
+  SUDS_FIELD_OF (SUDS_INDEXHEAD, magic, 0, 4, SUDS_FIELD_BYTES),
+  SUDS_FIELD_OF (SUDS_INDEXHEAD, num_chans, 4, SUDS_LONG_WIDTH, SUDS_FIELD_INT),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD EntryFields[] = {
+  SUDS_STATIDENT_OF (SUDS_CHANINDEX, ci_name, 0),
+  SUDS_FIELD_OF (SUDS_CHANINDEX, sc_offset, 12, SUDS_LONG_WIDTH, SUDS_FIELD_INT),
+  SUDS_FIELD_OF (SUDS_CHANINDEX, dt_offset, 16, SUDS_LONG_WIDTH, SUDS_FIELD_INT),
+  SUDS_FIELD_OF (SUDS_CHANINDEX, data_offset, 20, SUDS_LONG_WIDTH, SUDS_FIELD_INT),
+  SUDS_FIELD_OF (SUDS_CHANINDEX, begintime, 24, 8, SUDS_FIELD_REAL),
+  SUDS_FIELD_OF (SUDS_CHANINDEX, rate, 32, 4, SUDS_FIELD_REAL),
+  SUDS_FIELD_OF (SUDS_CHANINDEX, length, 36, SUDS_LONG_WIDTH, SUDS_FIELD_INT),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD TrailerFields[] = {
+  SUDS_FIELD_OF (SUDS_INDEXTRAILER, back, 0, SUDS_LONG_WIDTH, SUDS_FIELD_INT),
+  SUDS_FIELD_OF (SUDS_INDEXTRAILER, machine, 4, 1, SUDS_FIELD_BYTES),
+  SUDS_FIELD_OF (SUDS_INDEXTRAILER, pad, 5, 3, SUDS_FIELD_BYTES),
+  SUDS_FIELD_OF (SUDS_INDEXTRAILER, magic, 8, 4, SUDS_FIELD_BYTES),
+  SUDS_FIELD_END
+};
+
+/************************************************************************
+* SudsIndexAdd: note one channel                                        *
+*************************************************************************/
+int SudsIndexAdd (SUDS_INDEX *ix, const SUDS_CHANINDEX *ent)
+{
+  SUDS_CHANINDEX  *grown;
+  long             max;
+
+  if (ix->n == ix->max)
+  {
+    max = (ix->max > 0) ? 2 * ix->max : 64;
+    grown = (SUDS_CHANINDEX *) realloc (ix->ent, max * sizeof (SUDS_CHANINDEX));
+    if (grown == NULL)
+    {
+      logit ("e", "SudsIndexAdd: couldn't malloc %ld index entries\n", max);
+      return EW_FAILURE;
+    }
+    ix->ent = grown;
+    ix->max = max;
+  }
+  ix->ent[ix->n++] = *ent;
+  return EW_SUCCESS;
+}
+
+void SudsIndexReset (SUDS_INDEX *ix)
+{
+  ix->n = 0;
+}
+
+void SudsIndexFree (SUDS_INDEX *ix)
+{
+  free (ix->ent);
+  memset (ix, 0, sizeof (SUDS_INDEX));
+}
+
+/************************************************************************
+* SudsIndexWrite: append the index record, in the byte order given by   *
+*       machine ('6' for Intel), to out                                 *
+*************************************************************************/
+int SudsIndexWrite (SUDS_INDEX *ix, SUDS_OUT *out, char machine)
+{
+  SUDS_STRUCTTAG     tag;
+  SUDS_INDEXHEAD     head;
+  SUDS_INDEXTRAILER  trailer;
+  char              *buf, *p;
+  size_t             len;
+  long               i;
+  int                swap = SUDS_MACHINE_SWAP (machine);
+  int                ret;
+
+  len = SUDS_STRUCTTAG_LEN + SUDS_INDEXHEAD_LEN + ix->n * SUDS_CHANINDEX_LEN
+        + SUDS_INDEXTRAILER_LEN;
+  if ((buf = (char *) malloc (len)) == NULL)
+  {
+    logit ("e", "SudsIndexWrite: couldn't malloc %lu bytes\n", (unsigned long) len);
+    return EW_FAILURE;
+  }
+
+  memset (&tag, 0, sizeof (tag));
+  tag.sync = 'S';
+  tag.machine = machine;
+  tag.id_struct = SUDS_CHANINDEX_ID;
+  tag.len_struct = SUDS_INDEXHEAD_LEN;
+  tag.len_data = ix->n * SUDS_CHANINDEX_LEN + SUDS_INDEXTRAILER_LEN;
+
+  memset (&head, 0, sizeof (head));
+  memcpy (head.magic, SUDS_INDEX_MAGIC, 4);
+  head.num_chans = ix->n;
+
+  memset (&trailer, 0, sizeof (trailer));
+  trailer.back = (int32_t) len;
+  trailer.machine = machine;
+  memcpy (trailer.magic, SUDS_INDEX_MAGIC, 4);
+
+  memset (buf, 0, len);
+  p = buf;
+  SudsEncodeStruct (p, STRUCTTAG, &tag, swap);
+  p += SUDS_STRUCTTAG_LEN;
+  SudsEncodeFields (p, &head, HeadFields, swap);
+  p += SUDS_INDEXHEAD_LEN;
+  for (i = 0; i < ix->n; i++)
+  {
+    SudsEncodeFields (p, &ix->ent[i], EntryFields, swap);
+    p += SUDS_CHANINDEX_LEN;
+  }
+  SudsEncodeFields (p, &trailer, TrailerFields, swap);
+
+  ret = SudsOutWrite (out, buf, len);
+  free (buf);
+  return ret;
+}
+
+/************************************************************************
+* SudsIndexLoad: read the index from the end of the file                *
+*************************************************************************/
+int SudsIndexLoad (SUDS_FILE *sf, SUDS_CHANINDEX **ent, long *n)
+{
+  SUDS_INDEXTRAILER  trailer;
+  SUDS_INDEXHEAD     head;
+  SUDS_REC           rec;
+  const char        *p;
+  size_t             pos;
+  long               i;
+  int                swap;
+
+  *ent = NULL;
+  *n = 0;
+  if (sf->Size < SUDS_INDEXTRAILER_LEN)
+    return SUDS_EOF;
+  p = sf->Base + sf->Size - SUDS_INDEXTRAILER_LEN;
+  if (memcmp (p + 8, SUDS_INDEX_MAGIC, 4) != 0)
+    return SUDS_EOF;
+  swap = SUDS_MACHINE_SWAP (p[4]);
+  memset (&trailer, 0, sizeof (trailer));
+  SudsDecodeFields (&trailer, p, SUDS_INDEXTRAILER_LEN, TrailerFields, swap);
+  if (trailer.back <= 0 || (size_t) trailer.back > sf->Size)
+    return SUDS_EOF;
+
+  /* the trailer must end a well formed index record */
+  pos = sf->Size - trailer.back;
+  if (SudsNextRec (sf, &pos, &rec) != EW_SUCCESS || pos != sf->Size
+      || rec.id != SUDS_CHANINDEX_ID || rec.len_struct != SUDS_INDEXHEAD_LEN)
+  {
+    logit ("e", "SudsIndexLoad: index trailer doesn't lead to an index\n");
+    return EW_FAILURE;
+  }
+  memset (&head, 0, sizeof (head));
+  SudsDecodeFields (&head, rec.Struct, SUDS_INDEXHEAD_LEN, HeadFields, rec.swap);
+  if (head.num_chans < 0
+      || rec.len_data != (long) head.num_chans * SUDS_CHANINDEX_LEN
+                         + SUDS_INDEXTRAILER_LEN)
+  {
+    logit ("e", "SudsIndexLoad: index of %ld channels is %ld bytes\n",
+           (long) head.num_chans, rec.len_data);
+    return EW_FAILURE;
+  }
+
+  if (head.num_chans > 0)
+  {
+    *ent = (SUDS_CHANINDEX *) malloc (head.num_chans * sizeof (SUDS_CHANINDEX));
+    if (*ent == NULL)
+    {
+      logit ("e", "SudsIndexLoad: couldn't malloc %ld index entries\n",
+             (long) head.num_chans);
+      return EW_FAILURE;
+    }
+    memset (*ent, 0, head.num_chans * sizeof (SUDS_CHANINDEX));
+    for (i = 0; i < head.num_chans; i++)
+      SudsDecodeFields (&(*ent)[i], rec.Data + i * SUDS_CHANINDEX_LEN,
+                        SUDS_CHANINDEX_LEN, EntryFields, rec.swap);
+  }
+  *n = head.num_chans;
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsIndexFind: go straight to one channel                             *
+*************************************************************************/
+int SudsIndexFind (SUDS_FILE *sf, const char *sta, const char *net,
+                   char component, SUDS_TRACE *tr)
+{
+  SUDS_CHANINDEX  *ent;
+  SUDS_STATIDENT  *name;
+  size_t           pos;
+  long             n, i;
+  int              ret;
+
+  if ((ret = SudsIndexLoad (sf, &ent, &n)) != EW_SUCCESS)
+    return ret;
+  for (i = 0; i < n; i++)
+  {
+    name = &ent[i].ci_name;
+    if (strncmp (name->st_name, sta, sizeof (name->st_name)) == 0
+        && (net == NULL || net[0] == '\0'
+            || strncmp (name->network, net, sizeof (name->network)) == 0)
+        && (component == 0 || name->component == component))
+      break;
+  }
+  if (i == n)
+  {
+    free (ent);
+    return SUDS_EOF;
+  }
+
+  pos = (size_t) ent[i].sc_offset;
+  free (ent);
+  return SudsNextTrace (sf, &pos, tr);
+}
+
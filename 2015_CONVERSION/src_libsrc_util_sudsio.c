@@ -0,0 +1,421 @@
+/* sudsio.c
+
+        Output file layer for the SUDS putaway routines
+
+   sudsputaway.c hands each channel over as a small block of SUDS
+   structs plus the sample payload; SudsOutWritev gets both to the file
+   with one fwrite pair, one pwritev, or one copy into the O_DIRECT
+   staging buffer, depending on the mode. In SUDS_IO_ASYNC mode the
+   pieces are queued on the write-behind service in sudsasync.c instead.
+*/
+
+#define _GNU_SOURCE             /* for O_DIRECT */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <earthworm.h>
+#include <sudsio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Internal Function Prototypes */
+static int PwritevAll (int, struct iovec *, int, off_t);
+static int PwriteAll (int, const char *, size_t, off_t);
+static int StageFlush (SUDS_OUT *, int);
+static int PatchDirect (SUDS_OUT *, const char *, size_t, off_t);
+
+/************************************************************************
+* SudsOutOpen: create (or truncate) path for writing                    *
+*************************************************************************/
+int SudsOutOpen (SUDS_OUT *out, const char *path, int Mode)
+{
+  memset (out, 0, sizeof (SUDS_OUT));
+  out->fd = -1;
+  out->Mode = Mode;
+
+  switch (Mode)
+  {
+  case SUDS_IO_STDIO:
+    if ((out->fp = fopen (path, "wb")) == NULL)
+      return EW_FAILURE;
+    break;
+
+  case SUDS_IO_DIRECT:
+#ifdef O_DIRECT
+    /* read access too, for patching blocks already written */
+    if ((out->fd = open (path, O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0666)) >= 0)
+    {
+      if (posix_memalign ((void **) &out->Stage, SUDS_IO_ALIGN, SUDS_IO_STAGE) != 0
+          || posix_memalign ((void **) &out->Scratch, SUDS_IO_ALIGN,
+                             SUDS_IO_ALIGN) != 0)
+      {
+        logit ("e", "SudsOutOpen: couldn't malloc O_DIRECT buffers\n");
+        free (out->Stage);
+        close (out->fd);
+        return EW_FAILURE;
+      }
+      break;
+    }
+    if (errno != EINVAL)
+      return EW_FAILURE;
+#endif
+    /* file system won't do O_DIRECT; use plain writes */
+    out->Mode = SUDS_IO_WRITEV;
+    /* fall through */
+
+  case SUDS_IO_WRITEV:
+    if ((out->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+      return EW_FAILURE;
+    break;
+
+  default:
+    logit ("e", "SudsOutOpen: unknown output mode %d\n", Mode);
+    errno = EINVAL;
+    return EW_FAILURE;
+  }
+  out->Open = 1;
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsOutOpenAsync: queue the creation of path on the write-behind      *
+*       service; failures to create it are reported to done             *
+*************************************************************************/
+int SudsOutOpenAsync (SUDS_OUT *out, const char *path, SUDS_ASYNC *as,
+                      SUDS_ASYNC_DONE done, void *arg)
+{
+  memset (out, 0, sizeof (SUDS_OUT));
+  out->fd = -1;
+  out->Mode = SUDS_IO_ASYNC;
+  out->Done = done;
+  out->DoneArg = arg;
+  if (as == NULL || (out->af = SudsAsyncOpen (as, path)) == NULL)
+    return EW_FAILURE;
+  out->Open = 1;
+  return EW_SUCCESS;
+}
+
+int SudsOutIsOpen (SUDS_OUT *out)
+{
+  return out != NULL && out->Open;
+}
+
+/************************************************************************
+* SudsOutWritev: append the n pieces in iov to the file                 *
+*************************************************************************/
+int SudsOutWritev (SUDS_OUT *out, const struct iovec *iov, int n)
+{
+  struct iovec  v[IOV_MAX];
+  size_t        len;
+  int           i, k;
+  int           ret;
+
+  switch (out->Mode)
+  {
+  case SUDS_IO_STDIO:
+    for (i = 0; i < n; i++)
+      if (iov[i].iov_len > 0
+          && fwrite (iov[i].iov_base, 1, iov[i].iov_len, out->fp) != iov[i].iov_len)
+        return EW_FAILURE;
+    return EW_SUCCESS;
+
+  case SUDS_IO_WRITEV:
+    for (i = 0; i < n; i += k)
+    {
+      /* pwritev may change the iovec, so work on a copy */
+      for (k = 0; k < IOV_MAX && i + k < n; k++)
+        v[k] = iov[i + k];
+      if (PwritevAll (out->fd, v, k, out->Offset) != EW_SUCCESS)
+        return EW_FAILURE;
+      for (k = 0; k < IOV_MAX && i + k < n; k++)
+        out->Offset += iov[i + k].iov_len;
+    }
+    return EW_SUCCESS;
+
+  case SUDS_IO_DIRECT:
+    for (i = 0; i < n; i++)
+    {
+      const char *p = (const char *) iov[i].iov_base;
+
+      for (len = iov[i].iov_len; len > 0; )
+      {
+        size_t room = SUDS_IO_STAGE - out->StageUsed;
+
+        if (room > len)
+          room = len;
+        memcpy (out->Stage + out->StageUsed, p, room);
+        out->StageUsed += room;
+        p += room;
+        len -= room;
+        if (out->StageUsed == SUDS_IO_STAGE && StageFlush (out, 0) != EW_SUCCESS)
+          return EW_FAILURE;
+      }
+    }
+    return EW_SUCCESS;
+
+  case SUDS_IO_ASYNC:
+    if ((ret = SudsAsyncWrite (out->af, iov, n, out->Offset)) == EW_SUCCESS)
+      for (i = 0; i < n; i++)
+        out->Offset += iov[i].iov_len;
+    return ret;
+  }
+  return EW_FAILURE;
+}
+
+int SudsOutWrite (SUDS_OUT *out, const void *buf, size_t len)
+{
+  struct iovec  iov;
+
+  iov.iov_base = (void *) buf;
+  iov.iov_len = len;
+  return SudsOutWritev (out, &iov, 1);
+}
+
+/************************************************************************
+* SudsOutPatch: overwrite len bytes already written at off              *
+*************************************************************************/
+int SudsOutPatch (SUDS_OUT *out, const void *buf, size_t len, off_t off)
+{
+  off_t  end;
+
+  switch (out->Mode)
+  {
+  case SUDS_IO_STDIO:
+    if ((end = ftello (out->fp)) < 0
+        || fseeko (out->fp, off, SEEK_SET) != 0
+        || fwrite (buf, 1, len, out->fp) != len
+        || fseeko (out->fp, end, SEEK_SET) != 0)
+      return EW_FAILURE;
+    return EW_SUCCESS;
+
+  case SUDS_IO_WRITEV:
+    return PwriteAll (out->fd, (const char *) buf, len, off);
+
+  case SUDS_IO_DIRECT:
+    return PatchDirect (out, (const char *) buf, len, off);
+
+  case SUDS_IO_ASYNC:
+    return SudsAsyncPatch (out->af, buf, len, off);
+  }
+  return EW_FAILURE;
+}
+
+/************************************************************************
+* SudsOutTruncate: cut the file back to off bytes                       *
+*************************************************************************/
+int SudsOutTruncate (SUDS_OUT *out, off_t off)
+{
+  ssize_t  got;
+
+  switch (out->Mode)
+  {
+  case SUDS_IO_STDIO:
+    if (fflush (out->fp) != 0
+        || ftruncate (fileno (out->fp), off) != 0
+        || fseeko (out->fp, off, SEEK_SET) != 0)
+      return EW_FAILURE;
+    return EW_SUCCESS;
+
+  case SUDS_IO_WRITEV:
+    if (ftruncate (out->fd, off) != 0)
+      return EW_FAILURE;
+    out->Offset = off;
+    return EW_SUCCESS;
+
+  case SUDS_IO_DIRECT:
+    if (off >= out->StageOff)
+    {
+      out->StageUsed = (long) (off - out->StageOff);
+      return EW_SUCCESS;
+    }
+    /* cutting back into data already flushed: reload the partial *
+     * block at the new end of file into the staging buffer        */
+    if (ftruncate (out->fd, off) != 0)
+      return EW_FAILURE;
+    out->StageOff = off - off % SUDS_IO_ALIGN;
+    out->StageUsed = (long) (off - out->StageOff);
+    if (out->StageUsed > 0)
+    {
+      got = pread (out->fd, out->Stage, SUDS_IO_ALIGN, out->StageOff);
+      if (got < out->StageUsed)
+        return EW_FAILURE;
+    }
+    return EW_SUCCESS;
+
+  case SUDS_IO_ASYNC:
+    out->Offset = off;
+    return SudsAsyncTruncate (out->af, off);
+  }
+  return EW_FAILURE;
+}
+
+off_t SudsOutTell (SUDS_OUT *out)
+{
+  switch (out->Mode)
+  {
+  case SUDS_IO_STDIO:
+    return ftello (out->fp);
+  case SUDS_IO_WRITEV:
+  case SUDS_IO_ASYNC:
+    return out->Offset;
+  case SUDS_IO_DIRECT:
+    return out->StageOff + out->StageUsed;
+  }
+  return -1;
+}
+
+/************************************************************************
+* SudsOutClose: flush and close. The last O_DIRECT block is written     *
+*       padded out to the alignment, then the file is cut back to its   *
+*       real length. SUDS_IO_ASYNC files are only queued for closing.   *
+*************************************************************************/
+int SudsOutClose (SUDS_OUT *out)
+{
+  int  ret = EW_SUCCESS;
+
+  if (!out->Open)
+    return EW_SUCCESS;
+  out->Open = 0;
+
+  switch (out->Mode)
+  {
+  case SUDS_IO_STDIO:
+    if (fclose (out->fp) != 0)
+      ret = EW_FAILURE;
+    out->fp = NULL;
+    break;
+
+  case SUDS_IO_DIRECT:
+    if (StageFlush (out, 1) != EW_SUCCESS)
+      ret = EW_FAILURE;
+    free (out->Stage);
+    free (out->Scratch);
+    out->Stage = out->Scratch = NULL;
+    /* fall through */
+
+  case SUDS_IO_WRITEV:
+    if (close (out->fd) != 0)
+      ret = EW_FAILURE;
+    out->fd = -1;
+    break;
+
+  case SUDS_IO_ASYNC:
+    ret = SudsAsyncClose (out->af, out->Done, out->DoneArg);
+    out->af = NULL;
+    break;
+  }
+  return ret;
+}
+
+
+/* Write out the staging buffer. Normally only when it is full; at the  *
+ * end of the file (last != 0) the tail is padded to a whole block and  *
+ * the file cut back afterwards.                                        */
+static int StageFlush (SUDS_OUT *out, int last)
+{
+  size_t  len = out->StageUsed;
+  off_t   end = out->StageOff + out->StageUsed;
+
+  if (len == 0)
+    return EW_SUCCESS;
+  if (last && len % SUDS_IO_ALIGN != 0)
+  {
+    memset (out->Stage + len, 0, SUDS_IO_ALIGN - len % SUDS_IO_ALIGN);
+    len += SUDS_IO_ALIGN - len % SUDS_IO_ALIGN;
+  }
+  if (PwriteAll (out->fd, out->Stage, len, out->StageOff) != EW_SUCCESS)
+    return EW_FAILURE;
+  if (last)
+    return (ftruncate (out->fd, end) == 0) ? EW_SUCCESS : EW_FAILURE;
+  out->StageOff += len;
+  out->StageUsed = 0;
+  return EW_SUCCESS;
+}
+
+/* Patch O_DIRECT output: bytes still staged are changed in memory, bytes *
+ * already on disk by read-modify-write of whole aligned blocks           */
+static int PatchDirect (SUDS_OUT *out, const char *buf, size_t len, off_t off)
+{
+  off_t   block;
+  size_t  skip, n;
+
+  while (len > 0)
+  {
+    if (off >= out->StageOff)
+    {
+      if (off + (off_t) len > out->StageOff + out->StageUsed)
+        return EW_FAILURE;
+      memcpy (out->Stage + (off - out->StageOff), buf, len);
+      return EW_SUCCESS;
+    }
+    block = off - off % SUDS_IO_ALIGN;
+    skip = (size_t) (off - block);
+    n = SUDS_IO_ALIGN - skip;
+    if (n > len)
+      n = len;
+    if (pread (out->fd, out->Scratch, SUDS_IO_ALIGN, block) != SUDS_IO_ALIGN)
+      return EW_FAILURE;
+    memcpy (out->Scratch + skip, buf, n);
+    if (PwriteAll (out->fd, out->Scratch, SUDS_IO_ALIGN, block) != EW_SUCCESS)
+      return EW_FAILURE;
+    buf += n;
+    off += n;
+    len -= n;
+  }
+  return EW_SUCCESS;
+}
+
+/* pwritev until everything is written */
+static int PwritevAll (int fd, struct iovec *iov, int n, off_t off)
+{
+  ssize_t  done;
+
+  while (n > 0)
+  {
+    if ((done = pwritev (fd, iov, n, off)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return EW_FAILURE;
+    }
+    off += done;
+    while (n > 0 && (size_t) done >= iov->iov_len)
+    {
+      done -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0)
+    {
+      iov->iov_base = (char *) iov->iov_base + done;
+      iov->iov_len -= done;
+    }
+  }
+  return EW_SUCCESS;
+}
+
+static int PwriteAll (int fd, const char *buf, size_t len, off_t off)
+{
+  ssize_t  done;
+
+  while (len > 0)
+  {
+    if ((done = pwrite (fd, buf, len, off)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return EW_FAILURE;
+    }
+    buf += done;
+    off += done;
+    len -= done;
+  }
+  return EW_SUCCESS;
+}
@@ -0,0 +1,404 @@
+/* sudsirig.c
+
+        IRIG time code decoding and clock fitting; see sudsirig.h
+
+   The samples go through a level tracker and a comparator with some
+   hysteresis; each rising edge (placed between samples by linear
+   interpolation) starts a pulse and each falling edge ends one, and
+   the pulse width gives the bit. Two position markers in a row mark
+   the start of a frame; once its hundred bits are in, the frame is
+   checked and decoded into a true time for the leading edge of its
+   reference marker, and that time and the digitizer's time for the
+   same edge are kept for the fit.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <earthworm.h>
+#include <time_ew.h>
+#include <trace_buf.h>
+#include <sudsirig.h>
+
+#define FRAME_BITS      100
+#define MARK            2              /* bit value of a position marker */
+#define BAD             (-1)
+#define HI_FRAC         0.6            /* comparator thresholds, of the span */
+#define LO_FRAC         0.4
+#define TRACK_SECONDS   2.0            /* how fast the levels relax */
+
+typedef struct
+{
+  double  t;                           /* digitizer time of the frame */
+  double  off;                         /* true time - t */
+} IRIG_FRAME;
+
+struct _SUDS_IRIG
+{
+  char    sta[TRACE_STA_LEN];
+  char    chan[TRACE_CHAN_LEN];        /* "" for any */
+  double  bitlen;                      /* seconds */
+
+  /* signal */
+  int     started;
+  double  hi, lo;                      /* tracked levels */
+  int     high;                        /* comparator state */
+  double  xprev, tprev;
+  double  rise;                        /* last rising edge; -1 none */
+  double  last;                        /* time of the last sample; -1 none */
+
+  /* bits */
+  int     bits[FRAME_BITS];
+  int     nbit;                        /* bits of the frame so far; -1 unsynced */
+  int     lastmark;                    /* the bit before was a marker */
+  double  lastrise;                    /* rising edge of the bit before */
+  double  frame_t;                     /* rising edge of the reference marker */
+
+  /* frames */
+  IRIG_FRAME *fr;
+  int     n, max;
+  int     nbad;
+};
+
+/* Internal Function Prototypes */
+static void Sample (SUDS_IRIG *, double, double, double);
+static void Bit (SUDS_IRIG *, int, double);
+static void Frame (SUDS_IRIG *);
+static int Bcd (const int *, int, int);
+static double DayZero (int);
+static int CmpDouble (const void *, const void *);
+
+SUDS_IRIG *SudsIrigCreate (const char *sta, const char *chan, int code)
+{
+  SUDS_IRIG  *ir;
+
+  if (sta == NULL || (code != SUDS_IRIG_B && code != SUDS_IRIG_E))
+  {
+    logit ("e", "SudsIrigCreate: bad time code channel or code\n");
+    return NULL;
+  }
+  if ((ir = (SUDS_IRIG *) calloc (1, sizeof (SUDS_IRIG))) == NULL)
+  {
+    logit ("e", "SudsIrigCreate: couldn't malloc IRIG decoder\n");
+    return NULL;
+  }
+  strncpy (ir->sta, sta, TRACE_STA_LEN - 1);
+  if (chan != NULL)
+    strncpy (ir->chan, chan, TRACE_CHAN_LEN - 1);
+  ir->bitlen = (code == SUDS_IRIG_B) ? 0.01 : 0.1;
+  SudsIrigReset (ir);
+  return ir;
+}
+
+int SudsIrigMatch (SUDS_IRIG *ir, const char *sta, const char *chan)
+{
+  return ir != NULL && strcmp (ir->sta, sta) == 0
+         && (ir->chan[0] == '\0' || strcmp (ir->chan, chan) == 0);
+}
+
+void SudsIrigReset (SUDS_IRIG *ir)
+{
+  if (ir == NULL)
+    return;
+  ir->started = 0;
+  ir->rise = -1.0;
+  ir->last = -1.0;
+  ir->nbit = -1;
+  ir->lastmark = 0;
+  ir->lastrise = -1.0;
+  ir->n = 0;
+  ir->nbad = 0;
+}
+
+/************************************************************************
+* SudsIrigFeed: decode one packet of the time code                      *
+*************************************************************************/
+int SudsIrigFeed (SUDS_IRIG *ir, const TRACE_HEADER *wf, const void *samples,
+                  char datatype)
+{
+  double  rate = wf->samprate;
+  double  x;
+  long    n = wf->nsamp;
+  long    k = 0;
+
+  if (ir == NULL || rate < 0.01)
+    return EW_FAILURE;
+  if (rate * ir->bitlen < SUDS_IRIG_MINSPB)
+  {
+    logit ("e", "SudsIrigFeed: %g sps is too slow for the time code on <%s.%s>\n",
+           rate, wf->sta, wf->chan);
+    return EW_FAILURE;
+  }
+
+  /* skip anything already seen, as snippets of overlapping events repeat */
+  if (ir->last >= 0.0 && wf->starttime <= ir->last + 0.5 / rate)
+    k = (long) floor ((ir->last - wf->starttime) * rate + 0.5) + 1;
+
+  for (; k < n; k++)
+  {
+    if (datatype == 's')
+      x = ((const short *) samples)[k];
+    else if (datatype == 'l')
+      x = (double) ((const int32_t *) samples)[k];
+    else
+      x = ((const float *) samples)[k];
+    Sample (ir, wf->starttime + k / rate, x, rate);
+  }
+  if (n > 0 && ir->last < wf->starttime + (n - 1) / rate)
+    ir->last = wf->starttime + (n - 1) / rate;
+  return EW_SUCCESS;
+}
+
+/* One sample: follow the levels and look for edges */
+static void Sample (SUDS_IRIG *ir, double t, double x, double rate)
+{
+  double  alpha = 1.0 / (rate * TRACK_SECONDS);
+  double  span, mid, te;
+  int     bit;
+
+  if (!ir->started || t - ir->tprev > 1.5 / rate)
+  {
+    /* first sample, or after a gap: start over */
+    if (ir->started)
+      Bit (ir, BAD, t);
+    ir->started = 1;
+    ir->hi = ir->lo = x;
+    ir->high = 0;
+    ir->rise = -1.0;
+    ir->xprev = x;
+    ir->tprev = t;
+    return;
+  }
+
+  ir->hi = (x > ir->hi) ? x : ir->hi + (x - ir->hi) * alpha;
+  ir->lo = (x < ir->lo) ? x : ir->lo + (x - ir->lo) * alpha;
+  span = ir->hi - ir->lo;
+  mid = ir->lo + 0.5 * span;
+
+  if (span > 0.0 && !ir->high && x > ir->lo + HI_FRAC * span)
+  {
+    ir->high = 1;
+    te = (ir->xprev < mid) ? ir->tprev + (mid - ir->xprev) / (x - ir->xprev) / rate : t;
+    ir->rise = te;
+  }
+  else if (span > 0.0 && ir->high && x < ir->lo + LO_FRAC * span)
+  {
+    ir->high = 0;
+    te = (ir->xprev > mid) ? ir->tprev + (ir->xprev - mid) / (ir->xprev - x) / rate : t;
+    if (ir->rise >= 0.0)
+    {
+      span = (te - ir->rise) / ir->bitlen;
+      bit = (span < 0.1) ? BAD : (span < 0.35) ? 0 : (span < 0.65) ? 1
+          : (span < 0.95) ? MARK : BAD;
+      Bit (ir, bit, ir->rise);
+    }
+    ir->rise = -1.0;
+  }
+  ir->xprev = x;
+  ir->tprev = t;
+}
+
+/* One bit, whose pulse rose at t */
+static void Bit (SUDS_IRIG *ir, int b, double t)
+{
+  /* bits come one bitlen apart; anything else loses the frame */
+  if (b != BAD && ir->lastrise >= 0.0
+      && fabs (t - ir->lastrise - ir->bitlen) > 0.25 * ir->bitlen)
+  {
+    if (ir->nbit > 0)
+      ir->nbad++;
+    ir->nbit = -1;
+    ir->lastmark = 0;
+  }
+  ir->lastrise = (b == BAD) ? -1.0 : t;
+  if (b == BAD)
+  {
+    if (ir->nbit > 0)
+      ir->nbad++;
+    ir->nbit = -1;
+    ir->lastmark = 0;
+    return;
+  }
+
+  if (ir->nbit < 0)
+  {
+    /* the second of two markers in a row is the reference marker */
+    if (b == MARK && ir->lastmark)
+    {
+      ir->nbit = 0;
+      ir->frame_t = t;
+      ir->bits[ir->nbit++] = b;
+    }
+    ir->lastmark = (b == MARK);
+    return;
+  }
+  ir->bits[ir->nbit++] = b;
+  ir->lastmark = (b == MARK);
+  if (ir->nbit == FRAME_BITS)
+  {
+    Frame (ir);
+    ir->nbit = -1;
+  }
+}
+
+/* A whole frame: check it and keep its offset */
+static void Frame (SUDS_IRIG *ir)
+{
+  const int  *b = ir->bits;
+  IRIG_FRAME *grown;
+  struct tm   tm;
+  time_t      tt;
+  double      tod, best = 0.0, t;
+  int         sec, min, hour, day;
+  int         i, y;
+
+  for (i = 0; i < FRAME_BITS; i++)
+    if ((b[i] == MARK) != (i == 0 || i % 10 == 9))
+    {
+      ir->nbad++;
+      return;
+    }
+  sec = Bcd (b, 1, 4) + 10 * Bcd (b, 6, 3);
+  min = Bcd (b, 10, 4) + 10 * Bcd (b, 15, 3);
+  hour = Bcd (b, 20, 4) + 10 * Bcd (b, 25, 2);
+  day = Bcd (b, 30, 4) + 10 * Bcd (b, 35, 4) + 100 * Bcd (b, 40, 2);
+  if (sec > 60 || min > 59 || hour > 23 || day < 1 || day > 366)
+  {
+    ir->nbad++;
+    return;
+  }
+  tod = (day - 1) * 86400.0 + hour * 3600.0 + min * 60.0 + sec;
+
+  /* the code has no year: take the one nearest the digitizer's */
+  tt = (time_t) ir->frame_t;
+  gmtime_ew (&tt, &tm);
+  for (y = tm.tm_year + 1900 - 1; y <= tm.tm_year + 1900 + 1; y++)
+  {
+    t = DayZero (y) + tod;
+    if (y == tm.tm_year + 1900 - 1 || fabs (t - ir->frame_t) < fabs (best - ir->frame_t))
+      best = t;
+  }
+
+  if (ir->n == ir->max)
+  {
+    i = (ir->max > 0) ? 2 * ir->max : 64;
+    if ((grown = (IRIG_FRAME *) realloc (ir->fr, i * sizeof (IRIG_FRAME))) == NULL)
+    {
+      logit ("e", "SudsIrig: couldn't malloc %d frames\n", i);
+      return;
+    }
+    ir->fr = grown;
+    ir->max = i;
+  }
+  ir->fr[ir->n].t = ir->frame_t;
+  ir->fr[ir->n].off = best - ir->frame_t;
+  ir->n++;
+}
+
+/* n bits from first on, least significant first */
+static int Bcd (const int *b, int first, int n)
+{
+  int  v = 0, i;
+
+  for (i = n - 1; i >= 0; i--)
+    v = 2 * v + b[first + i];
+  return v;
+}
+
+/* Epoch seconds of 1 January of year y */
+static double DayZero (int y)
+{
+  long  days = 0;
+  int   i;
+
+  for (i = 1970; i < y; i++)
+    days += (i % 4 == 0 && (i % 100 != 0 || i % 400 == 0)) ? 366 : 365;
+  for (i = y; i < 1970; i++)
+    days -= (i % 4 == 0 && (i % 100 != 0 || i % 400 == 0)) ? 366 : 365;
+  return days * 86400.0;
+}
+
+static int CmpDouble (const void *a, const void *b)
+{
+  double  x = *(const double *) a, y = *(const double *) b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+/************************************************************************
+* SudsIrigFit: fit offset and drift to the frames, dropping outliers    *
+*************************************************************************/
+int SudsIrigFit (SUDS_IRIG *ir, SUDS_IRIGFIT *fit)
+{
+  double  *off, med;
+  double   st = 0.0, so = 0.0, stt = 0.0, sto = 0.0, r, d;
+  int      i, n = 0;
+
+  memset (fit, 0, sizeof (SUDS_IRIGFIT));
+  if (ir == NULL || ir->n == 0)
+    return EW_FAILURE;
+  if ((off = (double *) malloc (ir->n * sizeof (double))) == NULL)
+  {
+    logit ("e", "SudsIrigFit: couldn't malloc %d offsets\n", ir->n);
+    return EW_FAILURE;
+  }
+  for (i = 0; i < ir->n; i++)
+    off[i] = ir->fr[i].off;
+  qsort (off, ir->n, sizeof (double), CmpDouble);
+  med = (ir->n % 2) ? off[ir->n / 2]
+                    : 0.5 * (off[ir->n / 2 - 1] + off[ir->n / 2]);
+  free (off);
+
+  fit->tref = -1.0;
+  for (i = 0; i < ir->n; i++)
+  {
+    if (fabs (ir->fr[i].off - med) > SUDS_IRIG_OUTLIER)
+      continue;
+    if (fit->tref < 0.0)
+      fit->tref = ir->fr[i].t;
+    d = ir->fr[i].t - fit->tref;
+    st += d;
+    so += ir->fr[i].off;
+    stt += d * d;
+    sto += d * ir->fr[i].off;
+    n++;
+  }
+  fit->nframes = n;
+  fit->nbad = ir->nbad + ir->n - n;
+
+  /* frames less than a second apart can't say much about drift */
+  d = n * stt - st * st;
+  if (n >= 2 && d > 0.0 && stt / n - (st / n) * (st / n) >= 1.0)
+  {
+    fit->drift = (n * sto - st * so) / d;
+    fit->offset = (so - fit->drift * st) / n;
+    fit->fitted = 1;
+  }
+  else
+    fit->offset = so / n;
+
+  for (i = 0, r = 0.0; i < ir->n; i++)
+    if (fabs (ir->fr[i].off - med) <= SUDS_IRIG_OUTLIER)
+    {
+      d = ir->fr[i].off - SudsIrigCorrection (fit, ir->fr[i].t);
+      r += d * d;
+    }
+  fit->rms = sqrt (r / n);
+  return EW_SUCCESS;
+}
+
+double SudsIrigCorrection (const SUDS_IRIGFIT *fit, double t)
+{
+  return fit->offset + fit->drift * (t - fit->tref);
+}
+
+void SudsIrigDestroy (SUDS_IRIG *ir)
+{
+  if (ir == NULL)
+    return;
+  free (ir->fr);
+  free (ir);
+}
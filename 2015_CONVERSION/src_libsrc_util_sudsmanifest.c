@@ -0,0 +1,166 @@
+/* sudsmanifest.c
+
+        Append-only manifest of SUDS event files; see sudsmanifest.h
+
+   Each line is formatted whole in a local buffer and handed to one
+   write() on an O_APPEND descriptor, which the kernel appends in one
+   piece, so no lock is needed between writers; the mutex only keeps a
+   short write from one thread being finished after another's line.
+*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <earthworm.h>
+#include <sudsmanifest.h>
+
+#define LINE_MAX_LEN  (SUDS_MANIFEST_MAXPATH + SUDS_MANIFEST_MAXID + 128)
+
+struct _SUDS_MANIFEST
+{
+  int              fd;                 /* open O_APPEND */
+  int              Sync;               /* fdatasync each line */
+  char             Dir[SUDS_MANIFEST_MAXPATH];  /* paths under here go relative */
+  size_t           DirLen;             /* 0 if the manifest has no directory part */
+  pthread_mutex_t  mutex;
+};
+
+SUDS_MANIFEST *SudsManifestOpen (const char *path, int Sync)
+{
+  SUDS_MANIFEST *mf;
+  const char    *slash;
+
+  if (path == NULL || strlen (path) >= SUDS_MANIFEST_MAXPATH)
+  {
+    logit ("e", "SudsManifestOpen: bad manifest name\n");
+    return NULL;
+  }
+  if ((mf = (SUDS_MANIFEST *) calloc (1, sizeof (SUDS_MANIFEST))) == NULL)
+  {
+    logit ("e", "SudsManifestOpen: couldn't malloc manifest\n");
+    return NULL;
+  }
+  if ((mf->fd = open (path, O_WRONLY | O_APPEND | O_CREAT, 0644)) < 0)
+  {
+    logit ("e", "SudsManifestOpen: can't open %s: %s\n", path,
+           strerror (errno));
+    free (mf);
+    return NULL;
+  }
+  mf->Sync = Sync;
+  if ((slash = strrchr (path, '/')) != NULL)
+  {
+    mf->DirLen = slash - path;
+    memcpy (mf->Dir, path, mf->DirLen);
+    mf->Dir[mf->DirLen] = '\0';
+  }
+  pthread_mutex_init (&mf->mutex, NULL);
+  return mf;
+}
+
+int SudsManifestAdd (SUDS_MANIFEST *mf, const SUDS_MANIFEST_ENT *ent)
+{
+  char         line[LINE_MAX_LEN];
+  const char  *path = ent->path;
+  char        *p;
+  int          len, ret = EW_SUCCESS;
+  ssize_t      done, n;
+
+  if (mf == NULL || strchr (ent->path, '\n') != NULL)
+    return EW_FAILURE;
+  if (mf->DirLen > 0 && strncmp (path, mf->Dir, mf->DirLen) == 0
+      && path[mf->DirLen] == '/')
+    path += mf->DirLen + 1;
+
+  len = snprintf (line, sizeof (line), "%.*s %.3f %.3f %ld %ld ",
+                  SUDS_MANIFEST_MAXID - 1,
+                  (ent->evid[0] != '\0') ? ent->evid : "-",
+                  ent->begintime, ent->endtime, ent->nchans, ent->bytes);
+  /* the id is a single field whatever it holds */
+  for (p = line; *p != ' '; p++)
+    if (isspace ((unsigned char) *p))
+      *p = '_';
+  len += snprintf (line + len, sizeof (line) - len, "%s\n", path);
+
+  pthread_mutex_lock (&mf->mutex);
+  for (done = 0; done < len; done += n)
+    if ((n = write (mf->fd, line + done, len - done)) < 0)
+    {
+      if (errno == EINTR)
+      {
+        n = 0;
+        continue;
+      }
+      ret = EW_FAILURE;
+      break;
+    }
+  if (ret == EW_SUCCESS && mf->Sync && fdatasync (mf->fd) != 0)
+    ret = EW_FAILURE;
+  pthread_mutex_unlock (&mf->mutex);
+  if (ret != EW_SUCCESS)
+    logit ("e", "SudsManifestAdd: error writing manifest: %s\n",
+           strerror (errno));
+  return ret;
+}
+
+int SudsManifestClose (SUDS_MANIFEST *mf)
+{
+  int  ret;
+
+  if (mf == NULL)
+    return EW_SUCCESS;
+  ret = (close (mf->fd) == 0) ? EW_SUCCESS : EW_FAILURE;
+  pthread_mutex_destroy (&mf->mutex);
+  free (mf);
+  return ret;
+}
+
+int SudsManifestLoad (const char *path, SUDS_MANIFEST_ENT **ent, long *n)
+{
+  FILE              *fp;
+  char               line[LINE_MAX_LEN];
+  char              *nl;
+  SUDS_MANIFEST_ENT  e, *tmp;
+  long               max = 0;
+  int                at;
+
+  *ent = NULL;
+  *n = 0;
+  if ((fp = fopen (path, "r")) == NULL)
+    return (errno == ENOENT) ? EW_SUCCESS : EW_FAILURE;
+  while (fgets (line, sizeof (line), fp) != NULL)
+  {
+    if ((nl = strchr (line, '\n')) == NULL)
+      continue;                         /* cut short by a crash */
+    *nl = '\0';
+    memset (&e, 0, sizeof (e));
+    if (sscanf (line, "%31s %lf %lf %ld %ld %n", e.evid, &e.begintime,
+                &e.endtime, &e.nchans, &e.bytes, &at) != 5
+        || line[at] == '\0' || strlen (line + at) >= SUDS_MANIFEST_MAXPATH)
+      continue;
+    strcpy (e.path, line + at);
+    if (*n == max)
+    {
+      max = (max > 0) ? 2 * max : 256;
+      if ((tmp = (SUDS_MANIFEST_ENT *) realloc (*ent,
+                   max * sizeof (SUDS_MANIFEST_ENT))) == NULL)
+      {
+        logit ("e", "SudsManifestLoad: couldn't malloc entries\n");
+        fclose (fp);
+        free (*ent);
+        *ent = NULL;
+        *n = 0;
+        return EW_FAILURE;
+      }
+      *ent = tmp;
+    }
+    (*ent)[(*n)++] = e;
+  }
+  fclose (fp);
+  return EW_SUCCESS;
+}
@@ -0,0 +1,507 @@
+/* sudsmetrics.c
+
+        Counters and phase timers for the SUDS putaway routines; see
+        sudsmetrics.h
+
+   The totals are one SUDS_CHANMETRICS per station/channel/network,
+   found by an open-addressed hash on the names; a flush takes the lock
+   once per channel written. Writing the files copies the totals under
+   the lock and formats the copy outside it.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <earthworm.h>
+#include <sudsmetrics.h>
+
+#define CALIBRATE_SEC   0.01           /* least time to scale the clock over */
+
+static const char *PhaseName[SUDS_NPHASE] =
+  { "decode", "detect", "convert", "gapfill", "header", "write" };
+
+/* The counts, for writing them out */
+typedef struct
+{
+  const char *name;                    /* suds_channel_<name> */
+  const char *help;
+  int         gauge;
+  size_t      off;
+  int         real;                    /* a double, not a long */
+} METRIC_DESC;
+
+static const METRIC_DESC Desc[] =
+{
+  { "traces_total", "Traces (DESCRIPTRACEs) written.", 0,
+    offsetof (SUDS_CHANMETRICS, traces), 0 },
+  { "direct_traces_total", "Traces written from the packets without a copy.", 0,
+    offsetof (SUDS_CHANMETRICS, direct), 0 },
+  { "packets_total", "TRACE_BUF packets taken in.", 0,
+    offsetof (SUDS_CHANMETRICS, packets), 0 },
+  { "samples_total", "Samples taken in.", 0,
+    offsetof (SUDS_CHANMETRICS, samples), 0 },
+  { "bytes_written_total", "Bytes written to SUDS files.", 0,
+    offsetof (SUDS_CHANMETRICS, bytes), 1 },
+  { "gaps_total", "Gaps between packets.", 0,
+    offsetof (SUDS_CHANMETRICS, gaps), 0 },
+  { "gap_max_seconds", "Largest gap between packets.", 1,
+    offsetof (SUDS_CHANMETRICS, gap_max), 1 },
+  { "overlaps_total", "Packets starting before the last one ended.", 0,
+    offsetof (SUDS_CHANMETRICS, overlaps), 0 },
+  { "clipped_samples_total", "Samples at or beyond the clip level.", 0,
+    offsetof (SUDS_CHANMETRICS, clipped), 0 },
+  { "truncated_traces_total", "Traces cut short for want of buffer.", 0,
+    offsetof (SUDS_CHANMETRICS, truncated), 0 },
+  { "bad_components_total", "Traces with an unknown component.", 0,
+    offsetof (SUDS_CHANMETRICS, badcomp), 0 },
+  { "errors_total", "Traces or segments that failed.", 0,
+    offsetof (SUDS_CHANMETRICS, errors), 0 },
+};
+#define NDESC  (int) (sizeof (Desc) / sizeof (Desc[0]))
+
+struct _SUDS_METRICS
+{
+  SUDS_CHANMETRICS *ch;                /* totals per channel */
+  int        nch, maxch;
+  int       *hash;                     /* channel + 1, or 0 for none */
+  int        nhash;                    /* a power of 2, at least 2 * maxch */
+  long       events;
+  char      *PromFile, *JsonFile;
+  int        ExportSec;
+  double     LastExport;
+  uint64_t   tick0;                    /* clock and time at creation */
+  double     sec0;
+  pthread_mutex_t mutex;
+};
+
+/* Internal Function Prototypes */
+static int Find (SUDS_METRICS *, const SUDS_CHANMETRICS *);
+static int Grow (SUDS_METRICS *);
+static unsigned int Hash (const SUDS_CHANMETRICS *);
+static double TickSeconds (SUDS_METRICS *);
+static void WriteProm (FILE *, SUDS_CHANMETRICS *, int, long, double);
+static void WriteJson (FILE *, SUDS_CHANMETRICS *, int, long, double);
+static void PromLabels (FILE *, const SUDS_CHANMETRICS *);
+static void Escaped (FILE *, const char *);
+static double Value (const SUDS_CHANMETRICS *, const METRIC_DESC *);
+static double Now (void);
+
+SUDS_METRICS *SudsMetricsCreate (const char *PromFile, const char *JsonFile,
+                                 int ExportSec)
+{
+  SUDS_METRICS  *m;
+
+  if ((m = (SUDS_METRICS *) calloc (1, sizeof (SUDS_METRICS))) == NULL
+      || (PromFile != NULL && (m->PromFile = strdup (PromFile)) == NULL)
+      || (JsonFile != NULL && (m->JsonFile = strdup (JsonFile)) == NULL))
+  {
+    logit ("e", "SudsMetricsCreate: couldn't malloc metrics\n");
+    if (m != NULL)
+    {
+      free (m->PromFile);
+      free (m);
+    }
+    return NULL;
+  }
+  m->ExportSec = ExportSec;
+  pthread_mutex_init (&m->mutex, NULL);
+
+  /* the clock is scaled against the time since now, so start at least *
+   * CALIBRATE_SEC back                                                  */
+  m->tick0 = SudsMetricsClock ();
+  m->sec0 = Now ();
+  m->LastExport = m->sec0;
+  while (Now () - m->sec0 < CALIBRATE_SEC)
+    ;
+  return m;
+}
+
+void SudsMetricsStart (SUDS_METRICS *m, SUDS_CHANMETRICS *cm,
+                       const char *sta, const char *chan, const char *net)
+{
+  memset (cm, 0, sizeof (SUDS_CHANMETRICS));
+  if (m == NULL)
+    return;
+  strncpy (cm->sta, sta, TRACE_STA_LEN - 1);
+  strncpy (cm->chan, chan, TRACE_CHAN_LEN - 1);
+  strncpy (cm->net, net, TRACE_NET_LEN - 1);
+  cm->on = 1;
+  cm->last = SudsMetricsClock ();
+}
+
+int SudsMetricsFlush (SUDS_METRICS *m, SUDS_CHANMETRICS *cm)
+{
+  SUDS_CHANMETRICS *t;
+  int     i, p;
+
+  if (m == NULL || !cm->on)
+    return EW_SUCCESS;
+
+  pthread_mutex_lock (&m->mutex);
+  if ((i = Find (m, cm)) < 0)
+  {
+    pthread_mutex_unlock (&m->mutex);
+    return EW_FAILURE;
+  }
+  t = &m->ch[i];
+  for (p = 0; p < SUDS_NPHASE; p++)
+    t->ticks[p] += cm->ticks[p];
+  t->traces += cm->traces;
+  t->direct += cm->direct;
+  t->packets += cm->packets;
+  t->samples += cm->samples;
+  t->gaps += cm->gaps;
+  t->overlaps += cm->overlaps;
+  t->clipped += cm->clipped;
+  t->truncated += cm->truncated;
+  t->badcomp += cm->badcomp;
+  t->errors += cm->errors;
+  t->bytes += cm->bytes;
+  if (t->gap_max < cm->gap_max)
+    t->gap_max = cm->gap_max;
+  pthread_mutex_unlock (&m->mutex);
+
+  /* keep the names and the clock; the counts are in the totals now */
+  memset (cm->ticks, 0, sizeof (cm->ticks));
+  cm->traces = cm->direct = cm->packets = cm->samples = 0;
+  cm->gaps = cm->overlaps = cm->clipped = cm->truncated = 0;
+  cm->badcomp = cm->errors = 0;
+  cm->gap_max = cm->bytes = 0.0;
+  return EW_SUCCESS;
+}
+
+int SudsMetricsEvent (SUDS_METRICS *m)
+{
+  double  now;
+  int     due, ret = EW_SUCCESS;
+
+  if (m == NULL)
+    return EW_SUCCESS;
+  now = Now ();
+  pthread_mutex_lock (&m->mutex);
+  m->events++;
+  due = (m->ExportSec > 0 && now - m->LastExport >= m->ExportSec);
+  if (due)
+    m->LastExport = now;
+  pthread_mutex_unlock (&m->mutex);
+
+  if (due && m->PromFile != NULL
+      && SudsMetricsWrite (m, SUDS_METRICS_PROM, m->PromFile) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  if (due && m->JsonFile != NULL
+      && SudsMetricsWrite (m, SUDS_METRICS_JSON, m->JsonFile) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  return ret;
+}
+
+int SudsMetricsWrite (SUDS_METRICS *m, int format, const char *path)
+{
+  SUDS_CHANMETRICS *copy;
+  FILE   *fp;
+  char   *tmp;
+  double  spt;
+  long    events;
+  int     nch, err;
+
+  if (m == NULL || path == NULL)
+  {
+    logit ("e", "SudsMetricsWrite: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+
+  pthread_mutex_lock (&m->mutex);
+  nch = m->nch;
+  events = m->events;
+  if ((copy = (SUDS_CHANMETRICS *) malloc ((nch + 1)
+                                           * sizeof (SUDS_CHANMETRICS))) != NULL)
+    memcpy (copy, m->ch, nch * sizeof (SUDS_CHANMETRICS));
+  pthread_mutex_unlock (&m->mutex);
+  if (copy == NULL || (tmp = (char *) malloc (strlen (path) + 5)) == NULL)
+  {
+    logit ("e", "SudsMetricsWrite: couldn't malloc a copy of the metrics\n");
+    free (copy);
+    return EW_FAILURE;
+  }
+  spt = TickSeconds (m);
+
+  sprintf (tmp, "%s.tmp", path);
+  if ((fp = fopen (tmp, "w")) == NULL)
+  {
+    logit ("e", "SudsMetricsWrite: can't open %s: %s\n", tmp,
+           strerror (errno));
+    free (tmp);
+    free (copy);
+    return EW_FAILURE;
+  }
+  if (format == SUDS_METRICS_JSON)
+    WriteJson (fp, copy, nch, events, spt);
+  else
+    WriteProm (fp, copy, nch, events, spt);
+  err = ferror (fp);
+  if (fclose (fp) != 0 || err || rename (tmp, path) != 0)
+  {
+    logit ("e", "SudsMetricsWrite: error writing %s: %s\n", path,
+           strerror (errno));
+    remove (tmp);
+    free (tmp);
+    free (copy);
+    return EW_FAILURE;
+  }
+  free (tmp);
+  free (copy);
+  return EW_SUCCESS;
+}
+
+int SudsMetricsDestroy (SUDS_METRICS *m)
+{
+  int  ret = EW_SUCCESS;
+
+  if (m == NULL)
+    return EW_SUCCESS;
+  if (m->PromFile != NULL
+      && SudsMetricsWrite (m, SUDS_METRICS_PROM, m->PromFile) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  if (m->JsonFile != NULL
+      && SudsMetricsWrite (m, SUDS_METRICS_JSON, m->JsonFile) != EW_SUCCESS)
+    ret = EW_FAILURE;
+  pthread_mutex_destroy (&m->mutex);
+  free (m->ch);
+  free (m->hash);
+  free (m->PromFile);
+  free (m->JsonFile);
+  free (m);
+  return ret;
+}
+
+
+/*
+ *  The table of channels
+ */
+
+/* Index of cm's channel in the totals, added if new; -1 if out of memory */
+static int Find (SUDS_METRICS *m, const SUDS_CHANMETRICS *cm)
+{
+  SUDS_CHANMETRICS *t;
+  unsigned int  h;
+  int           i;
+
+  if (m->nch == m->maxch && Grow (m) != EW_SUCCESS)
+    return -1;
+  for (h = Hash (cm) & (m->nhash - 1); (i = m->hash[h] - 1) >= 0;
+       h = (h + 1) & (m->nhash - 1))
+  {
+    t = &m->ch[i];
+    if (strcmp (t->sta, cm->sta) == 0 && strcmp (t->chan, cm->chan) == 0
+        && strcmp (t->net, cm->net) == 0)
+      return i;
+  }
+  i = m->nch++;
+  memset (&m->ch[i], 0, sizeof (SUDS_CHANMETRICS));
+  strcpy (m->ch[i].sta, cm->sta);
+  strcpy (m->ch[i].chan, cm->chan);
+  strcpy (m->ch[i].net, cm->net);
+  m->hash[h] = i + 1;
+  return i;
+}
+
+/* Double the room for channels, and rehash */
+static int Grow (SUDS_METRICS *m)
+{
+  SUDS_CHANMETRICS *ch;
+  unsigned int  h;
+  int          *hash;
+  int           max = (m->maxch == 0) ? 64 : 2 * m->maxch;
+  int           i;
+
+  if ((ch = (SUDS_CHANMETRICS *) realloc (m->ch, max * sizeof (SUDS_CHANMETRICS)))
+      == NULL)
+  {
+    logit ("e", "SudsMetricsFlush: couldn't malloc room for %d channels\n",
+           max);
+    return EW_FAILURE;
+  }
+  m->ch = ch;
+  if ((hash = (int *) calloc (4 * max, sizeof (int))) == NULL)
+  {
+    logit ("e", "SudsMetricsFlush: couldn't malloc room for %d channels\n",
+           max);
+    return EW_FAILURE;
+  }
+  free (m->hash);
+  m->hash = hash;
+  m->nhash = 4 * max;
+  m->maxch = max;
+  for (i = 0; i < m->nch; i++)
+  {
+    for (h = Hash (&m->ch[i]) & (m->nhash - 1); m->hash[h] != 0;
+         h = (h + 1) & (m->nhash - 1))
+      ;
+    m->hash[h] = i + 1;
+  }
+  return EW_SUCCESS;
+}
+
+/* FNV-1a over the three names */
+static unsigned int Hash (const SUDS_CHANMETRICS *cm)
+{
+  const char   *s[3];
+  unsigned int  h = 2166136261u;
+  int           i;
+
+  s[0] = cm->sta;
+  s[1] = cm->chan;
+  s[2] = cm->net;
+  for (i = 0; i < 3; i++)
+  {
+    for (; *s[i] != '\0'; s[i]++)
+      h = (h ^ (unsigned char) *s[i]) * 16777619u;
+    h = (h ^ '.') * 16777619u;
+  }
+  return h;
+}
+
+
+/*
+ *  Writing the totals out
+ */
+
+/* Seconds per clock tick, from the clock and the time since creation */
+static double TickSeconds (SUDS_METRICS *m)
+{
+  uint64_t  ticks = SudsMetricsClock () - m->tick0;
+  double    sec = Now () - m->sec0;
+
+  return (ticks > 0) ? sec / (double) ticks : 0.0;
+}
+
+static void WriteProm (FILE *fp, SUDS_CHANMETRICS *ch, int nch, long events,
+                       double spt)
+{
+  uint64_t  total;
+  int       d, i, p;
+
+  fprintf (fp, "# HELP suds_events_total Events written.\n"
+           "# TYPE suds_events_total counter\n"
+           "suds_events_total %ld\n", events);
+
+  fprintf (fp, "# HELP suds_phase_seconds_total Time spent in each phase "
+           "of writing, all channels.\n"
+           "# TYPE suds_phase_seconds_total counter\n");
+  for (p = 0; p < SUDS_NPHASE; p++)
+  {
+    for (total = 0, i = 0; i < nch; i++)
+      total += ch[i].ticks[p];
+    fprintf (fp, "suds_phase_seconds_total{phase=\"%s\"} %.6f\n",
+             PhaseName[p], total * spt);
+  }
+
+  for (d = 0; d < NDESC; d++)
+  {
+    fprintf (fp, "# HELP suds_channel_%s %s\n# TYPE suds_channel_%s %s\n",
+             Desc[d].name, Desc[d].help, Desc[d].name,
+             Desc[d].gauge ? "gauge" : "counter");
+    for (i = 0; i < nch; i++)
+    {
+      fprintf (fp, "suds_channel_%s{", Desc[d].name);
+      PromLabels (fp, &ch[i]);
+      fprintf (fp, "} %.15g\n", Value (&ch[i], &Desc[d]));
+    }
+  }
+
+  fprintf (fp, "# HELP suds_channel_phase_seconds_total Time spent in each "
+           "phase of writing the channel.\n"
+           "# TYPE suds_channel_phase_seconds_total counter\n");
+  for (i = 0; i < nch; i++)
+    for (p = 0; p < SUDS_NPHASE; p++)
+    {
+      fprintf (fp, "suds_channel_phase_seconds_total{");
+      PromLabels (fp, &ch[i]);
+      fprintf (fp, ",phase=\"%s\"} %.6f\n", PhaseName[p],
+               ch[i].ticks[p] * spt);
+    }
+}
+
+static void PromLabels (FILE *fp, const SUDS_CHANMETRICS *cm)
+{
+  fprintf (fp, "sta=\"");
+  Escaped (fp, cm->sta);
+  fprintf (fp, "\",chan=\"");
+  Escaped (fp, cm->chan);
+  fprintf (fp, "\",net=\"");
+  Escaped (fp, cm->net);
+  fprintf (fp, "\"");
+}
+
+static void WriteJson (FILE *fp, SUDS_CHANMETRICS *ch, int nch, long events,
+                       double spt)
+{
+  uint64_t  total;
+  int       d, i, p;
+
+  fprintf (fp, "{\n  \"events\": %ld,\n  \"phase_seconds\": {", events);
+  for (p = 0; p < SUDS_NPHASE; p++)
+  {
+    for (total = 0, i = 0; i < nch; i++)
+      total += ch[i].ticks[p];
+    fprintf (fp, "%s\"%s\": %.6f", (p > 0) ? ", " : "", PhaseName[p],
+             total * spt);
+  }
+  fprintf (fp, "},\n  \"channels\": [");
+  for (i = 0; i < nch; i++)
+  {
+    fprintf (fp, "%s\n    {\"sta\": \"", (i > 0) ? "," : "");
+    Escaped (fp, ch[i].sta);
+    fprintf (fp, "\", \"chan\": \"");
+    Escaped (fp, ch[i].chan);
+    fprintf (fp, "\", \"net\": \"");
+    Escaped (fp, ch[i].net);
+    fprintf (fp, "\"");
+    for (d = 0; d < NDESC; d++)
+      fprintf (fp, ", \"%.*s\": %.15g",
+               (int) (strlen (Desc[d].name)
+                      - (strstr (Desc[d].name, "_total") != NULL ? 6 : 0)),
+               Desc[d].name, Value (&ch[i], &Desc[d]));
+    fprintf (fp, ",\n     \"phase_seconds\": {");
+    for (p = 0; p < SUDS_NPHASE; p++)
+      fprintf (fp, "%s\"%s\": %.6f", (p > 0) ? ", " : "", PhaseName[p],
+               ch[i].ticks[p] * spt);
+    fprintf (fp, "}}");
+  }
+  fprintf (fp, "\n  ]\n}\n");
+}
+
+/* s with backslashes, quotes and control characters escaped, which *
+ * does for both formats                                             */
+static void Escaped (FILE *fp, const char *s)
+{
+  for (; *s != '\0'; s++)
+  {
+    if (*s == '\\' || *s == '"')
+      fprintf (fp, "\\%c", *s);
+    else if (*s == '\n')
+      fprintf (fp, "\\n");
+    else if ((unsigned char) *s < ' ')
+      fprintf (fp, "?");
+    else
+      putc (*s, fp);
+  }
+}
+
+static double Value (const SUDS_CHANMETRICS *cm, const METRIC_DESC *d)
+{
+  const char  *p = (const char *) cm + d->off;
+
+  return d->real ? *(const double *) p : (double) *(const long *) p;
+}
+
+static double Now (void)
+{
+  struct timespec  ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,187 @@
+/* sudspool.c
+
+        Persistent thread pool for batches of independent tasks
+
+   Workers sleep on a condition variable between batches. Within a batch
+   each worker claims the next unclaimed task number with an atomic
+   increment, so tasks spread themselves over the workers however uneven
+   they are, without a queue per worker.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <earthworm.h>
+#include <sudspool.h>
+
+struct _SUDS_POOL
+{
+  int              nThreads;     /* workers, counting the calling thread */
+  pthread_t       *tid;          /* the nThreads-1 pool threads */
+  pthread_mutex_t  mutex;
+  pthread_cond_t   start;        /* signalled when a batch is posted */
+  pthread_cond_t   done;         /* signalled when a worker finishes a batch */
+  unsigned long    batch;        /* batch generation number */
+  int              busy;         /* pool threads still working on this batch */
+  int              quit;
+
+  /* the current batch */
+  SUDS_POOL_TASK   fn;
+  void            *arg;
+  int              nTasks;
+  volatile int     next;         /* next unclaimed task */
+};
+
+typedef struct
+{
+  SUDS_POOL *pool;
+  int        worker;
+} POOL_WORKER;
+
+/* Claim and run tasks until the batch is exhausted */
+static void RunTasks (SUDS_POOL *pool, int worker)
+{
+  int  task;
+
+  while ((task = __sync_fetch_and_add (&pool->next, 1)) < pool->nTasks)
+    pool->fn (pool->arg, task, worker);
+}
+
+static void *PoolThread (void *p)
+{
+  POOL_WORKER   *w = (POOL_WORKER *) p;
+  SUDS_POOL     *pool = w->pool;
+  unsigned long  seen = 0;
+
+  pthread_mutex_lock (&pool->mutex);
+  for (;;)
+  {
+    while (!pool->quit && pool->batch == seen)
+      pthread_cond_wait (&pool->start, &pool->mutex);
+    if (pool->quit)
+      break;
+    seen = pool->batch;
+    pthread_mutex_unlock (&pool->mutex);
+
+    RunTasks (pool, w->worker);
+
+    pthread_mutex_lock (&pool->mutex);
+    if (--pool->busy == 0)
+      pthread_cond_signal (&pool->done);
+  }
+  pthread_mutex_unlock (&pool->mutex);
+  free (w);
+  return NULL;
+}
+
+/************************************************************************
+* SudsPoolCreate: start a pool of nThreads workers. The calling thread  *
+*       of SudsPoolRun counts as one of them, so nThreads == 1 starts   *
+*       no threads at all.                                              *
+*************************************************************************/
+SUDS_POOL *SudsPoolCreate (int nThreads)
+{
+  SUDS_POOL   *pool;
+  POOL_WORKER *w;
+  int          i;
+
+  if (nThreads < 1)
+    nThreads = 1;
+  if ((pool = (SUDS_POOL *) calloc (1, sizeof (SUDS_POOL))) == NULL)
+  {
+    logit ("e", "SudsPoolCreate: couldn't malloc pool\n");
+    return NULL;
+  }
+  if ((pool->tid = (pthread_t *) calloc (nThreads, sizeof (pthread_t))) == NULL)
+  {
+    logit ("e", "SudsPoolCreate: couldn't malloc thread ids\n");
+    free (pool);
+    return NULL;
+  }
+  pthread_mutex_init (&pool->mutex, NULL);
+  pthread_cond_init (&pool->start, NULL);
+  pthread_cond_init (&pool->done, NULL);
+
+  pool->nThreads = 1;
+  for (i = 1; i < nThreads; i++)
+  {
+    if ((w = (POOL_WORKER *) malloc (sizeof (POOL_WORKER))) == NULL)
+      break;
+    w->pool = pool;
+    w->worker = i;
+    if (pthread_create (&pool->tid[i - 1], NULL, PoolThread, w) != 0)
+    {
+      logit ("e", "SudsPoolCreate: couldn't start thread %d; using %d\n",
+             i, pool->nThreads);
+      free (w);
+      break;
+    }
+    pool->nThreads++;
+  }
+  return pool;
+}
+
+int SudsPoolThreads (SUDS_POOL *pool)
+{
+  return (pool == NULL) ? 1 : pool->nThreads;
+}
+
+/************************************************************************
+* SudsPoolRun: run fn(arg, task, worker) for task = 0..nTasks-1 on the  *
+*       pool and the calling thread, and return when all are done.      *
+*       Only one thread may call SudsPoolRun on a pool at a time.       *
+*************************************************************************/
+int SudsPoolRun (SUDS_POOL *pool, int nTasks, SUDS_POOL_TASK fn, void *arg)
+{
+  int  i;
+
+  if (fn == NULL)
+    return EW_FAILURE;
+
+  /* No pool or nothing to share: just do it here */
+  if (pool == NULL || pool->nThreads == 1 || nTasks <= 1)
+  {
+    for (i = 0; i < nTasks; i++)
+      fn (arg, i, 0);
+    return EW_SUCCESS;
+  }
+
+  pthread_mutex_lock (&pool->mutex);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->nTasks = nTasks;
+  pool->next = 0;
+  pool->busy = pool->nThreads - 1;
+  pool->batch++;
+  pthread_cond_broadcast (&pool->start);
+  pthread_mutex_unlock (&pool->mutex);
+
+  RunTasks (pool, 0);
+
+  pthread_mutex_lock (&pool->mutex);
+  while (pool->busy > 0)
+    pthread_cond_wait (&pool->done, &pool->mutex);
+  pthread_mutex_unlock (&pool->mutex);
+  return EW_SUCCESS;
+}
+
+void SudsPoolDestroy (SUDS_POOL *pool)
+{
+  int  i;
+
+  if (pool == NULL)
+    return;
+  pthread_mutex_lock (&pool->mutex);
+  pool->quit = 1;
+  pthread_cond_broadcast (&pool->start);
+  pthread_mutex_unlock (&pool->mutex);
+  for (i = 0; i < pool->nThreads - 1; i++)
+    pthread_join (pool->tid[i], NULL);
+
+  pthread_mutex_destroy (&pool->mutex);
+  pthread_cond_destroy (&pool->start);
+  pthread_cond_destroy (&pool->done);
+  free (pool->tid);
+  free (pool);
+}
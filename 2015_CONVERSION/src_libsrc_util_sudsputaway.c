@@ -57,11 +57,18 @@
     everything else being passed in via the putaway.c calls.
 */
 
+#include <ctype.h>
 #include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <unistd.h>
 #include <earthworm.h>
 #include <time.h>
 #include <trace_buf.h>
@@ -69,6 +76,11 @@
 #include <ws_clientII.h>
 #include <sudshead.h>
 #include <pa_subs.h>
+#include <sudsconvert.h>
+#include <sudsstats.h>
+#include <sudsio.h>
+#include <sudsswap.h>
+#include <sudswriter.h>
 
 #define TAG_FILE        '.tag'        /* file containing the last known file tag */
 #define MAXTXT           150
@@ -76,13 +88,124 @@
 
 FILE    *SUDSfp;                      /* file pointer for the SUDS file */
 
-static  long   *SudsBuffer;           /* write out SUDS data as long integers */
-static  short  *SudsBufferShort;      /* write out SUDS data as short integers */
-static  char SudsOutputFormat[MAXTXT];
+/* Writer behind the SUDSPA_XXX entry points; callers that want to write
+   several events at once keep their own SUDS_WRITER and use SUDSWR_XXX */
+static  SUDS_WRITER SudsDefault;
+
+/* Bytes in the file of a channel's header block (the STATIONCOMP and *
+ * DESCRIPTRACE with their tags), where the DESCRIPTRACE tag is in it,  *
+ * and of its other records                                             */
+#define CHAN_HDR_SIZE    (2 * SUDS_STRUCTTAG_LEN + SUDS_STATIONCOMP_LEN \
+                          + SUDS_DESCRIPTRACE_LEN)
+#define CHAN_DT_AT       (SUDS_STRUCTTAG_LEN + SUDS_STATIONCOMP_LEN)
+#define CHAN_STATS_SIZE  (SUDS_STRUCTTAG_LEN + SUDS_CHANSTATS_LEN)
+#define CHAN_TRIG_SIZE   (SUDS_STRUCTTAG_LEN + SUDS_TRIGGERS_LEN)
+#define CHAN_QC_SIZE     (SUDS_STRUCTTAG_LEN + SUDS_CHANQC_LEN)
+
+/* time_correct and rate_correct, the last 12 bytes of a DESCRIPTRACE *
+ * in the file, which TimeCorrect patches                              */
+#define DT_CORRECT_AT    52
+#define DT_CORRECT_LEN   12
+
+/* Least bytes of samples a packet (the last aside) for a trace to be   *
+ * written straight from the packets; below it, each piece of a gather  *
+ * write costs more than copying the samples does                       */
+#define DIRECT_MIN_PIECE  2048
+
+/* One channel, encoded and ready to write: the SUDS structs are already
+   encoded in output byte order into hdr, just as they go in the file, and
+   data points at data_size bytes of samples. For a streamed channel
+   hdr_off is where room was left for the structs, and data holds only
+   the samples not yet written; otherwise it is -1. stats is the stats
+   record, written after the samples if the writer wants it, and trig
+   the channel's triggers, written after that if it triggered, and qc
+   its QC record, written last if the writer checks traces; cq is the
+   same in our byte order. m is filled in as the channel is encoded and
+   written, and added into the writer's metrics by PutChannel. A
+   channel whose samples go out just as they came in has npiece pieces
+   of them, piece[1] to piece[npiece], pointing into the packets,
+   instead of data; piece[0] and the three after the last are left for
+   WriteChannel */
+typedef struct
+{
+  char                hdr[CHAN_HDR_SIZE];
+  SUDS_CHANINDEX      ix;               /* native order; offsets set on writing */
+  SUDS_CATROW         cat;              /* the catalog's row, if there is a catalog */
+  char                stats[CHAN_STATS_SIZE];
+  char                trig[CHAN_TRIG_SIZE];
+  int                 triggered;
+  char                qc[CHAN_QC_SIZE];
+  SUDS_CHANQC         cq;
+  int                 irig;             /* this is the time code channel */
+  void               *data;
+  struct iovec       *piece;
+  long                npiece;
+  long                data_size;
+  long                trace_size;       /* bytes of samples in the whole trace */
+  off_t               hdr_off;
+  SUDS_CHANMETRICS    m;                /* the channel's counts and times */
+} SUDS_CHANOUT;
+
+/* State shared by the tasks of one SUDSWR_next_batch call */
+typedef struct
+{
+  SUDS_WRITER     *sw;
+  TRACE_REQ       *ptrReq;
+  double           GapThresh;
+  long             OutBufferLen;
+  int              debug;
+  int              nFailed;
+  int              NextWrite;        /* channel whose turn it is to write */
+  pthread_mutex_t  mutex;
+  pthread_cond_t   turn;
+} SUDS_BATCH;
+
+/* A channel's sample buffer, from the writer's pool; 16 or 32-bit *
+ * samples as the channel's data type has it                         */
+typedef struct
+{
+  char            *p;
+  size_t           size;             /* bytes */
+} SUDS_CHANBUF;
+
+/* Gaps and overlaps found while splitting one channel into segments */
+typedef struct
+{
+  char             sta[TRACE_STA_LEN];
+  char             chan[TRACE_CHAN_LEN];
+  char             net[TRACE_NET_LEN];
+  int              nseg;
+  int              ngaps;
+  int              noverlaps;
+  double           gap_total, gap_max;           /* seconds */
+  double           overlap_total, overlap_max;
+} SUDS_GAPSUM;
 
 /* Internal Function Prototypes */
-static int StructMakeLocal (void *, int, char, int);
-static int SwapDo (void *, int);
+static int EncodeChannel (SUDS_WRITER *, SUDS_CHANBUF *, TRACE_REQ *, double,
+                          long, SUDS_OUT *, SUDS_CHANOUT *, int);
+static int WriteChannel (SUDS_WRITER *, SUDS_CHANOUT *, int);
+static long TraceLimit (SUDS_WRITER *, long, SUDS_OUT *);
+static long Conforming (TRACE_REQ *, double, double, long);
+static int Reserve (SUDS_WRITER *, SUDS_CHANBUF *, long, long);
+static int StreamSamples (SUDS_OUT *, const void *, long);
+static void StreamAbort (SUDS_OUT *, off_t);
+static int PutChannel (SUDS_WRITER *, TRACE_REQ *, double, long, SUDS_OUT *,
+                       SUDS_BATCH *, int, int);
+static int NextSegment (TRACE_REQ *, char **, double, TRACE_REQ *, SUDS_GAPSUM *);
+static int WriteGapSummary (SUDS_WRITER *, SUDS_GAPSUM *, int);
+static void WaitTurn (SUDS_WRITER *, SUDS_BATCH *, int, size_t);
+static void PassTurn (SUDS_BATCH *, int);
+static void BatchTask (void *, int, int);
+static int BatchSetup (SUDS_WRITER *, int, int);
+static int WriteDetector (SUDS_WRITER *, int);
+static int TimeCorrect (SUDS_WRITER *, int);
+static int EventPath (SUDS_WRITER *, char *, const char *, const char *);
+static void NoteSpan (SUDS_WRITER *, const SUDS_CHANINDEX *);
+static void NoteQc (SUDS_WRITER *, const SUDS_CHANQC *);
+static int WriteQcSummary (SUDS_WRITER *, int);
+static int OpenEvent (SUDS_WRITER *, const char *, int);
+static const SUDS_STATIONCOMP *FindStation (SUDS_WRITER *, const SUDS_STATIDENT *);
 
 /************************************************************************
 * Initialization function,                                              *
@@ -93,48 +216,245 @@ static int SwapDo (void *, int);
 *                                                                       *
 *       For PCSUDS, all we want to do is to make sure that the          *
 *       directory where files should be written exists.                 *
+*                                                                       *
+*       Everything an event writer needs lives in the SUDS_WRITER, so   *
+*       each thread writing events can have its own.                    *
 *************************************************************************/
-int SUDSPA_init (int OutBufferLen, char *OutDir, char *OutputFormat, 
-                 int debug)
+int SUDSWR_init (SUDS_WRITER *sw, int OutBufferLen, char *OutDir,
+                 char *OutputFormat, int debug)
 {
-  /** Allocate SudsBuffer and SudsBufferShort 
-       We waste RAM by allocating both the long and short buffers here
-	 at the beginning of the code because some fluke (feature?) of NT 
-	 which I don't understand becomes unhappy if we do the allocation 
-	later. Win2000, of course, behaves differently, and is quite happy
-	with buffer allocation after we have determined the format of the
-	incoming data */
-  if ((SudsBuffer = (long *) malloc (OutBufferLen * sizeof (char))) == NULL)
+  if (sw == NULL)
   {
-    logit ("et", "SUDSPA_init: couldn't malloc SudsBuffer\n");
-    return EW_FAILURE;
-  }
-  if ((SudsBufferShort = (short *) malloc (OutBufferLen * sizeof (char))) == NULL)
-  {
-    logit ("et", "SUDSPA_init: couldn't malloc SudsBufferShort\n");
+    logit ("e", "SUDSWR_init: invalid argument passed in.\n");
     return EW_FAILURE;
   }
+  memset (sw, 0, sizeof (SUDS_WRITER));
 
   /* Make sure that the top level output directory exists */
   if (CreateDir (OutDir) != EW_SUCCESS)
   {
-    logit ("e", "SUDSPA_init: Call to CreateDir failed\n");
+    logit ("e", "SUDSWR_init: Call to CreateDir failed\n");
     return EW_FAILURE;
   }
 
-  if(strlen(OutputFormat) >= sizeof(SudsOutputFormat))
+  if(strlen(OutputFormat) >= sizeof(sw->OutputFormat))
   {
-    logit("","SUDSPA_init: Error: OutputFormat(%s) is too long! Quitting!\n",
+    logit("","SUDSWR_init: Error: OutputFormat(%s) is too long! Quitting!\n",
           OutputFormat);
     return(EW_FAILURE);
   }
   else
   {
-    strcpy(SudsOutputFormat,OutputFormat);
+    strcpy(sw->OutputFormat,OutputFormat);
+  }
+
+  /* Settle the output byte order here, once, rather than per channel */
+  if (SudsParseOrder (OutputFormat, &sw->Order) != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_init: OutputFormat must be intel or sparc, not %s\n",
+           OutputFormat);
+    return EW_FAILURE;
+  }
+  sw->Swap = SUDS_ORDER_SWAP (sw->Order);
+  sw->BufferLen = OutBufferLen;
+
+  /* Every struct goes out through its field table; make sure they are *
+   * all the PC-SUDS sizes before a file is written with them          */
+  if (SudsCheckLayout () != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_init: SUDS struct tables are wrong; not writing\n");
+    return EW_FAILURE;
+  }
+
+  /* The sample buffers come from a pool, a channel at a time, sized   *
+   * to the channel; nothing is allocated until there is data to hold. *
+   * SUDSWR_set_buffers can swap this pool for a shared one. It is     *
+   * made last, so that no failure above leaves it behind.             */
+  if ((sw->OwnBuffers = SudsBufPoolCreate (0, 0)) == NULL)
+  {
+    logit ("et", "SUDSWR_init: couldn't create buffer pool\n");
+    return EW_FAILURE;
   }
+  sw->Buffers = sw->OwnBuffers;
+
+  /* Pick the sample conversion kernels for this CPU */
+  SudsConvertInit ();
+  if (debug == 1)
+    logit ("", "SUDSWR_init: using %s sample conversion\n", SudsConvertName ());
+
   return EW_SUCCESS; 
 }
 
+/* Turn streaming of long traces on or off; see sudswriter.h */
+int SUDSWR_set_stream (SUDS_WRITER *sw, int Stream)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Stream = Stream;
+  return EW_SUCCESS;
+}
+
+/* Choose how event files are written (SUDS_IO_XXX in sudsio.h); takes *
+ * effect from the next event                                          */
+int SUDSWR_set_io (SUDS_WRITER *sw, int IoMode)
+{
+  if (sw == NULL || IoMode < SUDS_IO_STDIO || IoMode > SUDS_IO_DIRECT)
+    return EW_FAILURE;
+  sw->IoMode = IoMode;
+  return EW_SUCCESS;
+}
+
+/* Write through the write-behind service as from the next event on, *
+ * calling done (may be NULL) with arg as each file is finished; a    *
+ * NULL service goes back to plain stdio output                       */
+int SUDSWR_set_async (SUDS_WRITER *sw, SUDS_ASYNC *as, SUDS_ASYNC_DONE done,
+                      void *arg)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Async = as;
+  sw->AsyncDone = done;
+  sw->AsyncArg = arg;
+  sw->IoMode = (as != NULL) ? SUDS_IO_ASYNC : SUDS_IO_STDIO;
+  return EW_SUCCESS;
+}
+
+/* Turn splitting of channels at gaps on or off; see sudswriter.h */
+int SUDSWR_set_segment (SUDS_WRITER *sw, int Segment)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Segment = Segment;
+  return EW_SUCCESS;
+}
+
+/* Count samples at or beyond +/-ClipValue as clipped; 0 goes back to *
+ * the limits of the output sample type                               */
+int SUDSWR_set_clip (SUDS_WRITER *sw, long ClipValue)
+{
+  if (sw == NULL || ClipValue < 0 || ClipValue > INT32_MAX)
+    return EW_FAILURE;
+  sw->ClipValue = ClipValue;
+  return EW_SUCCESS;
+}
+
+/* Turn the stats record after each trace on or off; see sudsstats.h */
+int SUDSWR_set_stats (SUDS_WRITER *sw, int WriteStats)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->WriteStats = WriteStats;
+  return EW_SUCCESS;
+}
+
+/* Feed every packet to rs (NULL to stop); see sudsrsam.h */
+int SUDSWR_set_rsam (SUDS_WRITER *sw, SUDS_RSAM *rs)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Rsam = rs;
+  return EW_SUCCESS;
+}
+
+/* Run every channel through tg's detectors (NULL to stop); see *
+ * sudstrigger.h                                                 */
+int SUDSWR_set_trigger (SUDS_WRITER *sw, SUDS_TRIG *tg)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Trig = tg;
+  return EW_SUCCESS;
+}
+
+/* Decode the time code with ir (NULL to stop) and correct the times *
+ * of each event by it; see sudsirig.h                               */
+int SUDSWR_set_irig (SUDS_WRITER *sw, SUDS_IRIG *ir)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Irig = ir;
+  return EW_SUCCESS;
+}
+
+/* Count and time the work into m (NULL to stop); see sudsmetrics.h */
+int SUDSWR_set_metrics (SUDS_WRITER *sw, SUDS_METRICS *m)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Metrics = m;
+  return EW_SUCCESS;
+}
+
+/* Take sample buffers from bp, which may be shared with other writers, *
+ * rather than the writer's own pool; NULL to go back to that. Must not *
+ * be called while a channel is being written.                          */
+int SUDSWR_set_buffers (SUDS_WRITER *sw, SUDS_BUFPOOL *bp)
+{
+  if (sw == NULL || sw->OwnBuffers == NULL)
+    return EW_FAILURE;
+  sw->Buffers = (bp != NULL) ? bp : sw->OwnBuffers;
+  return EW_SUCCESS;
+}
+
+/* Choose where SUDSWR_next_ev puts each file under OutDir *
+ * (SUDS_LAYOUT_XXX); takes effect from the next event       */
+int SUDSWR_set_layout (SUDS_WRITER *sw, int Layout)
+{
+  if (sw == NULL || Layout < SUDS_LAYOUT_FLAT || Layout > SUDS_LAYOUT_HASH)
+    return EW_FAILURE;
+  sw->Layout = Layout;
+  return EW_SUCCESS;
+}
+
+/* Record each file closed in mf from now on; NULL to stop */
+int SUDSWR_set_manifest (SUDS_WRITER *sw, SUDS_MANIFEST *mf)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Manifest = mf;
+  return EW_SUCCESS;
+}
+
+/* Add a row to cat for each trace written from now on; NULL to stop */
+int SUDSWR_set_catalog (SUDS_WRITER *sw, SUDS_CATALOG *cat)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Catalog = cat;
+  return EW_SUCCESS;
+}
+
+/* Check every trace with qc (NULL to stop); see sudsqc.h. Must not be *
+ * called while a channel is being written.                            */
+int SUDSWR_set_qc (SUDS_WRITER *sw, SUDS_QC *qc)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->Qc = qc;
+  return EW_SUCCESS;
+}
+
+/* Start each channel's STATIONCOMP from the one of these (native byte *
+ * order; NULL to stop) with its name, rather than from zeros           */
+int SUDSWR_set_stations (SUDS_WRITER *sw, const SUDS_STATIONCOMP *sc, int n)
+{
+  if (sw == NULL || n < 0 || (sc == NULL && n > 0))
+    return EW_FAILURE;
+  sw->Stations = sc;
+  sw->nStations = n;
+  return EW_SUCCESS;
+}
+
+/* Turn the channel index record at the end of each file on or off; *
+ * takes effect from the next event                                 */
+int SUDSWR_set_index (SUDS_WRITER *sw, int WriteIndex)
+{
+  if (sw == NULL)
+    return EW_FAILURE;
+  sw->WriteIndex = WriteIndex;
+  return EW_SUCCESS;
+}
+
 /************************************************************************
 *   This is the Put Away event initializer. It's called when a snippet  *
 *   has been received, and is about to be processed.                    *
@@ -145,12 +465,12 @@ int SUDSPA_init (int OutBufferLen, char *OutDir, char *OutputFormat,
 *   exists, create it if it does not, then open the SUDS file           *
 *   for writing.                                                        *
 *************************************************************************/
-int SUDSPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq, 
-                    char *OutDir, char *EventDate, char *EventTime,
+int SUDSWR_next_ev (SUDS_WRITER *sw, char *EventID, TRACE_REQ *ptrReq,
+                    int nReq, char *OutDir, char *EventDate, char *EventTime,
                     char *EventSubnet, int debug)
 
 {
-  char    SUDSFile[4*MAXTXT];
+  char    SUDSName[4*SUDS_MAXTXT];
   char    hhmmss[7];
 
   /* Changed by Eugene Lublinsky, 3/31/Y2K */
@@ -168,6 +488,12 @@ int SUDSPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq,
   /* Changed by Eugene Lublinsky, 3/31/Y2K */
   /* choose which way to go */
 
+  if (sw == NULL || sw->Buffers == NULL)
+  {
+    logit ("e", "SUDSWR_next_ev: writer not initialized.\n");
+    return EW_FAILURE;
+  }
+
   /* Build the file name */
   /* added by murray (and it shows) to set the eventid at 3 characters */
   if (strlen(EventID) < 3)
@@ -188,26 +514,140 @@ int SUDSPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq,
   /* changed by Carol 3/21/01: if no subnet, use network name
      in filename */
   if (EventSubnet[0] != '\0')
-    sprintf (SUDSFile, "%s/%s_%s_%s_%s.dmx", OutDir,
+    sprintf (SUDSName, "%s_%s_%s_%s.dmx",
              EventDate, hhmmss, EventSubnet, 
              &tmpEventID[strlen(tmpEventID)-3]);
   else
-    sprintf (SUDSFile, "%s/%s_%s_%s_%s.dmx", OutDir,
+    sprintf (SUDSName, "%s_%s_%s_%s.dmx",
              EventDate, hhmmss, ptrReq->net, 
              &tmpEventID[strlen(tmpEventID)-3]);
         
   /* end of changes */
 
+  /* ... and, unless sharded, still placed in the top level directory */
+  if (EventPath (sw, OutDir, EventDate, SUDSName) != EW_SUCCESS)
+    return EW_FAILURE;
+  if (OpenEvent (sw, "SUDSWR_next_ev", debug) != EW_SUCCESS)
+    return EW_FAILURE;
+  strncpy (sw->Entry.evid, EventID, SUDS_MANIFEST_MAXID - 1);
+  return EW_SUCCESS;
+}
+
+/* Put Name in the directory under OutDir that the writer's layout calls *
+ * for, making it if need be, and leave the whole path in sw->FileName    */
+static int EventPath (SUDS_WRITER *sw, char *OutDir, const char *EventDate,
+                      const char *Name)
+{
+  char          dir[4*SUDS_MAXTXT];
+  const char   *p;
+  char         *q;
+  unsigned int  h;
+  int           i;
+
+  if (strlen (OutDir) + 12 + strlen (Name) >= sizeof (sw->FileName))
+  {
+    logit ("e", "SUDSWR_next_ev: file name too long in %s\n", OutDir);
+    return EW_FAILURE;
+  }
+  strcpy (dir, OutDir);
+  switch (sw->Layout)
+  {
+  case SUDS_LAYOUT_DATE:
+    for (i = 0; i < 8 && isdigit ((unsigned char) EventDate[i]); i++)
+      ;
+    if (i < 8)
+      logit ("e", "SUDSWR_next_ev: event date %s isn't yyyymmdd; "
+             "writing to %s\n", EventDate, OutDir);
+    else
+      sprintf (dir, "%s/%.4s/%.2s/%.2s", OutDir, EventDate, EventDate + 4,
+               EventDate + 6);
+    break;
+  case SUDS_LAYOUT_HASH:
+    /* FNV-1a, folded to a byte */
+    for (h = 2166136261u, p = Name; *p != '\0'; p++)
+      h = (h ^ (unsigned char) *p) * 16777619u;
+    sprintf (dir, "%s/%02x", OutDir,
+             (h ^ (h >> 8) ^ (h >> 16) ^ (h >> 24)) & 0xff);
+    break;
+  }
+
+  /* OutDir was made by SUDSWR_init; make the levels below it, unless *
+   * the last event already did                                       */
+  if (sw->Layout != SUDS_LAYOUT_FLAT && strcmp (dir, sw->MadeDir) != 0)
+  {
+    for (q = dir + strlen (OutDir) + 1; (q = strchr (q, '/')) != NULL; q++)
+    {
+      *q = '\0';
+      if (CreateDir (dir) != EW_SUCCESS)
+        break;
+      *q = '/';
+    }
+    if (q != NULL || CreateDir (dir) != EW_SUCCESS)
+    {
+      logit ("e", "SUDSWR_next_ev: can't make directory %s\n", dir);
+      sw->MadeDir[0] = '\0';
+      return EW_FAILURE;
+    }
+    strcpy (sw->MadeDir, dir);
+  }
+  sprintf (sw->FileName, "%s/%s", dir, Name);
+  return EW_SUCCESS;
+}
+
+/* Start an event in the file FileName, named by the caller rather than *
+ * built from the event's id and time (e.g. a demultiplexed .WVM file)  */
+int SUDSWR_next_ev_file (SUDS_WRITER *sw, const char *FileName, int debug)
+{
+  if (sw == NULL || sw->Buffers == NULL)
+  {
+    logit ("e", "SUDSWR_next_ev_file: writer not initialized.\n");
+    return EW_FAILURE;
+  }
+  if (FileName == NULL || strlen (FileName) >= sizeof (sw->FileName))
+  {
+    logit ("e", "SUDSWR_next_ev_file: bad file name.\n");
+    return EW_FAILURE;
+  }
+  strcpy (sw->FileName, FileName);
+  return OpenEvent (sw, "SUDSWR_next_ev_file", debug);
+}
+
+/* Open sw->FileName and reset the per-file state */
+static int OpenEvent (SUDS_WRITER *sw, const char *caller, int debug)
+{
+  char   *SUDSFile = sw->FileName;
+
   if (debug == 1)
     logit ("t", "Opening SUDS file %s\n", SUDSFile);
 
   /* open file */
-  if ((SUDSfp = fopen (SUDSFile, "wb")) == NULL)
+  if (sw->IoMode == SUDS_IO_ASYNC)
+  {
+    if (SudsOutOpenAsync (&sw->Out, SUDSFile, sw->Async, sw->AsyncDone,
+                          sw->AsyncArg) != EW_SUCCESS)
+    {
+      logit ("e", "%s: unable to queue file %s\n", caller, SUDSFile);
+      return EW_FAILURE;
+    }
+  }
+  else if (SudsOutOpen (&sw->Out, SUDSFile, sw->IoMode) != EW_SUCCESS)
   {
-    logit ("e", "SUDSPA_next_ev: unable to open file %s: %s\n", 
+    logit ("e", "%s: unable to open file %s: %s\n", caller,
            SUDSFile, strerror(errno));
     return EW_FAILURE;
   }
+  SudsIndexReset (&sw->Index);
+  sw->IndexFull = 0;
+  sw->TrigEvents = SudsTrigLastEvent (sw->Trig);
+  sw->nTriggered = 0;
+  SudsIrigReset (sw->Irig);
+  memset (&sw->IrigName, 0, sizeof (sw->IrigName));
+  memset (&sw->Entry, 0, sizeof (sw->Entry));
+  memset (&sw->LastChan, 0, sizeof (sw->LastChan));
+  sw->FileKey = SudsCatalogFileKey (SUDSFile);
+  sw->nChecked = sw->nBad = sw->nLowSnr = 0;
+  sw->QualitySum = 0.0;
+  sw->BadChans[0] = '\0';
 
   return (EW_SUCCESS);
 }
@@ -217,8 +657,8 @@ int SUDSPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq,
 * routine gets called for each trace snippet which has been recovered.  *
 * It gets to see the corresponding SNIPPET structure, and the event id  *
 *                                                                       *
-* For PCSUDS, this routine writes to the SUDS file, pointed to by the   *
-* SUDSfp pointer, all of the received trace data in SUDS format:        *
+* For PCSUDS, this routine writes to the writer's open SUDS file all    *
+* of the received trace data in SUDS format:                            *
 *                                                                       *
 *      1. SUDS tag - indicating what follows                            *
 *      2. SUDS_STATIONCOMP struct - describe the station                *
@@ -233,53 +673,72 @@ int SUDSPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq,
 * WARNING: we clip trace data to -2147483648 - +2147483647 so it will   *
 *  fit in a long int. Any incoming data that is longer than 32 bits     *
 *  will be CLIPPED. cjb 5/18/2001                                       *
+*  SUDS long samples are 4 bytes, as written by 32-bit builds, even     *
+*  where the C long is 8; so are i4 TRACE_BUF samples.                  *
 *************************************************************************/
-/* Process one channel of data */
-int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
-                 long OutBufferLen, int debug)
+/* Encode one channel of data into cb, growing it as need be. If stream *
+ * is not NULL, samples are written to it whenever OutBufferLen bytes   *
+ * are buffered, so the trace length is not limited by OutBufferLen.    *
+ * Short samples already in the output byte order, with no gap to fill, *
+ * aren't copied at all: cb only lists where they are in the packets.   */
+static int EncodeChannel (SUDS_WRITER *sw, SUDS_CHANBUF *cb,
+                          TRACE_REQ *getThis, double GapThresh,
+                          long OutBufferLen, SUDS_OUT *stream, SUDS_CHANOUT *co,
+                          int debug)
 {
   TRACE_HEADER *wf;
-  short  *s_data;
-  long   *l_data;
-  float  *f_data;
   char   *msg_p;        /* pointer into tracebuf data */
   char    datatype;
-  int     data_size;
-  int     j;
+  long    data_size;
+  int     swap;
   int     gap_count = 0;
-  long    nsamp, nfill;
+  long    nsamp, nfill, nfill_left;
   long    nfill_max = 0l;
   long    nsamp_this_scn = 0l;
+  long    nbuf = 0l;        /* samples in the buffer; less than nsamp_this_scn *
+                             * only once a streamed trace has been flushed   */
   long    this_size;
+  long    room;
+  long    limit;            /* most bytes buffered, at 4 bytes a sample */
+  long    elem;             /* bytes a sample in the buffer */
+  long    est;
+  long    npk;
+  int     direct = 0;       /* samples written from the packets as they are */
   double  begintime, starttime, endtime;
   double  samprate;
-  long    fill = 0l;
-  long    min, max;
-  int     total;
-  SUDS_STRUCTTAG          tag;
+  int32_t fill = 0;
+  int     rsam_ch;          /* station number in sw->Rsam, or -1 */
+  int     trig_ch;          /* channel number in sw->Trig, or -1 */
+  SUDS_STATS              st;
+  SUDS_TRIGGERS           tr;
+  SUDS_CHANSTATS          cs;
+  SUDS_QCTRACE            qt;
   SUDS_DESCRIPTRACE       dt;
   SUDS_STATIONCOMP        sc;
+  SUDS_STATIDENT          name;
+  const SUDS_STATIONCOMP *tmpl;
   
   /* Check arguments */
   if (getThis == NULL)
   {
-    logit ("e", "SUDSPA_next: invalid argument passed in.\n");
+    logit ("e", "SUDSWR_next: invalid argument passed in.\n");
     return EW_FAILURE;
   }
 
   /* Start with a clean slate */
-  memset(&tag, 0, sizeof(tag));
   memset(&dt, 0, sizeof(dt));
   memset(&sc, 0, sizeof(sc));
+  memset(&cs, 0, sizeof(cs));
+  memset(&tr, 0, sizeof(tr));
+  memset(&co->ix, 0, sizeof(co->ix));
+  co->npiece = 0;
   
-  /* Used for computing trace statistics */
-  max = 4096;
-  min = 0;
-  total = 0;
+  /* Whether samples must be swapped was settled by SUDSWR_init */
+  swap = sw->Swap;
 
   if ( (msg_p = getThis->pBuf) == NULL)   /* pointer to first message */
   {
-    logit ("e", "SUDSPA_next: Message buffer is NULL.\n");
+    logit ("e", "SUDSWR_next: Message buffer is NULL.\n");
     return EW_FAILURE;
   }
   wf = (TRACE_HEADER *) msg_p;
@@ -287,7 +746,7 @@ int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
   /* Look at the first TRACE_HEADER and get set up of action */
   if (WaveMsgMakeLocal(wf) < 0)
   {
-    logit("e", "SUDSPA_next: unknown trace data type: %s\n",
+    logit("e", "SUDSWR_next: unknown trace data type: %s\n",
           wf->datatype);
     return( EW_FAILURE );
   }
@@ -315,62 +774,172 @@ int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
   }
   if (datatype == 'n')
   {
-    logit("et", "SUDSPA_next: unsupported datatype: %s\n", datatype);
+    logit("et", "SUDSWR_next: unsupported datatype: %s\n", wf->datatype);
     return( EW_FAILURE );
   }
 
+  /* Short samples that need no swapping are already just what goes in *
+   * the file; if no gap needs filling and the trace needn't be cut     *
+   * short, they can be written straight from the packets, and cb need  *
+   * only hold a list of them. Not through stdio, which would only copy *
+   * them again. A streamed trace doesn't need streaming then, as none  *
+   * of it is buffered.                                                 */
+  elem = (datatype == 's') ? (long) sizeof (int16_t) : (long) sizeof (int32_t);
+  limit = TraceLimit (sw, OutBufferLen, stream);
+  if (datatype == 's' && !swap && sw->Out.Mode != SUDS_IO_STDIO
+      && (npk = Conforming (getThis, GapThresh, samprate,
+                            (stream == NULL) ? limit : LONG_MAX)) > 0
+      && Reserve (sw, cb, (npk + 4) * (long) sizeof (struct iovec), 0)
+         == EW_SUCCESS)
+  {
+    direct = 1;
+    stream = NULL;
+    co->piece = (struct iovec *) cb->p;
+  }
+
+  /* Otherwise start the buffer at about what the packets will convert to */
+  est = getThis->actLen / elem * elem;
+  if (est > limit / (long) sizeof (int32_t) * elem)
+    est = limit / (long) sizeof (int32_t) * elem;
+  if (!direct && Reserve (sw, cb, est, 0) != EW_SUCCESS)
+  {
+    logit ("et", "SUDSWR_next: no buffer for <%s.%s.%s>\n", wf->sta,
+           wf->chan, wf->net);
+    return EW_FAILURE;
+  }
+
+  /* Trace statistics are taken as the samples are converted; unless *
+   * told otherwise, a sample is clipped if it is pinned at the limit *
+   * of the output type                                               */
+  if (sw->ClipValue > 0)
+    SudsStatsInit (&st, -sw->ClipValue, sw->ClipValue);
+  else if (datatype == 's')
+    SudsStatsInit (&st, SHRT_MIN, SHRT_MAX);
+  else
+    SudsStatsInit (&st, INT32_MIN, INT32_MAX);
+  rsam_ch = SudsRsamFind (sw->Rsam, wf->sta, wf->chan, wf->net);
+  if (sw->TrigFed != NULL)
+  {
+    /* run through the detectors already (SudsDemuxFile) */
+    tr = *sw->TrigFed;
+    trig_ch = -1;
+  }
+  else
+    trig_ch = SudsTrigChannel (sw->Trig, wf->sta, wf->chan, wf->net,
+                               samprate);
+  co->irig = SudsIrigMatch (sw->Irig, wf->sta, wf->chan);
+  if (sw->Qc != NULL)
+    SudsQcStart (sw->Qc, &qt, samprate, GapThresh);
+
   if (debug == 1)
-    logit("et", "SUDSPA_next: working on <%s/%s/%s> datatype: %c \n",
+    logit("et", "SUDSWR_next: working on <%s/%s/%s> datatype: %c \n",
 			wf->sta, wf->chan, wf->net, datatype);
 
+  /* When streaming, leave room for the SUDS structs here and fill them *
+   * in once the length and statistics of the trace are known           */
+  co->hdr_off = -1;
+  if (stream != NULL)
+  {
+    static const char zero[CHAN_HDR_SIZE];
+
+    if ((co->hdr_off = SudsOutTell (stream)) < 0
+        || SudsOutWrite (stream, zero, CHAN_HDR_SIZE) != EW_SUCCESS)
+    {
+      logit ("et", "SUDSWR_next: error writing SUDS structs: %s\n",
+             strerror(errno));
+      return EW_FAILURE;
+    }
+  }
+
   /* loop through all the messages for this s-c-n */
   while (1) 
   {
     /* advance message pointer to the data */
     msg_p += sizeof(TRACE_HEADER);
         
-    /* check for sufficient memory in output buffer */
-    this_size = (nsamp_this_scn + nsamp ) * sizeof(long);
-    if ( OutBufferLen < this_size )
+    /* check for sufficient memory in output buffer; when streaming, *
+     * make room by writing out what we have so far. Conforming has  *
+     * already seen that a direct trace fits.                        */
+    this_size = (nbuf + nsamp ) * (long) sizeof(int32_t);
+    if (direct)
+      ;
+    else if ( stream != NULL && limit < this_size && nbuf > 0 )
+    {
+      SudsMetricsLap (&co->m, SUDS_PH_DECODE);
+      if (StreamSamples (stream, cb->p, nbuf * elem) != EW_SUCCESS)
+      {
+        StreamAbort (stream, co->hdr_off);
+        return EW_FAILURE;
+      }
+      SudsMetricsLap (&co->m, SUDS_PH_WRITE);
+      nbuf = 0;
+      this_size = nsamp * (long) sizeof(int32_t);
+    }
+    if ( !direct && limit < this_size )
     {
       logit( "e", "out of space for <%s.%s.%s>; saving long trace.\n",
              wf->sta, wf->chan, wf->net);
+      co->m.truncated++;
       break;
     }
+    if (!direct
+        && Reserve (sw, cb, (nbuf + nsamp) * elem, nbuf * elem) != EW_SUCCESS)
+    {
+      logit( "e", "out of memory for <%s.%s.%s>; saving long trace.\n",
+             wf->sta, wf->chan, wf->net);
+      co->m.truncated++;
+      break;
+    }
+    SudsMetricsLap (&co->m, SUDS_PH_DECODE);
   
-	/* if data are floats, clip to longs cjb 5/18/2001 */
+    /* Convert straight into the output buffer in output byte order, *
+     * taking the statistics as we go. Short data stays short (disk  *
+     * space saving feature requested by Gabriel Reyes cjb 6/11/01); *
+     * if data are floats, clip to 32-bit longs cjb 5/18/2001        */
+    if (rsam_ch >= 0)
+      SudsRsamFeed (sw->Rsam, rsam_ch, wf, msg_p, datatype);
+    if (trig_ch >= 0)
+      SudsTrigFeed (sw->Trig, trig_ch, wf, msg_p, datatype, &tr);
+    if (co->irig)
+      SudsIrigFeed (sw->Irig, wf, msg_p, datatype);
+    if (sw->Qc != NULL)
+      SudsQcFeed (&qt, wf, msg_p, datatype);
+    if (rsam_ch >= 0 || trig_ch >= 0 || co->irig || sw->Qc != NULL)
+      SudsMetricsLap (&co->m, SUDS_PH_DETECT);
     switch( datatype )
     {
     case 's':
-      s_data = (short *)msg_p;
-      for ( j = 0; j < nsamp ; j++, nsamp_this_scn++ )
-        SudsBuffer[nsamp_this_scn] = (long) s_data[j];
-      msg_p += sizeof(short) * nsamp;
+      if (direct)
+      {
+        /* the statistics, in place, and where the samples are */
+        SudsConvShort ((int16_t *) msg_p, NULL, nsamp, 0, &st);
+        co->piece[++co->npiece].iov_base = msg_p;
+        co->piece[co->npiece].iov_len = sizeof(int16_t) * nsamp;
+      }
+      else
+        SudsConvShort ((int16_t *) msg_p, (int16_t *) cb->p + nbuf,
+                       nsamp, swap, &st);
+      msg_p += sizeof(int16_t) * nsamp;
       break;
     case 'l':
-      l_data = (long *)msg_p;
-      for ( j = 0; j < nsamp; j++, nsamp_this_scn++ )
-          SudsBuffer[nsamp_this_scn] = l_data[j];
-      msg_p += sizeof(long) * nsamp;
+      SudsConvLong ((int32_t *) msg_p, (int32_t *) cb->p + nbuf,
+                    nsamp, swap, &st);
+      msg_p += sizeof(int32_t) * nsamp;
       break;
     case 'f':
-      f_data = (float *)msg_p;
-      /* CLIP the data to long int */
-      for ( j = 0; j < nsamp; j++, nsamp_this_scn++ )
-      {
-        if (l_data[j] < (float)LONG_MIN)
-          SudsBuffer[nsamp_this_scn] = LONG_MIN;
-        else if (l_data[j] > (float) LONG_MAX)
-          SudsBuffer[nsamp_this_scn] = LONG_MAX;
-        else
-          SudsBuffer[nsamp_this_scn] = (long) l_data[j];
-      }
+      SudsConvFloat ((float *) msg_p, (int32_t *) cb->p + nbuf,
+                     nsamp, swap, &st);
       msg_p += sizeof(float) * nsamp;
       break;
     }
+    SudsMetricsLap (&co->m, SUDS_PH_CONVERT);
+    co->m.packets++;
+    co->m.samples += nsamp;
+    nsamp_this_scn += nsamp;
+    nbuf += nsamp;
   
     /* End-check based on length of snippet buffer */
-    if ((long) msg_p >= ((long) getThis->actLen + (long) getThis->pBuf)) 
+    if (msg_p >= getThis->pBuf + getThis->actLen)
     {
       if (debug == 1)
         logit ("", "Setting done for <%s.%s.%s>\n", wf->sta, wf->chan, 
@@ -383,119 +952,87 @@ int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
     wf = (TRACE_HEADER *) msg_p;
     if (WaveMsgMakeLocal(wf) < 0)
     {
-      logit("e", "SUDSPA_next: unknown trace data type: %s\n",
+      logit("e", "SUDSWR_next: unknown trace data type: %s\n",
             wf->datatype);
+      if (stream != NULL)
+        StreamAbort (stream, co->hdr_off);
       return( EW_FAILURE );
     }
     nsamp = wf->nsamp;
     starttime = wf->starttime; 
+    if (starttime <= endtime)
+      co->m.overlaps++;
     /* starttime is set for new packet; endtime is still set for old packet */
     if ( endtime + ( 1.0/samprate ) * GapThresh < starttime ) 
     {
       /* there's a gap, so fill it */
       logit("e", "gap in %s.%s.%s: %lf: %lf\n", wf->sta, wf->chan, wf->net,
             endtime, starttime - endtime);
+      SudsMetricsLap (&co->m, SUDS_PH_DECODE);
+      co->m.gaps++;
+      if (co->m.gap_max < starttime - endtime)
+        co->m.gap_max = starttime - endtime;
       nfill = (long) (samprate * (starttime - endtime) - 1);
-      if ( (nsamp_this_scn + nfill) * (long)sizeof(long) > OutBufferLen ) 
+      if ( ((stream == NULL) ? nsamp_this_scn + nfill : nfill)
+           * (long)sizeof(int32_t) > limit ) 
       {
         logit("e", 
-              "bogus gap (%d); skipping\n", nfill);
+              "bogus gap (%ld); skipping\n", nfill);
+        if (stream != NULL)
+          StreamAbort (stream, co->hdr_off);
         return(EW_FAILURE);
       }
-      /* do the filling */
-      for ( j = 0; j < nfill; j++, nsamp_this_scn ++ ) 
-        SudsBuffer[nsamp_this_scn] = fill;
+      /* do the filling, a buffer-load at a time when streaming */
+      for (nfill_left = nfill; nfill_left > 0; nfill_left -= room)
+      {
+        room = limit / (long)sizeof(int32_t) - nbuf;
+        if (room <= 0)
+        {
+          if (StreamSamples (stream, cb->p, nbuf * elem) != EW_SUCCESS)
+          {
+            StreamAbort (stream, co->hdr_off);
+            return EW_FAILURE;
+          }
+          nbuf = 0;
+          room = limit / (long)sizeof(int32_t);
+        }
+        if (room > nfill_left)
+          room = nfill_left;
+        if (Reserve (sw, cb, (nbuf + room) * elem, nbuf * elem) != EW_SUCCESS)
+        {
+          logit ("e", "SUDSWR_next: out of memory filling gap in <%s.%s.%s>\n",
+                 wf->sta, wf->chan, wf->net);
+          if (stream != NULL)
+            StreamAbort (stream, co->hdr_off);
+          return EW_FAILURE;
+        }
+        if (datatype == 's')
+          SudsFillShort ((int16_t *) cb->p + nbuf, room, (int16_t) fill, swap);
+        else
+          SudsFillLong ((int32_t *) cb->p + nbuf, room, fill, swap);
+        SudsStatsFill (&st, room, fill);
+        nbuf += room;
+      }
+      nsamp_this_scn += nfill;
       /* keep track of how many gaps and the largest one */
       gap_count++;
       if (nfill_max < nfill) 
         nfill_max = nfill;
+      SudsMetricsLap (&co->m, SUDS_PH_GAPFILL);
     }
     /* Advance endtime to the new packet;        *
      * process this packet in the next iteration */
     endtime = wf->endtime;
   } /* while(1) */
       
-  /* figure out min, max, and "noise" */
-  for (j = 0; j < 200 && j < nsamp_this_scn; j++)
-  {
-    if (SudsBuffer[j] > max)
-      max = SudsBuffer[j];
-    if (SudsBuffer[j] < min)
-      min = SudsBuffer[j];
-    total += SudsBuffer[j];
-  }
-  dt.avenoise = ((float)total)/ (float)j;  /* Mean of the first 200 samples */
-  for (; j < nsamp_this_scn; j++)
-  {
-    if (SudsBuffer[j] > max)
-      max = SudsBuffer[j];
-    if (SudsBuffer[j] < min)
-      min = SudsBuffer[j];
-  }
-
-  /* If the incoming data were originally short integers, copy the values
-     back to an array of shorts; disk space saving feature requested
-	 by Gabriel Reyes cjb 6/11/01 */
-  if (datatype == 's') 
-  {
-    for (j = 0; j < nsamp_this_scn; j++)
-		SudsBufferShort[j] = (short)SudsBuffer[j];
-  }
-
-  /* Convert to the appropriate output format */
-#if defined (_INTEL)
-  /* we are on intel, data will be read on sparc */
-  if (strcmp (SudsOutputFormat, "sparc") == 0)
-    for (j = 0; j < nsamp_this_scn; j++)
-    {
-		if (datatype == 's')
-			SwapShort(&SudsBufferShort[j]);
-		else
-			SwapLong(&SudsBuffer[j]);
-	}
-#elif defined (_SPARC)
-  /* we are on sparc, data will be read on intel */
-  if (strcmp (SudsOutputFormat, "intel") == 0)
-    for (j = 0; j < nsamp_this_scn; j++)
-    {
-		if (datatype == 's')
-			SwapShort(&SudsBufferShort[j]);
-		else
-			SwapLong(&SudsBuffer[j]);
-	}
-#else
-  logit ("e", "SUDSPA_next: Can't determine my platform - please compile with either _INTEL or _SPARC set\n");
-      return EW_FAILURE;
-#endif
+  /* The statistics were taken during conversion; "noise" is still the *
+   * mean of the first 200 samples                                      */
+  SudsStatsRecord (&st, &cs);
+  dt.avenoise = cs.avenoise;
                
   /* Write out to the SUDS file */
-  /* Fill and write TAG for the STATIONCOMP struct */
-
-  tag.id_struct = STATIONCOMP; /* what follows is STATIONCOMP */
-  tag.len_struct = sizeof (SUDS_STATIONCOMP); 
-  tag.len_data = 0;
-  tag.sync = 'S';
-
   if (debug == 1)
-    logit ("", "Writing tag for %d (%d)\n", tag.id_struct, tag.len_struct);
-
-  if (strcmp (SudsOutputFormat, "sparc") == 0)
-    tag.machine = '1';
-  else if (strcmp (SudsOutputFormat, "intel") == 0)
-    tag.machine = '6';
-
-  if (StructMakeLocal ((void *) &tag, STRUCTTAG, tag.machine, debug) 
-      != EW_SUCCESS)
-  {
-    logit ("et", "SUDSPA_next: Call to StructMakeLocal failed. \n");
-    return EW_FAILURE;
-  }
-
-  if (fwrite ((void *) &tag, sizeof (SUDS_STRUCTTAG), 1, SUDSfp) != 1)
-  {
-    logit ("et", "SUDSPA_next: error writing SUDS tag. \n");
-    return EW_FAILURE;
-  }
+    logit ("", "Writing tag for %d (%d)\n", STATIONCOMP, SUDS_STATIONCOMP_LEN);
 
   /* Fill and write STATIONCOMP struct */
   /* in SUDS_STATIDENT structure, char st_name[5],
@@ -527,14 +1064,28 @@ int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
 	  && (sc.sc_name.component != 'E') && (sc.sc_name.component != 'e')
 	  && (sc.sc_name.component != 'V') && (sc.sc_name.component != 'v')
 	  && (sc.sc_name.component != 'T') && (sc.sc_name.component != 't'))
-	  logit("et", "SUDSPA_next: unknown station component %c \n",
+  {
+	  logit("et", "SUDSWR_next: unknown station component %c \n",
 		sc.sc_name.component);
+	  co->m.badcomp++;
+  }
+
+  /* Given a STATIONCOMP for the channel (the original of a demultiplexed *
+   * one, say), keep its site, instrument and clock details               */
+  if ((tmpl = FindStation (sw, &sc.sc_name)) != NULL)
+  {
+    name = sc.sc_name;
+    sc = *tmpl;
+    sc.sc_name = name;
+  }
 
   if (datatype == 's')
 	sc.data_type = 's';
   else
 	  sc.data_type = 'l';
-  sc.data_units = 'd';
+  if (tmpl == NULL || sc.data_units == '\0')
+    sc.data_units = 'd';
+  sc.clip_value = (float) st.cliphi;
 
   if (debug == 1)
     logit ("", "Writing STATIONCOMP struct for %s.%s.%c\n", 
@@ -542,42 +1093,17 @@ int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
            sc.sc_name.network,     
            sc.sc_name.component);
 
-  if (StructMakeLocal ((void *) &sc, STATIONCOMP, tag.machine, debug) 
-      != EW_SUCCESS)
-  {
-    logit ("et", "SUDSPA_next: Call to StructMakeLocal failed. \n");
-    return EW_FAILURE;
-  }
-
-  if (fwrite ((void *) &sc, sizeof (SUDS_STATIONCOMP), 1, SUDSfp) != 1)
+  if (SudsEncodeRecord (co->hdr, STATIONCOMP, &sc, 0, swap) != EW_SUCCESS)
   {
-    logit ("et", "SUDSPA_next: error writing SUDS_STATIONCOMP struct. \n");
+    logit ("et", "SUDSWR_next: Call to SudsEncodeRecord failed. \n");
     return EW_FAILURE;
   }
 
-  /* Fill and write TAG for the DESCRIPTRACE struct */
-  if (datatype == 's')
-	data_size = nsamp_this_scn * sizeof (short);
-  else
-	data_size = nsamp_this_scn * sizeof (long);
-  tag.id_struct = DESCRIPTRACE; /* what follows is DESCRIPTRACE */
-  tag.len_struct = sizeof (SUDS_DESCRIPTRACE); 
-  tag.len_data = (long) data_size;
+  /* The DESCRIPTRACE's tag gives the bytes of samples after it */
+  data_size = nsamp_this_scn * elem;
 
   if (debug == 1)
-    logit ("", "Writing tag for %d (%d)\n", tag.id_struct, tag.len_struct);
-
-  if (StructMakeLocal ((void *) &tag, STRUCTTAG, tag.machine, debug) != EW_SUCCESS)
-  {
-    logit ("et", "SUDSPA_next: Call to StructMakeLocal failed. \n");
-    return EW_FAILURE;
-  }
-
-  if (fwrite ((void *) &tag, sizeof (SUDS_STRUCTTAG), 1, SUDSfp) != 1)
-  {
-    logit ("et", "SUDSPA_next: error writing SUDS tag. \n");
-    return EW_FAILURE;
-  }
+    logit ("", "Writing tag for %d (%d)\n", DESCRIPTRACE, SUDS_DESCRIPTRACE_LEN);
 
   /* Fill and write DESCRIPTRACE struct */
   /*strcpy (dt.dt_name.st_name, wf->sta); 
@@ -613,7 +1139,7 @@ int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
 	  && (dt.dt_name.component != 'E') && (dt.dt_name.component != 'e')
 	  && (dt.dt_name.component != 'V') && (dt.dt_name.component != 'v')
 	  && (dt.dt_name.component != 'T') && (dt.dt_name.component != 't'))
-	  logit("et", "SUDSPA_next: error with station component %c \n",
+	  logit("et", "SUDSWR_next: error with station component %c \n",
 		dt.dt_name.component);
 
 
@@ -624,224 +1150,1031 @@ int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
   dt.begintime = begintime;
   dt.length = nsamp_this_scn;
   dt.rate = (float) wf->samprate;
-  dt.mindata = (float) min;
-  dt.maxdata = (float) max;
+  dt.mindata = (float) cs.mindata;
+  dt.maxdata = (float) cs.maxdata;
+  dt.numclip = cs.numclip;
 
   /* Ignore the rest for now - see how it works */
 
   if (debug == 1)
-    logit ("", "Writing DESCRIPTRACE - %d samples (%d,%d) \n", 
-           nsamp_this_scn, min, max);
-
-  if (StructMakeLocal ((void *) &dt, DESCRIPTRACE, tag.machine, debug) != EW_SUCCESS)
+    logit ("", "Writing DESCRIPTRACE - %ld samples (%ld,%ld), %ld clipped \n", 
+           nsamp_this_scn, (long) cs.mindata, (long) cs.maxdata, (long) cs.numclip);
+  if (cs.numclip > 0)
+    logit ("e", "SUDSWR_next: %ld of %ld samples of <%s.%s.%s> clipped\n",
+           (long) cs.numclip, (long) cs.length, wf->sta, wf->chan, wf->net);
+  co->m.clipped += cs.numclip;
+
+  /* The stats record goes out in the same byte order as the rest */
+  cs.cs_name = dt.dt_name;
+  if (SudsEncodeRecord (co->stats, SUDS_CHANSTATS_ID, &cs, 0, swap) != EW_SUCCESS)
   {
-    logit ("et", "SUDSPA_next: Call to StructMakeLocal failed. \n");
+    logit ("et", "SUDSWR_next: Call to SudsEncodeRecord failed. \n");
     return EW_FAILURE;
   }
 
-  if (fwrite ((void *) &dt, sizeof (SUDS_DESCRIPTRACE), 1, SUDSfp) != 1)
+  /* and so do the channel's triggers, if it had any */
+  co->triggered = (tr.num_triggers > 0);
+  if (co->triggered)
   {
-    logit ("et", "SUDSPA_next: error writing DESCRIPTRACE struct. \n");
-    return EW_FAILURE;
+    if (debug == 1)
+      logit ("", "<%s.%s.%s> triggered %d times\n", wf->sta, wf->chan,
+             wf->net, tr.num_triggers);
+    tr.tr_name = dt.dt_name;
+    if (SudsEncodeRecord (co->trig, TRIGGERS, &tr, 0, swap) != EW_SUCCESS)
+    {
+      logit ("et", "SUDSWR_next: Call to SudsEncodeRecord failed. \n");
+      return EW_FAILURE;
+    }
   }
 
-  /* write TRACE data - SudsBuffer holds long data;
-	  SudsBufferShort holds short data */
-  if (debug == 1)
-    logit ("", "Writing %d bytes of DESCRIPTRACE data\n", data_size);
-  if (datatype == 's')
+  /* and its QC record, if it was checked */
+  if (sw->Qc != NULL)
   {
-	if ((long)fwrite ((void *) SudsBufferShort, sizeof (char), data_size, SUDSfp)
-		!= data_size)
-	{
-		logit ("et", "SUDSPA_next: error writing short TRACE data. \n");
-		return EW_FAILURE;
-	}
+    SudsQcRecord (&qt, dt.numclip, &co->cq);
+    co->cq.qc_name = dt.dt_name;
+    if (debug == 1)
+      logit ("", "<%s.%s.%s> quality %.1f, snr %.2f, flags 0x%x\n", wf->sta,
+             wf->chan, wf->net, co->cq.quality, co->cq.snr,
+             (unsigned) co->cq.flags);
+    if (SudsEncodeRecord (co->qc, SUDS_CHANQC_ID, &co->cq, 0, swap) != EW_SUCCESS)
+    {
+      logit ("et", "SUDSWR_next: Call to SudsEncodeRecord failed. \n");
+      return EW_FAILURE;
+    }
   }
-  else
+
+  /* Keep what the channel index needs */
+  co->ix.ci_name = dt.dt_name;
+  co->ix.begintime = dt.begintime;
+  co->ix.rate = dt.rate;
+  co->ix.length = dt.length;
+
+  /* ... and the catalog, bar the file, which is WriteChannel's */
+  if (sw->Catalog != NULL)
   {
-	if ((long)fwrite ((void *) SudsBuffer, sizeof (char), data_size, SUDSfp)
-		!= data_size)
-	{
-		logit ("et", "SUDSPA_next: error writing long TRACE data. \n");
-		return EW_FAILURE;
-	}
+    memset (&co->cat, 0, sizeof (co->cat));
+    snprintf (co->cat.id, SUDS_CAT_IDLEN, "%s.%s.--.%s", getThis->net,
+              getThis->sta, getThis->chan);
+    co->cat.begintime = dt.begintime;
+    co->cat.rate = wf->samprate;
+    co->cat.nsamp = nsamp_this_scn;
+    co->cat.mindata = cs.mindata;
+    co->cat.maxdata = cs.maxdata;
+    co->cat.gaps = gap_count;
+    co->cat.clipped = cs.numclip;
+    co->cat.quality = (sw->Qc != NULL) ? co->cq.quality : -1.0f;
+    co->cat.snr = (sw->Qc != NULL) ? co->cq.snr : -1.0f;
   }
-  return EW_SUCCESS;
-}
 
-
-/************************************************************************
-* This is the Put Away end event routine. It's called after we've       *
-* finished processing one event                                         *
-*                                                                       *
-* For PC-SUDS - close the SUDS file, pointed to by SUDSfp               *
-*               free SudsBuffer memory to be nice to everyone else      *
-*************************************************************************/
-int SUDSPA_end_ev(int debug)
+  if (SudsEncodeRecord (co->hdr + CHAN_DT_AT, DESCRIPTRACE, &dt, (long) data_size,
+                        swap) != EW_SUCCESS)
+  {
+    logit ("et", "SUDSWR_next: Call to SudsEncodeRecord failed. \n");
+    return EW_FAILURE;
+  }
+
+  /* TRACE data - cb holds short data as int16_t, the rest as int32_t, *
+   * unless the samples are still in the packets                       */
+  co->data = direct ? NULL : (void *) cb->p;
+  co->data_size = nbuf * elem;
+  co->trace_size = data_size;
+  SudsMetricsLap (&co->m, SUDS_PH_HEADER);
+  return EW_SUCCESS;
+}
+
+/* The STATIONCOMP given to SUDSWR_set_stations for a channel: same *
+ * station and network, and the same component once z is taken as V *
+ * as above; NULL if there is none                                    */
+static const SUDS_STATIONCOMP *FindStation (SUDS_WRITER *sw,
+                                            const SUDS_STATIDENT *name)
 {
-  fclose (SUDSfp);
-        
-  if (debug == 1)
-    logit("t", "Closing SUDS file \n");
+  const SUDS_STATIDENT *id;
+  char    comp;
+  int     i;
 
-  return( EW_SUCCESS );
+  for (i = 0; i < sw->nStations; i++)
+  {
+    id = &sw->Stations[i].sc_name;
+    comp = id->component;
+    if (comp == 'Z' || comp == 'z')
+      comp = 'V';
+    if (comp == name->component
+        && strncmp (id->st_name, name->st_name, sizeof (id->st_name)) == 0
+        && strncmp (id->network, name->network, sizeof (id->network)) == 0)
+      return &sw->Stations[i];
+  }
+  return NULL;
 }
 
+/* The most bytes a channel may buffer, counting 4 bytes a sample      *
+ * whatever the data type: OutBufferLen, as it always was, unless the   *
+ * writer was given a pool with a cap, which is then the only limit on  *
+ * a trace. A streamed trace goes out OutBufferLen at a time either way */
+static long TraceLimit (SUDS_WRITER *sw, long OutBufferLen, SUDS_OUT *stream)
+{
+  size_t  cap = SudsBufPoolCap (sw->Buffers);
 
-/************************************************************************
-*       This is the Put Away close routine. It's called after when      *
-*       we're being shut down.                                          *
-*************************************************************************/
-int SUDSPA_close(int debug)
+  if (stream != NULL || sw->Buffers == sw->OwnBuffers || cap == 0)
+    return OutBufferLen;
+  return (cap > (size_t) LONG_MAX) ? LONG_MAX : (long) cap;
+}
+
+/* How many packets req has, if its samples can go in the file just as *
+ * they are: all 16-bit integers (put in local byte order here, so the  *
+ * caller knows whether that is the output order), no gap EncodeChannel *
+ * would fill, no more than maxbytes counting 4 bytes a sample, and     *
+ * packets big enough to be worth it. 0 if they must be converted.      *
+ * Small packets are the common case, so that is seen to first.         */
+static long Conforming (TRACE_REQ *req, double GapThresh, double samprate,
+                        long maxbytes)
 {
+  TRACE_HEADER *wf;
+  char   *p = req->pBuf;
+  char   *end = req->pBuf + req->actLen;
+  double  endtime = 0.0;
+  long    npk = 0;
+  long    nsamp = 0;
+  long    bytes;
+
+  while (p < end)
+  {
+    wf = (TRACE_HEADER *) p;
+    if (WaveMsgMakeLocal (wf) < 0 || wf->nsamp < 0
+        || (wf->datatype[0] != 's' && wf->datatype[0] != 'i')
+        || wf->datatype[1] != '2')
+      return 0;
+    bytes = wf->nsamp * (long) sizeof (int16_t);
+    if (bytes < DIRECT_MIN_PIECE
+        && p + sizeof (TRACE_HEADER) + bytes < end)
+      return 0;
+    if (npk > 0 && endtime + (1.0 / samprate) * GapThresh < wf->starttime)
+      return 0;
+    nsamp += wf->nsamp;
+    if (nsamp > maxbytes / (long) sizeof (int32_t))
+      return 0;
+    endtime = wf->endtime;
+    p += sizeof (TRACE_HEADER) + bytes;
+    npk++;
+  }
+  return (p == end) ? npk : 0;
+}
 
-  free ((char *) SudsBufferShort);
-  free ((char *) SudsBuffer);
-  return( EW_SUCCESS );
+/* Make cb hold at least need bytes, keeping its first keep; with a *
+ * shared pool this may wait for other writers to give buffers back */
+static int Reserve (SUDS_WRITER *sw, SUDS_CHANBUF *cb, long need, long keep)
+{
+  void  *p;
+
+  if (need <= (long) cb->size)
+    return EW_SUCCESS;
+  if ((p = SudsBufGrow (sw->Buffers, cb->p, (size_t) keep, (size_t) need,
+                        &cb->size)) == NULL)
+    return EW_FAILURE;
+  cb->p = (char *) p;
+  return EW_SUCCESS;
 }
 
+/* Write out a buffer-load of a streamed trace */
+static int StreamSamples (SUDS_OUT *stream, const void *data, long bytes)
+{
+  if (SudsOutWrite (stream, data, bytes) != EW_SUCCESS)
+  {
+    logit ("et", "SUDSWR_next: error writing TRACE data: %s\n",
+           strerror(errno));
+    return EW_FAILURE;
+  }
+  return EW_SUCCESS;
+}
 
-/*
- *
- *  Byte swapping functions
- */
+/* Drop a partly streamed trace, so a bad channel leaves no trace in the *
+ * file, as it would if it had been buffered                             */
+static void StreamAbort (SUDS_OUT *stream, off_t hdr_off)
+{
+  if (SudsOutTruncate (stream, hdr_off) != EW_SUCCESS)
+    logit ("et", "SUDSWR_next: couldn't drop partial trace: %s\n",
+           strerror(errno));
+}
 
-/* swap bytes if necessary, depending on what machine */
-/* we have been compiled, and what machine the data   */
-/* is being read from/being written to                */
 
-static int StructMakeLocal(void *ptr, int struct_type, char data_type, 
-                           int debug)
+/* Write one encoded channel to the writer's SUDS file: the header     *
+ * block and the samples go out together in one gather write. A        *
+ * streamed channel already has most of its samples in the file; write *
+ * the rest, then go back and fill in the header block.                *
+ *                                                                     *
+ *      1. SUDS tag - indicating what follows                          *
+ *      2. SUDS_STATIONCOMP struct - describe the station              *
+ *      3. SUDS tag - indicating what follows                          *
+ *      4. SUDS_DESCRIPTRACE struct - describe the trace data          *
+ *      5. trace data                                                  *
+ *      6. optionally, its stats record (sudsstats.h)                  *
+ *      7. if it triggered, its SUDS_TRIGGERS (sudstrigger.h)          */
+static int WriteChannel (SUDS_WRITER *sw, SUDS_CHANOUT *co, int debug)
 {
-  if (ptr == NULL)
+  struct iovec  buf[5];
+  struct iovec *iov = buf;
+  off_t         base;
+  long          n = 0;
+
+  /* time spent waiting for a batch turn isn't anyone's */
+  if (co->m.on)
+    co->m.last = SudsMetricsClock ();
+  base = (co->hdr_off >= 0) ? co->hdr_off : SudsOutTell (&sw->Out);
+  if (co->npiece > 0)
+    iov = co->piece;                   /* slot 0 is free for the header */
+  if (co->hdr_off < 0)
+  {
+    iov[n].iov_base = co->hdr;
+    iov[n++].iov_len = CHAN_HDR_SIZE;
+  }
+  if (co->npiece > 0)
+    n += co->npiece;
+  else
+  {
+    iov[n].iov_base = co->data;
+    iov[n++].iov_len = co->data_size;
+  }
+  if (sw->WriteStats)
+  {
+    iov[n].iov_base = co->stats;
+    iov[n++].iov_len = CHAN_STATS_SIZE;
+  }
+  if (co->triggered)
+  {
+    iov[n].iov_base = co->trig;
+    iov[n++].iov_len = CHAN_TRIG_SIZE;
+  }
+  if (sw->Qc != NULL)
+  {
+    iov[n].iov_base = co->qc;
+    iov[n++].iov_len = CHAN_QC_SIZE;
+  }
+
+  if (debug == 1)
+    logit ("", "Writing %ld bytes of DESCRIPTRACE data\n", co->data_size);
+  if (SudsOutWritev (&sw->Out, iov, (int) n) != EW_SUCCESS)
   {
-    logit ("e", "StructMakeLocal: NULL pointer passed in\n");
+    logit ("et", "SUDSWR_next: error writing TRACE data: %s\n",
+           strerror(errno));
     return EW_FAILURE;
   }
 
-#if defined (_INTEL)
-  if (data_type != '6')
+  if (co->hdr_off >= 0
+      && SudsOutPatch (&sw->Out, co->hdr, CHAN_HDR_SIZE, co->hdr_off)
+         != EW_SUCCESS)
   {
-    if (debug == 1)
-      logit ("", "Swapping from Intel to Sun \n");
+    logit ("et", "SUDSWR_next: error filling in streamed trace structs: %s\n",
+           strerror(errno));
+    return EW_FAILURE;
+  }
 
-    /* if we are on intel, and target data is not intel */
-    if (SwapDo (ptr, struct_type) != EW_SUCCESS)
+  SudsMetricsLap (&co->m, SUDS_PH_WRITE);
+  co->m.traces++;
+  if (co->npiece > 0)
+    co->m.direct++;
+  co->m.bytes += CHAN_HDR_SIZE + co->trace_size
+                 + (sw->WriteStats ? CHAN_STATS_SIZE : 0)
+                 + (co->triggered ? CHAN_TRIG_SIZE : 0)
+                 + ((sw->Qc != NULL) ? CHAN_QC_SIZE : 0);
+
+  if (co->triggered)
+    sw->nTriggered++;
+  if (sw->Qc != NULL)
+    NoteQc (sw, &co->cq);
+  if (sw->Manifest != NULL)
+    NoteSpan (sw, &co->ix);
+  if (sw->Catalog != NULL)
+  {
+    co->cat.file = sw->FileKey;
+    if (SudsCatalogAdd (sw->Catalog, &co->cat) != EW_SUCCESS)
+      logit ("et", "SUDSWR_next: channel left out of the catalog\n");
+  }
+  if (co->irig)
+    sw->IrigName = co->ix.ci_name;
+
+  /* the time correction needs to find the channels again, index or not; *
+   * the index's offsets are 32 bits, so a file that goes past them gets  *
+   * neither                                                              */
+  if ((sw->WriteIndex || sw->Irig != NULL) && !sw->IndexFull
+      && base + CHAN_HDR_SIZE > INT32_MAX)
+  {
+    logit ("et", "SUDSWR_next: %s is past 2 GB; no channel index or time "
+           "correction for it\n", sw->FileName);
+    sw->IndexFull = 1;
+  }
+  if ((sw->WriteIndex || sw->Irig != NULL) && !sw->IndexFull)
+  {
+    co->ix.sc_offset = (int32_t) base;
+    co->ix.dt_offset = (int32_t) (base + CHAN_DT_AT);
+    co->ix.data_offset = (int32_t) (base + CHAN_HDR_SIZE);
+    if (SudsIndexAdd (&sw->Index, &co->ix) != EW_SUCCESS)
+      logit ("et", "SUDSWR_next: channel left out of the index\n");
+  }
+  return EW_SUCCESS;
+}
+
+/* Widen the file's time span to take in a trace just written, and count *
+ * its channel unless it is another segment of the last one               */
+static void NoteSpan (SUDS_WRITER *sw, const SUDS_CHANINDEX *ix)
+{
+  SUDS_MANIFEST_ENT *e = &sw->Entry;
+  double  end;
+
+  end = ix->begintime + ((ix->rate > 0.0) ? ix->length / ix->rate : 0.0);
+  if (e->nchans == 0 || ix->begintime < e->begintime)
+    e->begintime = ix->begintime;
+  if (e->nchans == 0 || end > e->endtime)
+    e->endtime = end;
+  if (e->nchans == 0
+      || memcmp (&ix->ci_name, &sw->LastChan, sizeof (SUDS_STATIDENT)) != 0)
+  {
+    e->nchans++;
+    sw->LastChan = ix->ci_name;
+  }
+}
+
+/* Count a checked trace toward the file's QC summary, naming it there *
+ * if it was bad, as long as there is room                             */
+static void NoteQc (SUDS_WRITER *sw, const SUDS_CHANQC *cq)
+{
+  char        name[32];
+  const char *why;
+  size_t      len = strlen (sw->BadChans);
+
+  sw->nChecked++;
+  sw->QualitySum += cq->quality;
+  if (cq->flags & SUDS_QC_LOWSNR)
+    sw->nLowSnr++;
+  if (!(cq->flags & SUDS_QC_BAD))
+    return;
+  sw->nBad++;
+  if (cq->flags & SUDS_QC_BLANK)
+    why = "blank";
+  else if (cq->flags & SUDS_QC_ZEROS)
+    why = "zeros";
+  else if (cq->flags & SUDS_QC_NEG1)
+    why = "-1s";
+  else
+    why = "stuck";
+  snprintf (name, sizeof (name), "%s%.5s.%.4s.%c (%s)", (len > 0) ? ", " : "",
+            cq->qc_name.st_name, cq->qc_name.network,
+            cq->qc_name.component, why);
+  if (len + strlen (name) < sizeof (sw->BadChans) - 5)
+    strcat (sw->BadChans, name);
+  else if (len > 0 && sw->BadChans[len - 1] != '.')
+    strcat (sw->BadChans, ", ...");
+}
+
+
+/* Process one channel of data */
+int SUDSWR_next (SUDS_WRITER *sw, TRACE_REQ *getThis, double GapThresh,
+                 long OutBufferLen, int debug)
+{
+  /* Check arguments */
+  if (sw == NULL || !SudsOutIsOpen (&sw->Out) || getThis == NULL)
+  {
+    logit ("e", "SUDSWR_next: invalid argument passed in.\n");
+    return EW_FAILURE;
+  }
+
+  return PutChannel (sw, getThis, GapThresh, OutBufferLen,
+                     sw->Stream ? &sw->Out : NULL, NULL, 0, debug);
+}
+
+/* Encode and write one channel. Normally that is one DESCRIPTRACE with *
+ * any gaps filled; when segmenting, each contiguous run of packets is  *
+ * a DESCRIPTRACE of its own, followed by a COMMENT summing up the gaps *
+ * and overlaps between them. For a batch, channel i waits for its turn *
+ * before writing; the first segment is encoded before that, so         *
+ * unbroken channels are still encoded in parallel. The channel's       *
+ * buffer goes back to the pool once the next channel may write, so     *
+ * that channel never has to stop and wait for memory.                  */
+static int PutChannel (SUDS_WRITER *sw, TRACE_REQ *getThis, double GapThresh,
+                       long OutBufferLen, SUDS_OUT *stream, SUDS_BATCH *batch,
+                       int i, int debug)
+{
+  SUDS_CHANOUT  co;
+  SUDS_CHANBUF  cb;
+  SUDS_GAPSUM   sum;
+  TRACE_REQ     seg;
+  char         *pos;
+  int           ret;
+  int           nbad = 0;
+
+  cb.p = NULL;
+  cb.size = 0;
+  if (!sw->Segment)
+  {
+    SudsMetricsStart (sw->Metrics, &co.m, getThis->sta, getThis->chan,
+                      getThis->net);
+    ret = EncodeChannel (sw, &cb, getThis, GapThresh, OutBufferLen, stream,
+                         &co, debug);
+    WaitTurn (sw, batch, i, cb.size);
+    if (ret == EW_SUCCESS)
+      ret = WriteChannel (sw, &co, debug);
+    if (ret != EW_SUCCESS)
+      co.m.errors++;
+    PassTurn (batch, ret);
+    SudsBufPut (sw->Buffers, cb.p, cb.size);
+    SudsMetricsFlush (sw->Metrics, &co.m);
+    return ret;
+  }
+
+  memset (&sum, 0, sizeof (sum));
+  SudsMetricsStart (sw->Metrics, &co.m, getThis->sta, getThis->chan,
+                    getThis->net);
+  pos = getThis->pBuf;
+  while ((ret = NextSegment (getThis, &pos, GapThresh, &seg, &sum)) == 1)
+  {
+    /* a bad segment is lost on its own; the rest are still written */
+    if (EncodeChannel (sw, &cb, &seg, GapThresh, OutBufferLen, stream, &co,
+                       debug) != EW_SUCCESS)
     {
-      logit ("e", "StructMakeLocal: Call to SwapDo failed \n");
-      return EW_FAILURE;
+      nbad++;
+      continue;
     }
+    WaitTurn (sw, batch, i, cb.size);
+    if (WriteChannel (sw, &co, debug) != EW_SUCCESS)
+      nbad++;
   }
+  if (ret != 0)
+    nbad++;
+
+  WaitTurn (sw, batch, i, cb.size);
+  if (sum.ngaps + sum.noverlaps > 0
+      && WriteGapSummary (sw, &sum, debug) != EW_SUCCESS)
+    nbad++;
+  PassTurn (batch, (nbad > 0) ? EW_FAILURE : EW_SUCCESS);
+  SudsBufPut (sw->Buffers, cb.p, cb.size);
+  co.m.gaps += sum.ngaps;
+  co.m.overlaps += sum.noverlaps;
+  if (co.m.gap_max < sum.gap_max)
+    co.m.gap_max = sum.gap_max;
+  co.m.errors += nbad;
+  SudsMetricsFlush (sw->Metrics, &co.m);
+  return (nbad > 0) ? EW_FAILURE : EW_SUCCESS;
+}
 
-#elif defined (_SPARC)
-  if (data_type == '6')
+/* Find the run of packets starting at *pos that has no gap longer than  *
+ * GapThresh samples and no overlap, and describe it in seg as a request *
+ * of its own; *pos moves on to the packet after it. Returns 1 for a     *
+ * segment, 0 when there are no packets left, EW_FAILURE on a bad one.   */
+static int NextSegment (TRACE_REQ *req, char **pos, double GapThresh,
+                        TRACE_REQ *seg, SUDS_GAPSUM *sum)
+{
+  TRACE_HEADER *wf;
+  char   *p = *pos;
+  char   *end = req->pBuf + req->actLen;
+  double  endtime = 0.0;
+  double  samprate = 0.0;
+  double  dt;
+  long    size;
+
+  if (p >= end)
+    return 0;
+  *seg = *req;
+  seg->pBuf = p;
+
+  while (p < end)
   {
-    if (debug == 1)
-      logit ("", "Swapping from Sun to Intel \n");
-
-    /* if we are on solaris, and target data is not solaris */
-    if (SwapDo (ptr, struct_type) != EW_SUCCESS)
+    wf = (TRACE_HEADER *) p;
+    if (WaveMsgMakeLocal (wf) < 0)
     {
-      logit ("e", "StructMakeLocal: Call to SwapDo failed \n");
+      logit ("e", "SUDSWR_next: unknown trace data type: %s\n", wf->datatype);
       return EW_FAILURE;
     }
+    if (p == seg->pBuf && sum->nseg == 0)
+    {
+      strcpy (sum->sta, wf->sta);
+      strcpy (sum->chan, wf->chan);
+      strcpy (sum->net, wf->net);
+    }
+    if (p != seg->pBuf)
+    {
+      if (endtime + (1.0 / samprate) * GapThresh < wf->starttime)
+      {
+        dt = wf->starttime - endtime;
+        logit ("e", "gap in %s.%s.%s: %lf: %lf; starting a new segment\n",
+               wf->sta, wf->chan, wf->net, endtime, dt);
+        sum->ngaps++;
+        sum->gap_total += dt;
+        if (sum->gap_max < dt)
+          sum->gap_max = dt;
+        break;
+      }
+      if (wf->starttime <= endtime)
+      {
+        dt = endtime - wf->starttime + 1.0 / samprate;
+        logit ("e", "overlap in %s.%s.%s: %lf: %lf; starting a new segment\n",
+               wf->sta, wf->chan, wf->net, wf->starttime, dt);
+        sum->noverlaps++;
+        sum->overlap_total += dt;
+        if (sum->overlap_max < dt)
+          sum->overlap_max = dt;
+        break;
+      }
+    }
+    endtime = wf->endtime;
+    samprate = wf->samprate;
+
+    /* packet sizes as EncodeChannel reads them */
+    if (wf->datatype[1] == '2')
+      size = sizeof (int16_t);
+    else if (wf->datatype[0] == 't' || wf->datatype[0] == 'f')
+      size = sizeof (float);
+    else
+      size = sizeof (int32_t);
+    p += sizeof (TRACE_HEADER) + wf->nsamp * size;
+
+    /* a silly rate would make nonsense of the gap test; let *
+     * EncodeChannel reject it along with the rest           */
+    if (samprate < 0.01)
+      break;
   }
+  if (p > end)
+    p = end;
+  seg->actLen = (long) (p - seg->pBuf);
+  *pos = p;
+  sum->nseg++;
+  return 1;
+}
+
+/* Write a COMMENT after a segmented channel saying how it was broken up */
+static int WriteGapSummary (SUDS_WRITER *sw, SUDS_GAPSUM *sum, int debug)
+{
+  SUDS_COMMENT    cm;
+  char            rec[SUDS_STRUCTTAG_LEN + SUDS_COMMENT_LEN];
+  struct iovec    iov[2];
+  char            text[256];
+  int             len;
+
+  len = sprintf (text, "%s.%s.%s: %d segments; %d gaps, %.3f s total, "
+                 "%.3f s longest; %d overlaps, %.3f s total, %.3f s longest",
+                 sum->sta, sum->chan, sum->net, sum->nseg,
+                 sum->ngaps, sum->gap_total, sum->gap_max,
+                 sum->noverlaps, sum->overlap_total, sum->overlap_max);
+  if (debug == 1)
+    logit ("", "Writing COMMENT: %s\n", text);
+
+  memset (&cm, 0, sizeof (cm));
+  cm.refer = DESCRIPTRACE;
+  cm.length = (short) len;
 
-#endif
+  if (SudsEncodeRecord (rec, COMMENT, &cm, len, sw->Swap) != EW_SUCCESS)
+    return EW_FAILURE;
+
+  iov[0].iov_base = rec;
+  iov[0].iov_len = sizeof (rec);
+  iov[1].iov_base = text;
+  iov[1].iov_len = len;
+  if (SudsOutWritev (&sw->Out, iov, 2) != EW_SUCCESS)
+  {
+    logit ("et", "SUDSWR_next: error writing gap summary: %s\n",
+           strerror(errno));
+    return EW_FAILURE;
+  }
   return EW_SUCCESS;
 }
 
+/* Wait until it is channel i's turn to write; no wait outside a batch. *
+ * The held bytes of buffer can't go back to the pool until then, so    *
+ * the pool is told not to wait on them.                                */
+static void WaitTurn (SUDS_WRITER *sw, SUDS_BATCH *batch, int i, size_t held)
+{
+  int  stalled;
+
+  if (batch == NULL)
+    return;
+  pthread_mutex_lock (&batch->mutex);
+  stalled = (batch->NextWrite != i);
+  pthread_mutex_unlock (&batch->mutex);
+  if (!stalled)
+    return;
+
+  SudsBufStall (sw->Buffers, held, 1);
+  pthread_mutex_lock (&batch->mutex);
+  while (batch->NextWrite != i)
+    pthread_cond_wait (&batch->turn, &batch->mutex);
+  pthread_mutex_unlock (&batch->mutex);
+  SudsBufStall (sw->Buffers, held, 0);
+}
 
-/* Do the dirty work by swapping the innards of SUDS */
-/* structures that are of interest to us             */
-static int SwapDo( void *ptr, int struct_type)
+/* Channel i is written (ret says how well); let the next one write */
+static void PassTurn (SUDS_BATCH *batch, int ret)
 {
-  SUDS_STRUCTTAG *tag;
-  SUDS_STATIONCOMP *sc;
-  SUDS_DESCRIPTRACE *dt;
-  SUDS_TRIGGERS *tr;
-  SUDS_DETECTOR *de;
-  SUDS_TIMECORRECTION *tc;
+  if (batch == NULL)
+    return;
+  pthread_mutex_lock (&batch->mutex);
+  if (ret != EW_SUCCESS)
+    batch->nFailed++;
+  batch->NextWrite++;
+  pthread_cond_broadcast (&batch->turn);
+  pthread_mutex_unlock (&batch->mutex);
+}
 
-  if (ptr == NULL)
+
+/************************************************************************
+* SUDSWR_next_batch: write all nReq channels of the event, as if        *
+*   SUDSWR_next had been called for each TRACE_REQ in turn.             *
+*                                                                       *
+*   The channels are decoded, gap-filled and measured on nThreads       *
+*   workers, each channel in a buffer from the writer's pool; as it is  *
+*   done it waits for the channel before it to be written, then writes  *
+*   itself, so the file comes out in ptrReq order no matter which       *
+*   channel finishes first. Channels are handed out in order, so at     *
+*   most nThreads encoded channels are ever held in memory.             *
+*                                                                       *
+*   Returns EW_FAILURE if any channel could not be written; the other   *
+*   channels are still written, just as a caller looping over           *
+*   SUDSWR_next would carry on past a bad channel.                      *
+*************************************************************************/
+int SUDSWR_next_batch (SUDS_WRITER *sw, TRACE_REQ *ptrReq, int nReq,
+                       double GapThresh, long OutBufferLen, int nThreads,
+                       int debug)
+{
+  SUDS_BATCH  batch;
+
+  if (sw == NULL || !SudsOutIsOpen (&sw->Out) || ptrReq == NULL)
   {
-    logit ("e", "SwapDo: NULL pointer passed in.\n");
+    logit ("e", "SUDSWR_next_batch: invalid argument passed in.\n");
     return EW_FAILURE;
   }
+  if (BatchSetup (sw, nThreads, debug) != EW_SUCCESS)
+    return EW_FAILURE;
+
+  batch.sw = sw;
+  batch.ptrReq = ptrReq;
+  batch.GapThresh = GapThresh;
+  batch.OutBufferLen = OutBufferLen;
+  batch.debug = debug;
+  batch.nFailed = 0;
+  batch.NextWrite = 0;
+  pthread_mutex_init (&batch.mutex, NULL);
+  pthread_cond_init (&batch.turn, NULL);
 
-  switch( struct_type ) 
+  SudsPoolRun (sw->Pool, nReq, BatchTask, &batch);
+
+  pthread_mutex_destroy (&batch.mutex);
+  pthread_cond_destroy (&batch.turn);
+
+  if (batch.nFailed > 0)
   {
-  case STRUCTTAG:
-    tag = (SUDS_STRUCTTAG *) ptr;
-    SwapShort (&tag->id_struct);
-    SwapLong (&tag->len_struct);
-    SwapLong (&tag->len_data);
-    break;
-  case STATIONCOMP:
-    sc = (SUDS_STATIONCOMP *) ptr;
-    SwapShort (&sc->sc_name.inst_type);
-    SwapShort (&sc->azim);
-    SwapShort (&sc->incid);
-    SwapDouble (&sc->st_lat);
-    SwapDouble (&sc->st_long);
-    SwapFloat (&sc->elev);
-    SwapShort (&sc->rocktype);
-    SwapFloat (&sc->max_gain);
-    SwapFloat (&sc->clip_value);
-    SwapFloat (&sc->con_mvolts);
-    SwapShort (&sc->channel);
-    SwapShort (&sc->atod_gain);
-    SwapLong (&sc->effective);
-    SwapFloat (&sc->clock_correct);
-    SwapFloat (&sc->station_delay);
-    break;
-  case DESCRIPTRACE:
-    dt = (SUDS_DESCRIPTRACE *) ptr;
-    SwapShort (&dt->dt_name.inst_type);
-    SwapDouble (&dt->begintime);
-    SwapShort (&dt->localtime);
-    SwapShort (&dt->digi_by);
-    SwapShort (&dt->processed);
-    SwapLong (&dt->length);
-    SwapFloat (&dt->rate);
-    SwapFloat (&dt->mindata);
-    SwapFloat (&dt->maxdata);
-    SwapFloat (&dt->avenoise);
-    SwapLong (&dt->numclip);
-    SwapDouble (&dt->time_correct);
-    SwapFloat (&dt->rate_correct);
-    break;
-  case TRIGGERS:
-    tr = (SUDS_TRIGGERS *) ptr;
-    SwapShort (&tr->tr_name.inst_type);
-    SwapShort (&tr->sta);
-    SwapShort (&tr->lta);
-    SwapShort (&tr->abs_sta);
-    SwapShort (&tr->abs_lta);
-    SwapShort (&tr->trig_value);
-    SwapShort (&tr->num_triggers);
-    SwapDouble (&tr->trig_time);
-    break;
-  case DETECTOR:
-    de = (SUDS_DETECTOR *) ptr;
-    SwapFloat (&de->versionnum);
-    SwapLong (&de->event_number);
-    SwapLong (&de->spareL);
-    break;
-  case TIMECORRECTION:
-    tc = (SUDS_TIMECORRECTION *) ptr;
-    SwapShort (&tc->tm_name.inst_type);
-    SwapDouble (&tc->time_correct);
-    SwapFloat (&tc->rate_correct);
-    SwapLong (&tc->effective_time);
-    SwapShort (&tc->spareM);
-    break;
-  default:
-    logit ("e", "SwapDo: Don't know about type %d\n", struct_type);
+    logit ("e", "SUDSWR_next_batch: %d of %d channels not written\n",
+           batch.nFailed, nReq);
     return EW_FAILURE;
   }
+  return EW_SUCCESS;
+}
 
+/* Encode channel i, then write it in turn */
+static void BatchTask (void *arg, int i, int worker)
+{
+  SUDS_BATCH   *batch = (SUDS_BATCH *) arg;
+
+  PutChannel (batch->sw, &batch->ptrReq[i], batch->GapThresh,
+              batch->OutBufferLen, NULL, batch, i, batch->debug);
+}
+
+/* Start the encoding pool */
+static int BatchSetup (SUDS_WRITER *sw, int nThreads, int debug)
+{
+  if (nThreads < 1)
+    nThreads = 1;
+  if (sw->Pool != NULL && SudsPoolThreads (sw->Pool) == nThreads)
+    return EW_SUCCESS;
+
+  SudsPoolDestroy (sw->Pool);
+  if ((sw->Pool = SudsPoolCreate (nThreads)) == NULL)
+    return EW_FAILURE;
+  if (debug == 1)
+    logit ("", "SUDSWR_next_batch: encoding with %d threads\n",
+           SudsPoolThreads (sw->Pool));
   return EW_SUCCESS;
 }
 
+/* Fill in time_correct and rate_correct in the DESCRIPTRACE of every *
+ * channel written so far from the time code, and append the           *
+ * SUDS_TIMECORRECTION                                                 */
+static int TimeCorrect (SUDS_WRITER *sw, int debug)
+{
+  SUDS_IRIGFIT         fit;
+  SUDS_CHANINDEX      *ent;
+  SUDS_DESCRIPTRACE    dt;
+  SUDS_TIMECORRECTION  tc;
+  char                 rec[SUDS_DESCRIPTRACE_LEN];
+  char                 buf[SUDS_STRUCTTAG_LEN + SUDS_TIMECORRECTION_LEN];
+  long                 i;
+
+  if (SudsIrigFit (sw->Irig, &fit) != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_end_ev: no IRIG frames decoded; times in %s left uncorrected\n",
+           sw->FileName);
+    return EW_SUCCESS;
+  }
+  if (debug == 1)
+    logit ("", "IRIG: %d frames (%d dropped), offset %.4f s, drift %g, rms %.4f s\n",
+           fit.nframes, fit.nbad, fit.offset, fit.drift, fit.rms);
+
+  for (i = 0; i < sw->Index.n; i++)
+  {
+    ent = &sw->Index.ent[i];
+    memset (&dt, 0, sizeof (dt));
+    dt.time_correct = SudsIrigCorrection (&fit, ent->begintime);
+    dt.rate_correct = (float) (ent->rate / (1.0 + fit.drift) - ent->rate);
+    if (SudsEncodeStruct (rec, DESCRIPTRACE, &dt, sw->Swap) != EW_SUCCESS
+        || SudsOutPatch (&sw->Out, rec + DT_CORRECT_AT, DT_CORRECT_LEN,
+                         (off_t) ent->dt_offset + SUDS_STRUCTTAG_LEN + DT_CORRECT_AT)
+           != EW_SUCCESS)
+      return EW_FAILURE;
+  }
+
+  memset (&tc, 0, sizeof (tc));
+  tc.tm_name = sw->IrigName;
+  tc.effective_time = (long) floor (fit.tref);
+  tc.time_correct = SudsIrigCorrection (&fit, (double) tc.effective_time);
+  tc.rate_correct = (float) fit.drift;
+  tc.sync_code = fit.fitted ? 'G' : 'O';
+  tc.program = 'i';
+
+  if (SudsEncodeRecord (buf, TIMECORRECTION, &tc, 0, sw->Swap) != EW_SUCCESS)
+    return EW_FAILURE;
+  return SudsOutWrite (&sw->Out, buf, sizeof (buf));
+}
+
+/* A COMMENT at the end of a file summing up the QC of its traces */
+static int WriteQcSummary (SUDS_WRITER *sw, int debug)
+{
+  SUDS_COMMENT    cm;
+  char            rec[SUDS_STRUCTTAG_LEN + SUDS_COMMENT_LEN];
+  struct iovec    iov[2];
+  char            text[256];
+  int             len;
+
+  len = snprintf (text, sizeof (text), "QC: %d traces, %d bad, %d low SNR; "
+                  "mean quality %.2f%s%s", sw->nChecked, sw->nBad,
+                  sw->nLowSnr, sw->QualitySum / sw->nChecked,
+                  (sw->nBad > 0) ? "; bad: " : "", sw->BadChans);
+  if (len >= (int) sizeof (text))
+    len = (int) sizeof (text) - 1;
+  if (debug == 1)
+    logit ("", "Writing COMMENT: %s\n", text);
+
+  memset (&cm, 0, sizeof (cm));
+  cm.refer = DESCRIPTRACE;
+  cm.length = (short) len;
+
+  if (SudsEncodeRecord (rec, COMMENT, &cm, len, sw->Swap) != EW_SUCCESS)
+    return EW_FAILURE;
+
+  iov[0].iov_base = rec;
+  iov[0].iov_len = sizeof (rec);
+  iov[1].iov_base = text;
+  iov[1].iov_len = len;
+  return SudsOutWritev (&sw->Out, iov, 2);
+}
+
+/* The SUDS_DETECTOR for a file some channels triggered in */
+static int WriteDetector (SUDS_WRITER *sw, int debug)
+{
+  SUDS_DETECTOR   de;
+  char            buf[SUDS_STRUCTTAG_LEN + SUDS_DETECTOR_LEN];
+
+  SudsTrigDetector (sw->Trig, sw->TrigEvents, &de);
+  if (debug == 1)
+    logit ("", "Writing DETECTOR: %d channels triggered, event %ld\n",
+           sw->nTriggered, (long) de.event_number);
+
+  if (SudsEncodeRecord (buf, DETECTOR, &de, 0, sw->Swap) != EW_SUCCESS)
+    return EW_FAILURE;
+  return SudsOutWrite (&sw->Out, buf, sizeof (buf));
+}
+
+
+/************************************************************************
+* This is the Put Away end event routine. It's called after we've       *
+* finished processing one event                                         *
+*                                                                       *
+* For PC-SUDS - correct the times by the IRIG time code if there is a   *
+* decoder, append the detector record if any channel triggered, the QC  *
+* summary if traces were checked and the channel index if wanted, then  *
+* close the writer's SUDS file                                          *
+*************************************************************************/
+int SUDSWR_end_ev(SUDS_WRITER *sw, int debug)
+{
+  int  ret = EW_SUCCESS;
+
+  if (sw == NULL || !SudsOutIsOpen (&sw->Out))
+  {
+    logit ("e", "SUDSWR_end_ev: no SUDS file open.\n");
+    return EW_FAILURE;
+  }
+  if (sw->Irig != NULL && !sw->IndexFull && TimeCorrect (sw, debug) != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_end_ev: error correcting times in %s: %s\n",
+           sw->FileName, strerror(errno));
+    ret = EW_FAILURE;
+  }
+  if (sw->Trig != NULL && sw->nTriggered > 0
+      && WriteDetector (sw, debug) != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_end_ev: error writing detector record to %s: %s\n",
+           sw->FileName, strerror(errno));
+    ret = EW_FAILURE;
+  }
+  if (sw->nChecked > 0 && WriteQcSummary (sw, debug) != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_end_ev: error writing QC summary to %s: %s\n",
+           sw->FileName, strerror(errno));
+    ret = EW_FAILURE;
+  }
+  if (sw->WriteIndex && !sw->IndexFull
+      && SudsIndexWrite (&sw->Index, &sw->Out, SUDS_MACHINE (sw->Order))
+         != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_end_ev: error writing channel index to %s: %s\n",
+           sw->FileName, strerror(errno));
+    ret = EW_FAILURE;
+  }
+  SudsIndexReset (&sw->Index);
+  SudsMetricsEvent (sw->Metrics);
+  sw->Entry.bytes = (long) SudsOutTell (&sw->Out);
+  if (SudsOutClose (&sw->Out) != EW_SUCCESS)
+  {
+    logit ("e", "SUDSWR_end_ev: error closing %s: %s\n", sw->FileName,
+           strerror(errno));
+    return EW_FAILURE;
+  }
+
+  /* the file is there now, whole or not, so it goes in the manifest */
+  if (sw->Manifest != NULL)
+  {
+    strcpy (sw->Entry.path, sw->FileName);
+    if (SudsManifestAdd (sw->Manifest, &sw->Entry) != EW_SUCCESS)
+    {
+      logit ("e", "SUDSWR_end_ev: %s left out of the manifest\n",
+             sw->FileName);
+      ret = EW_FAILURE;
+    }
+  }
+        
+  if (debug == 1)
+    logit("t", "Closing SUDS file \n");
+
+  return( ret );
+}
+
+
+/************************************************************************
+*       This is the Put Away close routine. It's called after when      *
+*       we're being shut down. Frees the writer's own buffer pool; a    *
+*       shared one is the caller's to free.                             *
+*************************************************************************/
+int SUDSWR_close(SUDS_WRITER *sw, int debug)
+{
+  if (sw == NULL)
+    return( EW_SUCCESS );
+
+  SudsIndexFree (&sw->Index);
+  SudsPoolDestroy (sw->Pool);
+  sw->Pool = NULL;
+  SudsBufPoolDestroy (sw->OwnBuffers);
+  sw->OwnBuffers = NULL;
+  sw->Buffers = NULL;
+  return( EW_SUCCESS );
+}
+
+
+/*
+ *
+ *  SUDSPA_XXX entry points: the old single-writer interface used by
+ *  trig2disk and wave2disk, kept as a shim over the default writer.
+ */
+
+int SUDSPA_init (int OutBufferLen, char *OutDir, char *OutputFormat, 
+                 int debug)
+{
+  return SUDSWR_init (&SudsDefault, OutBufferLen, OutDir, OutputFormat, debug);
+}
+
+int SUDSPA_next_ev (char *EventID, TRACE_REQ *ptrReq, int nReq, 
+                    char *OutDir, char *EventDate, char *EventTime,
+                    char *EventSubnet, int debug)
+{
+  int  ret;
+
+  ret = SUDSWR_next_ev (&SudsDefault, EventID, ptrReq, nReq, OutDir,
+                        EventDate, EventTime, EventSubnet, debug);
+  SUDSfp = SudsDefault.Out.fp;
+  return ret;
+}
+
+int SUDSPA_next (TRACE_REQ *getThis, double GapThresh,
+                 long OutBufferLen, int debug)
+{
+  return SUDSWR_next (&SudsDefault, getThis, GapThresh, OutBufferLen, debug);
+}
+
+int SUDSPA_next_batch (TRACE_REQ *ptrReq, int nReq, double GapThresh,
+                       long OutBufferLen, int nThreads, int debug)
+{
+  return SUDSWR_next_batch (&SudsDefault, ptrReq, nReq, GapThresh,
+                            OutBufferLen, nThreads, debug);
+}
+
+int SUDSPA_set_stream (int Stream)
+{
+  return SUDSWR_set_stream (&SudsDefault, Stream);
+}
+
+int SUDSPA_set_io (int IoMode)
+{
+  return SUDSWR_set_io (&SudsDefault, IoMode);
+}
+
+int SUDSPA_set_async (SUDS_ASYNC *as, SUDS_ASYNC_DONE done, void *arg)
+{
+  return SUDSWR_set_async (&SudsDefault, as, done, arg);
+}
+
+int SUDSPA_set_segment (int Segment)
+{
+  return SUDSWR_set_segment (&SudsDefault, Segment);
+}
+
+int SUDSPA_set_index (int WriteIndex)
+{
+  return SUDSWR_set_index (&SudsDefault, WriteIndex);
+}
+
+int SUDSPA_set_clip (long ClipValue)
+{
+  return SUDSWR_set_clip (&SudsDefault, ClipValue);
+}
+
+int SUDSPA_set_stats (int WriteStats)
+{
+  return SUDSWR_set_stats (&SudsDefault, WriteStats);
+}
+
+int SUDSPA_set_rsam (SUDS_RSAM *rs)
+{
+  return SUDSWR_set_rsam (&SudsDefault, rs);
+}
+
+int SUDSPA_set_trigger (SUDS_TRIG *tg)
+{
+  return SUDSWR_set_trigger (&SudsDefault, tg);
+}
+
+int SUDSPA_set_stations (const SUDS_STATIONCOMP *sc, int n)
+{
+  return SUDSWR_set_stations (&SudsDefault, sc, n);
+}
+
+int SUDSPA_set_irig (SUDS_IRIG *ir)
+{
+  return SUDSWR_set_irig (&SudsDefault, ir);
+}
+
+int SUDSPA_set_metrics (SUDS_METRICS *m)
+{
+  return SUDSWR_set_metrics (&SudsDefault, m);
+}
+
+int SUDSPA_set_buffers (SUDS_BUFPOOL *bp)
+{
+  return SUDSWR_set_buffers (&SudsDefault, bp);
+}
+
+int SUDSPA_set_layout (int Layout)
+{
+  return SUDSWR_set_layout (&SudsDefault, Layout);
+}
+
+int SUDSPA_set_manifest (SUDS_MANIFEST *mf)
+{
+  return SUDSWR_set_manifest (&SudsDefault, mf);
+}
+
+int SUDSPA_set_catalog (SUDS_CATALOG *cat)
+{
+  return SUDSWR_set_catalog (&SudsDefault, cat);
+}
+
+int SUDSPA_set_qc (SUDS_QC *qc)
+{
+  return SUDSWR_set_qc (&SudsDefault, qc);
+}
+
+int SUDSPA_end_ev(int debug)
+{
+  int  ret;
+
+  ret = SUDSWR_end_ev (&SudsDefault, debug);
+  SUDSfp = NULL;
+  return ret;
+}
+
+int SUDSPA_close(int debug)
+{
+  return SUDSWR_close (&SudsDefault, debug);
+}
@@ -0,0 +1,511 @@
+/* sudsqc.c
+
+        In-line trace quality control for sudsputaway.c; see sudsqc.h
+
+   LIB/trace_quality_control.py found runs of zeros and -1s by joining
+   every sample of a trace into one string and searching it, and took
+   the per-second peaks by reshaping the whole trace. Here each packet
+   goes through a run kernel once, a second of samples at a time, which
+   follows the run going on and the least and greatest sample of the
+   second; at the end of each second its peak goes into a fixed
+   histogram, so nothing is kept per sample or per second.
+
+   The AVX2 kernels compare a vector of samples with the same vector
+   one sample back. A vector with no sample repeating the one before it
+   (most of them, in a live trace) can only end the run going on and
+   start a run of 1; otherwise the runs are walked from the bits of the
+   compare, one step a run rather than one a sample. Like the
+   conversion kernels they are compiled with per-function target
+   attributes, and SudsQcCreate picks them if the CPU has AVX2.
+*/
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <earthworm.h>
+#include <trace_buf.h>
+#include <sudsqc.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SUDS_QC_X86
+#include <immintrin.h>
+#endif
+
+#define QC_CHUNK     256               /* float samples converted at a time */
+
+struct _SUDS_QC
+{
+  long    ZeroRun;                     /* 0 for no check */
+  long    Neg1Run;
+  long    StuckRun;
+  int     MinSeconds;
+  double  SnrMin;
+};
+
+/* Internal Function Prototypes */
+static void QcShortScalar (const int16_t *, long, SUDS_QCTRACE *);
+static void QcLongScalar (const int32_t *, long, SUDS_QCTRACE *);
+static void QcInit (void);
+static void EndRun (SUDS_QCTRACE *);
+static void EndSecond (SUDS_QCTRACE *);
+static int Bin (uint32_t);
+static double BinValue (int);
+static double Nth (const SUDS_QCTRACE *, long);
+static double Percentile (const SUDS_QCTRACE *, double);
+static int32_t Clamp32 (int64_t);
+
+static void (*QcShort) (const int16_t *, long, SUDS_QCTRACE *) = QcShortScalar;
+static void (*QcLong) (const int32_t *, long, SUDS_QCTRACE *) = QcLongScalar;
+static const char *QcName = "scalar";
+
+
+SUDS_QC *SudsQcCreate (void)
+{
+  SUDS_QC  *qc;
+
+  if ((qc = (SUDS_QC *) calloc (1, sizeof (SUDS_QC))) == NULL)
+  {
+    logit ("e", "SudsQcCreate: couldn't malloc engine\n");
+    return NULL;
+  }
+  qc->ZeroRun = 12;
+  qc->Neg1Run = 8;
+  qc->StuckRun = 0;
+  qc->MinSeconds = 10;
+  qc->SnrMin = 1.0;
+  QcInit ();
+  return qc;
+}
+
+int SudsQcSetRuns (SUDS_QC *qc, long ZeroRun, long Neg1Run, long StuckRun)
+{
+  if (qc == NULL || ZeroRun < 0 || Neg1Run < 0 || StuckRun < 0)
+    return EW_FAILURE;
+  qc->ZeroRun = ZeroRun;
+  qc->Neg1Run = Neg1Run;
+  qc->StuckRun = StuckRun;
+  return EW_SUCCESS;
+}
+
+int SudsQcSetSnr (SUDS_QC *qc, int MinSeconds, double SnrMin)
+{
+  if (qc == NULL || MinSeconds < 0)
+    return EW_FAILURE;
+  qc->MinSeconds = MinSeconds;
+  qc->SnrMin = SnrMin;
+  return EW_SUCCESS;
+}
+
+const char *SudsQcName (void)
+{
+  return QcName;
+}
+
+void SudsQcDestroy (SUDS_QC *qc)
+{
+  free (qc);
+}
+
+void SudsQcStart (const SUDS_QC *qc, SUDS_QCTRACE *qt, double rate,
+                  double GapThresh)
+{
+  memset (qt, 0, sizeof (SUDS_QCTRACE));
+  qt->qc = qc;
+  qt->persec = (long) rate;
+  qt->gap = (rate > 0.0) ? GapThresh / rate : 0.0;
+  qt->secmin = INT32_MAX;
+  qt->secmax = INT32_MIN;
+}
+
+/* Each second's peak is taken as it fills up; a second left over at *
+ * the end of the trace is left out                                  */
+void SudsQcFeed (SUDS_QCTRACE *qt, const TRACE_HEADER *wf,
+                 const void *samples, char datatype)
+{
+  int32_t  tmp[QC_CHUNK];
+  const float *f;
+  long     i, j, k, n = wf->nsamp;
+
+  /* gap fill isn't data, so a gap ends the run */
+  if (qt->nsamp > 0 && wf->starttime > qt->lastend + qt->gap)
+  {
+    EndRun (qt);
+    qt->curlen = 0;
+  }
+  qt->lastend = wf->endtime;
+
+  for (i = 0; i < n; i += k)
+  {
+    k = n - i;
+    if (qt->persec > 0 && k > qt->persec - qt->secn)
+      k = qt->persec - qt->secn;
+    switch (datatype)
+    {
+    case 's':
+      QcShort ((const int16_t *) samples + i, k, qt);
+      break;
+    case 'l':
+      QcLong ((const int32_t *) samples + i, k, qt);
+      break;
+    case 'f':
+      /* clipped to 32-bit as the conversion does */
+      if (k > QC_CHUNK)
+        k = QC_CHUNK;
+      f = (const float *) samples + i;
+      for (j = 0; j < k; j++)
+      {
+        if (f[j] < (float) INT32_MIN)
+          tmp[j] = INT32_MIN;
+        else if (f[j] >= (float) INT32_MAX)
+          tmp[j] = INT32_MAX;
+        else
+          tmp[j] = (int32_t) f[j];
+      }
+      QcLong (tmp, k, qt);
+      break;
+    default:
+      return;
+    }
+    qt->secn += k;
+    if (qt->persec > 0 && qt->secn == qt->persec)
+      EndSecond (qt);
+  }
+  qt->nsamp += n;
+}
+
+/* As the script had it: blank or long runs of 0 or -1 make a trace bad *
+ * (quality 0); otherwise an snr no more than SnrMin, or none at all,   *
+ * halves its quality                                                   */
+void SudsQcRecord (SUDS_QCTRACE *qt, int32_t numclip, SUDS_CHANQC *cq)
+{
+  const SUDS_QC *qc = qt->qc;
+  double  high, low;
+
+  EndRun (qt);
+  qt->curlen = 0;
+
+  memset (cq, 0, sizeof (SUDS_CHANQC));
+  cq->nseconds = qt->nsec;
+  cq->zero_run = Clamp32 (qt->zero_run);
+  cq->neg1_run = Clamp32 (qt->neg1_run);
+  cq->stuck_run = Clamp32 (qt->stuck_run);
+  cq->numclip = numclip;
+  if (qt->nonzero == 0)
+    cq->flags |= SUDS_QC_BLANK;
+  if (qc->ZeroRun > 0 && qt->zero_run >= qc->ZeroRun)
+    cq->flags |= SUDS_QC_ZEROS;
+  if (qc->Neg1Run > 0 && qt->neg1_run >= qc->Neg1Run)
+    cq->flags |= SUDS_QC_NEG1;
+  if (qc->StuckRun > 0 && qt->stuck_run >= qc->StuckRun)
+    cq->flags |= SUDS_QC_STUCK;
+
+  cq->snr = cq->signal = cq->noise = -1.0f;
+  if (qt->nsec > qc->MinSeconds && (high = Percentile (qt, 95.0)) >= 1.0)
+  {
+    /* a flat noise second still has a count of quantization noise */
+    low = Percentile (qt, 5.0);
+    cq->signal = (float) high;
+    cq->noise = (float) low;
+    cq->snr = (float) (high / ((low >= 1.0) ? low : 1.0));
+  }
+  else
+    cq->flags |= SUDS_QC_SHORT;
+
+  if (cq->flags & SUDS_QC_BAD)
+    cq->quality = 0.0f;
+  else if (cq->snr <= qc->SnrMin)
+  {
+    cq->quality = 0.5f;
+    if (cq->snr >= 0.0f)
+      cq->flags |= SUDS_QC_LOWSNR;
+  }
+  else
+    cq->quality = 1.0f;
+}
+
+
+/* The run going on is over */
+static void EndRun (SUDS_QCTRACE *qt)
+{
+  if (qt->curlen > qt->stuck_run)
+    qt->stuck_run = qt->curlen;
+  if (qt->cur == 0)
+  {
+    if (qt->curlen > qt->zero_run)
+      qt->zero_run = qt->curlen;
+  }
+  else if (qt->cur == -1)
+  {
+    if (qt->curlen > qt->neg1_run)
+      qt->neg1_run = qt->curlen;
+  }
+}
+
+/* A whole second is in; half its peak-to-peak goes in the histogram */
+static void EndSecond (SUDS_QCTRACE *qt)
+{
+  qt->hist[Bin ((uint32_t) (((int64_t) qt->secmax - qt->secmin) / 2))]++;
+  qt->nsec++;
+  qt->secn = 0;
+  qt->secmin = INT32_MAX;
+  qt->secmax = INT32_MIN;
+}
+
+/* Exact below 32; above, 32 bins an octave */
+static int Bin (uint32_t v)
+{
+  int  e = 5;
+
+  if (v < 32)
+    return (int) v;
+  while ((v >> (e + 1)) != 0)
+    e++;
+  return 32 + (e - 5) * 32 + (int) ((v >> (e - 5)) & 31);
+}
+
+/* The middle of a bin */
+static double BinValue (int b)
+{
+  double  width;
+
+  if (b < 32)
+    return b;
+  width = (double) (1UL << ((b - 32) / 32));
+  return (32 + (b - 32) % 32) * width + (width - 1.0) / 2.0;
+}
+
+/* The k'th least second peak, from 0 */
+static double Nth (const SUDS_QCTRACE *qt, long k)
+{
+  long  seen = 0;
+  int   b;
+
+  for (b = 0; b < SUDS_QC_BINS; b++)
+    if ((seen += qt->hist[b]) > k)
+      return BinValue (b);
+  return BinValue (SUDS_QC_BINS - 1);
+}
+
+/* As numpy's, interpolating between the two nearest ranks */
+static double Percentile (const SUDS_QCTRACE *qt, double pct)
+{
+  double  r = pct / 100.0 * (qt->nsec - 1);
+  long    k = (long) r;
+  double  lo = Nth (qt, k);
+
+  if (k + 1 >= qt->nsec)
+    return lo;
+  return lo + (r - k) * (Nth (qt, k + 1) - lo);
+}
+
+static int32_t Clamp32 (int64_t v)
+{
+  return (v > INT32_MAX) ? INT32_MAX : (int32_t) v;
+}
+
+
+/*
+ *  Scalar kernels; also used for the head and tail of each vector loop
+ */
+
+/* Fold one sample into the runs */
+#define RUN_ADD(qt, x) \
+  do { \
+    if ((x) == (qt)->cur) \
+      (qt)->curlen++; \
+    else \
+    { \
+      EndRun (qt); \
+      (qt)->cur = (x); \
+      (qt)->curlen = 1; \
+    } \
+  } while (0)
+
+/* ... and into the second going on */
+#define SAMPLE_ADD(qt, x) \
+  do { \
+    RUN_ADD (qt, x); \
+    if ((x) < (qt)->secmin) \
+      (qt)->secmin = (x); \
+    if ((x) > (qt)->secmax) \
+      (qt)->secmax = (x); \
+    (qt)->nonzero += ((x) != 0); \
+  } while (0)
+
+static void QcShortScalar (const int16_t *x, long n, SUDS_QCTRACE *qt)
+{
+  long  j;
+
+  for (j = 0; j < n; j++)
+    SAMPLE_ADD (qt, (int32_t) x[j]);
+}
+
+static void QcLongScalar (const int32_t *x, long n, SUDS_QCTRACE *qt)
+{
+  long  j;
+
+  for (j = 0; j < n; j++)
+    SAMPLE_ADD (qt, x[j]);
+}
+
+
+#ifdef SUDS_QC_X86
+
+/* Fold w samples at x into the runs, given rep, bit k of which is set *
+ * if sample k is the same as the one before it; a step for each run   *
+ * that starts among them                                              */
+#define RUNS_MASK(qt, x, rep, w) \
+  do { \
+    uint32_t s_ = ~(rep) & (uint32_t) ((1UL << (w)) - 1); \
+    int      p_; \
+    \
+    if (s_ == 0) \
+    { \
+      (qt)->curlen += (w); \
+      break; \
+    } \
+    (qt)->curlen += __builtin_ctz (s_); \
+    while (s_ != 0) \
+    { \
+      p_ = __builtin_ctz (s_); \
+      s_ &= s_ - 1; \
+      EndRun (qt); \
+      (qt)->cur = (x)[p_]; \
+      (qt)->curlen = ((s_ != 0) ? __builtin_ctz (s_) : (w)) - p_; \
+    } \
+  } while (0)
+
+/* No sample of the w at x repeats the one before: the run going on *
+ * ends, each is a run of 1, and the last one goes on                */
+#define RUNS_NONE(qt, x, haszero, hasneg1, w) \
+  do { \
+    EndRun (qt); \
+    if ((haszero) && (qt)->zero_run < 1) \
+      (qt)->zero_run = 1; \
+    if ((hasneg1) && (qt)->neg1_run < 1) \
+      (qt)->neg1_run = 1; \
+    (qt)->cur = (x)[(w) - 1]; \
+    (qt)->curlen = 1; \
+  } while (0)
+
+__attribute__((target("avx2")))
+static void QcShortAvx2 (const int16_t *x, long n, SUDS_QCTRACE *qt)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i neg1 = _mm256_set1_epi16 (-1);
+  __m256i   v, eq, isz, vmin, vmax;
+  int16_t   lo[16], hi[16];
+  uint32_t  rep, z;
+  long      j, nzero = 0;
+  int       k;
+
+  if (n < 17)
+  {
+    QcShortScalar (x, n, qt);
+    return;
+  }
+  QcShortScalar (x, 1, qt);            /* against the run before */
+  vmin = vmax = _mm256_set1_epi16 (x[0]);
+  for (j = 1; j + 16 <= n; j += 16)
+  {
+    v = _mm256_loadu_si256 ((const __m256i *) (x + j));
+    eq = _mm256_cmpeq_epi16 (v, _mm256_loadu_si256 ((const __m256i *) (x + j - 1)));
+    isz = _mm256_cmpeq_epi16 (v, zero);
+    vmin = _mm256_min_epi16 (vmin, v);
+    vmax = _mm256_max_epi16 (vmax, v);
+    z = (uint32_t) _mm256_movemask_epi8 (isz);
+    nzero += __builtin_popcount (z) / 2;
+
+    /* a bit a lane: the packs keep lanes 0-7 in bytes 0-7 and 8-15 in 16-23 */
+    rep = (uint32_t) _mm256_movemask_epi8 (_mm256_packs_epi16 (eq, zero));
+    rep = (rep & 0xFF) | ((rep >> 8) & 0xFF00);
+    if (rep == 0)
+      RUNS_NONE (qt, x + j, z != 0,
+                 _mm256_movemask_epi8 (_mm256_cmpeq_epi16 (v, neg1)) != 0, 16);
+    else
+      RUNS_MASK (qt, x + j, rep, 16);
+  }
+
+  _mm256_storeu_si256 ((__m256i *) lo, vmin);
+  _mm256_storeu_si256 ((__m256i *) hi, vmax);
+  for (k = 0; k < 16; k++)
+  {
+    if (lo[k] < qt->secmin)
+      qt->secmin = lo[k];
+    if (hi[k] > qt->secmax)
+      qt->secmax = hi[k];
+  }
+  qt->nonzero += (j - 1) - nzero;
+  QcShortScalar (x + j, n - j, qt);
+}
+
+__attribute__((target("avx2")))
+static void QcLongAvx2 (const int32_t *x, long n, SUDS_QCTRACE *qt)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i neg1 = _mm256_set1_epi32 (-1);
+  __m256i   v, isz, vmin, vmax;
+  int32_t   lo[8], hi[8];
+  uint32_t  rep, z;
+  long      j, nzero = 0;
+  int       k;
+
+  if (n < 9)
+  {
+    QcLongScalar (x, n, qt);
+    return;
+  }
+  QcLongScalar (x, 1, qt);             /* against the run before */
+  vmin = vmax = _mm256_set1_epi32 (x[0]);
+  for (j = 1; j + 8 <= n; j += 8)
+  {
+    v = _mm256_loadu_si256 ((const __m256i *) (x + j));
+    isz = _mm256_cmpeq_epi32 (v, zero);
+    vmin = _mm256_min_epi32 (vmin, v);
+    vmax = _mm256_max_epi32 (vmax, v);
+    z = (uint32_t) _mm256_movemask_ps (_mm256_castsi256_ps (isz));
+    nzero += __builtin_popcount (z);
+    rep = (uint32_t) _mm256_movemask_ps (_mm256_castsi256_ps (
+            _mm256_cmpeq_epi32 (v, _mm256_loadu_si256 ((const __m256i *) (x + j - 1)))));
+    if (rep == 0)
+      RUNS_NONE (qt, x + j, z != 0,
+                 _mm256_movemask_ps (_mm256_castsi256_ps (
+                   _mm256_cmpeq_epi32 (v, neg1))) != 0, 8);
+    else
+      RUNS_MASK (qt, x + j, rep, 8);
+  }
+
+  _mm256_storeu_si256 ((__m256i *) lo, vmin);
+  _mm256_storeu_si256 ((__m256i *) hi, vmax);
+  for (k = 0; k < 8; k++)
+  {
+    if (lo[k] < qt->secmin)
+      qt->secmin = lo[k];
+    if (hi[k] > qt->secmax)
+      qt->secmax = hi[k];
+  }
+  qt->nonzero += (j - 1) - nzero;
+  QcLongScalar (x + j, n - j, qt);
+}
+
+#endif /* SUDS_QC_X86 */
+
+
+/* Point the run kernels at the best versions this CPU supports */
+static void QcInit (void)
+{
+#ifdef SUDS_QC_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    QcShort = QcShortAvx2;
+    QcLong = QcLongAvx2;
+    QcName = "avx2";
+    return;
+  }
+#endif
+  QcShort = QcShortScalar;
+  QcLong = QcLongScalar;
+  QcName = "scalar";
+}
@@ -0,0 +1,313 @@
+/* sudsreader.c
+
+        Routines for reading PC-SUDS files
+
+   The file is mapped, and SUDS_STRUCTTAGs are walked in place. Each tag
+   says which byte order its record is in (machine '6' is Intel), so
+   files written on either kind of machine, or even a mix of both, read
+   the same. Structs are decoded through the field tables the putaway
+   routines encode them with (sudsswap.c).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WINNT
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <earthworm.h>
+#include <swap.h>
+#include <sudshead.h>
+#include <sudsswap.h>
+#include <sudsreader.h>
+
+/************************************************************************
+* SudsFileOpen: map path read-only                                      *
+*************************************************************************/
+int SudsFileOpen (SUDS_FILE *sf, const char *path)
+{
+#ifndef _WINNT
+  struct stat  st;
+  int          fd;
+  void        *base;
+
+  memset (sf, 0, sizeof (SUDS_FILE));
+  if ((fd = open (path, O_RDONLY)) < 0)
+  {
+    logit ("e", "SudsFileOpen: unable to open %s: %s\n", path, strerror (errno));
+    return EW_FAILURE;
+  }
+  if (fstat (fd, &st) != 0)
+  {
+    logit ("e", "SudsFileOpen: unable to stat %s: %s\n", path, strerror (errno));
+    close (fd);
+    return EW_FAILURE;
+  }
+  if (st.st_size > 0)
+  {
+    base = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+    {
+      logit ("e", "SudsFileOpen: unable to map %s: %s\n", path, strerror (errno));
+      close (fd);
+      return EW_FAILURE;
+    }
+    sf->Base = (const char *) base;
+    sf->Mapped = 1;
+  }
+  sf->Size = (size_t) st.st_size;
+  close (fd);
+  return EW_SUCCESS;
+#else
+  /* no mmap here; read the whole file instead */
+  FILE  *fp;
+  long   len;
+  char  *buf;
+
+  memset (sf, 0, sizeof (SUDS_FILE));
+  if ((fp = fopen (path, "rb")) == NULL)
+  {
+    logit ("e", "SudsFileOpen: unable to open %s: %s\n", path, strerror (errno));
+    return EW_FAILURE;
+  }
+  if (fseek (fp, 0, SEEK_END) != 0 || (len = ftell (fp)) < 0
+      || fseek (fp, 0, SEEK_SET) != 0
+      || (buf = (char *) malloc (len + 1)) == NULL)
+  {
+    logit ("e", "SudsFileOpen: unable to read %s\n", path);
+    fclose (fp);
+    return EW_FAILURE;
+  }
+  if (fread (buf, 1, len, fp) != (size_t) len)
+  {
+    logit ("e", "SudsFileOpen: unable to read %s\n", path);
+    free (buf);
+    fclose (fp);
+    return EW_FAILURE;
+  }
+  fclose (fp);
+  sf->Base = buf;
+  sf->Size = (size_t) len;
+  return EW_SUCCESS;
+#endif
+}
+
+void SudsFileClose (SUDS_FILE *sf)
+{
+  if (sf == NULL || sf->Base == NULL)
+    return;
+#ifndef _WINNT
+  if (sf->Mapped)
+    munmap ((void *) sf->Base, sf->Size);
+  else
+#endif
+    free ((void *) sf->Base);
+  memset (sf, 0, sizeof (SUDS_FILE));
+}
+
+/************************************************************************
+* SudsNextRec: read the tag at *pos; the struct and data after it are   *
+*       only pointed at                                                 *
+*************************************************************************/
+int SudsNextRec (SUDS_FILE *sf, size_t *pos, SUDS_REC *rec)
+{
+  SUDS_STRUCTTAG  tag;
+  const char     *p;
+  size_t          left;
+
+  if (*pos >= sf->Size)
+    return SUDS_EOF;
+  if (sf->Size - *pos < SUDS_STRUCTTAG_LEN)
+  {
+    logit ("e", "SudsNextRec: truncated tag at offset %lu\n", (unsigned long) *pos);
+    return EW_FAILURE;
+  }
+  p = sf->Base + *pos;
+  if (p[0] != 'S')
+  {
+    logit ("e", "SudsNextRec: no tag at offset %lu\n", (unsigned long) *pos);
+    return EW_FAILURE;
+  }
+
+  memset (rec, 0, sizeof (SUDS_REC));
+  rec->machine = p[1];
+  rec->swap = SUDS_MACHINE_SWAP (rec->machine);
+  if (SudsDecodeStruct (&tag, STRUCTTAG, p, SUDS_STRUCTTAG_LEN, rec->swap)
+      != EW_SUCCESS)
+    return EW_FAILURE;
+  rec->id = tag.id_struct;
+  rec->len_struct = tag.len_struct;
+  rec->len_data = tag.len_data;
+  rec->Offset = *pos;
+
+  left = sf->Size - *pos - SUDS_STRUCTTAG_LEN;
+  if (tag.len_struct < 0 || tag.len_data < 0
+      || (size_t) tag.len_struct > left
+      || (size_t) tag.len_data > left - (size_t) tag.len_struct)
+  {
+    logit ("e", "SudsNextRec: bad lengths (%ld, %ld) in tag at offset %lu\n",
+           (long) tag.len_struct, (long) tag.len_data, (unsigned long) *pos);
+    return EW_FAILURE;
+  }
+  rec->Struct = p + SUDS_STRUCTTAG_LEN;
+  rec->Data = rec->Struct + tag.len_struct;
+  *pos += SUDS_STRUCTTAG_LEN + tag.len_struct + tag.len_data;
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsRecStruct: decode the record's struct in native byte order       *
+*************************************************************************/
+int SudsRecStruct (const SUDS_REC *rec, void *out, int struct_type)
+{
+  if (rec->id != struct_type)
+  {
+    logit ("e", "SudsRecStruct: struct %d at offset %lu, expected %d\n",
+           rec->id, (unsigned long) rec->Offset, struct_type);
+    return EW_FAILURE;
+  }
+  return SudsDecodeStruct (out, struct_type, rec->Struct, rec->len_struct,
+                           rec->swap);
+}
+
+/************************************************************************
+* SudsNextTrace: find the next DESCRIPTRACE, remembering the last       *
+*       STATIONCOMP before it                                           *
+*************************************************************************/
+int SudsNextTrace (SUDS_FILE *sf, size_t *pos, SUDS_TRACE *tr)
+{
+  SUDS_REC  rec;
+  int       ret;
+
+  memset (tr, 0, sizeof (SUDS_TRACE));
+  while ((ret = SudsNextRec (sf, pos, &rec)) == EW_SUCCESS)
+  {
+    if (rec.id == STATIONCOMP && rec.len_struct == SUDS_STATIONCOMP_LEN)
+    {
+      tr->have_sc = (SudsRecStruct (&rec, &tr->sc, STATIONCOMP) == EW_SUCCESS);
+      continue;
+    }
+    if (rec.id != DESCRIPTRACE || rec.len_struct != SUDS_DESCRIPTRACE_LEN)
+      continue;
+
+    if (SudsRecStruct (&rec, &tr->dt, DESCRIPTRACE) != EW_SUCCESS)
+      return EW_FAILURE;
+    tr->Offset = rec.Offset;
+    tr->samples.Base = rec.Data;
+    tr->samples.swap = rec.swap;
+    tr->samples.n = tr->dt.length;
+    if (tr->dt.length > 0)
+      tr->samples.Size = (int) (rec.len_data / tr->dt.length);
+    if (tr->dt.length < 0
+        || (tr->dt.length > 0 && tr->samples.Size != 2 && tr->samples.Size != 4
+            && tr->samples.Size != (int) sizeof (long))
+        || (long) tr->samples.Size * tr->dt.length != rec.len_data)
+    {
+      logit ("e", "SudsNextTrace: %ld bytes of data for %ld samples at offset %lu\n",
+             rec.len_data, (long) tr->dt.length, (unsigned long) rec.Offset);
+      return EW_FAILURE;
+    }
+    return EW_SUCCESS;
+  }
+  return ret;
+}
+
+/************************************************************************
+* SudsSample, SudsSamples: fetch samples, fixing the byte order on the  *
+*       way out                                                         *
+*************************************************************************/
+long SudsSample (const SUDS_SPAN *sp, long i)
+{
+  long  out;
+
+  SudsSamples (sp, i, 1, &out);
+  return out;
+}
+
+long SudsSamples (const SUDS_SPAN *sp, long first, long n, long *out)
+{
+  const char  *p;
+  short        s;
+  int          k;
+  long         l;
+  long         i;
+
+  if (first < 0 || first >= sp->n || n <= 0)
+    return 0;
+  if (n > sp->n - first)
+    n = sp->n - first;
+  p = sp->Base + first * sp->Size;
+
+  if (sp->Size == 2)
+  {
+    for (i = 0; i < n; i++, p += 2)
+    {
+      memcpy (&s, p, 2);
+      if (sp->swap)
+        SwapShort (&s);
+      out[i] = s;
+    }
+  }
+  else if (sp->Size == 4 && sizeof (long) != 4)
+  {
+    for (i = 0; i < n; i++, p += 4)
+    {
+      memcpy (&k, p, 4);
+      if (sp->swap)
+        SwapInt32 (&k);
+      out[i] = k;
+    }
+  }
+  else
+  {
+    for (i = 0; i < n; i++, p += sizeof (long))
+    {
+      memcpy (&l, p, sizeof (long));
+      if (sp->swap)
+        SwapLong (&l);
+      out[i] = l;
+    }
+  }
+  return n;
+}
+
+/************************************************************************
+* SudsEffectiveTime: the time sud2asc reports as "effective"            *
+*************************************************************************/
+int SudsEffectiveTime (SUDS_FILE *sf, long *effective)
+{
+  SUDS_REC             rec;
+  SUDS_REC             first_sc;
+  SUDS_TIMECORRECTION  tc;
+  SUDS_STATIONCOMP     sc;
+  size_t               pos = 0;
+  int                  have_sc = 0;
+  int                  ret;
+
+  memset (&first_sc, 0, sizeof (first_sc));
+  while ((ret = SudsNextRec (sf, &pos, &rec)) == EW_SUCCESS)
+  {
+    if (rec.id == TIMECORRECTION)
+    {
+      if (SudsRecStruct (&rec, &tc, TIMECORRECTION) != EW_SUCCESS)
+        return EW_FAILURE;
+      *effective = tc.effective_time;
+      return EW_SUCCESS;
+    }
+    if (rec.id == STATIONCOMP && !have_sc)
+    {
+      first_sc = rec;
+      have_sc = 1;
+    }
+  }
+  if (ret == EW_FAILURE || !have_sc
+      || SudsRecStruct (&first_sc, &sc, STATIONCOMP) != EW_SUCCESS)
+    return EW_FAILURE;
+  *effective = sc.effective;
+  return EW_SUCCESS;
+}
@@ -0,0 +1,617 @@
+/* sudsrsam.c
+
+        Incremental RSAM and RSAM alarms; see sudsrsam.h
+
+   Each station sums the absolute amplitude of its samples over the
+   second they fall in. When a sample from a later second comes along,
+   the finished second is pushed into a ring of the last 600 seconds,
+   which keeps running sums for the 1-minute and 10-minute windows, so
+   nothing is ever summed twice. Feeding a station only takes that
+   station's lock; pushing a second takes the engine's lock, which also
+   covers judging the alarms and writing the files.
+*/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <earthworm.h>
+#include <time_ew.h>
+#include <trace_buf.h>
+#include <sudsswap.h>
+#include <sudsrsam.h>
+
+#define RING            600            /* seconds of history per station */
+#define DC_SECONDS      30.0           /* time constant of the DC tracker */
+
+static const int WinLen[RSAM_NWIN] = { 1, 60, 600 };
+
+/* One second of one station */
+typedef struct
+{
+  long    sec;                         /* which second this slot holds; -1 none */
+  float   avg[RSAM_NWIN];              /* averages as of then; -1 for no data */
+} RSAM_SLOT;
+
+typedef struct
+{
+  char    sta[TRACE_STA_LEN];
+  char    chan[TRACE_CHAN_LEN];        /* "" for any */
+  char    net[TRACE_NET_LEN];          /* "" for any */
+  double  thresh[RSAM_NRULE];
+
+  /* the second being summed; guarded by feed */
+  pthread_mutex_t feed;
+  long    cur;                         /* -1 before the first sample */
+  double  abs_sum;
+  long    nabs;
+  double  dc;
+  double  last;                        /* time of the last sample taken */
+
+  /* finished seconds; guarded by the engine's mutex */
+  long    done;                        /* last second pushed; -1 none */
+  double  sum[RSAM_NWIN];
+  long    n[RSAM_NWIN];
+  RSAM_SLOT ring[RING];
+} RSAM_CHAN;
+
+typedef struct
+{
+  int     window;
+  int     every;
+  int     MinStations;
+  int     Holdoff;
+  long    quiet;                       /* no alarm before this second */
+} RSAM_RULE;
+
+struct _SUDS_RSAM
+{
+  RSAM_CHAN **ch;
+  int        nch;
+  int        started;                  /* a packet has been fed */
+  RSAM_RULE  rule[RSAM_NRULE];
+  int        MaxLag;
+  long       judged;                   /* last second judged; -1 none */
+  FILE      *fp[RSAM_NRULE];           /* alarm files */
+  FILE      *arch;
+  pthread_mutex_t mutex;
+};
+
+/* Internal Function Prototypes */
+static void Push (SUDS_RSAM *, int, long, float);
+static void Leave (RSAM_CHAN *, long, int);
+static void Archive (SUDS_RSAM *, int, long);
+static void Judge (SUDS_RSAM *, int);
+static void JudgeSecond (SUDS_RSAM *, long);
+static float SlotValue (RSAM_CHAN *, long, int);
+static void WriteAlarm (SUDS_RSAM *, int, long);
+static int OpenAlarmFile (SUDS_RSAM *, int, const char *);
+static int OpenArchive (SUDS_RSAM *, const char *);
+static double AbsSum (RSAM_CHAN *, const void *, char, long, long, double);
+
+static const char *Month[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+SUDS_RSAM *SudsRsamCreate (void)
+{
+  SUDS_RSAM  *rs;
+
+  if ((rs = (SUDS_RSAM *) calloc (1, sizeof (SUDS_RSAM))) == NULL)
+  {
+    logit ("e", "SudsRsamCreate: couldn't malloc RSAM engine\n");
+    return NULL;
+  }
+  rs->rule[RSAM_EVENT].window = RSAM_1MIN;
+  rs->rule[RSAM_EVENT].every = 1;
+  rs->rule[RSAM_EVENT].MinStations = 2;
+  rs->rule[RSAM_EVENT].Holdoff = 60;
+  rs->rule[RSAM_TREMOR].window = RSAM_10MIN;
+  rs->rule[RSAM_TREMOR].every = 600;
+  rs->rule[RSAM_TREMOR].MinStations = 2;
+  rs->rule[RSAM_TREMOR].Holdoff = 600;
+  rs->MaxLag = 60;
+  rs->judged = -1;
+  pthread_mutex_init (&rs->mutex, NULL);
+  return rs;
+}
+
+int SudsRsamAddStation (SUDS_RSAM *rs, const char *sta, const char *chan,
+                        const char *net, double EventThresh,
+                        double TremorThresh)
+{
+  RSAM_CHAN  **grown;
+  RSAM_CHAN   *c;
+  int          i;
+
+  if (rs == NULL || sta == NULL || rs->started)
+  {
+    logit ("e", "SudsRsamAddStation: stations must be added before any data\n");
+    return EW_FAILURE;
+  }
+  grown = (RSAM_CHAN **) realloc (rs->ch, (rs->nch + 1) * sizeof (RSAM_CHAN *));
+  if (grown == NULL || (c = (RSAM_CHAN *) calloc (1, sizeof (RSAM_CHAN))) == NULL)
+  {
+    logit ("e", "SudsRsamAddStation: couldn't malloc station %s\n", sta);
+    if (grown != NULL)
+      rs->ch = grown;
+    return EW_FAILURE;
+  }
+  rs->ch = grown;
+  strncpy (c->sta, sta, TRACE_STA_LEN - 1);
+  if (chan != NULL)
+    strncpy (c->chan, chan, TRACE_CHAN_LEN - 1);
+  if (net != NULL)
+    strncpy (c->net, net, TRACE_NET_LEN - 1);
+  c->thresh[RSAM_EVENT] = EventThresh;
+  c->thresh[RSAM_TREMOR] = TremorThresh;
+  c->cur = -1;
+  c->last = -1.0;
+  c->done = -1;
+  for (i = 0; i < RING; i++)
+    c->ring[i].sec = -1;
+  pthread_mutex_init (&c->feed, NULL);
+  rs->ch[rs->nch++] = c;
+  return EW_SUCCESS;
+}
+
+int SudsRsamSetRule (SUDS_RSAM *rs, int rule, int window, int every,
+                     int MinStations, int Holdoff)
+{
+  if (rs == NULL || rule < 0 || rule >= RSAM_NRULE || window < 0
+      || window >= RSAM_NWIN || every < 1 || RING % every != 0
+      || MinStations < 1 || Holdoff < 0)
+  {
+    logit ("e", "SudsRsamSetRule: bad rule\n");
+    return EW_FAILURE;
+  }
+  rs->rule[rule].window = window;
+  rs->rule[rule].every = every;
+  rs->rule[rule].MinStations = MinStations;
+  rs->rule[rule].Holdoff = Holdoff;
+  return EW_SUCCESS;
+}
+
+int SudsRsamSetMaxLag (SUDS_RSAM *rs, int MaxLag)
+{
+  if (rs == NULL || MaxLag < 0 || MaxLag > RSAM_MAXLAG)
+    return EW_FAILURE;
+  rs->MaxLag = MaxLag;
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsRsamOpen: open (for appending) the alarm files and the archive    *
+*************************************************************************/
+int SudsRsamOpen (SUDS_RSAM *rs, const char *EventFile, const char *TremorFile,
+                  const char *ArchiveFile)
+{
+  if (rs == NULL)
+    return EW_FAILURE;
+  if (EventFile != NULL && OpenAlarmFile (rs, RSAM_EVENT, EventFile) != EW_SUCCESS)
+    return EW_FAILURE;
+  if (TremorFile != NULL && OpenAlarmFile (rs, RSAM_TREMOR, TremorFile) != EW_SUCCESS)
+    return EW_FAILURE;
+  if (ArchiveFile != NULL && OpenArchive (rs, ArchiveFile) != EW_SUCCESS)
+    return EW_FAILURE;
+  return EW_SUCCESS;
+}
+
+/* A new alarm file starts with the column names. The event file's  *
+ * header, like the observatory's, has no tab after DATE but one after *
+ * every station's columns; its alarm lines are tab separated.         */
+static int OpenAlarmFile (SUDS_RSAM *rs, int rule, const char *path)
+{
+  FILE  *fp;
+  int    i;
+
+  if ((fp = fopen (path, "a")) == NULL)
+  {
+    logit ("e", "SudsRsamOpen: unable to open %s\n", path);
+    return EW_FAILURE;
+  }
+  if (ftell (fp) == 0)
+  {
+    fprintf (fp, "DATE");
+    for (i = 0; i < rs->nch; i++)
+      if (rule == RSAM_EVENT)
+        fprintf (fp, "%s.THRESH\t%s.DATA\t", rs->ch[i]->sta, rs->ch[i]->sta);
+      else
+        fprintf (fp, ",%s.THRESH,%s.DATA", rs->ch[i]->sta, rs->ch[i]->sta);
+    fprintf (fp, "\n");
+    fflush (fp);
+  }
+  rs->fp[rule] = fp;
+  return EW_SUCCESS;
+}
+
+/* A new archive gets a header; an old one must have the same stations */
+static int OpenArchive (SUDS_RSAM *rs, const char *path)
+{
+  SUDS_RSAMHEAD  head, old;
+  SUDS_RSAMCHAN  rc, oldrc;
+  FILE          *fp;
+  long           size;
+  int            i;
+
+  if ((fp = fopen (path, "a+b")) == NULL)
+  {
+    logit ("e", "SudsRsamOpen: unable to open %s\n", path);
+    return EW_FAILURE;
+  }
+  memset (&head, 0, sizeof (head));
+  memcpy (head.magic, RSAM_MAGIC, 4);
+  head.machine = SUDS_MACHINE (SUDS_HOST_ORDER);
+  head.version = 1;
+  head.nchan = (short) rs->nch;
+
+  fseek (fp, 0L, SEEK_END);
+  size = ftell (fp);
+  rewind (fp);
+  if (size > 0
+      && (fread (&old, sizeof (old), 1, fp) != 1
+          || memcmp (&old, &head, sizeof (head)) != 0))
+  {
+    logit ("e", "SudsRsamOpen: %s isn't an archive of these stations\n", path);
+    fclose (fp);
+    return EW_FAILURE;
+  }
+  if (size == 0)
+    fwrite (&head, sizeof (head), 1, fp);
+  for (i = 0; i < rs->nch; i++)
+  {
+    memset (&rc, 0, sizeof (rc));
+    strncpy (rc.sta, rs->ch[i]->sta, sizeof (rc.sta) - 1);
+    strncpy (rc.chan, rs->ch[i]->chan, sizeof (rc.chan) - 1);
+    strncpy (rc.net, rs->ch[i]->net, sizeof (rc.net) - 1);
+    if (size == 0)
+      fwrite (&rc, sizeof (rc), 1, fp);
+    else if (fread (&oldrc, sizeof (oldrc), 1, fp) != 1
+             || memcmp (&oldrc, &rc, sizeof (rc)) != 0)
+    {
+      logit ("e", "SudsRsamOpen: %s isn't an archive of these stations\n", path);
+      fclose (fp);
+      return EW_FAILURE;
+    }
+  }
+  if (fflush (fp) != 0)
+  {
+    logit ("e", "SudsRsamOpen: unable to write %s\n", path);
+    fclose (fp);
+    return EW_FAILURE;
+  }
+  rs->arch = fp;
+  return EW_SUCCESS;
+}
+
+int SudsRsamFind (SUDS_RSAM *rs, const char *sta, const char *chan,
+                  const char *net)
+{
+  RSAM_CHAN  *c;
+  int         i;
+
+  if (rs == NULL)
+    return -1;
+  for (i = 0; i < rs->nch; i++)
+  {
+    c = rs->ch[i];
+    if (strcmp (c->sta, sta) == 0
+        && (c->chan[0] == '\0' || strcmp (c->chan, chan) == 0)
+        && (c->net[0] == '\0' || strcmp (c->net, net) == 0))
+      return i;
+  }
+  return -1;
+}
+
+/************************************************************************
+* SudsRsamFeed: add one packet's samples to station ch                  *
+*************************************************************************/
+int SudsRsamFeed (SUDS_RSAM *rs, int ch, const TRACE_HEADER *wf,
+                  const void *samples, char datatype)
+{
+  RSAM_CHAN  *c;
+  double      rate = wf->samprate;
+  double      alpha, t;
+  long        n = wf->nsamp;
+  long        k = 0, m;
+  long        sec;
+
+  if (rs == NULL || ch < 0 || ch >= rs->nch || rate < 0.01)
+    return EW_FAILURE;
+  rs->started = 1;
+  c = rs->ch[ch];
+  alpha = 1.0 / (rate * DC_SECONDS);
+  if (alpha > 1.0)
+    alpha = 1.0;
+
+  pthread_mutex_lock (&c->feed);
+
+  /* skip anything already seen, as snippets of overlapping events repeat */
+  if (c->last >= 0.0 && wf->starttime <= c->last + 0.5 / rate)
+    k = (long) floor ((c->last - wf->starttime) * rate + 0.5) + 1;
+
+  while (k < n)
+  {
+    t = wf->starttime + k / rate;
+    sec = (long) floor (t);
+    if (sec != c->cur)
+    {
+      if (c->cur >= 0 && c->nabs > 0)
+      {
+        pthread_mutex_lock (&rs->mutex);
+        Push (rs, ch, c->cur, (float) (c->abs_sum / c->nabs));
+        Judge (rs, 0);
+        pthread_mutex_unlock (&rs->mutex);
+      }
+      if (c->cur < 0)
+        c->dc = (datatype == 's') ? ((const short *) samples)[k]
+              : (datatype == 'l') ? ((const int32_t *) samples)[k]
+              : ((const float *) samples)[k];
+      c->cur = sec;
+      c->abs_sum = 0.0;
+      c->nabs = 0;
+    }
+    /* the samples left in this second */
+    m = (long) ceil (((double) (sec + 1) - t) * rate);
+    if (m < 1)
+      m = 1;
+    if (m > n - k)
+      m = n - k;
+    c->abs_sum += AbsSum (c, samples, datatype, k, m, alpha);
+    c->nabs += m;
+    k += m;
+  }
+  if (n > 0)
+    c->last = wf->starttime + (n - 1) / rate;
+
+  pthread_mutex_unlock (&c->feed);
+  return EW_SUCCESS;
+}
+
+/* Sum of |x - DC| over samples first..first+m-1, tracking the DC as we go */
+static double AbsSum (RSAM_CHAN *c, const void *samples, char datatype,
+                      long first, long m, double alpha)
+{
+  double  dc = c->dc, sum = 0.0, x;
+  long    j;
+
+  for (j = first; j < first + m; j++)
+  {
+    if (datatype == 's')
+      x = ((const short *) samples)[j];
+    else if (datatype == 'l')
+      x = (double) ((const int32_t *) samples)[j];
+    else
+      x = ((const float *) samples)[j];
+    dc += (x - dc) * alpha;
+    sum += fabs (x - dc);
+  }
+  c->dc = dc;
+  return sum;
+}
+
+/* Push second sec, with 1-s average v, for station ch; seconds skipped *
+ * since the last one pushed had no data                                */
+static void Push (SUDS_RSAM *rs, int ch, long sec, float v)
+{
+  RSAM_CHAN  *c = rs->ch[ch];
+  RSAM_SLOT  *slot;
+  long        s;
+  int         w;
+
+  if (c->done >= 0 && sec <= c->done)
+    return;
+  if (c->done < 0 || sec - c->done > RING)
+  {
+    for (w = 0; w < RSAM_NWIN; w++)
+    {
+      c->sum[w] = 0.0;
+      c->n[w] = 0;
+    }
+    s = sec;
+  }
+  else
+    s = c->done + 1;
+
+  for (; s <= sec; s++)
+  {
+    /* drop the seconds falling out of the windows; the slot for s - RING *
+     * is the one about to be reused, so this comes first                 */
+    for (w = 1; w < RSAM_NWIN; w++)
+      Leave (c, s - WinLen[w], w);
+
+    slot = &c->ring[s % RING];
+    slot->sec = s;
+    slot->avg[RSAM_1S] = (s == sec) ? v : -1.0f;
+    for (w = 1; w < RSAM_NWIN; w++)
+    {
+      if (s == sec)
+      {
+        c->sum[w] += v;
+        c->n[w]++;
+      }
+      slot->avg[w] = (c->n[w] > 0) ? (float) (c->sum[w] / c->n[w]) : -1.0f;
+    }
+    if ((s + 1) % 60 == 0)
+      Archive (rs, ch, s);
+  }
+  c->done = sec;
+}
+
+static void Leave (RSAM_CHAN *c, long s, int w)
+{
+  RSAM_SLOT  *slot;
+
+  if (s < 0)
+    return;
+  slot = &c->ring[s % RING];
+  if (slot->sec != s || slot->avg[RSAM_1S] < 0.0f)
+    return;
+  c->sum[w] -= slot->avg[RSAM_1S];
+  if (--c->n[w] == 0)
+    c->sum[w] = 0.0;               /* don't let rounding pile up */
+}
+
+/* Write the minute ending with second s to the archive */
+static void Archive (SUDS_RSAM *rs, int ch, long s)
+{
+  RSAM_CHAN    *c = rs->ch[ch];
+  SUDS_RSAMREC  rec;
+
+  if (rs->arch == NULL || c->n[RSAM_1MIN] == 0)
+    return;
+  rec.time = (int) (s + 1 - 60);
+  rec.rsam = (float) (c->sum[RSAM_1MIN] / c->n[RSAM_1MIN]);
+  rec.chan = (short) ch;
+  rec.nsec = (short) c->n[RSAM_1MIN];
+  if (fwrite (&rec, sizeof (rec), 1, rs->arch) != 1)
+    logit ("e", "SudsRsam: error writing RSAM archive\n");
+}
+
+/* Judge every second all stations are done with (or, finally, every second */
+/* any station is done with)                                                */
+static void Judge (SUDS_RSAM *rs, int final)
+{
+  long  hi = -1, lo = -1;
+  long  from, upto, s;
+  int   i;
+
+  for (i = 0; i < rs->nch; i++)
+  {
+    if (rs->ch[i]->done < 0)
+      continue;
+    if (hi < rs->ch[i]->done)
+      hi = rs->ch[i]->done;
+    if (lo < 0 || lo > rs->ch[i]->done)
+      lo = rs->ch[i]->done;
+  }
+  if (hi < 0)
+    return;
+  upto = final ? hi : ((lo > hi - rs->MaxLag) ? lo : hi - rs->MaxLag);
+
+  /* the rings only go back so far */
+  from = rs->judged + 1;
+  if (from < hi - RING + 1)
+    from = hi - RING + 1;
+  for (s = from; s <= upto; s++)
+    JudgeSecond (rs, s);
+  if (upto > rs->judged)
+    rs->judged = upto;
+}
+
+static void JudgeSecond (SUDS_RSAM *rs, long s)
+{
+  RSAM_RULE  *rule;
+  double      th;
+  float       v;
+  int         r, i, over;
+
+  for (r = 0; r < RSAM_NRULE; r++)
+  {
+    rule = &rs->rule[r];
+    if ((s + 1) % rule->every != 0 || s + 1 < rule->quiet)
+      continue;
+    over = 0;
+    for (i = 0; i < rs->nch; i++)
+    {
+      th = rs->ch[i]->thresh[r];
+      v = SlotValue (rs->ch[i], s, rule->window);
+      if (th > 0.0 && v >= 0.0f && v >= th)
+        over++;
+    }
+    if (over >= rule->MinStations)
+    {
+      WriteAlarm (rs, r, s + 1);
+      rule->quiet = s + 1 + rule->Holdoff;
+    }
+  }
+}
+
+/* Station c's average over window as of second s; -1 for no data */
+static float SlotValue (RSAM_CHAN *c, long s, int window)
+{
+  RSAM_SLOT  *slot = &c->ring[s % RING];
+
+  return (slot->sec == s) ? slot->avg[window] : -1.0f;
+}
+
+/* One alarm line: the time, then each station's threshold and average */
+static void WriteAlarm (SUDS_RSAM *rs, int r, long t)
+{
+  FILE       *fp = rs->fp[r];
+  char        sep = (r == RSAM_EVENT) ? '\t' : ',';
+  struct tm   tm;
+  time_t      tt = (time_t) t;
+  float       v;
+  int         i;
+
+  if (fp == NULL)
+    return;
+  gmtime_ew (&tt, &tm);
+  fprintf (fp, "%02d-%s-%04d %02d:%02d:%02d", tm.tm_mday, Month[tm.tm_mon],
+           tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+  for (i = 0; i < rs->nch; i++)
+  {
+    v = SlotValue (rs->ch[i], t - 1, rs->rule[r].window);
+    fprintf (fp, "%c%4.0f%c%4.0f", sep, rs->ch[i]->thresh[r], sep,
+             (v > 0.0f) ? v : 0.0);
+  }
+  fprintf (fp, "\n");
+  fflush (fp);
+}
+
+double SudsRsamValue (SUDS_RSAM *rs, int ch, int window)
+{
+  double  v = -1.0;
+
+  if (rs == NULL || ch < 0 || ch >= rs->nch || window < 0 || window >= RSAM_NWIN)
+    return -1.0;
+  pthread_mutex_lock (&rs->mutex);
+  if (rs->ch[ch]->done >= 0)
+    v = SlotValue (rs->ch[ch], rs->ch[ch]->done, window);
+  pthread_mutex_unlock (&rs->mutex);
+  return v;
+}
+
+/************************************************************************
+* SudsRsamDestroy: push the seconds still being summed, judge the rest, *
+*       and close up                                                    *
+*************************************************************************/
+int SudsRsamDestroy (SUDS_RSAM *rs)
+{
+  RSAM_CHAN  *c;
+  int         ret = EW_SUCCESS;
+  int         i;
+
+  if (rs == NULL)
+    return EW_SUCCESS;
+  pthread_mutex_lock (&rs->mutex);
+  for (i = 0; i < rs->nch; i++)
+  {
+    c = rs->ch[i];
+    if (c->cur >= 0 && c->nabs > 0)
+      Push (rs, i, c->cur, (float) (c->abs_sum / c->nabs));
+  }
+  Judge (rs, 1);
+  pthread_mutex_unlock (&rs->mutex);
+
+  for (i = 0; i < RSAM_NRULE; i++)
+    if (rs->fp[i] != NULL && fclose (rs->fp[i]) != 0)
+      ret = EW_FAILURE;
+  if (rs->arch != NULL && fclose (rs->arch) != 0)
+  {
+    logit ("e", "SudsRsamDestroy: error writing RSAM archive\n");
+    ret = EW_FAILURE;
+  }
+  for (i = 0; i < rs->nch; i++)
+  {
+    pthread_mutex_destroy (&rs->ch[i]->feed);
+    free (rs->ch[i]);
+  }
+  free (rs->ch);
+  pthread_mutex_destroy (&rs->mutex);
+  free (rs);
+  return ret;
+}
@@ -0,0 +1,67 @@
+/* sudsstats.c
+
+        Trace statistics for sudsputaway.c
+
+   The sums themselves are taken by the conversion kernels in
+   sudsconvert.c as they copy the samples; what is here starts a trace,
+   accounts for gap fill, and turns the sums into the numbers written
+   to the file. See sudsstats.h.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <sudsstats.h>
+
+void SudsStatsInit (SUDS_STATS *st, int32_t cliplo, int32_t cliphi)
+{
+  memset (st, 0, sizeof (SUDS_STATS));
+  st->min = INT32_MAX;
+  st->max = INT32_MIN;
+  st->cliplo = cliplo;
+  st->cliphi = cliphi;
+}
+
+/* Fill only matters to avenoise, which averages the trace as written */
+void SudsStatsFill (SUDS_STATS *st, long n, int32_t value)
+{
+  int64_t  k = SUDS_HEAD_SAMPLES - st->nhead;
+
+  if (k <= 0)
+    return;
+  if (k > n)
+    k = n;
+  st->headsum += k * value;
+  st->nhead += k;
+}
+
+float SudsStatsAvenoise (const SUDS_STATS *st)
+{
+  if (st->nhead == 0)
+    return 0.0f;
+  return (float) ((double) st->headsum / (double) st->nhead);
+}
+
+void SudsStatsRecord (const SUDS_STATS *st, SUDS_CHANSTATS *cs)
+{
+  double  ms, ac;
+
+  cs->length = (int32_t) st->n;
+  cs->numclip = (int32_t) st->nclip;
+  cs->clip_lo = st->cliplo;
+  cs->clip_hi = st->cliphi;
+  cs->avenoise = SudsStatsAvenoise (st);
+  if (st->n == 0)
+  {
+    cs->mindata = cs->maxdata = 0;
+    cs->mean = cs->rms = cs->rms_ac = 0.0;
+    return;
+  }
+  cs->mindata = st->min;
+  cs->maxdata = st->max;
+  cs->mean = (double) st->sum / (double) st->n;
+  ms = st->sumsq / (double) st->n;
+  cs->rms = sqrt (ms);
+  /* rounding can leave a flat trace a hair below zero */
+  ac = ms - cs->mean * cs->mean;
+  cs->rms_ac = (ac > 0.0) ? sqrt (ac) : 0.0;
+}
@@ -0,0 +1,465 @@
+/* sudsswap.c
+
+        Field tables and encoding for the PC-SUDS structs
+
+   Every field of every struct we read or write is listed here once,
+   with its place in the record in the file. The offsets are those of
+   SUDSFORM.H in the PC-SUDS library: structs packed to 2 bytes, longs
+   32 bits. Encoding copies each field into its place in the record,
+   narrowing integers to their width in the file and reversing the
+   bytes if the file's byte order isn't ours; decoding does the same
+   the other way.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <earthworm.h>
+#include <sudshead.h>
+#include <sudsstats.h>
+#include <sudsqc.h>
+#include <sudsswap.h>
+
+#define BYTES(type, field, disk, n) \
+  SUDS_FIELD_OF (type, field, disk, n, SUDS_FIELD_BYTES)
+#define CHAR(type, field, disk)    BYTES (type, field, disk, 1)
+#define SHORT(type, field, disk)   SUDS_FIELD_OF (type, field, disk, 2, SUDS_FIELD_INT)
+#define LONG(type, field, disk) \
+  SUDS_FIELD_OF (type, field, disk, SUDS_LONG_WIDTH, SUDS_FIELD_INT)
+#define FLOAT(type, field, disk)   SUDS_FIELD_OF (type, field, disk, 4, SUDS_FIELD_REAL)
+#define DOUBLE(type, field, disk)  SUDS_FIELD_OF (type, field, disk, 8, SUDS_FIELD_REAL)
+
+static const SUDS_FIELD TagFields[] = {
+  CHAR (SUDS_STRUCTTAG, sync, 0),
+  CHAR (SUDS_STRUCTTAG, machine, 1),
+  SHORT (SUDS_STRUCTTAG, id_struct, 2),
+  LONG (SUDS_STRUCTTAG, len_struct, 4),
+  LONG (SUDS_STRUCTTAG, len_data, 8),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD StationCompFields[] = {
+  SUDS_STATIDENT_OF (SUDS_STATIONCOMP, sc_name, 0),
+  SHORT (SUDS_STATIONCOMP, azim, 12),
+  SHORT (SUDS_STATIONCOMP, incid, 14),
+  DOUBLE (SUDS_STATIONCOMP, st_lat, 16),
+  DOUBLE (SUDS_STATIONCOMP, st_long, 24),
+  FLOAT (SUDS_STATIONCOMP, elev, 32),
+  CHAR (SUDS_STATIONCOMP, enclosure, 36),
+  CHAR (SUDS_STATIONCOMP, annotation, 37),
+  CHAR (SUDS_STATIONCOMP, recorder, 38),
+  CHAR (SUDS_STATIONCOMP, rockclass, 39),
+  SHORT (SUDS_STATIONCOMP, rocktype, 40),
+  CHAR (SUDS_STATIONCOMP, sitecondition, 42),
+  CHAR (SUDS_STATIONCOMP, sensor_type, 43),
+  CHAR (SUDS_STATIONCOMP, data_type, 44),
+  CHAR (SUDS_STATIONCOMP, data_units, 45),
+  CHAR (SUDS_STATIONCOMP, polarity, 46),
+  CHAR (SUDS_STATIONCOMP, st_status, 47),
+  FLOAT (SUDS_STATIONCOMP, max_gain, 48),
+  FLOAT (SUDS_STATIONCOMP, clip_value, 52),
+  FLOAT (SUDS_STATIONCOMP, con_mvolts, 56),
+  SHORT (SUDS_STATIONCOMP, channel, 60),
+  SHORT (SUDS_STATIONCOMP, atod_gain, 62),
+  LONG (SUDS_STATIONCOMP, effective, 64),
+  FLOAT (SUDS_STATIONCOMP, clock_correct, 68),
+  FLOAT (SUDS_STATIONCOMP, station_delay, 72),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD DescripTraceFields[] = {
+  SUDS_STATIDENT_OF (SUDS_DESCRIPTRACE, dt_name, 0),
+  DOUBLE (SUDS_DESCRIPTRACE, begintime, 12),
+  SHORT (SUDS_DESCRIPTRACE, localtime, 20),
+  CHAR (SUDS_DESCRIPTRACE, datatype, 22),
+  CHAR (SUDS_DESCRIPTRACE, descriptor, 23),
+  SHORT (SUDS_DESCRIPTRACE, digi_by, 24),
+  SHORT (SUDS_DESCRIPTRACE, processed, 26),
+  LONG (SUDS_DESCRIPTRACE, length, 28),
+  FLOAT (SUDS_DESCRIPTRACE, rate, 32),
+  FLOAT (SUDS_DESCRIPTRACE, mindata, 36),
+  FLOAT (SUDS_DESCRIPTRACE, maxdata, 40),
+  FLOAT (SUDS_DESCRIPTRACE, avenoise, 44),
+  LONG (SUDS_DESCRIPTRACE, numclip, 48),
+  DOUBLE (SUDS_DESCRIPTRACE, time_correct, 52),
+  FLOAT (SUDS_DESCRIPTRACE, rate_correct, 60),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD MuxDataFields[] = {
+  BYTES (SUDS_MUXDATA, netname, 0, 4),
+  DOUBLE (SUDS_MUXDATA, begintime, 4),
+  SHORT (SUDS_MUXDATA, loctime, 12),
+  SHORT (SUDS_MUXDATA, numchans, 14),
+  FLOAT (SUDS_MUXDATA, dig_rate, 16),
+  CHAR (SUDS_MUXDATA, typedata, 20),
+  CHAR (SUDS_MUXDATA, descript, 21),
+  SHORT (SUDS_MUXDATA, spareG, 22),
+  LONG (SUDS_MUXDATA, numsamps, 24),
+  LONG (SUDS_MUXDATA, blocksize, 28),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD CommentFields[] = {
+  SHORT (SUDS_COMMENT, refer, 0),
+  SHORT (SUDS_COMMENT, item, 2),
+  SHORT (SUDS_COMMENT, length, 4),
+  SHORT (SUDS_COMMENT, unused, 6),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD TriggersFields[] = {
+  SUDS_STATIDENT_OF (SUDS_TRIGGERS, tr_name, 0),
+  SHORT (SUDS_TRIGGERS, sta, 12),
+  SHORT (SUDS_TRIGGERS, lta, 14),
+  SHORT (SUDS_TRIGGERS, abs_sta, 16),
+  SHORT (SUDS_TRIGGERS, abs_lta, 18),
+  SHORT (SUDS_TRIGGERS, trig_value, 20),
+  SHORT (SUDS_TRIGGERS, num_triggers, 22),
+  DOUBLE (SUDS_TRIGGERS, trig_time, 24),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD DetectorFields[] = {
+  CHAR (SUDS_DETECTOR, dalgorithm, 0),
+  CHAR (SUDS_DETECTOR, event_type, 1),
+  BYTES (SUDS_DETECTOR, net_node_id, 2, 10),
+  FLOAT (SUDS_DETECTOR, versionnum, 12),
+  LONG (SUDS_DETECTOR, event_number, 16),
+  LONG (SUDS_DETECTOR, spareL, 20),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD TimeCorrectionFields[] = {
+  SUDS_STATIDENT_OF (SUDS_TIMECORRECTION, tm_name, 0),
+  DOUBLE (SUDS_TIMECORRECTION, time_correct, 12),
+  FLOAT (SUDS_TIMECORRECTION, rate_correct, 20),
+  CHAR (SUDS_TIMECORRECTION, sync_code, 24),
+  CHAR (SUDS_TIMECORRECTION, program, 25),
+  LONG (SUDS_TIMECORRECTION, effective_time, 26),
+  SHORT (SUDS_TIMECORRECTION, spareM, 30),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD ChanStatsFields[] = {
+  SUDS_STATIDENT_OF (SUDS_CHANSTATS, cs_name, 0),
+  LONG (SUDS_CHANSTATS, length, 12),
+  LONG (SUDS_CHANSTATS, mindata, 16),
+  LONG (SUDS_CHANSTATS, maxdata, 20),
+  LONG (SUDS_CHANSTATS, numclip, 24),
+  LONG (SUDS_CHANSTATS, clip_lo, 28),
+  LONG (SUDS_CHANSTATS, clip_hi, 32),
+  DOUBLE (SUDS_CHANSTATS, mean, 36),
+  DOUBLE (SUDS_CHANSTATS, rms, 44),
+  DOUBLE (SUDS_CHANSTATS, rms_ac, 52),
+  FLOAT (SUDS_CHANSTATS, avenoise, 60),
+  SUDS_FIELD_END
+};
+
+static const SUDS_FIELD ChanQcFields[] = {
+  SUDS_STATIDENT_OF (SUDS_CHANQC, qc_name, 0),
+  FLOAT (SUDS_CHANQC, quality, 12),
+  FLOAT (SUDS_CHANQC, snr, 16),
+  FLOAT (SUDS_CHANQC, signal, 20),
+  FLOAT (SUDS_CHANQC, noise, 24),
+  LONG (SUDS_CHANQC, nseconds, 28),
+  LONG (SUDS_CHANQC, zero_run, 32),
+  LONG (SUDS_CHANQC, neg1_run, 36),
+  LONG (SUDS_CHANQC, stuck_run, 40),
+  LONG (SUDS_CHANQC, numclip, 44),
+  LONG (SUDS_CHANQC, flags, 48),
+  SUDS_FIELD_END
+};
+
+/* struct type -> field table, bytes in the file and in memory */
+typedef struct
+{
+  int               id;
+  const SUDS_FIELD *fields;
+  long              len;
+  size_t            size;
+} SUDS_STRUCTDEF;
+
+static const SUDS_STRUCTDEF StructDefs[] = {
+  { STRUCTTAG,      TagFields,            SUDS_STRUCTTAG_LEN,      sizeof (SUDS_STRUCTTAG) },
+  { STATIONCOMP,    StationCompFields,    SUDS_STATIONCOMP_LEN,    sizeof (SUDS_STATIONCOMP) },
+  { MUXDATA,        MuxDataFields,        SUDS_MUXDATA_LEN,        sizeof (SUDS_MUXDATA) },
+  { DESCRIPTRACE,   DescripTraceFields,   SUDS_DESCRIPTRACE_LEN,   sizeof (SUDS_DESCRIPTRACE) },
+  { COMMENT,        CommentFields,        SUDS_COMMENT_LEN,        sizeof (SUDS_COMMENT) },
+  { TRIGGERS,       TriggersFields,       SUDS_TRIGGERS_LEN,       sizeof (SUDS_TRIGGERS) },
+  { DETECTOR,       DetectorFields,       SUDS_DETECTOR_LEN,       sizeof (SUDS_DETECTOR) },
+  { TIMECORRECTION, TimeCorrectionFields, SUDS_TIMECORRECTION_LEN, sizeof (SUDS_TIMECORRECTION) },
+  { SUDS_CHANSTATS_ID, ChanStatsFields,   SUDS_CHANSTATS_LEN,      sizeof (SUDS_CHANSTATS) },
+  { SUDS_CHANQC_ID,    ChanQcFields,      SUDS_CHANQC_LEN,         sizeof (SUDS_CHANQC) },
+};
+
+#define NUM_STRUCTDEFS  (sizeof (StructDefs) / sizeof (StructDefs[0]))
+
+static const SUDS_STRUCTDEF *FindStruct (int struct_type)
+{
+  size_t  i;
+
+  for (i = 0; i < NUM_STRUCTDEFS; i++)
+    if (StructDefs[i].id == struct_type)
+      return &StructDefs[i];
+  return NULL;
+}
+
+static void Reverse (unsigned char *p, int w)
+{
+  unsigned char  t;
+  int            i;
+
+  for (i = 0; i < w / 2; i++)
+  {
+    t = p[i];
+    p[i] = p[w - 1 - i];
+    p[w - 1 - i] = t;
+  }
+}
+
+/* An integer field of size bytes in memory, widened */
+static int64_t GetInt (const char *p, int size)
+{
+  int16_t  s;
+  int32_t  l;
+  int64_t  ll;
+
+  switch (size)
+  {
+  case 1:
+    return (signed char) *p;
+  case 2:
+    memcpy (&s, p, 2);
+    return s;
+  case 4:
+    memcpy (&l, p, 4);
+    return l;
+  default:
+    memcpy (&ll, p, 8);
+    return ll;
+  }
+}
+
+static void PutInt (char *p, int size, int64_t v)
+{
+  int16_t  s = (int16_t) v;
+  int32_t  l = (int32_t) v;
+
+  switch (size)
+  {
+  case 1:
+    *p = (char) v;
+    break;
+  case 2:
+    memcpy (p, &s, 2);
+    break;
+  case 4:
+    memcpy (p, &l, 4);
+    break;
+  default:
+    memcpy (p, &v, 8);
+    break;
+  }
+}
+
+/************************************************************************
+* SudsParseOrder: turn an OutputFormat string into a byte order         *
+*************************************************************************/
+int SudsParseOrder (const char *OutputFormat, SUDS_ORDER *order)
+{
+  if (strcmp (OutputFormat, "intel") == 0)
+    *order = SUDS_ORDER_INTEL;
+  else if (strcmp (OutputFormat, "sparc") == 0)
+    *order = SUDS_ORDER_SPARC;
+  else
+    return EW_FAILURE;
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsEncodeFields: put each field in the table into its place in the   *
+*       record                                                          *
+*************************************************************************/
+void SudsEncodeFields (char *out, const void *ptr, const SUDS_FIELD *fields,
+                       int swap)
+{
+  const char     *p;
+  unsigned char  *q;
+
+  for (; fields->width != 0; fields++)
+  {
+    p = (const char *) ptr + fields->offset;
+    q = (unsigned char *) out + fields->disk;
+    if (fields->kind == SUDS_FIELD_INT)
+      PutInt ((char *) q, fields->width, GetInt (p, fields->size));
+    else
+      memcpy (q, p, fields->width);
+    if (swap && fields->kind != SUDS_FIELD_BYTES)
+      Reverse (q, fields->width);
+  }
+}
+
+/************************************************************************
+* SudsDecodeFields: take each field in the table from its place in the  *
+*       record                                                          *
+*************************************************************************/
+void SudsDecodeFields (void *ptr, const char *in, size_t len,
+                       const SUDS_FIELD *fields, int swap)
+{
+  unsigned char  buf[8];
+  char          *p;
+
+  for (; fields->width != 0; fields++)
+  {
+    if ((size_t) fields->disk + fields->width > len)
+      continue;
+    p = (char *) ptr + fields->offset;
+    if (fields->kind == SUDS_FIELD_BYTES)
+    {
+      memcpy (p, in + fields->disk, fields->width);
+      continue;
+    }
+    memcpy (buf, in + fields->disk, fields->width);
+    if (swap)
+      Reverse (buf, fields->width);
+    if (fields->kind == SUDS_FIELD_INT)
+      PutInt (p, fields->size, GetInt ((char *) buf, fields->width));
+    else
+      memcpy (p, buf, fields->width);
+  }
+}
+
+/************************************************************************
+* SudsCheckFields: does the table lay out len bytes, with no gaps or    *
+*       overlaps, and fit each field to its width?                      *
+*************************************************************************/
+int SudsCheckFields (const SUDS_FIELD *fields, long len)
+{
+  long  at = 0;
+
+  for (; fields->width != 0; fields++)
+  {
+    if (fields->disk != at)
+      return EW_FAILURE;
+    switch (fields->kind)
+    {
+    case SUDS_FIELD_BYTES:
+      if (fields->size < fields->width)
+        return EW_FAILURE;
+      break;
+    case SUDS_FIELD_INT:
+      if ((fields->width != 2 && fields->width != 4)
+          || (fields->size != 1 && fields->size != 2 && fields->size != 4
+              && fields->size != 8))
+        return EW_FAILURE;
+      break;
+    case SUDS_FIELD_REAL:
+      if ((fields->width != 4 && fields->width != 8) || fields->size != fields->width)
+        return EW_FAILURE;
+      break;
+    default:
+      return EW_FAILURE;
+    }
+    at += fields->width;
+  }
+  return (at == len) ? EW_SUCCESS : EW_FAILURE;
+}
+
+/************************************************************************
+* SudsCheckLayout: check every struct table                             *
+*************************************************************************/
+int SudsCheckLayout (void)
+{
+  size_t  i;
+  int     ret = EW_SUCCESS;
+
+  for (i = 0; i < NUM_STRUCTDEFS; i++)
+    if (SudsCheckFields (StructDefs[i].fields, StructDefs[i].len) != EW_SUCCESS)
+    {
+      logit ("e", "SudsCheckLayout: table for struct %d doesn't make %ld bytes\n",
+             StructDefs[i].id, StructDefs[i].len);
+      ret = EW_FAILURE;
+    }
+  return ret;
+}
+
+/************************************************************************
+* SudsStructLen: bytes a struct of a known SUDS type takes in the file  *
+*************************************************************************/
+long SudsStructLen (int struct_type)
+{
+  const SUDS_STRUCTDEF  *def = FindStruct (struct_type);
+
+  return (def != NULL) ? def->len : 0;
+}
+
+/************************************************************************
+* SudsEncodeStruct: encode a struct of a known SUDS type                *
+*************************************************************************/
+int SudsEncodeStruct (char *out, int struct_type, const void *ptr, int swap)
+{
+  const SUDS_STRUCTDEF  *def;
+
+  if (ptr == NULL || out == NULL)
+  {
+    logit ("e", "SudsEncodeStruct: NULL pointer passed in.\n");
+    return EW_FAILURE;
+  }
+  if ((def = FindStruct (struct_type)) == NULL)
+  {
+    logit ("e", "SudsEncodeStruct: Don't know about type %d\n", struct_type);
+    return EW_FAILURE;
+  }
+  memset (out, 0, def->len);
+  SudsEncodeFields (out, ptr, def->fields, swap);
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsDecodeStruct: decode a struct of a known SUDS type                *
+*************************************************************************/
+int SudsDecodeStruct (void *ptr, int struct_type, const char *in, long len,
+                      int swap)
+{
+  const SUDS_STRUCTDEF  *def;
+
+  if (ptr == NULL || in == NULL)
+  {
+    logit ("e", "SudsDecodeStruct: NULL pointer passed in.\n");
+    return EW_FAILURE;
+  }
+  if ((def = FindStruct (struct_type)) == NULL)
+  {
+    logit ("e", "SudsDecodeStruct: Don't know about type %d\n", struct_type);
+    return EW_FAILURE;
+  }
+  if (len != def->len)
+  {
+    logit ("e", "SudsDecodeStruct: struct %d is %ld bytes, expected %ld\n",
+           struct_type, len, def->len);
+    return EW_FAILURE;
+  }
+  memset (ptr, 0, def->size);
+  SudsDecodeFields (ptr, in, (size_t) len, def->fields, swap);
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsEncodeRecord: encode a tag and the struct it introduces           *
+*************************************************************************/
+int SudsEncodeRecord (char *out, int struct_type, const void *ptr,
+                      long len_data, int swap)
+{
+  SUDS_STRUCTTAG  tag;
+
+  memset (&tag, 0, sizeof (tag));
+  tag.sync = 'S';
+  tag.machine = SUDS_MACHINE (SUDS_SWAP_ORDER (swap));
+  tag.id_struct = (short) struct_type;
+  tag.len_struct = SudsStructLen (struct_type);
+  tag.len_data = len_data;
+  if (SudsEncodeStruct (out, STRUCTTAG, &tag, swap) != EW_SUCCESS)
+    return EW_FAILURE;
+  return SudsEncodeStruct (out + SUDS_STRUCTTAG_LEN, struct_type, ptr, swap);
+}
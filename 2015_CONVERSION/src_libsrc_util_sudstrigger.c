@@ -0,0 +1,529 @@
+/* sudstrigger.c
+
+        Recursive STA/LTA triggering and a network coincidence
+        trigger; see sudstrigger.h
+
+   Each quantity of the detectors (DC level, averages, coefficients,
+   trigger state) is an array with a slot per channel. Row updates a
+   run of neighbouring slots for one sample time in a loop with no
+   branches in it, so it vectorizes across the channels of a
+   multiplexed scan; the rare sample where some channel turns on or off
+   is handled after the row, in Step. A channel's slots are only touched under
+   its own lock; the coincidence trigger takes the engine's lock.
+*/
+
+#include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <earthworm.h>
+#include <swap.h>
+#include <trace_buf.h>
+#include <sudshead.h>
+#include <sudstrigger.h>
+
+#define CHUNK           4096           /* samples converted at a time */
+#define RECENT          512            /* channel triggers kept for coincidence */
+
+typedef struct
+{
+  char    sta[TRACE_STA_LEN];
+  char    chan[TRACE_CHAN_LEN];
+  char    net[TRACE_NET_LEN];
+  double  rate;
+  double  last;                        /* time of the last sample; -1 none */
+} TRIG_NAME;
+
+typedef struct
+{
+  double  t;
+  int     ch;
+} TRIG_ON;
+
+struct _SUDS_TRIG
+{
+  int     MaxChans;
+  int     nch;
+  TRIG_NAME *name;
+  pthread_mutex_t *feed;               /* one per channel */
+
+  /* detector state, a slot per channel */
+  float  *dc;                          /* DC level, followed over LtaSec */
+  float  *msta, *mlta;                 /* means of the samples */
+  float  *sta, *lta;                   /* averages of |x - dc| */
+  float  *cs, *cl;                     /* 1 / (StaSec * rate), 1 / (LtaSec * rate) */
+  float  *on, *off;                    /* ratios */
+  int    *trig;                        /* 1 while triggered, else 0 */
+  int    *warm;                        /* samples before it may trigger */
+  int    *flip;                        /* turned on or off this sample */
+
+  /* settings for channels taken on from now on */
+  double  StaSec, LtaSec, OnRatio, OffRatio;
+
+  /* coincidence; guarded by mutex */
+  int     MinStations;
+  double  Window;
+  SUDS_TRIG_EVENT done;
+  void   *arg;
+  TRIG_ON recent[RECENT];
+  long    nrecent;
+  SUDS_NETEVENT ev;                    /* the last event declared */
+  double  ev_last;                     /* its latest channel trigger */
+  long   *evno;                        /* event each channel last counted in */
+  long   *mark;                        /* scratch, for counting channels */
+  long    stamp;
+  pthread_mutex_t mutex;
+};
+
+/* Internal Function Prototypes */
+static void Start (SUDS_TRIG *, int, float);
+static int Row (int, const float *, float *, float *, float *, float *,
+                float *, const float *, const float *, const float *,
+                const float *, const int *, int *, int *);
+static void Step (SUDS_TRIG *, int, int, const float *, long, long, double,
+                  long, double, SUDS_TRIGGERS *);
+static void Flip (SUDS_TRIG *, int, double, SUDS_TRIGGERS *);
+static void Coincide (SUDS_TRIG *, int, double);
+static short ToShort (double);
+
+SUDS_TRIG *SudsTrigCreate (int MaxChans)
+{
+  SUDS_TRIG  *tg;
+  size_t      n = (MaxChans > 0) ? (size_t) MaxChans : 1;
+
+  if ((tg = (SUDS_TRIG *) calloc (1, sizeof (SUDS_TRIG))) == NULL)
+  {
+    logit ("e", "SudsTrigCreate: couldn't malloc trigger engine\n");
+    return NULL;
+  }
+  pthread_mutex_init (&tg->mutex, NULL);
+  tg->MaxChans = (int) n;
+  tg->name = (TRIG_NAME *) calloc (n, sizeof (TRIG_NAME));
+  tg->feed = (pthread_mutex_t *) calloc (n, sizeof (pthread_mutex_t));
+  tg->dc = (float *) calloc (n, sizeof (float));
+  tg->msta = (float *) calloc (n, sizeof (float));
+  tg->mlta = (float *) calloc (n, sizeof (float));
+  tg->sta = (float *) calloc (n, sizeof (float));
+  tg->lta = (float *) calloc (n, sizeof (float));
+  tg->cs = (float *) calloc (n, sizeof (float));
+  tg->cl = (float *) calloc (n, sizeof (float));
+  tg->on = (float *) calloc (n, sizeof (float));
+  tg->off = (float *) calloc (n, sizeof (float));
+  tg->trig = (int *) calloc (n, sizeof (int));
+  tg->warm = (int *) calloc (n, sizeof (int));
+  tg->flip = (int *) calloc (n, sizeof (int));
+  tg->evno = (long *) calloc (n, sizeof (long));
+  tg->mark = (long *) calloc (n, sizeof (long));
+  if (tg->name == NULL || tg->feed == NULL || tg->dc == NULL
+      || tg->msta == NULL || tg->mlta == NULL || tg->sta == NULL
+      || tg->lta == NULL || tg->cs == NULL || tg->cl == NULL
+      || tg->on == NULL || tg->off == NULL || tg->trig == NULL
+      || tg->warm == NULL || tg->flip == NULL || tg->evno == NULL
+      || tg->mark == NULL)
+  {
+    logit ("e", "SudsTrigCreate: couldn't malloc %d channels\n", MaxChans);
+    SudsTrigDestroy (tg);
+    return NULL;
+  }
+  tg->StaSec = 1.0;
+  tg->LtaSec = 30.0;
+  tg->OnRatio = 4.0;
+  tg->OffRatio = 1.5;
+  tg->MinStations = 3;
+  tg->Window = 10.0;
+  return tg;
+}
+
+int SudsTrigSetDetector (SUDS_TRIG *tg, double StaSec, double LtaSec,
+                         double OnRatio, double OffRatio)
+{
+  if (tg == NULL || StaSec <= 0.0 || LtaSec <= StaSec || OnRatio <= 1.0
+      || OffRatio <= 0.0 || OffRatio > OnRatio)
+  {
+    logit ("e", "SudsTrigSetDetector: bad detector settings\n");
+    return EW_FAILURE;
+  }
+  tg->StaSec = StaSec;
+  tg->LtaSec = LtaSec;
+  tg->OnRatio = OnRatio;
+  tg->OffRatio = OffRatio;
+  return EW_SUCCESS;
+}
+
+int SudsTrigSetCoincidence (SUDS_TRIG *tg, int MinStations, double Window,
+                            SUDS_TRIG_EVENT done, void *arg)
+{
+  if (tg == NULL || MinStations < 1 || Window < 0.0)
+  {
+    logit ("e", "SudsTrigSetCoincidence: bad coincidence settings\n");
+    return EW_FAILURE;
+  }
+  pthread_mutex_lock (&tg->mutex);
+  tg->MinStations = MinStations;
+  tg->Window = Window;
+  tg->done = done;
+  tg->arg = arg;
+  pthread_mutex_unlock (&tg->mutex);
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsTrigChannel: find a channel, or take it on                        *
+*************************************************************************/
+int SudsTrigChannel (SUDS_TRIG *tg, const char *sta, const char *chan,
+                     const char *net, double rate)
+{
+  TRIG_NAME  *nm;
+  double      cs, cl;
+  int         i;
+
+  if (tg == NULL || rate < 0.01)
+    return -1;
+  pthread_mutex_lock (&tg->mutex);
+  for (i = 0; i < tg->nch; i++)
+  {
+    nm = &tg->name[i];
+    if (strcmp (nm->sta, sta) == 0 && strcmp (nm->chan, chan) == 0
+        && strcmp (nm->net, net) == 0)
+    {
+      pthread_mutex_unlock (&tg->mutex);
+      return i;
+    }
+  }
+  if (tg->nch == tg->MaxChans)
+  {
+    pthread_mutex_unlock (&tg->mutex);
+    logit ("e", "SudsTrigChannel: no room for <%s.%s.%s>\n", sta, chan, net);
+    return -1;
+  }
+
+  nm = &tg->name[i];
+  strncpy (nm->sta, sta, TRACE_STA_LEN - 1);
+  strncpy (nm->chan, chan, TRACE_CHAN_LEN - 1);
+  strncpy (nm->net, net, TRACE_NET_LEN - 1);
+  nm->rate = rate;
+  nm->last = -1.0;
+  cs = 1.0 / (tg->StaSec * rate);
+  cl = 1.0 / (tg->LtaSec * rate);
+  tg->cs[i] = (float) ((cs < 1.0) ? cs : 1.0);
+  tg->cl[i] = (float) ((cl < 1.0) ? cl : 1.0);
+  tg->on[i] = (float) tg->OnRatio;
+  tg->off[i] = (float) tg->OffRatio;
+  tg->warm[i] = (int) ceil (tg->LtaSec * rate);
+  pthread_mutex_init (&tg->feed[i], NULL);
+  tg->nch++;
+  pthread_mutex_unlock (&tg->mutex);
+  return i;
+}
+
+/* A channel's first sample sets its levels */
+static void Start (SUDS_TRIG *tg, int c, float x)
+{
+  tg->dc[c] = tg->msta[c] = tg->mlta[c] = x;
+  tg->sta[c] = tg->lta[c] = 0.0f;
+  tg->trig[c] = 0;
+}
+
+/************************************************************************
+* SudsTrigFeed: run one packet through channel ch's detector            *
+*************************************************************************/
+int SudsTrigFeed (SUDS_TRIG *tg, int ch, const TRACE_HEADER *wf,
+                  const void *samples, char datatype, SUDS_TRIGGERS *tr)
+{
+  TRIG_NAME  *nm;
+  float       x[CHUNK];
+  double      rate = wf->samprate;
+  long        n = wf->nsamp;
+  long        k = 0, m, j;
+
+  if (tg == NULL || ch < 0 || ch >= tg->nch || rate < 0.01)
+    return EW_FAILURE;
+  nm = &tg->name[ch];
+
+  pthread_mutex_lock (&tg->feed[ch]);
+
+  /* skip anything already seen, as snippets of overlapping events repeat */
+  if (nm->last >= 0.0 && wf->starttime <= nm->last + 0.5 / rate)
+    k = (long) floor ((nm->last - wf->starttime) * rate + 0.5) + 1;
+
+  for (; k < n; k += m)
+  {
+    m = (n - k < CHUNK) ? n - k : CHUNK;
+    for (j = 0; j < m; j++)
+    {
+      if (datatype == 's')
+        x[j] = ((const short *) samples)[k + j];
+      else if (datatype == 'l')
+        x[j] = (float) ((const int32_t *) samples)[k + j];
+      else
+        x[j] = ((const float *) samples)[k + j];
+    }
+    if (nm->last < 0.0)
+      Start (tg, ch, x[0]);
+    Step (tg, ch, 1, x, 1, m, wf->starttime, k, rate, tr);
+    nm->last = wf->starttime + (k + m - 1) / rate;
+  }
+
+  pthread_mutex_unlock (&tg->feed[ch]);
+  return EW_SUCCESS;
+}
+
+/************************************************************************
+* SudsTrigFeedMux: run multiplexed scans through a run of channels      *
+*************************************************************************/
+int SudsTrigFeedMux (SUDS_TRIG *tg, int first, int nch, const char *mux,
+                     int swap, long nscan, double t0, SUDS_TRIGGERS *tr)
+{
+  float       x[CHUNK];
+  double      rate, last;
+  long        i = 0, m, j, rows;
+  short       s;
+  int         c;
+
+  if (tg == NULL || first < 0 || nch < 1 || nch > CHUNK
+      || first + nch > tg->nch)
+    return EW_FAILURE;
+  rate = tg->name[first].rate;
+  rows = CHUNK / nch;
+  for (c = first; c < first + nch; c++)
+    pthread_mutex_lock (&tg->feed[c]);
+
+  last = tg->name[first].last;
+  if (last >= 0.0 && t0 <= last + 0.5 / rate)
+    i = (long) floor ((last - t0) * rate + 0.5) + 1;
+
+  for (; i < nscan; i += m)
+  {
+    m = (nscan - i < rows) ? nscan - i : rows;
+    for (j = 0; j < m * nch; j++)
+    {
+      memcpy (&s, mux + (i * nch + j) * sizeof (short), sizeof (short));
+      if (swap)
+        SwapShort (&s);
+      x[j] = s;
+    }
+    for (c = 0; c < nch; c++)
+      if (tg->name[first + c].last < 0.0)
+        Start (tg, first + c, x[c]);
+    Step (tg, first, nch, x, nch, m, t0, i, rate, tr);
+    for (c = first; c < first + nch; c++)
+      tg->name[c].last = t0 + (i + m - 1) / rate;
+  }
+
+  for (c = first + nch - 1; c >= first; c--)
+    pthread_mutex_unlock (&tg->feed[c]);
+  return EW_SUCCESS;
+}
+
+/* One sample time of nch neighbouring channels: update each detector *
+ * and note which turned on or off; returns whether any did. The       *
+ * arrays never overlap, and saying so lets the loop vectorize.        */
+static int Row (int nch, const float *restrict x, float *restrict dc,
+                float *restrict msta, float *restrict mlta,
+                float *restrict sta, float *restrict lta,
+                const float *restrict cs, const float *restrict cl,
+                const float *restrict on, const float *restrict off,
+                const int *restrict trig, int *restrict warm,
+                int *restrict flip)
+{
+  float  v, d, a;
+  int    k, up, down, any = 0;
+
+  for (k = 0; k < nch; k++)
+  {
+    v = x[k];
+    d = v - dc[k];
+    dc[k] += d * cl[k];
+    a = fabsf (d);
+    msta[k] += (v - msta[k]) * cs[k];
+    mlta[k] += (v - mlta[k]) * cl[k];
+    sta[k] += (a - sta[k]) * cs[k];
+    lta[k] += (a - lta[k]) * cl[k] * (float) (1 - trig[k]);
+    warm[k] -= (warm[k] > 0);
+    up = (sta[k] >= on[k] * lta[k]) & (lta[k] > 0.0f) & (warm[k] == 0);
+    down = (sta[k] < off[k] * lta[k]);
+    flip[k] = (trig[k] & down) | ((1 - trig[k]) & up);
+    any |= flip[k];
+  }
+  return any;
+}
+
+/* m samples of channels first..first+nch-1, row i at x + i * stride and *
+ * time t0 + (k + i) / rate; the time doesn't depend on how a packet is   *
+ * cut into chunks, so multiplexed and single channels agree             */
+static void Step (SUDS_TRIG *tg, int first, int nch, const float *x,
+                  long stride, long m, double t0, long k, double rate,
+                  SUDS_TRIGGERS *tr)
+{
+  long  i;
+  int   c;
+
+  for (i = 0; i < m; i++)
+  {
+    if (!Row (nch, x + i * stride, tg->dc + first, tg->msta + first,
+              tg->mlta + first, tg->sta + first, tg->lta + first,
+              tg->cs + first, tg->cl + first, tg->on + first,
+              tg->off + first, tg->trig + first, tg->warm + first,
+              tg->flip + first))
+      continue;
+    for (c = 0; c < nch; c++)
+      if (tg->flip[first + c])
+        Flip (tg, first + c, t0 + (k + i) / rate,
+              (tr != NULL) ? &tr[c] : NULL);
+  }
+}
+
+/* Channel c turns on or off at time t */
+static void Flip (SUDS_TRIG *tg, int c, double t, SUDS_TRIGGERS *tr)
+{
+  if (tg->trig[c])
+  {
+    tg->trig[c] = 0;
+    return;
+  }
+  tg->trig[c] = 1;
+  if (tr != NULL)
+  {
+    if (tr->num_triggers == 0)
+    {
+      tr->sta = ToShort (tg->msta[c]);
+      tr->lta = ToShort (tg->mlta[c]);
+      tr->abs_sta = ToShort (tg->sta[c]);
+      tr->abs_lta = ToShort (tg->lta[c]);
+      tr->trig_value = ToShort (100.0 * tg->sta[c] / tg->lta[c]);
+      tr->trig_time = t;
+    }
+    if (tr->num_triggers < SHRT_MAX)
+      tr->num_triggers++;
+  }
+  Coincide (tg, c, t);
+}
+
+/* Channel c turned on at time t: part of the last event, a new one, or *
+ * neither                                                              */
+static void Coincide (SUDS_TRIG *tg, int c, double t)
+{
+  SUDS_NETEVENT  *ev = &tg->ev;
+  TRIG_ON        *r;
+  double          on = t, last = t;
+  long            i, n;
+  int             nsta = 0;
+
+  pthread_mutex_lock (&tg->mutex);
+  r = &tg->recent[tg->nrecent++ % RECENT];
+  r->t = t;
+  r->ch = c;
+
+  if (ev->number > 0 && t >= ev->on_time - tg->Window
+      && t <= tg->ev_last + tg->Window)
+  {
+    if (tg->evno[c] != ev->number)
+    {
+      tg->evno[c] = ev->number;
+      ev->nsta++;
+    }
+    if (ev->on_time > t)
+      ev->on_time = t;
+    if (tg->ev_last < t)
+      tg->ev_last = t;
+    pthread_mutex_unlock (&tg->mutex);
+    return;
+  }
+
+  n = (tg->nrecent < RECENT) ? tg->nrecent : RECENT;
+  tg->stamp++;
+  for (i = 0; i < n; i++)
+  {
+    r = &tg->recent[i];
+    if (fabs (r->t - t) > tg->Window || tg->mark[r->ch] == tg->stamp)
+      continue;
+    tg->mark[r->ch] = tg->stamp;
+    nsta++;
+    if (on > r->t)
+      on = r->t;
+    if (last < r->t)
+      last = r->t;
+  }
+  if (nsta >= tg->MinStations)
+  {
+    ev->number++;
+    ev->on_time = on;
+    ev->nsta = nsta;
+    tg->ev_last = last;
+    for (i = 0; i < tg->nch; i++)
+      if (tg->mark[i] == tg->stamp)
+        tg->evno[i] = ev->number;
+    if (tg->done != NULL)
+      tg->done (tg->arg, ev);
+  }
+  pthread_mutex_unlock (&tg->mutex);
+}
+
+static short ToShort (double v)
+{
+  if (v >= SHRT_MAX)
+    return SHRT_MAX;
+  if (v <= SHRT_MIN)
+    return SHRT_MIN;
+  return (short) floor (v + 0.5);
+}
+
+long SudsTrigLastEvent (SUDS_TRIG *tg)
+{
+  long  n;
+
+  if (tg == NULL)
+    return 0;
+  pthread_mutex_lock (&tg->mutex);
+  n = tg->ev.number;
+  pthread_mutex_unlock (&tg->mutex);
+  return n;
+}
+
+void SudsTrigDetector (SUDS_TRIG *tg, long events_before, SUDS_DETECTOR *de)
+{
+  long  n = SudsTrigLastEvent (tg);
+
+  memset (de, 0, sizeof (SUDS_DETECTOR));
+  de->dalgorithm = 'r';
+  strncpy (de->net_node_id, "stalta", sizeof (de->net_node_id) - 1);
+  de->versionnum = 1.0f;
+  if (n > events_before)
+  {
+    de->event_type = 't';
+    de->event_number = n;
+  }
+  else
+    de->event_type = 'u';
+}
+
+void SudsTrigDestroy (SUDS_TRIG *tg)
+{
+  int  i;
+
+  if (tg == NULL)
+    return;
+  for (i = 0; i < tg->nch; i++)
+    pthread_mutex_destroy (&tg->feed[i]);
+  pthread_mutex_destroy (&tg->mutex);
+  free (tg->name);
+  free (tg->feed);
+  free (tg->dc);
+  free (tg->msta);
+  free (tg->mlta);
+  free (tg->sta);
+  free (tg->lta);
+  free (tg->cs);
+  free (tg->cl);
+  free (tg->on);
+  free (tg->off);
+  free (tg->trig);
+  free (tg->warm);
+  free (tg->flip);
+  free (tg->evno);
+  free (tg->mark);
+  free (tg);
+}